@@ -82,6 +82,10 @@ RegImportBinaryHive(
         return FALSE;
     }
 
+    /* Index the subkeys of large keys such as Services (best effort) */
+    if (!CmpInitializeSubKeyIndex(&CmHive->Hive))
+        WARN("Cannot create the subkey index, lookups will be slower\n");
+
     /* Save the root key node */
     RootKeyNode = (PCM_KEY_NODE)HvGetCell(&CmHive->Hive, CmHive->Hive.BaseBlock->RootCell);
 
@@ -55,6 +55,14 @@ RtlpGetMode(VOID)
    return UserMode;
 }
 
+ULONG
+NTAPI
+RtlpGetHeapAffinity(VOID)
+{
+    /* Spread threads over the affinity slots by their ID */
+    return HandleToUlong(NtCurrentTeb()->ClientId.UniqueThread) >> 2;
+}
+
 /*
  * @implemented
  */
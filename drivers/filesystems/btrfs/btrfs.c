@@ -3662,6 +3662,7 @@ static NTSTATUS load_chunk_root(_In_ _Requires_lock_held_(_Curr_->tree_lock) dev
 
                 InitializeListHead(&c->space);
                 InitializeListHead(&c->space_size);
+                c->space_root = c->space_size_root = NULL;
                 InitializeListHead(&c->deleting);
                 InitializeListHead(&c->changed_extents);
 
@@ -523,11 +523,20 @@ typedef struct _root_cache {
     struct _root_cache* next;
 } root_cache;
 
+typedef struct _space_node {
+    struct _space_node* parent;
+    struct _space_node* left;
+    struct _space_node* right;
+    uint32_t priority;
+} space_node;
+
 typedef struct {
     uint64_t address;
     uint64_t size;
     LIST_ENTRY list_entry;
     LIST_ENTRY list_entry_size;
+    space_node address_node;
+    space_node size_node;
 } space;
 
 typedef struct {
@@ -578,6 +587,8 @@ typedef struct {
     fcb* old_cache;
     LIST_ENTRY space;
     LIST_ENTRY space_size;
+    space_node* space_root;
+    space_node* space_size_root;
     LIST_ENTRY deleting;
     LIST_ENTRY changed_extents;
     LIST_ENTRY range_locks;
@@ -1509,6 +1520,8 @@ NTSTATUS allocate_cache(device_extension* Vcb, bool* changed, PIRP Irp, LIST_ENT
 NTSTATUS update_chunk_caches(device_extension* Vcb, PIRP Irp, LIST_ENTRY* rollback);
 NTSTATUS update_chunk_caches_tree(device_extension* Vcb, PIRP Irp);
 NTSTATUS add_space_entry(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t offset, uint64_t size);
+space* find_space_at_address(chunk* c, uint64_t address);
+space* find_space_best_fit(chunk* c, uint64_t length);
 void space_list_add(chunk* c, uint64_t address, uint64_t length, LIST_ENTRY* rollback);
 void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address, uint64_t length, chunk* c, LIST_ENTRY* rollback);
 void space_list_subtract(chunk* c, bool deleting, uint64_t address, uint64_t length, LIST_ENTRY* rollback);
@@ -735,7 +735,6 @@ static bool insert_tree_extent_skinny(device_extension* Vcb, uint8_t level, uint
 }
 
 bool find_metadata_address_in_chunk(device_extension* Vcb, chunk* c, uint64_t* address) {
-    LIST_ENTRY* le;
     space* s;
 
     TRACE("(%p, %I64x, %p)\n", Vcb, c->offset, address);
@@ -768,51 +767,22 @@ bool find_metadata_address_in_chunk(device_extension* Vcb, chunk* c, uint64_t* a
         }
     }
 
-    le = c->space.Flink;
-    while (le != &c->space) {
-        s = CONTAINING_RECORD(le, space, list_entry);
-
-        if (s->address <= c->last_alloc && s->address + s->size >= c->last_alloc + Vcb->superblock.node_size) {
-            *address = c->last_alloc;
-            c->last_alloc += Vcb->superblock.node_size;
-            return true;
-        }
-
-        le = le->Flink;
-    }
-
-    le = c->space_size.Flink;
-    while (le != &c->space_size) {
-        s = CONTAINING_RECORD(le, space, list_entry_size);
+    s = find_space_at_address(c, c->last_alloc);
 
-        if (s->size == Vcb->superblock.node_size) {
-            *address = s->address;
-            c->last_alloc = s->address + Vcb->superblock.node_size;
-            return true;
-        } else if (s->size < Vcb->superblock.node_size) {
-            if (le == c->space_size.Flink)
-                return false;
-
-            s = CONTAINING_RECORD(le->Blink, space, list_entry_size);
-
-            *address = s->address;
-            c->last_alloc = s->address + Vcb->superblock.node_size;
-
-            return true;
-        }
-
-        le = le->Flink;
+    if (s && s->address + s->size >= c->last_alloc + Vcb->superblock.node_size) {
+        *address = c->last_alloc;
+        c->last_alloc += Vcb->superblock.node_size;
+        return true;
     }
 
-    s = CONTAINING_RECORD(c->space_size.Blink, space, list_entry_size);
+    s = find_space_best_fit(c, Vcb->superblock.node_size);
+    if (!s)
+        return false;
 
-    if (s->size > Vcb->superblock.node_size) {
-        *address = s->address;
-        c->last_alloc = s->address + Vcb->superblock.node_size;
-        return true;
-    }
+    *address = s->address;
+    c->last_alloc = s->address + Vcb->superblock.node_size;
 
-    return false;
+    return true;
 }
 
 static bool insert_tree_extent(device_extension* Vcb, uint8_t level, uint64_t root_id, chunk* c, uint64_t* new_address, PIRP Irp, LIST_ENTRY* rollback) {
@@ -187,6 +187,207 @@ NTSTATUS clear_free_space_cache(device_extension* Vcb, LIST_ENTRY* batchlist, PI
     return Status;
 }
 
+// The free space of each chunk is also indexed by two treaps, one keyed on the
+// address of each entry and one on its size, so that the allocators and
+// space_list_add2 / space_list_subtract2 don't need to walk the lists. The
+// lists stay authoritative: the size list is kept in descending order, i.e.
+// in the reverse order of the size tree.
+
+static uint32_t space_node_priority(space_node* n) {
+    uint64_t h = (uintptr_t)n;
+
+    // the pool hands out addresses in sequence, so mix them up a bit
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+
+    return (uint32_t)h;
+}
+
+static void space_node_rotate(space_node** root, space_node* n) {
+    space_node* p = n->parent;
+    space_node* g = p->parent;
+
+    if (p->left == n) {
+        p->left = n->right;
+
+        if (p->left)
+            p->left->parent = p;
+
+        n->right = p;
+    } else {
+        p->right = n->left;
+
+        if (p->right)
+            p->right->parent = p;
+
+        n->left = p;
+    }
+
+    p->parent = n;
+    n->parent = g;
+
+    if (!g)
+        *root = n;
+    else if (g->left == p)
+        g->left = n;
+    else
+        g->right = n;
+}
+
+static void space_node_link(space_node** root, space_node* n, space_node* parent, space_node** link) {
+    n->parent = parent;
+    n->left = n->right = NULL;
+    n->priority = space_node_priority(n);
+
+    *link = n;
+
+    while (n->parent && n->parent->priority < n->priority) {
+        space_node_rotate(root, n);
+    }
+}
+
+// Doesn't look at the key, so can be called after the entry has been resized.
+static void space_node_unlink(space_node** root, space_node* n) {
+    while (n->left || n->right) {
+        space_node* child;
+
+        if (!n->left)
+            child = n->right;
+        else if (!n->right)
+            child = n->left;
+        else
+            child = n->left->priority > n->right->priority ? n->left : n->right;
+
+        space_node_rotate(root, child);
+    }
+
+    if (!n->parent)
+        *root = NULL;
+    else if (n->parent->left == n)
+        n->parent->left = NULL;
+    else
+        n->parent->right = NULL;
+}
+
+static void add_space_address(space* s, LIST_ENTRY* list_size) {
+    chunk* c = CONTAINING_RECORD(list_size, chunk, space_size);
+    space_node *parent = NULL, **link = &c->space_root;
+
+    while (*link) {
+        parent = *link;
+
+        if (s->address < CONTAINING_RECORD(parent, space, address_node)->address)
+            link = &parent->left;
+        else
+            link = &parent->right;
+    }
+
+    space_node_link(&c->space_root, &s->address_node, parent, link);
+}
+
+static void order_space_entry(space* s, LIST_ENTRY* list_size) {
+    chunk* c = CONTAINING_RECORD(list_size, chunk, space_size);
+    space_node *parent = NULL, **link = &c->space_size_root;
+    space* next = NULL;
+
+    while (*link) {
+        space* s2 = CONTAINING_RECORD(*link, space, size_node);
+
+        parent = *link;
+
+        if (s->size < s2->size || (s->size == s2->size && s->address < s2->address)) {
+            next = s2;
+            link = &parent->left;
+        } else
+            link = &parent->right;
+    }
+
+    space_node_link(&c->space_size_root, &s->size_node, parent, link);
+
+    if (next)
+        InsertHeadList(&next->list_entry_size, &s->list_entry_size);
+    else
+        InsertHeadList(list_size, &s->list_entry_size);
+}
+
+static void remove_space_size(space* s, LIST_ENTRY* list_size) {
+    chunk* c = CONTAINING_RECORD(list_size, chunk, space_size);
+
+    space_node_unlink(&c->space_size_root, &s->size_node);
+    RemoveEntryList(&s->list_entry_size);
+}
+
+static void remove_space_entry(space* s, LIST_ENTRY* list_size) {
+    RemoveEntryList(&s->list_entry);
+
+    if (list_size) {
+        chunk* c = CONTAINING_RECORD(list_size, chunk, space_size);
+
+        space_node_unlink(&c->space_root, &s->address_node);
+        remove_space_size(s, list_size);
+    }
+}
+
+space* find_space_at_address(chunk* c, uint64_t address) {
+    space_node* n = c->space_root;
+    space* ret = NULL;
+
+    while (n) {
+        space* s = CONTAINING_RECORD(n, space, address_node);
+
+        if (s->address <= address) {
+            ret = s;
+            n = n->right;
+        } else
+            n = n->left;
+    }
+
+    return ret;
+}
+
+space* find_space_best_fit(chunk* c, uint64_t length) {
+    space_node* n = c->space_size_root;
+    space *below = NULL, *above = NULL;
+
+    // An entry of exactly the right size is best, otherwise use the smallest one which is
+    // big enough. Ties are broken the same way as by walking the size list.
+
+    while (n) {
+        space* s = CONTAINING_RECORD(n, space, size_node);
+
+        if (s->size <= length) {
+            below = s;
+            n = n->right;
+        } else {
+            above = s;
+            n = n->left;
+        }
+    }
+
+    if (below && below->size == length)
+        return below;
+
+    return above;
+}
+
+// Returns the first entry of list which ends at or after address, or the list head if there isn't one.
+static LIST_ENTRY* first_space_entry(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address) {
+    space* s;
+
+    if (!list_size)
+        return list->Flink;
+
+    s = find_space_at_address(CONTAINING_RECORD(list_size, chunk, space_size), address);
+
+    if (!s)
+        return list->Flink;
+
+    return s->address + s->size >= address ? &s->list_entry : s->list_entry.Flink;
+}
+
 NTSTATUS add_space_entry(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t offset, uint64_t size) {
     space* s;
 
@@ -207,7 +408,11 @@ NTSTATUS add_space_entry(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t offse
 
         if (s2->address < offset)
             InsertTailList(list, &s->list_entry);
-        else {
+        else if (list_size) {
+            space* prev = find_space_at_address(CONTAINING_RECORD(list_size, chunk, space_size), offset);
+
+            InsertHeadList(prev ? &prev->list_entry : list, &s->list_entry);
+        } else {
             LIST_ENTRY* le;
 
             le = list->Flink;
@@ -228,29 +433,8 @@ size:
     if (!list_size)
         return STATUS_SUCCESS;
 
-    if (IsListEmpty(list_size))
-        InsertTailList(list_size, &s->list_entry_size);
-    else {
-        space* s2 = CONTAINING_RECORD(list_size->Blink, space, list_entry_size);
-
-        if (s2->size >= size)
-            InsertTailList(list_size, &s->list_entry_size);
-        else {
-            LIST_ENTRY* le;
-
-            le = list_size->Flink;
-            while (le != list_size) {
-                s2 = CONTAINING_RECORD(le, space, list_entry_size);
-
-                if (s2->size <= size) {
-                    InsertHeadList(le->Blink, &s->list_entry_size);
-                    return STATUS_SUCCESS;
-                }
-
-                le = le->Flink;
-            }
-        }
-    }
+    add_space_address(s, list_size);
+    order_space_entry(s, list_size);
 
     return STATUS_SUCCESS;
 }
@@ -296,30 +480,6 @@ static void load_free_space_bitmap(device_extension* Vcb, chunk* c, uint64_t off
     }
 }
 
-static void order_space_entry(space* s, LIST_ENTRY* list_size) {
-    LIST_ENTRY* le;
-
-    if (IsListEmpty(list_size)) {
-        InsertHeadList(list_size, &s->list_entry_size);
-        return;
-    }
-
-    le = list_size->Flink;
-
-    while (le != list_size) {
-        space* s2 = CONTAINING_RECORD(le, space, list_entry_size);
-
-        if (s2->size <= s->size) {
-            InsertHeadList(le->Blink, &s->list_entry_size);
-            return;
-        }
-
-        le = le->Flink;
-    }
-
-    InsertTailList(list_size, &s->list_entry_size);
-}
-
 typedef struct {
     uint64_t stripe;
     LIST_ENTRY list_entry;
@@ -667,11 +827,10 @@ NTSTATUS load_stored_free_space_cache(device_extension* Vcb, chunk* c, bool load
             if (s2->address == s->address + s->size) {
                 s->size += s2->size;
 
-                RemoveEntryList(&s2->list_entry);
-                RemoveEntryList(&s2->list_entry_size);
+                remove_space_entry(s2, &c->space_size);
                 ExFreePool(s2);
 
-                RemoveEntryList(&s->list_entry_size);
+                remove_space_size(s, &c->space_size);
                 order_space_entry(s, &c->space_size);
 
                 le2 = le;
@@ -716,8 +875,7 @@ clearcache:
         space* s = CONTAINING_RECORD(le, space, list_entry);
         LIST_ENTRY* le2 = le->Flink;
 
-        RemoveEntryList(&s->list_entry);
-        RemoveEntryList(&s->list_entry_size);
+        remove_space_entry(s, &c->space_size);
         ExFreePool(s);
 
         le = le2;
@@ -866,11 +1024,10 @@ static NTSTATUS load_stored_free_space_tree(device_extension* Vcb, chunk* c, PIR
             if (s2->address == s->address + s->size) {
                 s->size += s2->size;
 
-                RemoveEntryList(&s2->list_entry);
-                RemoveEntryList(&s2->list_entry_size);
+                remove_space_entry(s2, &c->space_size);
                 ExFreePool(s2);
 
-                RemoveEntryList(&s->list_entry_size);
+                remove_space_size(s, &c->space_size);
                 order_space_entry(s, &c->space_size);
 
                 le2 = le;
@@ -940,6 +1097,7 @@ static NTSTATUS load_free_space_cache(device_extension* Vcb, chunk* c, PIRP Irp)
                     s->size = tp.item->key.obj_id - lastaddr;
                     InsertTailList(&c->space, &s->list_entry);
 
+                    add_space_address(s, &c->space_size);
                     order_space_entry(s, &c->space_size);
 
                     TRACE("(%I64x,%I64x)\n", s->address, s->size);
@@ -968,6 +1126,7 @@ static NTSTATUS load_free_space_cache(device_extension* Vcb, chunk* c, PIRP Irp)
             s->size = c->offset + c->chunk_item->size - lastaddr;
             InsertTailList(&c->space, &s->list_entry);
 
+            add_space_address(s, &c->space_size);
             order_space_entry(s, &c->space_size);
 
             TRACE("(%I64x,%I64x)\n", s->address, s->size);
@@ -1456,8 +1615,10 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
         s->size = length;
         InsertTailList(list, &s->list_entry);
 
-        if (list_size)
-            InsertTailList(list_size, &s->list_entry_size);
+        if (list_size) {
+            add_space_address(s, list_size);
+            order_space_entry(s, list_size);
+        }
 
         if (rollback)
             add_rollback_space(rollback, true, list, list_size, address, length, c);
@@ -1465,8 +1626,8 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
         return;
     }
 
-    le = list->Flink;
-    do {
+    le = first_space_entry(list, list_size, address);
+    while (le != list) {
         s2 = CONTAINING_RECORD(le, space, list_entry);
 
         // old entry envelops new one completely
@@ -1489,11 +1650,7 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
                         s2->address = s3->address;
                         s2->size += s3->size;
 
-                        RemoveEntryList(&s3->list_entry);
-
-                        if (list_size)
-                            RemoveEntryList(&s3->list_entry_size);
-
+                        remove_space_entry(s3, list_size);
                         ExFreePool(s3);
                     } else
                         break;
@@ -1512,11 +1669,7 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
                     if (s3->address <= s2->address + s2->size) {
                         s2->size = max(s2->size, s3->address + s3->size - s2->address);
 
-                        RemoveEntryList(&s3->list_entry);
-
-                        if (list_size)
-                            RemoveEntryList(&s3->list_entry_size);
-
+                        remove_space_entry(s3, list_size);
                         ExFreePool(s3);
                     } else
                         break;
@@ -1524,7 +1677,7 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
             }
 
             if (list_size) {
-                RemoveEntryList(&s2->list_entry_size);
+                remove_space_size(s2, list_size);
                 order_space_entry(s2, list_size);
             }
 
@@ -1546,18 +1699,14 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
                     s2->address = s3->address;
                     s2->size += s3->size;
 
-                    RemoveEntryList(&s3->list_entry);
-
-                    if (list_size)
-                        RemoveEntryList(&s3->list_entry_size);
-
+                    remove_space_entry(s3, list_size);
                     ExFreePool(s3);
                 } else
                     break;
             }
 
             if (list_size) {
-                RemoveEntryList(&s2->list_entry_size);
+                remove_space_size(s2, list_size);
                 order_space_entry(s2, list_size);
             }
 
@@ -1577,18 +1726,14 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
                 if (s3->address <= s2->address + s2->size) {
                     s2->size = max(s2->size, s3->address + s3->size - s2->address);
 
-                    RemoveEntryList(&s3->list_entry);
-
-                    if (list_size)
-                        RemoveEntryList(&s3->list_entry_size);
-
+                    remove_space_entry(s3, list_size);
                     ExFreePool(s3);
                 } else
                     break;
             }
 
             if (list_size) {
-                RemoveEntryList(&s2->list_entry_size);
+                remove_space_size(s2, list_size);
                 order_space_entry(s2, list_size);
             }
 
@@ -1611,21 +1756,25 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
             s->size = length;
             InsertHeadList(s2->list_entry.Blink, &s->list_entry);
 
-            if (list_size)
+            if (list_size) {
+                add_space_address(s, list_size);
                 order_space_entry(s, list_size);
+            }
 
             return;
         }
 
         le = le->Flink;
-    } while (le != list);
+    }
+
+    s2 = CONTAINING_RECORD(list->Blink, space, list_entry);
 
     // check if contiguous with last entry
     if (s2->address + s2->size == address) {
         s2->size += length;
 
         if (list_size) {
-            RemoveEntryList(&s2->list_entry_size);
+            remove_space_size(s2, list_size);
             order_space_entry(s2, list_size);
         }
 
@@ -1644,8 +1793,10 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
     s->size = length;
     InsertTailList(list, &s->list_entry);
 
-    if (list_size)
+    if (list_size) {
+        add_space_address(s, list_size);
         order_space_entry(s, list_size);
+    }
 
     if (rollback)
         add_rollback_space(rollback, true, list, list_size, address, length, c);
@@ -1972,7 +2123,7 @@ void space_list_subtract2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t addr
     if (IsListEmpty(list))
         return;
 
-    le = list->Flink;
+    le = first_space_entry(list, list_size, address);
     while (le != list) {
         s2 = CONTAINING_RECORD(le, space, list_entry);
         le2 = le->Flink;
@@ -1984,11 +2135,7 @@ void space_list_subtract2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t addr
             if (rollback)
                 add_rollback_space(rollback, false, list, list_size, s2->address, s2->size, c);
 
-            RemoveEntryList(&s2->list_entry);
-
-            if (list_size)
-                RemoveEntryList(&s2->list_entry_size);
-
+            remove_space_entry(s2, list_size);
             ExFreePool(s2);
         } else if (address + length > s2->address && address + length < s2->address + s2->size) {
             if (address > s2->address) { // cut out hole
@@ -2010,8 +2157,9 @@ void space_list_subtract2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t addr
                 s2->address = address + length;
 
                 if (list_size) {
-                    RemoveEntryList(&s2->list_entry_size);
+                    remove_space_size(s2, list_size);
                     order_space_entry(s2, list_size);
+                    add_space_address(s, list_size);
                     order_space_entry(s, list_size);
                 }
 
@@ -2024,7 +2172,7 @@ void space_list_subtract2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t addr
                 s2->address = address + length;
 
                 if (list_size) {
-                    RemoveEntryList(&s2->list_entry_size);
+                    remove_space_size(s2, list_size);
                     order_space_entry(s2, list_size);
                 }
             }
@@ -2035,7 +2183,7 @@ void space_list_subtract2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t addr
             s2->size = address - s2->address;
 
             if (list_size) {
-                RemoveEntryList(&s2->list_entry_size);
+                remove_space_size(s2, list_size);
                 order_space_entry(s2, list_size);
             }
         }
@@ -36,7 +36,6 @@ extern tFsRtlUpdateDiskCounters fFsRtlUpdateDiskCounters;
 extern bool diskacc;
 
 bool find_data_address_in_chunk(device_extension* Vcb, chunk* c, uint64_t length, uint64_t* address) {
-    LIST_ENTRY* le;
     space* s;
 
     TRACE("(%p, %I64x, %I64x, %p)\n", Vcb, c->offset, length, address);
@@ -53,37 +52,12 @@ bool find_data_address_in_chunk(device_extension* Vcb, chunk* c, uint64_t length
         }
     }
 
-    if (IsListEmpty(&c->space_size))
+    s = find_space_best_fit(c, length);
+    if (!s)
         return false;
 
-    le = c->space_size.Flink;
-    while (le != &c->space_size) {
-        s = CONTAINING_RECORD(le, space, list_entry_size);
-
-        if (s->size == length) {
-            *address = s->address;
-            return true;
-        } else if (s->size < length) {
-            if (le == c->space_size.Flink)
-                return false;
-
-            s = CONTAINING_RECORD(le->Blink, space, list_entry_size);
-
-            *address = s->address;
-            return true;
-        }
-
-        le = le->Flink;
-    }
-
-    s = CONTAINING_RECORD(c->space_size.Blink, space, list_entry_size);
-
-    if (s->size > length) {
-        *address = s->address;
-        return true;
-    }
-
-    return false;
+    *address = s->address;
+    return true;
 }
 
 chunk* get_chunk_from_address(device_extension* Vcb, uint64_t address) {
@@ -367,7 +341,6 @@ NTSTATUS alloc_chunk(device_extension* Vcb, uint64_t flags, chunk** pc, bool ful
     uint16_t cisize;
     CHUNK_ITEM_STRIPE* cis;
     chunk* c = NULL;
-    space* s = NULL;
     LIST_ENTRY* le;
 
     le = Vcb->devices.Flink;
@@ -619,6 +592,7 @@ NTSTATUS alloc_chunk(device_extension* Vcb, uint64_t flags, chunk** pc, bool ful
 
     InitializeListHead(&c->space);
     InitializeListHead(&c->space_size);
+    c->space_root = c->space_size_root = NULL;
     InitializeListHead(&c->deleting);
     InitializeListHead(&c->changed_extents);
 
@@ -632,18 +606,12 @@ NTSTATUS alloc_chunk(device_extension* Vcb, uint64_t flags, chunk** pc, bool ful
     ExInitializeResourceLite(&c->lock);
     ExInitializeResourceLite(&c->changed_extents_lock);
 
-    s = ExAllocatePoolWithTag(NonPagedPool, sizeof(space), ALLOC_TAG);
-    if (!s) {
-        ERR("out of memory\n");
-        Status = STATUS_INSUFFICIENT_RESOURCES;
+    Status = add_space_entry(&c->space, &c->space_size, c->offset, c->chunk_item->size);
+    if (!NT_SUCCESS(Status)) {
+        ERR("add_space_entry returned %08lx\n", Status);
         goto end;
     }
 
-    s->address = c->offset;
-    s->size = c->chunk_item->size;
-    InsertTailList(&c->space, &s->list_entry);
-    InsertTailList(&c->space_size, &s->list_entry_size);
-
     protect_superblocks(c);
 
     for (i = 0; i < num_stripes; i++) {
@@ -671,8 +639,6 @@ end:
 
             ExFreePool(c);
         }
-
-        if (s) ExFreePool(s);
     } else {
         bool done = false;
 
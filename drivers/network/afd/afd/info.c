@@ -58,6 +58,10 @@ AfdGetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
         InfoReq->Information.Ulong = FCB->Recv.Content - FCB->Recv.BytesUsed;
         break;
 
+        case AFD_INFO_DIRECT_RECEIVES:
+            InfoReq->Information.Ulong = FCB->DirectReceives;
+            break;
+
         case AFD_INFO_SENDS_IN_PROGRESS:
             InfoReq->Information.Ulong = 0;
 
@@ -1277,6 +1277,14 @@ AfdCancelHandler(PDEVICE_OBJECT DeviceObject,
             return;
     }
 
+    if (Irp == FCB->DirectRecvIrp)
+    {
+        /* The transport is writing to its buffer, so it is completed once the receive comes back */
+        IoCancelIrp(FCB->ReceiveIrp.InFlightRequest);
+        SocketStateUnlock(FCB);
+        return;
+    }
+
     CurrentEntry = FCB->PendingIrpList[Function].Flink;
     while (CurrentEntry != &FCB->PendingIrpList[Function])
     {
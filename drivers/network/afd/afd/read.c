@@ -10,14 +10,99 @@
 
 #include "afd.h"
 
+static PIRP GetDirectRecvIrp( PAFD_FCB FCB )
+{
+    PIRP NextIrp;
+    PAFD_RECV_INFO RecvReq;
+    PAFD_MAPBUF Map;
+
+    /* Buffered data must be consumed first to keep the stream in order */
+    if (FCB->Recv.Content != FCB->Recv.BytesUsed) return NULL;
+
+    if (IsListEmpty(&FCB->PendingIrpList[FUNCTION_RECV])) return NULL;
+
+    NextIrp = CONTAINING_RECORD(FCB->PendingIrpList[FUNCTION_RECV].Flink,
+                                IRP, Tail.Overlay.ListEntry);
+
+    if (NextIrp->Cancel) return NULL;
+
+    RecvReq = GetLockedData(NextIrp, IoGetCurrentIrpStackLocation(NextIrp));
+
+    /* A receive that can't wait is failed by its dispatch routine instead */
+    if (!(RecvReq->AfdFlags & AFD_OVERLAPPED) &&
+        ((RecvReq->AfdFlags & AFD_IMMEDIATE) || (FCB->NonBlocking))) return NULL;
+
+    /* A peek must leave the data for the next receive */
+    if (RecvReq->TdiFlags & TDI_RECEIVE_PEEK) return NULL;
+
+    /* Small receives are cheaper to serve from the buffer */
+    if (!RecvReq->BufferCount ||
+        RecvReq->BufferArray[0].len < AFD_DIRECT_RECV_THRESHOLD) return NULL;
+
+    Map = (PAFD_MAPBUF)(RecvReq->BufferArray + RecvReq->BufferCount);
+    if (!Map[0].Mdl) return NULL;
+
+    return NextIrp;
+}
+
 static VOID RefillSocketBuffer( PAFD_FCB FCB )
 {
+    PIRP NextIrp;
+    PAFD_RECV_INFO RecvReq;
+    PAFD_MAPBUF Map;
+    NTSTATUS Status;
+
     /* Make sure nothing's in flight first */
-    if (FCB->ReceiveIrp.InFlightRequest) return;
+    if (FCB->ReceiveIrp.InFlightRequest)
+    {
+        /* An idle buffered receive would take the data of a user buffer that
+         * can receive it directly, so cancel it and post the direct one from
+         * its completion. The transport completes a receive with data, so
+         * nothing is lost if the data wins the race. */
+        if (!FCB->DirectRecvIrp && !FCB->BufferedRecvCancelled &&
+            GetDirectRecvIrp(FCB))
+        {
+            FCB->BufferedRecvCancelled = TRUE;
+            IoCancelIrp(FCB->ReceiveIrp.InFlightRequest);
+        }
+        return;
+    }
 
     /* Now ensure that receive is still allowed */
     if (FCB->TdiReceiveClosed) return;
 
+    /* An empty buffer can be refilled from its beginning */
+    if (FCB->Recv.Content == FCB->Recv.BytesUsed)
+    {
+        FCB->Recv.Content = 0;
+        FCB->Recv.BytesUsed = 0;
+    }
+
+    /* Let the transport copy straight into the first pending user buffer */
+    NextIrp = GetDirectRecvIrp(FCB);
+    if (NextIrp)
+    {
+        RecvReq = GetLockedData(NextIrp, IoGetCurrentIrpStackLocation(NextIrp));
+        Map = (PAFD_MAPBUF)(RecvReq->BufferArray + RecvReq->BufferCount);
+
+        AFD_DbgPrint(MID_TRACE,("Receiving directly into %p\n", NextIrp));
+
+        /* The receive may complete before TdiReceiveMdl returns */
+        FCB->DirectRecvIrp = NextIrp;
+
+        Status = TdiReceiveMdl( &FCB->ReceiveIrp.InFlightRequest,
+                                FCB->Connection.Object,
+                                TDI_RECEIVE_NORMAL,
+                                Map[0].Mdl,
+                                RecvReq->BufferArray[0].len,
+                                ReceiveComplete,
+                                FCB );
+        if (Status == STATUS_PENDING) return;
+
+        /* Fall back to the receive buffer */
+        FCB->DirectRecvIrp = NULL;
+    }
+
     /* Check if the buffer is full */
     if (FCB->Recv.Content == FCB->Recv.Size)
     {
@@ -50,6 +135,39 @@ static VOID RefillSocketBuffer( PAFD_FCB FCB )
                 FCB );
 }
 
+static BOOLEAN CompleteDirectReceive( PAFD_FCB FCB, PIRP NextIrp,
+                                      NTSTATUS Status, ULONG_PTR Information )
+{
+    PAFD_RECV_INFO RecvReq;
+
+    /* Closure is reported through the pending IRP list like for buffered data */
+    if (FCB->TdiReceiveClosed) return FALSE;
+
+    if (Status == STATUS_SUCCESS && Information != 0)
+    {
+        FCB->LastReceiveStatus = Status;
+        FCB->DirectReceives++;
+    }
+    else if (Status != STATUS_CANCELLED || !NextIrp->Cancel)
+    {
+        return FALSE;
+    }
+
+    AFD_DbgPrint(MID_TRACE,("Completing direct recv %p (%u)\n", NextIrp,
+                            (UINT)Information));
+
+    RemoveEntryList(&NextIrp->Tail.Overlay.ListEntry);
+    RecvReq = GetLockedData(NextIrp, IoGetCurrentIrpStackLocation(NextIrp));
+    UnlockBuffers( RecvReq->BufferArray, RecvReq->BufferCount, FALSE );
+    NextIrp->IoStatus.Status = Status;
+    NextIrp->IoStatus.Information = Information;
+    if( NextIrp->MdlAddress ) UnlockRequest( NextIrp, IoGetCurrentIrpStackLocation( NextIrp ) );
+    (void)IoSetCancelRoutine(NextIrp, NULL);
+    IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
+
+    return TRUE;
+}
+
 static VOID HandleReceiveComplete( PAFD_FCB FCB, NTSTATUS Status, ULONG_PTR Information )
 {
     FCB->LastReceiveStatus = Status;
@@ -71,11 +189,6 @@ static VOID HandleReceiveComplete( PAFD_FCB FCB, NTSTATUS Status, ULONG_PTR Info
             /* Receive is closed */
             FCB->TdiReceiveClosed = TRUE;
         }
-        else
-        {
-            /* Issue another receive IRP to keep the buffer well stocked */
-            RefillSocketBuffer(FCB);
-        }
     }
     /* Receive failed with no data (unexpected closure) */
     else
@@ -142,9 +255,6 @@ static NTSTATUS TryToSatisfyRecvRequestFromBuffer( PAFD_FCB FCB,
         }
     }
 
-    /* Issue another receive IRP to keep the buffer well stocked */
-    RefillSocketBuffer(FCB);
-
     return STATUS_SUCCESS;
 }
 
@@ -161,6 +271,9 @@ static NTSTATUS ReceiveActivity( PAFD_FCB FCB, PIRP Irp ) {
     AFD_DbgPrint(MID_TRACE,("FCB %p Receive data waiting %u\n",
                             FCB, FCB->Recv.Content));
 
+    /* The transport owns the first pending request until it completes */
+    if (FCB->DirectRecvIrp) return STATUS_PENDING;
+
     if( CantReadMore( FCB ) ) {
         /* Success here means that we got an EOF.  Complete a pending read
          * with zero bytes if we haven't yet overread, then kill the others.
@@ -261,6 +374,9 @@ static NTSTATUS ReceiveActivity( PAFD_FCB FCB, PIRP Irp ) {
         PollReeval(FCB->DeviceExt, FCB->FileObject);
     }
 
+    /* Issue another receive IRP to keep the buffer well stocked */
+    RefillSocketBuffer(FCB);
+
     AFD_DbgPrint(MID_TRACE,("RetStatus for irp %p is %x\n", Irp, RetStatus));
 
     return RetStatus;
@@ -272,20 +388,35 @@ NTSTATUS NTAPI ReceiveComplete
   PVOID Context ) {
     PAFD_FCB FCB = (PAFD_FCB)Context;
     PLIST_ENTRY NextIrpEntry;
-    PIRP NextIrp;
+    PIRP NextIrp, DirectIrp;
     PAFD_RECV_INFO RecvReq;
     PIO_STACK_LOCATION NextIrpSp;
+    BOOLEAN BufferedRecvCancelled;
 
     UNREFERENCED_PARAMETER(DeviceObject);
 
     AFD_DbgPrint(MID_TRACE,("Called\n"));
 
+    /* The partial MDL of a direct receive must be gone before the user buffer
+     * is unlocked, and the I/O manager must not unlock it either */
+    if (Irp->MdlAddress && (Irp->MdlAddress->MdlFlags & MDL_PARTIAL))
+    {
+        IoFreeMdl(Irp->MdlAddress);
+        Irp->MdlAddress = NULL;
+    }
+
     if( !SocketAcquireStateLock( FCB ) )
         return STATUS_FILE_CLOSED;
 
     ASSERT(FCB->ReceiveIrp.InFlightRequest == Irp);
     FCB->ReceiveIrp.InFlightRequest = NULL;
 
+    DirectIrp = FCB->DirectRecvIrp;
+    FCB->DirectRecvIrp = NULL;
+
+    BufferedRecvCancelled = FCB->BufferedRecvCancelled;
+    FCB->BufferedRecvCancelled = FALSE;
+
     if( FCB->State == SOCKET_STATE_CLOSED ) {
         /* Cleanup our IRP queue because the FCB is being destroyed */
         while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_RECV] ) ) {
@@ -308,7 +439,20 @@ NTSTATUS NTAPI ReceiveComplete
         return STATUS_INVALID_PARAMETER;
     }
 
-    HandleReceiveComplete( FCB, Irp->IoStatus.Status, Irp->IoStatus.Information );
+    if (DirectIrp)
+    {
+        if (!CompleteDirectReceive( FCB, DirectIrp, Irp->IoStatus.Status, Irp->IoStatus.Information ))
+            HandleReceiveComplete( FCB, Irp->IoStatus.Status, Irp->IoStatus.Information );
+    }
+    else if (BufferedRecvCancelled && Irp->IoStatus.Status == STATUS_CANCELLED)
+    {
+        /* We cancelled it to receive directly, the socket stays open */
+        AFD_DbgPrint(MID_TRACE,("Buffered receive made way for a direct one\n"));
+    }
+    else
+    {
+        HandleReceiveComplete( FCB, Irp->IoStatus.Status, Irp->IoStatus.Information );
+    }
 
     ReceiveActivity( FCB, NULL );
 
@@ -511,29 +655,37 @@ AfdConnectedSocketReadData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
     Irp->IoStatus.Status = STATUS_PENDING;
     Irp->IoStatus.Information = 0;
 
-    InsertTailList( &FCB->PendingIrpList[FUNCTION_RECV],
-                    &Irp->Tail.Overlay.ListEntry );
+    if( !(RecvReq->AfdFlags & AFD_OVERLAPPED) &&
+        ((RecvReq->AfdFlags & AFD_IMMEDIATE) || (FCB->NonBlocking))) {
+        InsertTailList( &FCB->PendingIrpList[FUNCTION_RECV],
+                        &Irp->Tail.Overlay.ListEntry );
 
-    /************ From this point, the IRP is not ours ************/
+        Status = ReceiveActivity( FCB, Irp );
 
-    Status = ReceiveActivity( FCB, Irp );
+        if( Status == STATUS_PENDING ) {
+            AFD_DbgPrint(MID_TRACE,("Nonblocking\n"));
+            Status = STATUS_CANT_WAIT;
+            TotalBytesCopied = 0;
+            RemoveEntryList( &Irp->Tail.Overlay.ListEntry );
+            UnlockBuffers( RecvReq->BufferArray, RecvReq->BufferCount, FALSE );
+            return UnlockAndMaybeComplete( FCB, Status, Irp,
+                                           TotalBytesCopied );
+        }
 
-    if( Status == STATUS_PENDING &&
-        !(RecvReq->AfdFlags & AFD_OVERLAPPED) && 
-        ((RecvReq->AfdFlags & AFD_IMMEDIATE) || (FCB->NonBlocking))) {
-        AFD_DbgPrint(MID_TRACE,("Nonblocking\n"));
-        Status = STATUS_CANT_WAIT;
-        TotalBytesCopied = 0;
-        RemoveEntryList( &Irp->Tail.Overlay.ListEntry );
-        UnlockBuffers( RecvReq->BufferArray, RecvReq->BufferCount, FALSE );
-        return UnlockAndMaybeComplete( FCB, Status, Irp,
-                                       TotalBytesCopied );
-    } else if( Status == STATUS_PENDING ) {
-        AFD_DbgPrint(MID_TRACE,("Leaving read irp\n"));
-        IoMarkIrpPending( Irp );
-        (void)IoSetCancelRoutine(Irp, AfdCancelHandler);
-    } else {
         AFD_DbgPrint(MID_TRACE,("Completed with status %x\n", Status));
+        SocketStateUnlock( FCB );
+        return Status;
+    }
+
+    /* Make the IRP pending and cancellable first, so that ReceiveActivity
+     * may complete it or hand its buffer to the transport right away */
+    Status = QueueUserModeIrp( FCB, Irp, FUNCTION_RECV );
+
+    if( Status == STATUS_PENDING ) {
+        /************ From this point, the IRP is not ours ************/
+
+        AFD_DbgPrint(MID_TRACE,("Leaving read irp\n"));
+        ReceiveActivity( FCB, Irp );
     }
 
     SocketStateUnlock( FCB );
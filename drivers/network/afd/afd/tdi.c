@@ -1054,6 +1054,84 @@ NTSTATUS TdiReceive(
     return STATUS_PENDING;
 }
 
+NTSTATUS TdiReceiveMdl(
+    PIRP *Irp,
+    PFILE_OBJECT TransportObject,
+    USHORT Flags,
+    PMDL Mdl,
+    UINT BufferLength,
+    PIO_COMPLETION_ROUTINE CompletionRoutine,
+    PVOID CompletionContext)
+/*
+ * FUNCTION: Receives stream data straight into an already locked buffer
+ * ARGUMENTS:
+ *     Mdl          = Locked MDL describing the buffer, owned by the caller
+ *     BufferLength = Number of bytes to receive at most
+ * NOTES
+ *     The IRP gets a partial MDL describing the same pages. It has to be
+ *     freed before the caller unlocks its own MDL.
+ */
+{
+    PDEVICE_OBJECT DeviceObject;
+    PMDL PartialMdl;
+    PVOID Va;
+
+    ASSERT(*Irp == NULL);
+    ASSERT(BufferLength <= MmGetMdlByteCount(Mdl));
+
+    if (!TransportObject) {
+        AFD_DbgPrint(MIN_TRACE, ("Bad transport object.\n"));
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    DeviceObject = IoGetRelatedDeviceObject(TransportObject);
+    if (!DeviceObject) {
+        AFD_DbgPrint(MIN_TRACE, ("Bad device object.\n"));
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    *Irp = TdiBuildInternalDeviceControlIrp(TDI_RECEIVE,             /* Sub function */
+                                            DeviceObject,            /* Device object */
+                                            TransportObject,         /* File object */
+                                            NULL,                    /* Event */
+                                            NULL);                   /* Status */
+
+    if (!*Irp) {
+        AFD_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Va = MmGetMdlVirtualAddress(Mdl);
+    PartialMdl = IoAllocateMdl(Va,             /* Virtual address */
+                               BufferLength,   /* Length of buffer */
+                               FALSE,          /* Not secondary */
+                               FALSE,          /* Don't charge quota */
+                               NULL);          /* Don't use IRP */
+    if (!PartialMdl) {
+        AFD_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+        IoCompleteRequest(*Irp, IO_NO_INCREMENT);
+        *Irp = NULL;
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    IoBuildPartialMdl(Mdl, PartialMdl, Va, BufferLength);
+
+    AFD_DbgPrint(MID_TRACE,("AFD>>> Got a partial MDL: %p\n", PartialMdl));
+
+    TdiBuildReceive(*Irp,                   /* I/O Request Packet */
+                    DeviceObject,           /* Device object */
+                    TransportObject,        /* File object */
+                    CompletionRoutine,      /* Completion routine */
+                    CompletionContext,      /* Completion context */
+                    PartialMdl,             /* Data buffer */
+                    Flags,                  /* Flags */
+                    BufferLength);          /* Length of data */
+
+    TdiCall(*Irp, DeviceObject, NULL, NULL);
+
+    return STATUS_PENDING;
+}
+
 
 NTSTATUS TdiReceiveDatagram(
     PIRP *Irp,
@@ -92,6 +92,10 @@ typedef struct IPADDR_ENTRY {
 
 #define IN_FLIGHT_REQUESTS              5
 
+#define AFD_DIRECT_RECV_THRESHOLD       PAGE_SIZE /* Smallest user buffer a
+					   * stream receive is posted into
+					   * directly. */
+
 #define EXTRA_LOCK_BUFFERS              2 /* Number of extra buffers needed
 					   * for ancillary data on packet
 					   * requests. */
@@ -176,6 +180,9 @@ typedef struct _AFD_FCB {
     AFD_TDI_OBJECT AddressFile, Connection;
     AFD_IN_FLIGHT_REQUEST ConnectIrp, ListenIrp, ReceiveIrp, SendIrp, DisconnectIrp;
     AFD_DATA_WINDOW Send, Recv;
+    PIRP DirectRecvIrp;
+    BOOLEAN BufferedRecvCancelled;
+    UINT DirectReceives;
     KMUTEX Mutex;
     PKEVENT EventSelect;
     DWORD EventSelectTriggers;
@@ -370,6 +377,15 @@ NTSTATUS TdiReceive
   PIO_COMPLETION_ROUTINE  CompletionRoutine,
   PVOID CompletionContext);
 
+NTSTATUS TdiReceiveMdl
+( PIRP *Irp,
+  PFILE_OBJECT ConnectionObject,
+  USHORT Flags,
+  PMDL Mdl,
+  UINT BufferLength,
+  PIO_COMPLETION_ROUTINE  CompletionRoutine,
+  PVOID CompletionContext);
+
 NTSTATUS TdiSend
 ( PIRP *Irp,
   PFILE_OBJECT ConnectionObject,
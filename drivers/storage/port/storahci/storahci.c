@@ -440,30 +440,37 @@ AhciCommandCompletionDpcRoutine (
     AdapterExtension = (PAHCI_ADAPTER_EXTENSION)HwDeviceExtension;
     PortExtension = (PAHCI_PORT_EXTENSION)SystemArgument1;
 
-    StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
-    Srb = RemoveQueue(&PortExtension->CompletionQueue);
-    StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
+    // several completions may have been queued before this DPC got to run
+    for (;;)
+    {
+        StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
+        Srb = RemoveQueue(&PortExtension->CompletionQueue);
+        StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
 
-    NT_ASSERT(Srb != NULL);
+        if (Srb == NULL)
+        {
+            break;
+        }
 
-    if (Srb->SrbStatus == SRB_STATUS_PENDING)
-    {
-        Srb->SrbStatus = SRB_STATUS_SUCCESS;
-    }
-    else
-    {
-        return;
-    }
+        if (Srb->SrbStatus == SRB_STATUS_PENDING)
+        {
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        }
+        else
+        {
+            continue;
+        }
 
-    SrbExtension = GetSrbExtension(Srb);
+        SrbExtension = GetSrbExtension(Srb);
 
-    CompletionRoutine = SrbExtension->CompletionRoutine;
-    NT_ASSERT(CompletionRoutine != NULL);
+        CompletionRoutine = SrbExtension->CompletionRoutine;
+        NT_ASSERT(CompletionRoutine != NULL);
 
-    // now it's completion routine responsibility to set SrbStatus
-    CompletionRoutine(PortExtension, Srb);
+        // now it's completion routine responsibility to set SrbStatus
+        CompletionRoutine(PortExtension, Srb);
 
-    StorPortNotification(RequestComplete, AdapterExtension, Srb);
+        StorPortNotification(RequestComplete, AdapterExtension, Srb);
+    }
 
     return;
 }// -- AhciCommandCompletionDpcRoutine();
@@ -564,6 +571,7 @@ AhciCompleteIssuedSrb (
     )
 {
     ULONG NCS, i;
+    BOOLEAN issueDpc;
     PSCSI_REQUEST_BLOCK Srb;
     PAHCI_SRB_EXTENSION SrbExtension;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
@@ -576,6 +584,9 @@ AhciCompleteIssuedSrb (
 
     AdapterExtension = PortExtension->AdapterExtension;
     NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
+    issueDpc = FALSE;
+
+    PortExtension->NcqSlots &= ~CommandsToComplete;
 
     for (i = 0; i < NCS; i++)
     {
@@ -588,13 +599,15 @@ AhciCompleteIssuedSrb (
                 continue;
             }
 
+            PortExtension->Slot[i] = NULL;
+
             SrbExtension = GetSrbExtension(Srb);
             NT_ASSERT(SrbExtension != NULL);
 
             if (SrbExtension->CompletionRoutine != NULL)
             {
                 AddQueue(&PortExtension->CompletionQueue, Srb);
-                StorPortIssueDpc(AdapterExtension, &PortExtension->CommandCompletion, PortExtension, Srb);
+                issueDpc = TRUE;
             }
             else
             {
@@ -605,6 +618,12 @@ AhciCompleteIssuedSrb (
         }
     }
 
+    // one DPC run drains the whole completion queue
+    if (issueDpc)
+    {
+        StorPortIssueDpc(AdapterExtension, &PortExtension->CommandCompletion, PortExtension, NULL);
+    }
+
     return;
 }// -- AhciCompleteIssuedSrb();
 
@@ -697,6 +716,10 @@ AhciInterruptHandler (
     {
         AhciCompleteIssuedSrb(PortExtension, (PortExtension->CommandIssuedSlots & (~outstanding)));
         PortExtension->CommandIssuedSlots &= outstanding;
+
+        // hand the freed slots to queued Srbs right away, we already hold the interrupt lock
+        AhciIssueQueuedSrbs(PortExtension);
+        AhciActivatePort(PortExtension);
     }
 
     return;
@@ -1119,7 +1142,7 @@ AhciHwFindAdapter (
 
     ConfigInfo->MaximumNumberOfTargets = 1;
     ConfigInfo->ResetTargetSupported = TRUE;
-    ConfigInfo->NumberOfPhysicalBreaks = 0x21;
+    ConfigInfo->NumberOfPhysicalBreaks = MAXIMUM_AHCI_PRDT_ENTRIES - 1;
     ConfigInfo->MaximumNumberOfLogicalUnits = 1;
     ConfigInfo->NumberOfBuses = MAXIMUM_AHCI_PORT_COUNT;
     ConfigInfo->MaximumTransferLength = MAXIMUM_TRANSFER_LENGTH;
@@ -1328,7 +1351,12 @@ AhciBuild_PRDT (
     AdapterExtension = PortExtension->AdapterExtension;
 
     NT_ASSERT(sgl != NULL);
-    NT_ASSERT(sgl->NumberOfElements < MAXIMUM_AHCI_PRDT_ENTRIES);
+
+    // AhciProcessIO rejects the longer lists, never write past the PRDT
+    if (sgl->NumberOfElements > MAXIMUM_AHCI_PRDT_ENTRIES)
+    {
+        return -1;
+    }
 
     for (index = 0; index < sgl->NumberOfElements; index++)
     {
@@ -1403,6 +1431,14 @@ AhciProcessSrb (
     NT_ASSERT(SlotIndex < AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
     SrbExtension->SlotIndex = SlotIndex;
 
+    // native queued commands carry their slot as tag in SectorCount(7:3)
+    if (IsNcqCommand(SrbExtension))
+    {
+        SrbExtension->SectorCountLow = (UCHAR)(SlotIndex << 3);
+        SrbExtension->SectorCountHigh = 0;
+        PortExtension->NcqSlots |= 1 << SlotIndex;
+    }
+
     // program the CFIS in the CommandTable
     CommandHeader = &PortExtension->CommandList[SlotIndex];
 
@@ -1492,7 +1528,7 @@ AhciActivatePort (
     )
 {
     AHCI_PORT_CMD cmd;
-    ULONG QueueSlots, slotToActivate, tmp;
+    ULONG QueueSlots, ncqSlots;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
 
     AhciDebugPrint("AhciActivatePort()\n");
@@ -1514,23 +1550,21 @@ AhciActivatePort (
         return;
     }
 
-    // get the lowest set bit
-    tmp = QueueSlots & (QueueSlots - 1);
-
-    if (tmp == 0)
-        slotToActivate = QueueSlots;
-    else
-        slotToActivate = (QueueSlots & (~tmp));
-
-    // mark that bit off in QueueSlots
-    // so we can know we it is really needed to activate port or not
-    PortExtension->QueueSlots &= ~slotToActivate;
+    // issue every prepared slot at once, so the HBA can keep the device busy
+    PortExtension->QueueSlots = 0;
     // mark this CommandIssuedSlots
     // to validate in completeIssuedCommand
-    PortExtension->CommandIssuedSlots |= slotToActivate;
+    PortExtension->CommandIssuedSlots |= QueueSlots;
 
-    // tell the HBA to issue this Command Slot to the given port
-    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, slotToActivate);
+    // for native queued commands, PxSACT has to be set before PxCI
+    ncqSlots = QueueSlots & PortExtension->NcqSlots;
+    if (ncqSlots != 0)
+    {
+        StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->SACT, ncqSlots);
+    }
+
+    // tell the HBA to issue these Command Slots to the given port
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, QueueSlots);
 
     return;
 }// -- AhciActivatePort();
@@ -1539,6 +1573,68 @@ AhciActivatePort (
     #pragma warning(pop)
 #endif
 
+/**
+ * @name AhciIssueQueuedSrbs
+ * @implemented
+ *
+ * Move pending Srbs from the port queue into every free command slot.
+ * Must be called with the InterruptLock held.
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciIssueQueuedSrbs (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    PSCSI_REQUEST_BLOCK Srb;
+    PAHCI_SRB_EXTENSION SrbExtension;
+    ULONG freeSlots, occupiedSlots, slotIndex;
+
+    AhciDebugPrint("AhciIssueQueuedSrbs()\n");
+
+    if (PortExtension->DeviceParams.IsActive == FALSE)
+    {
+        return; // we should wait for device to get active
+    }
+
+    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots); // Busy command slots for given port
+    freeSlots = AHCI_SLOT_MASK(PortExtension->MaxPortQueueDepth) & ~occupiedSlots;
+
+    for (slotIndex = 0; (slotIndex < MAXIMUM_AHCI_PORT_NCS) && (freeSlots != 0); slotIndex++)
+    {
+        if ((freeSlots & (1 << slotIndex)) == 0)
+        {
+            continue;
+        }
+
+        Srb = PeekQueue(&PortExtension->SrbQueue);
+        if (Srb == NULL)
+        {
+            break;
+        }
+
+        // native queued commands can't be outstanding together with non-queued commands,
+        // so anything else waits until the port has drained
+        SrbExtension = GetSrbExtension(Srb);
+        if ((occupiedSlots != 0) &&
+            (!IsNcqCommand(SrbExtension) || ((occupiedSlots & ~PortExtension->NcqSlots) != 0)))
+        {
+            break;
+        }
+
+        RemoveQueue(&PortExtension->SrbQueue);
+        NT_ASSERT(Srb->PathId == PortExtension->PortNumber);
+        AhciProcessSrb(PortExtension, Srb, slotIndex);
+
+        occupiedSlots |= 1 << slotIndex;
+        freeSlots &= ~(1 << slotIndex);
+    }
+
+    return;
+}// -- AhciIssueQueuedSrbs();
+
 /**
  * @name AhciProcessIO
  * @implemented
@@ -1558,10 +1654,9 @@ AhciProcessIO (
     __in PSCSI_REQUEST_BLOCK Srb
     )
 {
-    PSCSI_REQUEST_BLOCK tmpSrb;
     STOR_LOCK_HANDLE lockhandle = {0};
     PAHCI_PORT_EXTENSION PortExtension;
-    ULONG commandSlotMask, occupiedSlots, slotIndex, NCS;
+    PAHCI_SRB_EXTENSION SrbExtension;
 
     AhciDebugPrint("AhciProcessIO()\n");
     AhciDebugPrint("\tPathId: %d\n", PathId);
@@ -1570,51 +1665,34 @@ AhciProcessIO (
 
     NT_ASSERT(PathId < AdapterExtension->PortCount);
 
+    // the scatter gather list has to fit the PRDT of the command table
+    SrbExtension = GetSrbExtension(Srb);
+    if (IsDataTransferNeeded(SrbExtension) &&
+        ((SrbExtension->pSgl == NULL) ||
+         (SrbExtension->pSgl->NumberOfElements > MAXIMUM_AHCI_PRDT_ENTRIES)))
+    {
+        AhciDebugPrint("	Scatter gather list doesn't fit the PRDT\n");
+        Srb->SrbStatus = SRB_STATUS_INVALID_REQUEST;
+        StorPortNotification(RequestComplete, AdapterExtension, Srb);
+        return;
+    }
+
     // Acquire Lock
     StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
 
     // add Srb to queue
-    AddQueue(&PortExtension->SrbQueue, Srb);
-
-    if (PortExtension->DeviceParams.IsActive == FALSE)
+    if (!AddQueue(&PortExtension->SrbQueue, Srb))
     {
         // Release Lock
         StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
-        return; // we should wait for device to get active
-    }
 
-    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots); // Busy command slots for given port
-    NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
-    commandSlotMask = (1 << NCS) - 1; // available slots mask
-
-    commandSlotMask = (commandSlotMask & ~occupiedSlots);
-    if(commandSlotMask != 0)
-    {
-        // iterate over HBA port slots
-        for (slotIndex = 0; slotIndex < NCS; slotIndex++)
-        {
-            // find first free slot
-            if ((commandSlotMask & (1 << slotIndex)) != 0)
-            {
-                tmpSrb = RemoveQueue(&PortExtension->SrbQueue);
-                if (tmpSrb != NULL)
-                {
-                    NT_ASSERT(tmpSrb->PathId == PathId);
-                    AhciProcessSrb(PortExtension, tmpSrb, slotIndex);
-                }
-                else
-                {
-                    break;
-                }
-            }
-            else
-            {
-                break;
-            }
-        }
+        Srb->SrbStatus = SRB_STATUS_BUSY;
+        StorPortNotification(RequestComplete, AdapterExtension, Srb);
+        return;
     }
 
-    // program HBA port
+    // fill all free slots and program HBA port
+    AhciIssueQueuedSrbs(PortExtension);
     AhciActivatePort(PortExtension);
 
     // Release Lock
@@ -1641,7 +1719,6 @@ AtapiInquiryCompletion (
     )
 {
     PAHCI_PORT_EXTENSION PortExtension;
-    PAHCI_ADAPTER_EXTENSION AdapterExtension;
     PSCSI_REQUEST_BLOCK Srb;
     BOOLEAN status;
 
@@ -1653,14 +1730,12 @@ AtapiInquiryCompletion (
     NT_ASSERT(Srb != NULL);
     NT_ASSERT(PortExtension != NULL);
 
-    AdapterExtension = PortExtension->AdapterExtension;
-
-    // send queue depth
+    // send queue depth, ATAPI devices have no native command queuing
     status = StorPortSetDeviceQueueDepth(PortExtension->AdapterExtension,
                                          Srb->PathId,
                                          Srb->TargetId,
                                          Srb->Lun,
-                                         AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
+                                         1);
 
     NT_ASSERT(status == TRUE);
     return;
@@ -1735,6 +1810,20 @@ InquiryCompletion (
             PortExtension->DeviceParams.Lba48BitMode = 1;
         }
 
+        // Native command queuing needs support from both the HBA and the device
+        if (IsAdapterCAPSNCQ(AdapterExtension->CAP) &&
+            (PortExtension->DeviceParams.Lba48BitMode) &&
+            ((((PUSHORT)IdentifyDeviceData)[IDENTIFY_WORD_SATA_CAPABILITIES] & IDENTIFY_SATA_CAPABILITIES_NCQ) != 0))
+        {
+            PortExtension->DeviceParams.NcqSupported = 1;
+
+            // word 75, 0's based queue depth
+            PortExtension->MaxPortQueueDepth = min(AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP),
+                                                   (ULONG)IdentifyDeviceData->QueueDepth + 1);
+
+            AhciDebugPrint("\tNCQ Queue Depth: %d\n", PortExtension->MaxPortQueueDepth);
+        }
+
         PortExtension->DeviceParams.AccessType = DIRECT_ACCESS_DEVICE;
 
         /* Device max address lba */
@@ -1815,12 +1904,13 @@ InquiryCompletion (
     InquiryData->ProductId[sizeof(InquiryData->ProductId) - 1] = '\0';
     InquiryData->ProductRevisionLevel[sizeof(InquiryData->ProductRevisionLevel) - 1] = '\0';
 
-    // send queue depth
+    // send queue depth, a device without native command queuing runs one command at a time
     status = StorPortSetDeviceQueueDepth(PortExtension->AdapterExtension,
                                          Srb->PathId,
                                          Srb->TargetId,
                                          Srb->Lun,
-                                         AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
+                                         PortExtension->DeviceParams.NcqSupported ?
+                                         PortExtension->MaxPortQueueDepth : 1);
 
     NT_ASSERT(status == TRUE);
     return;
@@ -2048,6 +2138,28 @@ DeviceRequestReadWrite (
 
     SrbExtension->Device = (0xA0 | IDE_LBA_MODE);
 
+    if (PortExtension->DeviceParams.NcqSupported)
+    {
+        // READ/WRITE FPDMA QUEUED
+        // the sector count moves to the features register, the tag is set once a slot is assigned
+        SrbExtension->Flags |= (ATA_FLAGS_48BIT_COMMAND | ATA_FLAGS_USE_NCQ);
+        SrbExtension->CommandReg = IsReading ? IDE_COMMAND_READ_FPDMA_QUEUED : IDE_COMMAND_WRITE_FPDMA_QUEUED;
+
+        SrbExtension->Device = IDE_LBA_MODE; // bit 7 is FUA
+        SrbExtension->LBA3 = (StartOffset >> 24) & 0xFF;
+        SrbExtension->LBA4 = (StartOffset >> 32) & 0xFF;
+        SrbExtension->LBA5 = (StartOffset >> 40) & 0xFF;
+
+        SrbExtension->FeaturesLow = (SectorCount >> 0) & 0xFF;
+        SrbExtension->FeaturesHigh = (SectorCount >> 8) & 0xFF;
+        SrbExtension->SectorCountLow = 0;
+        SrbExtension->SectorCountHigh = 0;
+
+        SrbExtension->pSgl = (PLOCAL_SCATTER_GATHER_LIST)StorPortGetScatterGatherList(AdapterExtension, Srb);
+
+        return SRB_STATUS_PENDING;
+    }
+
     if (PortExtension->DeviceParams.Lba48BitMode)
     {
         SrbExtension->Flags |= ATA_FLAGS_48BIT_COMMAND;
@@ -2547,6 +2659,33 @@ RemoveQueue (
     return Srb;
 }// -- RemoveQueue();
 
+/**
+ * @name PeekQueue
+ * @implemented
+ *
+ * Return Srb at the front of Queue without removing it
+ *
+ * @param Queue
+ *
+ * @return
+ * return Srb
+ *
+ */
+FORCEINLINE
+PVOID
+PeekQueue (
+    __in PAHCI_QUEUE Queue
+    )
+{
+    NT_ASSERT(Queue->Head < MAXIMUM_QUEUE_BUFFER_SIZE);
+    NT_ASSERT(Queue->Tail < MAXIMUM_QUEUE_BUFFER_SIZE);
+
+    if (Queue->Head == Queue->Tail)
+        return NULL;
+
+    return Queue->Buffer[Queue->Tail];
+}// -- PeekQueue();
+
 /**
  * @name GetSrbExtension
  * @implemented
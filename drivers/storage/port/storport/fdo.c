@@ -24,8 +24,8 @@ PortFdoInterruptRoutine(
 {
     PFDO_DEVICE_EXTENSION DeviceExtension;
 
-    DPRINT1("PortFdoInterruptRoutine(%p %p)\n",
-            Interrupt, ServiceContext);
+    DPRINT("PortFdoInterruptRoutine(%p %p)\n",
+           Interrupt, ServiceContext);
 
     DeviceExtension = (PFDO_DEVICE_EXTENSION)ServiceContext;
 
@@ -139,6 +139,14 @@ PortFdoStartMiniport(
         return Status;
     }
 
+    /* Set up the SRB extensions and completion queues for the request path */
+    Status = PortInitializeRequestQueues(DeviceExtension);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("PortInitializeRequestQueues() failed (Status 0x%08lx)\n", Status);
+        return Status;
+    }
+
     /* Connect the configured interrupt */
     Status = PortFdoConnectInterrupt(DeviceExtension);
     if (!NT_SUCCESS(Status))
@@ -0,0 +1,511 @@
+/*
+ * PROJECT:     ReactOS Storport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Storport request queuing and completion
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include "precomp.h"
+
+#define NDEBUG
+#include <debug.h>
+
+
+/* FUNCTIONS ******************************************************************/
+
+static
+BOOLEAN
+PortBuildScatterGatherList(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _Out_ PSTOR_SCATTER_GATHER_LIST ScatterGatherList)
+{
+    PSTOR_SCATTER_GATHER_ELEMENT Element = NULL;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PUCHAR DataBuffer, MdlBuffer;
+    PPFN_NUMBER PfnArray = NULL;
+    ULONG Remaining, Length;
+    PMDL Mdl;
+
+    ScatterGatherList->NumberOfElements = 0;
+
+    DataBuffer = Srb->DataBuffer;
+    Remaining = Srb->DataTransferLength;
+    if (DataBuffer == NULL || Remaining == 0)
+        return TRUE;
+
+    /* Use the page frames of the MDL when it describes the data buffer */
+    Mdl = Irp->MdlAddress;
+    if (Mdl != NULL)
+    {
+        MdlBuffer = MmGetMdlVirtualAddress(Mdl);
+        if (DataBuffer >= MdlBuffer &&
+            DataBuffer + Remaining <= MdlBuffer + MmGetMdlByteCount(Mdl))
+        {
+            PfnArray = MmGetMdlPfnArray(Mdl) +
+                       ((BYTE_OFFSET(MdlBuffer) + (DataBuffer - MdlBuffer)) >> PAGE_SHIFT);
+        }
+    }
+
+    while (Remaining != 0)
+    {
+        Length = min(PAGE_SIZE - BYTE_OFFSET(DataBuffer), Remaining);
+
+        if (PfnArray != NULL)
+        {
+            PhysicalAddress.QuadPart = ((LONGLONG)*PfnArray++ << PAGE_SHIFT) + BYTE_OFFSET(DataBuffer);
+        }
+        else
+        {
+            PhysicalAddress = MmGetPhysicalAddress(DataBuffer);
+        }
+
+        /* Merge physically contiguous pages into a single element */
+        if (Element != NULL &&
+            Element->PhysicalAddress.QuadPart + Element->Length == PhysicalAddress.QuadPart)
+        {
+            Element->Length += Length;
+        }
+        else
+        {
+            if (ScatterGatherList->NumberOfElements == DeviceExtension->MaximumScatterGatherElements)
+                return FALSE;
+
+            Element = &ScatterGatherList->List[ScatterGatherList->NumberOfElements++];
+            Element->PhysicalAddress = PhysicalAddress;
+            Element->Length = Length;
+            Element->Reserved = 0;
+        }
+
+        DataBuffer += Length;
+        Remaining -= Length;
+    }
+
+    return TRUE;
+}
+
+
+/*
+ * Hands a request to the miniport. The caller holds the StartIo lock and
+ * has already charged the request to the queue depth of its logical unit.
+ */
+static
+VOID
+PortStartIo(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp)
+{
+    PSCSI_REQUEST_BLOCK Srb;
+    PVOID SrbExtension;
+
+    Srb = IoGetCurrentIrpStackLocation(Irp)->Parameters.Scsi.Srb;
+
+    SrbExtension = ExAllocateFromNPagedLookasideList(&DeviceExtension->SrbExtensionList);
+    if (SrbExtension == NULL)
+    {
+        Srb->SrbExtension = NULL;
+        Srb->SrbStatus = SRB_STATUS_BUSY;
+        PortCompleteRequest(DeviceExtension, Srb);
+        return;
+    }
+
+    RtlZeroMemory(SrbExtension, DeviceExtension->SrbExtensionSize);
+    Srb->SrbExtension = SrbExtension;
+
+    if (!PortBuildScatterGatherList(DeviceExtension,
+                                    Irp,
+                                    Srb,
+                                    (PSTOR_SCATTER_GATHER_LIST)((ULONG_PTR)SrbExtension + DeviceExtension->ScatterGatherListOffset)))
+    {
+        DPRINT1("Transfer of %lu bytes needs too many elements\n", Srb->DataTransferLength);
+        Srb->SrbStatus = SRB_STATUS_INVALID_REQUEST;
+        PortCompleteRequest(DeviceExtension, Srb);
+        return;
+    }
+
+    if (!MiniportStartIo(&DeviceExtension->Miniport, Srb))
+    {
+        Srb->SrbStatus = SRB_STATUS_BUSY;
+        PortCompleteRequest(DeviceExtension, Srb);
+    }
+}
+
+
+static
+VOID
+NTAPI
+PortCompletionDpcRoutine(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PPORT_COMPLETION_QUEUE CompletionQueue;
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+    PPDO_DEVICE_EXTENSION PdoExtension;
+    PSCSI_REQUEST_BLOCK Srb, NextSrb, CompletedSrbs = NULL;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    LIST_ENTRY StartIrpListHead;
+    PLIST_ENTRY ListEntry;
+    PIRP Irp;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    CompletionQueue = (PPORT_COMPLETION_QUEUE)DeferredContext;
+    DeviceExtension = CompletionQueue->DeviceExtension;
+
+    /* Grab everything completed so far, and restore the completion order */
+    Srb = InterlockedExchangePointer((PVOID*)&CompletionQueue->CompletedSrbs, NULL);
+    while (Srb != NULL)
+    {
+        NextSrb = Srb->NextSrb;
+        Srb->NextSrb = CompletedSrbs;
+        CompletedSrbs = Srb;
+        Srb = NextSrb;
+    }
+
+    /* Return the queue depth and pick the requests it lets us start */
+    InitializeListHead(&StartIrpListHead);
+
+    KeAcquireInStackQueuedSpinLock(&DeviceExtension->StartIoLock, &LockHandle);
+
+    /* Requests let in by a raised queue depth come first */
+    while (!IsListEmpty(&DeviceExtension->StartIrpListHead))
+    {
+        ListEntry = RemoveHeadList(&DeviceExtension->StartIrpListHead);
+        InsertTailList(&StartIrpListHead, ListEntry);
+    }
+
+    for (Srb = CompletedSrbs; Srb != NULL; Srb = Srb->NextSrb)
+    {
+        Irp = Srb->OriginalRequest;
+        PdoExtension = IoGetCurrentIrpStackLocation(Irp)->DeviceObject->DeviceExtension;
+
+        ASSERT(PdoExtension->OutstandingRequests != 0);
+        PdoExtension->OutstandingRequests--;
+
+        while (PdoExtension->OutstandingRequests < PdoExtension->QueueDepth &&
+               !IsListEmpty(&PdoExtension->PendingIrpListHead))
+        {
+            ListEntry = RemoveHeadList(&PdoExtension->PendingIrpListHead);
+            InsertTailList(&StartIrpListHead, ListEntry);
+            PdoExtension->OutstandingRequests++;
+        }
+    }
+
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    /* Complete the IRPs */
+    for (Srb = CompletedSrbs; Srb != NULL; Srb = NextSrb)
+    {
+        NextSrb = Srb->NextSrb;
+        Srb->NextSrb = NULL;
+
+        if (Srb->SrbExtension != NULL)
+        {
+            ExFreeToNPagedLookasideList(&DeviceExtension->SrbExtensionList,
+                                        Srb->SrbExtension);
+            Srb->SrbExtension = NULL;
+        }
+
+        Irp = Srb->OriginalRequest;
+
+        switch (SRB_STATUS(Srb->SrbStatus))
+        {
+            case SRB_STATUS_SUCCESS:
+            case SRB_STATUS_DATA_OVERRUN:
+                Irp->IoStatus.Status = STATUS_SUCCESS;
+                Irp->IoStatus.Information = Srb->DataTransferLength;
+                break;
+
+            case SRB_STATUS_BUSY:
+                Irp->IoStatus.Status = STATUS_DEVICE_BUSY;
+                Irp->IoStatus.Information = 0;
+                break;
+
+            case SRB_STATUS_INVALID_REQUEST:
+            case SRB_STATUS_BAD_FUNCTION:
+                Irp->IoStatus.Status = STATUS_INVALID_DEVICE_REQUEST;
+                Irp->IoStatus.Information = 0;
+                break;
+
+            case SRB_STATUS_NO_DEVICE:
+            case SRB_STATUS_SELECTION_TIMEOUT:
+                Irp->IoStatus.Status = STATUS_NO_SUCH_DEVICE;
+                Irp->IoStatus.Information = 0;
+                break;
+
+            default:
+                Irp->IoStatus.Status = STATUS_IO_DEVICE_ERROR;
+                Irp->IoStatus.Information = 0;
+                break;
+        }
+
+        IoCompleteRequest(Irp, IO_DISK_INCREMENT);
+    }
+
+    /* Hand the waiting requests to the miniport in one go */
+    if (!IsListEmpty(&StartIrpListHead))
+    {
+        KeAcquireInStackQueuedSpinLock(&DeviceExtension->StartIoLock, &LockHandle);
+
+        while (!IsListEmpty(&StartIrpListHead))
+        {
+            ListEntry = RemoveHeadList(&StartIrpListHead);
+            Irp = CONTAINING_RECORD(ListEntry, IRP, Tail.Overlay.ListEntry);
+            PortStartIo(DeviceExtension, Irp);
+        }
+
+        KeReleaseInStackQueuedSpinLock(&LockHandle);
+    }
+}
+
+
+NTSTATUS
+PortInitializeRequestQueues(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    PPORT_COMPLETION_QUEUE CompletionQueue;
+    ULONG MaximumTransferLength;
+    ULONG NumberOfPhysicalBreaks;
+    ULONG BlockSize;
+    ULONG i;
+
+    DPRINT1("PortInitializeRequestQueues(%p)\n", DeviceExtension);
+
+    MaximumTransferLength = DeviceExtension->Miniport.PortConfig.MaximumTransferLength;
+    if (MaximumTransferLength == (ULONG)-1 || MaximumTransferLength == 0)
+        MaximumTransferLength = 0x10000;
+
+    DeviceExtension->MaximumScatterGatherElements = BYTES_TO_PAGES(MaximumTransferLength) + 1;
+
+    /* The miniport's own tables may hold fewer elements, requests that need more are failed */
+    NumberOfPhysicalBreaks = DeviceExtension->Miniport.PortConfig.NumberOfPhysicalBreaks;
+    if (NumberOfPhysicalBreaks != 0 && NumberOfPhysicalBreaks != (ULONG)-1)
+    {
+        DeviceExtension->MaximumScatterGatherElements = min(DeviceExtension->MaximumScatterGatherElements,
+                                                            NumberOfPhysicalBreaks + 1);
+    }
+    DeviceExtension->SrbExtensionSize = DeviceExtension->Miniport.InitData->SrbExtensionSize;
+    DeviceExtension->ScatterGatherListOffset = ALIGN_UP_BY(DeviceExtension->SrbExtensionSize,
+                                                           sizeof(ULONGLONG));
+
+    /*
+     * The scatter/gather list is stored behind the SRB extension. Using whole
+     * pages keeps every block page aligned, so an SRB extension that fits in
+     * a page never crosses a page boundary and miniports can hand it to the
+     * hardware as a command table. Blocks larger than a page come from pool
+     * and are not physically contiguous.
+     */
+    BlockSize = DeviceExtension->ScatterGatherListOffset +
+                FIELD_OFFSET(STOR_SCATTER_GATHER_LIST, List) +
+                DeviceExtension->MaximumScatterGatherElements * sizeof(STOR_SCATTER_GATHER_ELEMENT);
+    BlockSize = ROUND_TO_PAGES(BlockSize);
+
+    DPRINT1("SRB extension block size: %lu\n", BlockSize);
+
+    ExInitializeNPagedLookasideList(&DeviceExtension->SrbExtensionList,
+                                    NULL,
+                                    NULL,
+                                    0,
+                                    BlockSize,
+                                    TAG_SRB_EXTENSION,
+                                    0);
+
+    /* One completion queue per processor, drained by a DPC on that processor */
+    DeviceExtension->CompletionQueues = ExAllocatePoolWithTag(NonPagedPool,
+                                                              KeNumberProcessors * sizeof(PORT_COMPLETION_QUEUE),
+                                                              TAG_COMPLETION_DATA);
+    if (DeviceExtension->CompletionQueues == NULL)
+    {
+        ExDeleteNPagedLookasideList(&DeviceExtension->SrbExtensionList);
+        return STATUS_NO_MEMORY;
+    }
+
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        CompletionQueue = &DeviceExtension->CompletionQueues[i];
+
+        KeInitializeDpc(&CompletionQueue->Dpc,
+                        PortCompletionDpcRoutine,
+                        CompletionQueue);
+        KeSetTargetProcessorDpc(&CompletionQueue->Dpc, (CCHAR)i);
+        CompletionQueue->DeviceExtension = DeviceExtension;
+        CompletionQueue->CompletedSrbs = NULL;
+    }
+
+    DeviceExtension->CompletionQueueCount = KeNumberProcessors;
+
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS
+PortQueueRequest(
+    _In_ PPDO_DEVICE_EXTENSION PdoExtension,
+    _In_ PIRP Irp)
+{
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PSCSI_REQUEST_BLOCK Srb;
+
+    DPRINT("PortQueueRequest(%p %p)\n", PdoExtension, Irp);
+
+    DeviceExtension = PdoExtension->FdoExtension;
+    Srb = IoGetCurrentIrpStackLocation(Irp)->Parameters.Scsi.Srb;
+
+    if (DeviceExtension->CompletionQueues == NULL)
+    {
+        Srb->SrbStatus = SRB_STATUS_NO_DEVICE;
+        Irp->IoStatus.Status = STATUS_NO_SUCH_DEVICE;
+        Irp->IoStatus.Information = 0;
+        IoCompleteRequest(Irp, IO_NO_INCREMENT);
+        return STATUS_NO_SUCH_DEVICE;
+    }
+
+    Srb->PathId = (UCHAR)PdoExtension->Bus;
+    Srb->TargetId = (UCHAR)PdoExtension->Target;
+    Srb->Lun = (UCHAR)PdoExtension->Lun;
+    Srb->OriginalRequest = Irp;
+    Srb->SrbExtension = NULL;
+    Srb->NextSrb = NULL;
+    Srb->SrbStatus = SRB_STATUS_PENDING;
+
+    IoMarkIrpPending(Irp);
+
+    KeAcquireInStackQueuedSpinLock(&DeviceExtension->StartIoLock, &LockHandle);
+
+    if (PdoExtension->OutstandingRequests >= PdoExtension->QueueDepth)
+    {
+        /* Started by the completion DPC once the logical unit has room again */
+        InsertTailList(&PdoExtension->PendingIrpListHead,
+                       &Irp->Tail.Overlay.ListEntry);
+    }
+    else
+    {
+        PdoExtension->OutstandingRequests++;
+        PortStartIo(DeviceExtension, Irp);
+    }
+
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    return STATUS_PENDING;
+}
+
+
+/*
+ * Called by the miniport at any IRQL up to its interrupt IRQL, so the SRB is
+ * only pushed onto the completion queue of the current processor here.
+ */
+VOID
+PortCompleteRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PPORT_COMPLETION_QUEUE CompletionQueue;
+    PSCSI_REQUEST_BLOCK CompletedSrbs;
+
+    if (Srb->OriginalRequest == NULL)
+    {
+        DPRINT1("Srb %p has no request\n", Srb);
+        return;
+    }
+
+    CompletionQueue = &DeviceExtension->CompletionQueues[KeGetCurrentProcessorNumber() %
+                                                         DeviceExtension->CompletionQueueCount];
+
+    do
+    {
+        CompletedSrbs = CompletionQueue->CompletedSrbs;
+        Srb->NextSrb = CompletedSrbs;
+    } while (InterlockedCompareExchangePointer((PVOID*)&CompletionQueue->CompletedSrbs,
+                                               Srb,
+                                               CompletedSrbs) != CompletedSrbs);
+
+    /* Fails if the DPC is already queued, which then picks this SRB up too */
+    KeInsertQueueDpc(&CompletionQueue->Dpc, NULL, NULL);
+}
+
+
+BOOLEAN
+PortSetDeviceQueueDepth(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun,
+    _In_ ULONG Depth)
+{
+    PPDO_DEVICE_EXTENSION PdoExtension;
+    PPORT_COMPLETION_QUEUE CompletionQueue;
+    KLOCK_QUEUE_HANDLE LockHandle, StartIoLockHandle;
+    PLIST_ENTRY ListEntry;
+    BOOLEAN Result = FALSE;
+    BOOLEAN StartIrps = FALSE;
+
+    DPRINT1("PortSetDeviceQueueDepth(%p %u %u %u %lu)\n",
+            DeviceExtension, PathId, TargetId, Lun, Depth);
+
+    if (Depth == 0 || Depth > MAXIMUM_QUEUE_DEPTH)
+        return FALSE;
+
+    KeAcquireInStackQueuedSpinLock(&DeviceExtension->PdoListLock,
+                                   &LockHandle);
+
+    ListEntry = DeviceExtension->PdoListHead.Flink;
+    while (ListEntry != &DeviceExtension->PdoListHead)
+    {
+        PdoExtension = CONTAINING_RECORD(ListEntry,
+                                         PDO_DEVICE_EXTENSION,
+                                         PdoListEntry);
+
+        if (PdoExtension->Bus == PathId &&
+            PdoExtension->Target == TargetId &&
+            PdoExtension->Lun == Lun)
+        {
+            KeAcquireInStackQueuedSpinLock(&DeviceExtension->StartIoLock,
+                                           &StartIoLockHandle);
+
+            PdoExtension->QueueDepth = Depth;
+
+            /* Charge the waiting requests that fit now, the completion DPC starts them */
+            while (PdoExtension->OutstandingRequests < PdoExtension->QueueDepth &&
+                   !IsListEmpty(&PdoExtension->PendingIrpListHead))
+            {
+                ListEntry = RemoveHeadList(&PdoExtension->PendingIrpListHead);
+                InsertTailList(&DeviceExtension->StartIrpListHead, ListEntry);
+                PdoExtension->OutstandingRequests++;
+                StartIrps = TRUE;
+            }
+
+            KeReleaseInStackQueuedSpinLock(&StartIoLockHandle);
+
+            Result = TRUE;
+            break;
+        }
+
+        ListEntry = ListEntry->Flink;
+    }
+
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    /*
+     * Miniports call this from their own DPC or completion routines, so the
+     * requests are started by the completion DPC rather than by calling back
+     * into HwStartIo from here. HwStartIo itself must not call this, since it
+     * runs under the StartIo lock.
+     */
+    if (StartIrps)
+    {
+        CompletionQueue = &DeviceExtension->CompletionQueues[KeGetCurrentProcessorNumber() %
+                                                             DeviceExtension->CompletionQueueCount];
+        KeInsertQueueDpc(&CompletionQueue->Dpc, NULL, NULL);
+    }
+
+    return Result;
+}
+
+/* EOF */
@@ -70,6 +70,9 @@ PortCreatePdo(
     DeviceExtension->Target = Target;
     DeviceExtension->Lun = Lun;
 
+    DeviceExtension->QueueDepth = DEFAULT_QUEUE_DEPTH;
+    InitializeListHead(&DeviceExtension->PendingIrpListHead);
+
 
     // FIXME: More initialization
 
@@ -121,7 +124,16 @@ PortPdoScsi(
     _In_ PDEVICE_OBJECT DeviceObject,
     _In_ PIRP Irp)
 {
-    DPRINT1("PortPdoScsi(%p %p)\n", DeviceObject, Irp);
+    PSCSI_REQUEST_BLOCK Srb;
+
+    DPRINT("PortPdoScsi(%p %p)\n", DeviceObject, Irp);
+
+    Srb = IoGetCurrentIrpStackLocation(Irp)->Parameters.Scsi.Srb;
+    if (Srb != NULL && Srb->Function == SRB_FUNCTION_EXECUTE_SCSI)
+    {
+        return PortQueueRequest((PPDO_DEVICE_EXTENSION)DeviceObject->DeviceExtension,
+                                Irp);
+    }
 
     Irp->IoStatus.Information = 0;
     Irp->IoStatus.Status = STATUS_SUCCESS;
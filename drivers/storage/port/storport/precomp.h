@@ -31,6 +31,12 @@
 #define TAG_ADDRESS_MAPPING 'MAtS'
 #define TAG_INQUIRY_DATA    'QItS'
 #define TAG_SENSE_DATA      'NStS'
+#define TAG_SRB_EXTENSION   'EStS'
+#define TAG_COMPLETION_DATA 'DCtS'
+
+/* Requests a logical unit may have outstanding until the miniport raises it */
+#define DEFAULT_QUEUE_DEPTH     20
+#define MAXIMUM_QUEUE_DEPTH     254
 
 typedef enum
 {
@@ -81,6 +87,13 @@ typedef struct _MINIPORT
     PMINIPORT_DEVICE_EXTENSION MiniportExtension;
 } MINIPORT, *PMINIPORT;
 
+typedef struct _PORT_COMPLETION_QUEUE
+{
+    KDPC Dpc;
+    struct _FDO_DEVICE_EXTENSION *DeviceExtension;
+    PSCSI_REQUEST_BLOCK CompletedSrbs;
+} PORT_COMPLETION_QUEUE, *PPORT_COMPLETION_QUEUE;
+
 typedef struct _UNIT_DATA
 {
     LIST_ENTRY ListEntry;
@@ -112,6 +125,15 @@ typedef struct _FDO_DEVICE_EXTENSION
     PKINTERRUPT Interrupt;
     ULONG InterruptIrql;
 
+    KSPIN_LOCK StartIoLock;
+    NPAGED_LOOKASIDE_LIST SrbExtensionList;
+    ULONG SrbExtensionSize;
+    ULONG ScatterGatherListOffset;
+    ULONG MaximumScatterGatherElements;
+    ULONG CompletionQueueCount;
+    PPORT_COMPLETION_QUEUE CompletionQueues;
+    LIST_ENTRY StartIrpListHead;
+
     KSPIN_LOCK PdoListLock;
     LIST_ENTRY PdoListHead;
     ULONG PdoCount;
@@ -132,7 +154,9 @@ typedef struct _PDO_DEVICE_EXTENSION
     ULONG Lun;
     PINQUIRYDATA InquiryBuffer;
 
-
+    ULONG QueueDepth;
+    ULONG OutstandingRequests;
+    LIST_ENTRY PendingIrpListHead;
 } PDO_DEVICE_EXTENSION, *PPDO_DEVICE_EXTENSION;
 
 
@@ -151,6 +175,31 @@ PortFdoPnp(
     _In_ PIRP Irp);
 
 
+/* io.c */
+
+NTSTATUS
+PortInitializeRequestQueues(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension);
+
+NTSTATUS
+PortQueueRequest(
+    _In_ PPDO_DEVICE_EXTENSION PdoExtension,
+    _In_ PIRP Irp);
+
+VOID
+PortCompleteRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+BOOLEAN
+PortSetDeviceQueueDepth(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun,
+    _In_ ULONG Depth);
+
+
 /* miniport.c */
 
 NTSTATUS
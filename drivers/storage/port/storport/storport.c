@@ -18,6 +18,12 @@
 ULONG PortNumber = 0;
 
 
+/* The in-stack queued lock handle is stored in the lock context */
+C_ASSERT(sizeof(((PSTOR_LOCK_HANDLE)NULL)->Context) >= sizeof(KLOCK_QUEUE_HANDLE));
+C_ASSERT(FIELD_OFFSET(KLOCK_QUEUE_HANDLE, OldIrql) ==
+         FIELD_OFFSET(STOR_LOCK_HANDLE, Context.OldIrql) - FIELD_OFFSET(STOR_LOCK_HANDLE, Context));
+
+
 /* FUNCTIONS ******************************************************************/
 
 static
@@ -108,23 +114,27 @@ PortAcquireSpinLock(
     PVOID LockContext,
     PSTOR_LOCK_HANDLE LockHandle)
 {
-    DPRINT1("PortAcquireSpinLock(%p %lu %p %p)\n",
-            DeviceExtension, SpinLock, LockContext, LockHandle);
+    DPRINT("PortAcquireSpinLock(%p %lu %p %p)\n",
+           DeviceExtension, SpinLock, LockContext, LockHandle);
 
     LockHandle->Lock = SpinLock;
 
     switch (SpinLock)
     {
         case DpcLock: /* 1, */
-            DPRINT1("DpcLock\n");
+            DPRINT("DpcLock\n");
+            KeAcquireInStackQueuedSpinLock((PKSPIN_LOCK)&((PSTOR_DPC)LockContext)->Lock,
+                                           (PKLOCK_QUEUE_HANDLE)&LockHandle->Context);
             break;
 
         case StartIoLock: /* 2 */
-            DPRINT1("StartIoLock\n");
+            DPRINT("StartIoLock\n");
+            KeAcquireInStackQueuedSpinLock(&DeviceExtension->StartIoLock,
+                                           (PKLOCK_QUEUE_HANDLE)&LockHandle->Context);
             break;
 
         case InterruptLock: /* 3 */
-            DPRINT1("InterruptLock\n");
+            DPRINT("InterruptLock\n");
             if (DeviceExtension->Interrupt == NULL)
                 LockHandle->Context.OldIrql = 0;
             else
@@ -140,21 +150,23 @@ PortReleaseSpinLock(
     PFDO_DEVICE_EXTENSION DeviceExtension,
     PSTOR_LOCK_HANDLE LockHandle)
 {
-    DPRINT1("PortReleaseSpinLock(%p %p)\n",
-            DeviceExtension, LockHandle);
+    DPRINT("PortReleaseSpinLock(%p %p)\n",
+           DeviceExtension, LockHandle);
 
     switch (LockHandle->Lock)
     {
         case DpcLock: /* 1, */
-            DPRINT1("DpcLock\n");
+            DPRINT("DpcLock\n");
+            KeReleaseInStackQueuedSpinLock((PKLOCK_QUEUE_HANDLE)&LockHandle->Context);
             break;
 
         case StartIoLock: /* 2 */
-            DPRINT1("StartIoLock\n");
+            DPRINT("StartIoLock\n");
+            KeReleaseInStackQueuedSpinLock((PKLOCK_QUEUE_HANDLE)&LockHandle->Context);
             break;
 
         case InterruptLock: /* 3 */
-            DPRINT1("InterruptLock\n");
+            DPRINT("InterruptLock\n");
             if (DeviceExtension->Interrupt != NULL)
                 KeReleaseInterruptSpinLock(DeviceExtension->Interrupt,
                                            LockHandle->Context.OldIrql);
@@ -223,6 +235,9 @@ PortAddDevice(
 
     DeviceExtension->PnpState = dsStopped;
 
+    KeInitializeSpinLock(&DeviceExtension->StartIoLock);
+    InitializeListHead(&DeviceExtension->StartIrpListHead);
+
     KeInitializeSpinLock(&DeviceExtension->PdoListLock);
     InitializeListHead(&DeviceExtension->PdoListHead);
 
@@ -799,15 +814,15 @@ StorPortGetPhysicalAddress(
     STOR_PHYSICAL_ADDRESS PhysicalAddress;
     ULONG_PTR Offset;
 
-    DPRINT1("StorPortGetPhysicalAddress(%p %p %p %p)\n",
-            HwDeviceExtension, Srb, VirtualAddress, Length);
+    DPRINT("StorPortGetPhysicalAddress(%p %p %p %p)\n",
+           HwDeviceExtension, Srb, VirtualAddress, Length);
 
     /* Get the miniport extension */
     MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
                                           MINIPORT_DEVICE_EXTENSION,
                                           HwDeviceExtension);
-    DPRINT1("HwDeviceExtension %p  MiniportExtension %p\n",
-            HwDeviceExtension, MiniportExtension);
+    DPRINT("HwDeviceExtension %p  MiniportExtension %p\n",
+           HwDeviceExtension, MiniportExtension);
 
     DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
 
@@ -838,7 +853,7 @@ StorPortGetPhysicalAddress(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 PSTOR_SCATTER_GATHER_LIST
@@ -847,9 +862,21 @@ StorPortGetScatterGatherList(
     _In_ PVOID DeviceExtension,
     _In_ PSCSI_REQUEST_BLOCK Srb)
 {
-    DPRINT1("StorPortGetScatterGatherList()\n");
-    UNIMPLEMENTED;
-    return NULL;
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+
+    DPRINT("StorPortGetScatterGatherList(%p %p)\n", DeviceExtension, Srb);
+
+    if (Srb->SrbExtension == NULL)
+        return NULL;
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(DeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+
+    /* The list was built behind the SRB extension when the request was started */
+    return (PSTOR_SCATTER_GATHER_LIST)((ULONG_PTR)Srb->SrbExtension +
+                                       MiniportExtension->Miniport->DeviceExtension->ScatterGatherListOffset);
 }
 
 
@@ -1102,6 +1129,7 @@ StorPortNotification(
     PBOOLEAN Result;
     PSTOR_DPC Dpc;
     PHW_DPC_ROUTINE HwDpcRoutine;
+    PVOID SystemArgument1, SystemArgument2;
     va_list ap;
 
     STOR_SPINLOCK SpinLock;
@@ -1109,8 +1137,8 @@ StorPortNotification(
     PSTOR_LOCK_HANDLE LockHandle;
     PSCSI_REQUEST_BLOCK Srb;
 
-    DPRINT1("StorPortNotification(%x %p)\n",
-            NotificationType, HwDeviceExtension);
+    DPRINT("StorPortNotification(%x %p)\n",
+           NotificationType, HwDeviceExtension);
 
     /* Get the miniport extension */
     if (HwDeviceExtension != NULL)
@@ -1118,8 +1146,8 @@ StorPortNotification(
         MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
                                               MINIPORT_DEVICE_EXTENSION,
                                               HwDeviceExtension);
-        DPRINT1("HwDeviceExtension %p  MiniportExtension %p\n",
-                HwDeviceExtension, MiniportExtension);
+        DPRINT("HwDeviceExtension %p  MiniportExtension %p\n",
+               HwDeviceExtension, MiniportExtension);
 
         DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
     }
@@ -1129,14 +1157,11 @@ StorPortNotification(
     switch (NotificationType)
     {
         case RequestComplete:
-            DPRINT1("RequestComplete\n");
+            DPRINT("RequestComplete\n");
             Srb = (PSCSI_REQUEST_BLOCK)va_arg(ap, PSCSI_REQUEST_BLOCK);
-            DPRINT1("Srb %p\n", Srb);
-            if (Srb->OriginalRequest != NULL)
-            {
-                DPRINT1("Need to complete the IRP!\n");
-
-            }
+            DPRINT("Srb %p\n", Srb);
+            if (DeviceExtension != NULL)
+                PortCompleteRequest(DeviceExtension, Srb);
             break;
 
         case GetExtendedFunctionTable:
@@ -1171,18 +1196,29 @@ StorPortNotification(
 
             KeInitializeDpc((PRKDPC)&Dpc->Dpc,
                             (PKDEFERRED_ROUTINE)HwDpcRoutine,
-                            (PVOID)DeviceExtension);
-            KeInitializeSpinLock(&Dpc->Lock);
+                            HwDeviceExtension);
+            KeInitializeSpinLock((PKSPIN_LOCK)&Dpc->Lock);
+            break;
+
+        case IssueDpc:
+            DPRINT("IssueDpc\n");
+            Dpc = (PSTOR_DPC)va_arg(ap, PSTOR_DPC);
+            SystemArgument1 = (PVOID)va_arg(ap, PVOID);
+            SystemArgument2 = (PVOID)va_arg(ap, PVOID);
+            Result = (PBOOLEAN)va_arg(ap, PBOOLEAN);
+            *Result = KeInsertQueueDpc((PRKDPC)&Dpc->Dpc,
+                                       SystemArgument1,
+                                       SystemArgument2);
             break;
 
         case AcquireSpinLock:
-            DPRINT1("AcquireSpinLock\n");
+            DPRINT("AcquireSpinLock\n");
             SpinLock = (STOR_SPINLOCK)va_arg(ap, STOR_SPINLOCK);
-            DPRINT1("SpinLock %lu\n", SpinLock);
+            DPRINT("SpinLock %lu\n", SpinLock);
             LockContext = (PVOID)va_arg(ap, PVOID);
-            DPRINT1("LockContext %p\n", LockContext);
+            DPRINT("LockContext %p\n", LockContext);
             LockHandle = (PSTOR_LOCK_HANDLE)va_arg(ap, PSTOR_LOCK_HANDLE);
-            DPRINT1("LockHandle %p\n", LockHandle);
+            DPRINT("LockHandle %p\n", LockHandle);
             PortAcquireSpinLock(DeviceExtension,
                                 SpinLock,
                                 LockContext,
@@ -1190,9 +1226,9 @@ StorPortNotification(
             break;
 
         case ReleaseSpinLock:
-            DPRINT1("ReleaseSpinLock\n");
+            DPRINT("ReleaseSpinLock\n");
             LockHandle = (PSTOR_LOCK_HANDLE)va_arg(ap, PSTOR_LOCK_HANDLE);
-            DPRINT1("LockHandle %p\n", LockHandle);
+            DPRINT("LockHandle %p\n", LockHandle);
             PortReleaseSpinLock(DeviceExtension,
                                 LockHandle);
             break;
@@ -1390,7 +1426,7 @@ StorPortSetBusDataByOffset(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 BOOLEAN
@@ -1402,9 +1438,20 @@ StorPortSetDeviceQueueDepth(
     _In_ UCHAR Lun,
     _In_ ULONG Depth)
 {
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+
     DPRINT1("StorPortSetDeviceQueueDepth()\n");
-    UNIMPLEMENTED;
-    return FALSE;
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+
+    return PortSetDeviceQueueDepth(MiniportExtension->Miniport->DeviceExtension,
+                                   PathId,
+                                   TargetId,
+                                   Lun,
+                                   Depth);
 }
 
 
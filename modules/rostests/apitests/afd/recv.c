@@ -0,0 +1,133 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     Test for IOCTL_AFD_RECV receiving into the user buffer
+ */
+
+#include "precomp.h"
+
+#define TRANSFER_SIZE   (1024 * 1024)
+#define CHUNK_SIZE      (16 * 1024)
+#define RECV_SIZE       (64 * 1024)
+
+static
+DWORD
+WINAPI
+SendThread(
+    _In_ PVOID Parameter)
+{
+    SOCKET Socket = (SOCKET)Parameter;
+    static UCHAR Buffer[CHUNK_SIZE];
+    ULONG Sent, i;
+    int Length;
+
+    for (Sent = 0; Sent < TRANSFER_SIZE; Sent += Length)
+    {
+        for (i = 0; i < CHUNK_SIZE; i++)
+            Buffer[i] = (UCHAR)(Sent + i);
+
+        Length = send(Socket, (const char *)Buffer, CHUNK_SIZE, 0);
+        if (Length <= 0)
+            break;
+
+        /* Let the receiver post its next receive before the data arrives */
+        Sleep(1);
+    }
+
+    shutdown(Socket, SD_SEND);
+    return 0;
+}
+
+static
+void
+TestLoneReceiver(void)
+{
+    NTSTATUS Status;
+    SOCKET Listener, Client, Server;
+    struct sockaddr_in addr;
+    int AddrLength, Length, i;
+    HANDLE Thread;
+    PUCHAR Buffer;
+    ULONG Received = 0, DirectReceives;
+    BOOL Corrupted = FALSE;
+
+    Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(Listener != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    Client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(Client != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (Listener == INVALID_SOCKET || Client == INVALID_SOCKET)
+        return;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(0);
+    ok(bind(Listener, (struct sockaddr *)&addr, sizeof(addr)) == 0, "bind failed with %d\n", WSAGetLastError());
+    ok(listen(Listener, 1) == 0, "listen failed with %d\n", WSAGetLastError());
+    AddrLength = sizeof(addr);
+    ok(getsockname(Listener, (struct sockaddr *)&addr, &AddrLength) == 0, "getsockname failed with %d\n", WSAGetLastError());
+
+    ok(connect(Client, (struct sockaddr *)&addr, sizeof(addr)) == 0, "connect failed with %d\n", WSAGetLastError());
+    Server = accept(Listener, NULL, NULL);
+    ok(Server != INVALID_SOCKET, "accept failed with %d\n", WSAGetLastError());
+    if (Server == INVALID_SOCKET)
+        goto Cleanup;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, RECV_SIZE);
+    Thread = CreateThread(NULL, 0, SendThread, (PVOID)Client, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+
+    /* A single blocking recv at a time, as most applications do */
+    for (;;)
+    {
+        Length = recv(Server, (char *)Buffer, RECV_SIZE, 0);
+        if (Length <= 0)
+            break;
+
+        for (i = 0; i < Length && !Corrupted; i++)
+            Corrupted = (Buffer[i] != (UCHAR)(Received + i));
+        Received += Length;
+    }
+
+    ok(Length == 0, "recv failed with %d\n", WSAGetLastError());
+    ok(Received == TRANSFER_SIZE, "Received %lu bytes\n", Received);
+    ok(!Corrupted, "The received data is out of order\n");
+
+    Status = AfdGetInformation((HANDLE)Server, AFD_INFO_DIRECT_RECEIVES, NULL, &DirectReceives, NULL);
+    if (Status != STATUS_SUCCESS)
+    {
+        skip("AFD_INFO_DIRECT_RECEIVES is not supported (%lx)\n", Status);
+    }
+    else
+    {
+        trace("%lu receives went straight into the user buffer\n", DirectReceives);
+        ok(DirectReceives != 0, "No receive went straight into the user buffer\n");
+    }
+
+    if (Thread)
+    {
+        WaitForSingleObject(Thread, INFINITE);
+        CloseHandle(Thread);
+    }
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    closesocket(Server);
+
+Cleanup:
+    closesocket(Client);
+    closesocket(Listener);
+}
+
+START_TEST(recv)
+{
+    WSADATA WsaData;
+
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0)
+    {
+        skip("WSAStartup failed\n");
+        return;
+    }
+
+    TestLoneReceiver();
+
+    WSACleanup();
+}
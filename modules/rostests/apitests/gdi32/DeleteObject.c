@@ -0,0 +1,177 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for creating and deleting GDI objects from many threads
+ */
+
+#include "precomp.h"
+
+#define CHURN_THREADS       4
+#define CHURN_ITERATIONS    25000
+#define CHURN_BATCH         64
+
+typedef struct _CHURN_THREAD
+{
+    ULONG cFailures;
+    HGDIOBJ ahobj[3 * CHURN_BATCH];
+} CHURN_THREAD, *PCHURN_THREAD;
+
+static HANDLE ghevtHandOff;
+static HANDLE ghevtHandedOff;
+static HGDIOBJ gahobjHandOff[3 * CHURN_BATCH];
+
+static BOOL
+CreateTriple(HGDIOBJ *phobj, ULONG i)
+{
+    phobj[0] = CreateSolidBrush(RGB(i, i >> 8, 0));
+    phobj[1] = CreatePen(PS_SOLID, 1, RGB(0, i, i >> 8));
+    phobj[2] = CreateRectRgn(0, 0, (i & 0xff) + 1, 1);
+
+    return (GetObjectType(phobj[0]) == OBJ_BRUSH &&
+            GetObjectType(phobj[1]) == OBJ_PEN &&
+            GetObjectType(phobj[2]) == OBJ_REGION);
+}
+
+/* Create and delete brushes, pens and regions in batches, the way a report
+   renderer does, and check that deleted handles really are gone */
+static DWORD WINAPI
+ChurnThread(LPVOID lpParameter)
+{
+    PCHURN_THREAD pct = lpParameter;
+    HGDIOBJ ahobjStale[2] = { NULL, NULL };
+    ULONG i, j;
+
+    for (i = 0; i < CHURN_ITERATIONS; i += CHURN_BATCH)
+    {
+        for (j = 0; j < CHURN_BATCH; j++)
+        {
+            if (!CreateTriple(&pct->ahobj[3 * j], i + j))
+                pct->cFailures++;
+        }
+
+        /* The new batch reuses the entries of the last one. A stale handle
+           must not reach the new object that now lives in its entry */
+        for (j = 0; j < 2 && ahobjStale[j]; j++)
+        {
+            if (GetObjectType(ahobjStale[j]) != 0)
+                pct->cFailures++;
+        }
+
+        ahobjStale[0] = pct->ahobj[0];
+        ahobjStale[1] = pct->ahobj[3 * CHURN_BATCH - 1];
+
+        for (j = 0; j < 3 * CHURN_BATCH; j++)
+        {
+            if (!DeleteObject(pct->ahobj[j]))
+                pct->cFailures++;
+        }
+
+        GdiFlush();
+
+        if (GetObjectType(ahobjStale[0]) != 0 ||
+            GetObjectType(ahobjStale[1]) != 0)
+        {
+            pct->cFailures++;
+        }
+    }
+
+    return 0;
+}
+
+/* Deletes objects that another thread created */
+static DWORD WINAPI
+DeleterThread(LPVOID lpParameter)
+{
+    PULONG pcFailures = lpParameter;
+    ULONG i, j;
+
+    for (i = 0; i < CHURN_ITERATIONS / 10; i += CHURN_BATCH)
+    {
+        WaitForSingleObject(ghevtHandOff, INFINITE);
+        for (j = 0; j < 3 * CHURN_BATCH; j++)
+        {
+            if (!DeleteObject(gahobjHandOff[j]))
+                (*pcFailures)++;
+        }
+        GdiFlush();
+        SetEvent(ghevtHandedOff);
+    }
+
+    return 0;
+}
+
+static void
+Test_CrossThreadDelete(void)
+{
+    HANDLE hThread;
+    ULONG i, j, cFailures = 0, cDeleterFailures = 0;
+
+    ghevtHandOff = CreateEventW(NULL, FALSE, FALSE, NULL);
+    ghevtHandedOff = CreateEventW(NULL, FALSE, FALSE, NULL);
+    hThread = CreateThread(NULL, 0, DeleterThread, &cDeleterFailures, 0, NULL);
+    ok(hThread != NULL, "CreateThread failed\n");
+    if (!hThread)
+        return;
+
+    for (i = 0; i < CHURN_ITERATIONS / 10; i += CHURN_BATCH)
+    {
+        for (j = 0; j < CHURN_BATCH; j++)
+        {
+            if (!CreateTriple(&gahobjHandOff[3 * j], i + j))
+                cFailures++;
+        }
+        SetEvent(ghevtHandOff);
+        WaitForSingleObject(ghevtHandedOff, INFINITE);
+
+        for (j = 0; j < 3 * CHURN_BATCH; j++)
+        {
+            if (GetObjectType(gahobjHandOff[j]) != 0)
+                cFailures++;
+        }
+    }
+
+    WaitForSingleObject(hThread, INFINITE);
+    CloseHandle(hThread);
+    CloseHandle(ghevtHandOff);
+    CloseHandle(ghevtHandedOff);
+
+    ok_long(cFailures, 0);
+    ok_long(cDeleterFailures, 0);
+}
+
+static void
+Test_Churn(void)
+{
+    static CHURN_THREAD act[CHURN_THREADS];
+    HANDLE ahThread[CHURN_THREADS];
+    ULONG i, cThreads, cFailures = 0;
+    DWORD dwStart, dwTime;
+
+    dwStart = GetTickCount();
+    for (cThreads = 0; cThreads < CHURN_THREADS; cThreads++)
+    {
+        ahThread[cThreads] = CreateThread(NULL, 0, ChurnThread, &act[cThreads], 0, NULL);
+        ok(ahThread[cThreads] != NULL, "CreateThread failed\n");
+        if (!ahThread[cThreads])
+            break;
+    }
+
+    WaitForMultipleObjects(cThreads, ahThread, TRUE, INFINITE);
+    dwTime = GetTickCount() - dwStart;
+
+    for (i = 0; i < cThreads; i++)
+    {
+        cFailures += act[i].cFailures;
+        CloseHandle(ahThread[i]);
+    }
+
+    ok_long(cFailures, 0);
+    trace("%lu threads created and deleted %lu objects in %lu ms\n",
+          cThreads, cThreads * CHURN_ITERATIONS * 3, dwTime);
+}
+
+START_TEST(DeleteObject)
+{
+    Test_Churn();
+    Test_CrossThreadDelete();
+}
@@ -0,0 +1,90 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for PtInRegion and RectInRegion
+ */
+
+#include "precomp.h"
+
+/* A 4x4 checkerboard of 10x10 squares, the top left one being set */
+static HRGN
+CreateCheckerRgn(void)
+{
+    HRGN hrgn, hrgnSquare;
+    INT x, y;
+
+    hrgn = CreateRectRgn(0, 0, 0, 0);
+    for (y = 0; y < 4; y++)
+    {
+        for (x = (y & 1); x < 4; x += 2)
+        {
+            hrgnSquare = CreateRectRgn(x * 10, y * 10, x * 10 + 10, y * 10 + 10);
+            CombineRgn(hrgn, hrgn, hrgnSquare, RGN_OR);
+            DeleteObject(hrgnSquare);
+        }
+    }
+
+    return hrgn;
+}
+
+void Test_PtInRegion()
+{
+    HRGN hrgn;
+    INT x, y;
+
+    hrgn = CreateCheckerRgn();
+    ok(hrgn != NULL, "CreateRectRgn failed\n");
+
+    for (y = -1; y <= 40; y++)
+    {
+        for (x = -1; x <= 40; x++)
+        {
+            BOOL bExpected = (x >= 0) && (x < 40) && (y >= 0) && (y < 40) &&
+                             ((((x / 10) + (y / 10)) & 1) == 0);
+            ok(PtInRegion(hrgn, x, y) == bExpected, "PtInRegion(%d, %d) failed\n", x, y);
+        }
+    }
+
+    DeleteObject(hrgn);
+}
+
+void Test_RectInRegion()
+{
+    HRGN hrgn;
+    RECT rc;
+
+    hrgn = CreateCheckerRgn();
+    ok(hrgn != NULL, "CreateRectRgn failed\n");
+
+    /* Inside a square that is set, and one that is not */
+    SetRect(&rc, 22, 22, 28, 28);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+    SetRect(&rc, 12, 22, 18, 28);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+
+    /* Touching the squares that are set, without overlapping them */
+    SetRect(&rc, 10, 0, 20, 10);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+
+    /* Spanning two bands, overlapping only in the second one */
+    SetRect(&rc, 12, 2, 18, 10);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+    SetRect(&rc, 12, 2, 18, 11);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+
+    /* Unordered coordinates */
+    SetRect(&rc, 28, 28, 22, 22);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+
+    /* Outside of the region */
+    SetRect(&rc, 40, 0, 50, 40);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+
+    DeleteObject(hrgn);
+}
+
+START_TEST(PtInRegion)
+{
+    Test_PtInRegion();
+    Test_RectInRegion();
+}
@@ -19,6 +19,7 @@ extern void func_CreateFontIndirect(void);
 extern void func_CreateIconIndirect(void);
 extern void func_CreatePen(void);
 extern void func_CreateRectRgn(void);
+extern void func_DeleteObject(void);
 extern void func_DPtoLP(void);
 extern void func_EngAcquireSemaphore(void);
 extern void func_EngCreateSemaphore(void);
@@ -62,6 +63,7 @@ extern void func_OffsetClipRgn(void);
 extern void func_OffsetRgn(void);
 extern void func_PaintRgn(void);
 extern void func_PatBlt(void);
+extern void func_PtInRegion(void);
 extern void func_Rectangle(void);
 extern void func_RealizePalette(void);
 extern void func_SelectObject(void);
@@ -97,6 +99,7 @@ const struct test winetest_testlist[] =
     { "CreateIconIndirect", func_CreateIconIndirect },
     { "CreatePen", func_CreatePen },
     { "CreateRectRgn", func_CreateRectRgn },
+    { "DeleteObject", func_DeleteObject },
     { "DPtoLP", func_DPtoLP },
     { "EngAcquireSemaphore", func_EngAcquireSemaphore },
     { "EngCreateSemaphore", func_EngCreateSemaphore },
@@ -140,6 +143,7 @@ const struct test winetest_testlist[] =
     { "OffsetRgn", func_OffsetRgn },
     { "PaintRgn", func_PaintRgn },
     { "PatBlt", func_PatBlt },
+    { "PtInRegion", func_PtInRegion },
     { "Rectangle", func_Rectangle },
     { "RealizePalette", func_RealizePalette },
     { "SelectObject", func_SelectObject },
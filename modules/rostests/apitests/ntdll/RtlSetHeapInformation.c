@@ -0,0 +1,134 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for RtlSetHeapInformation / Low Fragmentation Heap
+ */
+
+#include "precomp.h"
+
+#define BLOCK_COUNT 0x400
+
+static PUCHAR Blocks[BLOCK_COUNT];
+
+static
+ULONG
+QueryFrontEndType(
+    HANDLE hHeap)
+{
+    ULONG Info = 0xdeadbeef;
+    SIZE_T ReturnLength = 0;
+    NTSTATUS Status;
+
+    Status = RtlQueryHeapInformation(hHeap,
+                                     HeapCompatibilityInformation,
+                                     &Info,
+                                     sizeof(Info),
+                                     &ReturnLength);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_size_t(ReturnLength, sizeof(ULONG));
+    return Info;
+}
+
+static
+VOID
+TestAllocations(
+    HANDLE hHeap)
+{
+    ULONG i;
+    SIZE_T Size;
+    PUCHAR NewBlock;
+
+    for (i = 0; i < BLOCK_COUNT; i++)
+    {
+        Size = (i % 300) + 1;
+        Blocks[i] = RtlAllocateHeap(hHeap, HEAP_ZERO_MEMORY, Size);
+        ok(Blocks[i] != NULL, "Allocation %lu of size %lu failed\n", i, (ULONG)Size);
+        if (!Blocks[i])
+            continue;
+
+        ok_size_t(RtlSizeHeap(hHeap, 0, Blocks[i]), Size);
+        ok(Blocks[i][0] == 0 && Blocks[i][Size - 1] == 0, "Block %lu not zeroed\n", i);
+        RtlFillMemory(Blocks[i], Size, (UCHAR)i);
+    }
+
+    /* Grow and shrink some of them */
+    for (i = 0; i < BLOCK_COUNT; i += 3)
+    {
+        if (!Blocks[i])
+            continue;
+
+        Size = (i % 300) + 1;
+        NewBlock = RtlReAllocateHeap(hHeap, HEAP_ZERO_MEMORY, Blocks[i], Size + 100);
+        ok(NewBlock != NULL, "Reallocation %lu failed\n", i);
+        if (!NewBlock)
+            continue;
+
+        ok_size_t(RtlSizeHeap(hHeap, 0, NewBlock), Size + 100);
+        ok(NewBlock[0] == (UCHAR)i && NewBlock[Size - 1] == (UCHAR)i, "Block %lu contents lost\n", i);
+        ok(NewBlock[Size] == 0 && NewBlock[Size + 99] == 0, "Block %lu tail not zeroed\n", i);
+        Blocks[i] = NewBlock;
+    }
+
+    for (i = 0; i < BLOCK_COUNT; i++)
+    {
+        if (!Blocks[i])
+            continue;
+
+        ok(RtlValidateHeap(hHeap, 0, Blocks[i]), "Block %lu is invalid\n", i);
+        ok(RtlFreeHeap(hHeap, 0, Blocks[i]), "Freeing block %lu failed\n", i);
+    }
+
+    ok(RtlValidateHeap(hHeap, 0, NULL), "Heap is invalid\n");
+}
+
+START_TEST(RtlSetHeapInformation)
+{
+    HANDLE hHeap;
+    ULONG Info;
+    NTSTATUS Status;
+
+    hHeap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    if (!hHeap)
+    {
+        skip("RtlCreateHeap failed\n");
+        return;
+    }
+
+    ok_long(QueryFrontEndType(hHeap), 0);
+
+    /* Only the LFH can be enabled */
+    Info = 1;
+    Status = RtlSetHeapInformation(hHeap, HeapCompatibilityInformation, &Info, sizeof(Info));
+    ok_ntstatus(Status, STATUS_UNSUCCESSFUL);
+
+    Status = RtlSetHeapInformation(hHeap, HeapCompatibilityInformation, &Info, sizeof(USHORT));
+    ok_ntstatus(Status, STATUS_BUFFER_TOO_SMALL);
+
+    /* Allocations done before enabling it must still be freed correctly afterwards */
+    Blocks[0] = RtlAllocateHeap(hHeap, 0, 16);
+    ok(Blocks[0] != NULL, "Allocation failed\n");
+
+    Info = 2;
+    Status = RtlSetHeapInformation(hHeap, HeapCompatibilityInformation, &Info, sizeof(Info));
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(QueryFrontEndType(hHeap), 2);
+
+    /* Enabling it twice is fine */
+    Status = RtlSetHeapInformation(hHeap, HeapCompatibilityInformation, &Info, sizeof(Info));
+    ok_ntstatus(Status, STATUS_SUCCESS);
+
+    ok(RtlFreeHeap(hHeap, 0, Blocks[0]), "Freeing a back end block failed\n");
+
+    TestAllocations(hHeap);
+    RtlDestroyHeap(hHeap);
+
+    /* Not serialized heaps can't have a LFH */
+    hHeap = RtlCreateHeap(HEAP_GROWABLE | HEAP_NO_SERIALIZE, NULL, 0, 0, NULL, NULL);
+    if (hHeap)
+    {
+        Status = RtlSetHeapInformation(hHeap, HeapCompatibilityInformation, &Info, sizeof(Info));
+        ok_ntstatus(Status, STATUS_UNSUCCESSFUL);
+        ok_long(QueryFrontEndType(hHeap), 0);
+        RtlDestroyHeap(hHeap);
+    }
+}
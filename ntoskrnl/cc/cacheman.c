@@ -150,7 +150,15 @@ CcRemapBcb (
 }
 
 /*
- * @unimplemented
+ * @implemented
+ *
+ * The private cache map keeps the history of the handle:
+ * - FileOffset1/BeyondLastByte1 and FileOffset2/BeyondLastByte2 are the
+ *   last two reads, updated by CcCopyRead
+ * - ReadAheadOffset[0] is how far read ahead went for the current stream
+ *   and ReadAheadLength[0] is its current window
+ * - ReadAheadOffset[1]/ReadAheadLength[1] is the range waiting for
+ *   CcPerformReadAhead, a length of 0 means there is none
  */
 VOID
 NTAPI
@@ -161,7 +169,12 @@ CcScheduleReadAhead (
 	)
 {
     KIRQL OldIrql;
-    LARGE_INTEGER NewOffset;
+    LONGLONG ReadEnd;
+    LONGLONG Stride;
+    LONGLONG Start;
+    LONGLONG End;
+    ULONG Window;
+    ULONG MinWindow;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
     PPRIVATE_CACHE_MAP PrivateCacheMap;
 
@@ -170,53 +183,103 @@ CcScheduleReadAhead (
 
     /* If file isn't cached, or if read ahead is disabled, this is no op */
     if (SharedCacheMap == NULL || PrivateCacheMap == NULL ||
-        BooleanFlagOn(SharedCacheMap->Flags, READAHEAD_DISABLED))
+        BooleanFlagOn(SharedCacheMap->Flags, READAHEAD_DISABLED) ||
+        BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS))
     {
         return;
     }
 
-    /* Round read length with read ahead mask */
-    Length = ROUND_UP(Length, PrivateCacheMap->ReadAheadMask + 1);
-    /* Compute the offset we'll reach */
-    NewOffset.QuadPart = FileOffset->QuadPart + Length;
+    /* Never read ahead less than the read itself, rounded to the granularity */
+    MinWindow = max(CC_MIN_READ_AHEAD, ROUND_UP(Length, PrivateCacheMap->ReadAheadMask + 1));
+    MinWindow = min(MinWindow, CC_MAX_READ_AHEAD);
+    ReadEnd = FileOffset->QuadPart + Length;
 
     /* Lock read ahead spin lock */
     KeAcquireSpinLock(&PrivateCacheMap->ReadAheadSpinLock, &OldIrql);
-    /* Easy case: the file is sequentially read */
-    if (BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY))
+
+    Window = max(PrivateCacheMap->ReadAheadLength[0], MinWindow);
+    Stride = FileOffset->QuadPart - PrivateCacheMap->FileOffset2.QuadPart;
+
+    /* Sequential: this read starts within or right after the previous one */
+    if (BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY) ||
+        (FileOffset->QuadPart >= PrivateCacheMap->FileOffset2.QuadPart &&
+         FileOffset->QuadPart <= PrivateCacheMap->BeyondLastByte2.QuadPart))
     {
-        /* If we went backward, this is no go! */
-        if (NewOffset.QuadPart < PrivateCacheMap->ReadAheadOffset[1].QuadPart)
+        /* Forget about a stream that was left behind */
+        if (PrivateCacheMap->ReadAheadOffset[0].QuadPart > ReadEnd + CC_MAX_READ_AHEAD)
+        {
+            PrivateCacheMap->ReadAheadOffset[0].QuadPart = 0;
+        }
+
+        /* Wait for the reader to get into the second half of the window, so that
+         * read ahead is issued in batches rather than for every single read
+         */
+        if (ReadEnd + Window / 2 <= PrivateCacheMap->ReadAheadOffset[0].QuadPart)
         {
             KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
             return;
         }
 
-        /* FIXME: hackish, but will do the job for now */
-        PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-        PrivateCacheMap->ReadAheadLength[1] = Length;
+        /* The reader is consuming what we read ahead, it's a stream: widen the window */
+        if (PrivateCacheMap->ReadAheadOffset[0].QuadPart > FileOffset->QuadPart)
+        {
+            Window = min(Window * 2, CC_MAX_READ_AHEAD);
+        }
+
+        Start = max(ReadEnd, PrivateCacheMap->ReadAheadOffset[0].QuadPart);
+        End = ReadEnd + Window;
     }
-    /* Other cases: try to find some logic in that mess... */
-    else
+    /* Strided: this read is as far from the previous one as the previous one from its own */
+    else if (Stride != 0 &&
+             Stride == PrivateCacheMap->FileOffset2.QuadPart - PrivateCacheMap->FileOffset1.QuadPart)
     {
-        /* Let's check if we always read the same way (like going down in the file)
-         * and pretend it's enough for now
-         */
-        if (PrivateCacheMap->FileOffset2.QuadPart >= PrivateCacheMap->FileOffset1.QuadPart &&
-            FileOffset->QuadPart >= PrivateCacheMap->FileOffset2.QuadPart)
+        Start = FileOffset->QuadPart + Stride;
+        End = Start + Length;
+
+        /* With short strides, take as many records as fit in the window in one go */
+        if (Stride > 0 && Stride < Window)
         {
-            /* FIXME: hackish, but will do the job for now */
-            PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-            PrivateCacheMap->ReadAheadLength[1] = Length;
+            End = FileOffset->QuadPart + (Window / Stride) * Stride + Length;
         }
-        else
+
+        /* Don't read the same records twice */
+        if (Stride > 0)
+        {
+            Start = max(Start, PrivateCacheMap->ReadAheadOffset[0].QuadPart);
+        }
+
+        if (Start < 0 || Start >= End)
         {
-            /* FIXME: handle the other cases */
             KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
-            UNIMPLEMENTED_ONCE;
             return;
         }
     }
+    /* Random access: start over with the smallest window */
+    else
+    {
+        PrivateCacheMap->ReadAheadOffset[0].QuadPart = 0;
+        PrivateCacheMap->ReadAheadLength[0] = MinWindow;
+        KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+        return;
+    }
+
+    PrivateCacheMap->ReadAheadLength[0] = Window;
+    if (End > PrivateCacheMap->ReadAheadOffset[0].QuadPart)
+    {
+        PrivateCacheMap->ReadAheadOffset[0].QuadPart = End;
+    }
+
+    /* If the worker didn't pick up the previous range yet, just extend it */
+    if (PrivateCacheMap->ReadAheadLength[1] != 0 &&
+        PrivateCacheMap->ReadAheadOffset[1].QuadPart < Start &&
+        PrivateCacheMap->ReadAheadOffset[1].QuadPart + PrivateCacheMap->ReadAheadLength[1] >= Start &&
+        End - PrivateCacheMap->ReadAheadOffset[1].QuadPart <= 2 * CC_MAX_READ_AHEAD)
+    {
+        Start = PrivateCacheMap->ReadAheadOffset[1].QuadPart;
+    }
+
+    PrivateCacheMap->ReadAheadOffset[1].QuadPart = Start;
+    PrivateCacheMap->ReadAheadLength[1] = (ULONG)(End - Start);
 
     /* If read ahead isn't active yet */
     if (!PrivateCacheMap->Flags.ReadAheadActive)
@@ -180,6 +180,7 @@ CcPerformReadAhead(
         KeAcquireSpinLockAtDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
         CurrentOffset = PrivateCacheMap->ReadAheadOffset[1].QuadPart;
         Length = PrivateCacheMap->ReadAheadLength[1];
+        PrivateCacheMap->ReadAheadLength[1] = 0;
         KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
     }
     KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
@@ -196,6 +197,7 @@ CcPerformReadAhead(
     /* Remember it's locked */
     Locked = TRUE;
 
+Next:
     /* Don't read past the end of the file */
     if (CurrentOffset >= SharedCacheMap->FileSize.QuadPart)
     {
@@ -271,8 +273,22 @@ Clear:
     PrivateCacheMap = FileObject->PrivateCacheMap;
     if (PrivateCacheMap != NULL)
     {
-        /* Mark read ahead as unactive */
         KeAcquireSpinLockAtDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+
+        /* If the reader scheduled more while we were busy, and everything
+         * went fine so far, handle it now instead of queueing another item
+         */
+        if (Locked && Length == 0 && PrivateCacheMap->ReadAheadLength[1] != 0)
+        {
+            CurrentOffset = PrivateCacheMap->ReadAheadOffset[1].QuadPart;
+            Length = PrivateCacheMap->ReadAheadLength[1];
+            PrivateCacheMap->ReadAheadLength[1] = 0;
+            KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+            KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+            goto Next;
+        }
+
+        /* Mark read ahead as unactive */
         InterlockedAnd((volatile long *)&PrivateCacheMap->UlongFlags, ~PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
         KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
     }
@@ -546,28 +562,28 @@ CcCopyRead (
     IoStatus->Status = STATUS_SUCCESS;
     IoStatus->Information = ReadLength;
 
-#if 0
     /* If that was a successful sync read operation, let's handle read ahead */
-    if (Length == 0 && Wait)
+    if (Length == 0 && Wait && FileObject->PrivateCacheMap != NULL)
     {
         PPRIVATE_CACHE_MAP PrivateCacheMap = FileObject->PrivateCacheMap;
+        KIRQL OldIrql;
 
-        /* If file isn't random access and next read may get us cross VACB boundary,
-         * schedule next read
+        /* The read history is still the one before this read: CcScheduleReadAhead
+         * relies on it to tell sequential, strided and random readers apart
          */
-        if (!BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS) &&
-            (CurrentOffset - 1) / VACB_MAPPING_GRANULARITY != (CurrentOffset + ReadLength - 1) / VACB_MAPPING_GRANULARITY)
+        if (ReadLength != 0)
         {
             CcScheduleReadAhead(FileObject, FileOffset, ReadLength);
         }
 
         /* And update read history in private cache map */
+        KeAcquireSpinLock(&PrivateCacheMap->ReadAheadSpinLock, &OldIrql);
         PrivateCacheMap->FileOffset1.QuadPart = PrivateCacheMap->FileOffset2.QuadPart;
         PrivateCacheMap->BeyondLastByte1.QuadPart = PrivateCacheMap->BeyondLastByte2.QuadPart;
         PrivateCacheMap->FileOffset2.QuadPart = FileOffset->QuadPart;
         PrivateCacheMap->BeyondLastByte2.QuadPart = FileOffset->QuadPart + ReadLength;
+        KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
     }
-#endif
 
     return TRUE;
 }
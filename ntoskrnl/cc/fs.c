@@ -242,7 +242,7 @@ CcPurgeCacheSection (
         {
             CcRosUnmarkDirtyVacb(Vacb, FALSE);
         }
-        RemoveEntryList(&Vacb->CacheMapVacbListEntry);
+        CcRosUnlinkVacb(Vacb);
         InsertHeadList(&FreeList, &Vacb->CacheMapVacbListEntry);
     }
     KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
@@ -33,6 +33,16 @@ ULONG CcPinMappedDataCount = 0;
 
 /* FUNCTIONS *****************************************************************/
 
+/* A BCB never spans two views, so it only has to be looked for in the bucket of its view */
+static
+PLIST_ENTRY
+CcpGetBcbBucket(
+    IN PROS_SHARED_CACHE_MAP SharedCacheMap,
+    IN PLARGE_INTEGER FileOffset)
+{
+    return &SharedCacheMap->BcbList[(FileOffset->QuadPart / VACB_MAPPING_GRANULARITY) % BCB_HASH_BUCKETS];
+}
+
 static
 PINTERNAL_BCB
 NTAPI
@@ -44,10 +54,11 @@ CcpFindBcb(
 {
     PINTERNAL_BCB Bcb;
     BOOLEAN Found = FALSE;
-    PLIST_ENTRY NextEntry;
+    PLIST_ENTRY BcbList, NextEntry;
 
-    for (NextEntry = SharedCacheMap->BcbList.Flink;
-         NextEntry != &SharedCacheMap->BcbList;
+    BcbList = CcpGetBcbBucket(SharedCacheMap, FileOffset);
+    for (NextEntry = BcbList->Flink;
+         NextEntry != BcbList;
          NextEntry = NextEntry->Flink)
     {
         Bcb = CONTAINING_RECORD(NextEntry, INTERNAL_BCB, BcbEntry);
@@ -200,7 +211,7 @@ CcpGetAppropriateBcb(
             ASSERT(Result);
         }
 
-        InsertTailList(&SharedCacheMap->BcbList, &iBcb->BcbEntry);
+        InsertTailList(CcpGetBcbBucket(SharedCacheMap, FileOffset), &iBcb->BcbEntry);
         KeReleaseSpinLock(&SharedCacheMap->BcbSpinLock, OldIrql);
     }
 
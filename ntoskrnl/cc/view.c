@@ -369,14 +369,183 @@ CcRosReleaseVacb (
     return STATUS_SUCCESS;
 }
 
+static
+PROS_VACB *
+CcRosGetVacbIndexSlot (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    ULONGLONG ViewIndex)
+{
+    ULONGLONG Block = ViewIndex >> VACB_INDEX_BLOCK_SHIFT;
+
+    /* Caller must hold the cache map lock */
+    if (Block >= SharedCacheMap->VacbIndexBlocks ||
+        SharedCacheMap->VacbIndex[Block] == NULL)
+    {
+        return NULL;
+    }
+
+    return &SharedCacheMap->VacbIndex[Block][ViewIndex & VACB_INDEX_BLOCK_MASK];
+}
+
+static
+PROS_VACB
+CcRosGetPreviousIndexedVacb (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    ULONGLONG ViewIndex)
+{
+    PROS_VACB *Slot;
+
+    while (ViewIndex-- > 0)
+    {
+        Slot = CcRosGetVacbIndexSlot(SharedCacheMap, ViewIndex);
+
+        /* Skip missing blocks as a whole */
+        if (Slot == NULL)
+        {
+            ViewIndex &= ~(ULONGLONG)VACB_INDEX_BLOCK_MASK;
+            continue;
+        }
+
+        if (*Slot != NULL)
+            return *Slot;
+    }
+
+    return NULL;
+}
+
+static
+NTSTATUS
+CcRosPrepareVacbIndex (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    ULONGLONG ViewIndex)
+{
+    ULONGLONG Block = ViewIndex >> VACB_INDEX_BLOCK_SHIFT;
+    ULONGLONG SectionBlocks;
+    PROS_VACB **NewIndex = NULL;
+    PROS_VACB **OldIndex = NULL;
+    PROS_VACB *NewBlock = NULL;
+    ULONG NewIndexBlocks = 0;
+    BOOLEAN NeedIndex;
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &OldIrql);
+    NeedIndex = (Block >= SharedCacheMap->VacbIndexBlocks);
+    if (!NeedIndex && SharedCacheMap->VacbIndex[Block] != NULL)
+    {
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
+        return STATUS_SUCCESS;
+    }
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
+
+    /* Allocate outside of the lock, whatever we lose in a race is freed below */
+    if (NeedIndex)
+    {
+        /* Cover the whole section, so that the index seldom has to grow */
+        SectionBlocks = (SharedCacheMap->SectionSize.QuadPart + VACB_MAPPING_GRANULARITY - 1) / VACB_MAPPING_GRANULARITY;
+        SectionBlocks = (SectionBlocks + VACB_INDEX_BLOCK_MASK) >> VACB_INDEX_BLOCK_SHIFT;
+        SectionBlocks = max(SectionBlocks, Block + 1);
+        if (SectionBlocks > MAXULONG / sizeof(PROS_VACB *))
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        NewIndexBlocks = (ULONG)SectionBlocks;
+        NewIndex = ExAllocatePoolWithTag(NonPagedPool, NewIndexBlocks * sizeof(PROS_VACB *), TAG_VACB);
+        if (NewIndex == NULL)
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    NewBlock = ExAllocatePoolWithTag(NonPagedPool, VACB_INDEX_BLOCK_SIZE * sizeof(PROS_VACB), TAG_VACB);
+    if (NewBlock == NULL)
+    {
+        if (NewIndex != NULL)
+            ExFreePoolWithTag(NewIndex, TAG_VACB);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+    RtlZeroMemory(NewBlock, VACB_INDEX_BLOCK_SIZE * sizeof(PROS_VACB));
+
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &OldIrql);
+
+    if (NewIndex != NULL && NewIndexBlocks > SharedCacheMap->VacbIndexBlocks)
+    {
+        RtlZeroMemory(NewIndex, NewIndexBlocks * sizeof(PROS_VACB *));
+        if (SharedCacheMap->VacbIndex != NULL)
+        {
+            RtlCopyMemory(NewIndex,
+                          SharedCacheMap->VacbIndex,
+                          SharedCacheMap->VacbIndexBlocks * sizeof(PROS_VACB *));
+        }
+
+        OldIndex = SharedCacheMap->VacbIndex;
+        SharedCacheMap->VacbIndex = NewIndex;
+        SharedCacheMap->VacbIndexBlocks = NewIndexBlocks;
+        NewIndex = NULL;
+    }
+
+    ASSERT(Block < SharedCacheMap->VacbIndexBlocks);
+    if (SharedCacheMap->VacbIndex[Block] == NULL)
+    {
+        SharedCacheMap->VacbIndex[Block] = NewBlock;
+        NewBlock = NULL;
+    }
+
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
+
+    if (OldIndex != NULL)
+        ExFreePoolWithTag(OldIndex, TAG_VACB);
+    if (NewIndex != NULL)
+        ExFreePoolWithTag(NewIndex, TAG_VACB);
+    if (NewBlock != NULL)
+        ExFreePoolWithTag(NewBlock, TAG_VACB);
+
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+CcRosFreeVacbIndex (
+    PROS_SHARED_CACHE_MAP SharedCacheMap)
+{
+    ULONG i;
+
+    for (i = 0; i < SharedCacheMap->VacbIndexBlocks; i++)
+    {
+        if (SharedCacheMap->VacbIndex[i] != NULL)
+            ExFreePoolWithTag(SharedCacheMap->VacbIndex[i], TAG_VACB);
+    }
+
+    if (SharedCacheMap->VacbIndex != NULL)
+        ExFreePoolWithTag(SharedCacheMap->VacbIndex, TAG_VACB);
+
+    SharedCacheMap->VacbIndex = NULL;
+    SharedCacheMap->VacbIndexBlocks = 0;
+}
+
+VOID
+CcRosUnlinkVacb (
+    PROS_VACB Vacb)
+{
+    PROS_VACB *Slot;
+
+    /* Caller must hold the cache map lock */
+    Slot = CcRosGetVacbIndexSlot(Vacb->SharedCacheMap,
+                                 Vacb->FileOffset.QuadPart / VACB_MAPPING_GRANULARITY);
+    ASSERT(Slot != NULL && *Slot == Vacb);
+    *Slot = NULL;
+
+    RemoveEntryList(&Vacb->CacheMapVacbListEntry);
+}
+
 /* Returns with VACB Lock Held! */
 PROS_VACB
 CcRosLookupVacb (
     PROS_SHARED_CACHE_MAP SharedCacheMap,
     LONGLONG FileOffset)
 {
-    PLIST_ENTRY current_entry;
-    PROS_VACB current;
+    PROS_VACB *Slot;
+    PROS_VACB current = NULL;
     KIRQL oldIrql;
 
     ASSERT(SharedCacheMap);
@@ -384,33 +553,19 @@ CcRosLookupVacb (
     DPRINT("CcRosLookupVacb(SharedCacheMap 0x%p, FileOffset %I64u)\n",
            SharedCacheMap, FileOffset);
 
-    oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-    KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
+    /* The index only changes with the cache map lock held, so the master lock isn't needed */
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
 
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    Slot = CcRosGetVacbIndexSlot(SharedCacheMap, FileOffset / VACB_MAPPING_GRANULARITY);
+    if (Slot != NULL && *Slot != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
-            return current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        current = *Slot;
+        CcRosVacbIncRefCount(current);
     }
 
-    KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 
-    return NULL;
+    return current;
 }
 
 VOID
@@ -524,7 +679,7 @@ CcRosFreeUnusedVacb (
             ASSERT(Refs == 1);
 
             /* Reset and move to free list */
-            RemoveEntryList(&current->CacheMapVacbListEntry);
+            CcRosUnlinkVacb(current);
             RemoveEntryList(&current->VacbLruListEntry);
             InitializeListHead(&current->VacbLruListEntry);
             InsertHeadList(&FreeList, &current->CacheMapVacbListEntry);
@@ -575,7 +730,7 @@ CcRosCreateVacb (
 {
     PROS_VACB current;
     PROS_VACB previous;
-    PLIST_ENTRY current_entry;
+    PROS_VACB *Slot;
     NTSTATUS Status;
     KIRQL oldIrql;
     ULONG Refs;
@@ -586,6 +741,13 @@ CcRosCreateVacb (
 
     DPRINT("CcRosCreateVacb()\n");
 
+    /* Make room in the index first, allocating is not possible later on */
+    Status = CcRosPrepareVacbIndex(SharedCacheMap, FileOffset / VACB_MAPPING_GRANULARITY);
+    if (!NT_SUCCESS(Status))
+    {
+        return Status;
+    }
+
     current = ExAllocateFromNPagedLookasideList(&VacbLookasideList);
     current->BaseAddress = NULL;
     current->Dirty = FALSE;
@@ -641,50 +803,37 @@ Retry:
      * our newly created VACB and return the existing one.
      */
     KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    previous = NULL;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    Slot = CcRosGetVacbIndexSlot(SharedCacheMap, FileOffset / VACB_MAPPING_GRANULARITY);
+    ASSERT(Slot != NULL);
+    if (*Slot != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+        current = *Slot;
+        CcRosVacbIncRefCount(current);
+        KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
 #if DBG
-            if (SharedCacheMap->Trace)
-            {
-                DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
-                        SharedCacheMap,
-                        (*Vacb),
-                        current);
-            }
+        if (SharedCacheMap->Trace)
+        {
+            DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
+                    SharedCacheMap,
+                    (*Vacb),
+                    current);
+        }
 #endif
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
 
-            Refs = CcRosVacbDecRefCount(*Vacb);
-            ASSERT(Refs == 0);
+        Refs = CcRosVacbDecRefCount(*Vacb);
+        ASSERT(Refs == 0);
 
-            *Vacb = current;
-            return STATUS_SUCCESS;
-        }
-        if (current->FileOffset.QuadPart < FileOffset)
-        {
-            ASSERT(previous == NULL ||
-                   previous->FileOffset.QuadPart < current->FileOffset.QuadPart);
-            previous = current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        *Vacb = current;
+        return STATUS_SUCCESS;
     }
-    /* There was no existing VACB. */
+    /* There was no existing VACB, keep the list sorted by file offset */
     current = *Vacb;
+    *Slot = current;
+    previous = CcRosGetPreviousIndexedVacb(SharedCacheMap, FileOffset / VACB_MAPPING_GRANULARITY);
     if (previous)
     {
+        ASSERT(previous->FileOffset.QuadPart < current->FileOffset.QuadPart);
         InsertHeadList(&previous->CacheMapVacbListEntry, &current->CacheMapVacbListEntry);
     }
     else
@@ -1106,6 +1255,7 @@ CcRosDeleteFileCache (
         ObDereferenceObject(SharedCacheMap->Section);
     ObDereferenceObject(SharedCacheMap->FileObject);
 
+    CcRosFreeVacbIndex(SharedCacheMap);
     ExFreeToNPagedLookasideList(&SharedCacheMapLookasideList, SharedCacheMap);
 
     /* Acquire the lock again for our caller */
@@ -1199,6 +1349,7 @@ CcRosInitializeFileCache (
     KIRQL OldIrql;
     BOOLEAN Allocated;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
+    ULONG i;
 
     DPRINT("CcRosInitializeFileCache(FileObject 0x%p)\n", FileObject);
 
@@ -1229,7 +1380,10 @@ CcRosInitializeFileCache (
         InitializeListHead(&SharedCacheMap->PrivateList);
         KeInitializeSpinLock(&SharedCacheMap->CacheMapLock);
         InitializeListHead(&SharedCacheMap->CacheMapVacbListHead);
-        InitializeListHead(&SharedCacheMap->BcbList);
+        for (i = 0; i < BCB_HASH_BUCKETS; i++)
+        {
+            InitializeListHead(&SharedCacheMap->BcbList[i]);
+        }
 
         SharedCacheMap->Flags = SHARED_CACHE_MAP_IN_CREATION;
 
@@ -2815,6 +2815,22 @@ QSI_DEF(SystemFirmwareTableInformation)
     return Status;
 }
 
+/* Class 0x10000 - Scheduler statistics (ReactOS specific) */
+QSI_DEF(SystemSchedulerStatisticsInformation)
+{
+    *ReqSize = KeNumberProcessors * sizeof(SYSTEM_SCHEDULER_STATISTICS_INFORMATION);
+
+    /* Check user buffer's size */
+    if (Size < *ReqSize)
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    /* The counters are updated without locking, a snapshot is good enough */
+    RtlCopyMemory(Buffer, KiSchedulerStatistics, *ReqSize);
+    return STATUS_SUCCESS;
+}
+
 /* Query/Set Calls Table */
 typedef
 struct _QSSI_CALLS
@@ -2920,6 +2936,38 @@ C_ASSERT(SystemBasicInformation == 0);
 #define MIN_SYSTEM_INFO_CLASS (SystemBasicInformation)
 #define MAX_SYSTEM_INFO_CLASS (sizeof(CallQS) / sizeof(CallQS[0]))
 
+/* ReactOS specific classes, query only */
+static
+QSSI_CALLS
+CallQSReactOS [] =
+{
+    SI_QX(SystemSchedulerStatisticsInformation),
+};
+
+#define MIN_REACTOS_INFO_CLASS (SystemSchedulerStatisticsInformation)
+#define MAX_REACTOS_INFO_CLASS \
+    (MIN_REACTOS_INFO_CLASS + sizeof(CallQSReactOS) / sizeof(CallQSReactOS[0]))
+
+static
+QSSI_CALLS *
+ExpGetQueryCalls(
+    _In_ SYSTEM_INFORMATION_CLASS SystemInformationClass)
+{
+    if (SystemInformationClass >= MIN_SYSTEM_INFO_CLASS &&
+        SystemInformationClass < MAX_SYSTEM_INFO_CLASS)
+    {
+        return &CallQS[SystemInformationClass];
+    }
+
+    if (SystemInformationClass >= MIN_REACTOS_INFO_CLASS &&
+        SystemInformationClass < MAX_REACTOS_INFO_CLASS)
+    {
+        return &CallQSReactOS[SystemInformationClass - MIN_REACTOS_INFO_CLASS];
+    }
+
+    return NULL;
+}
+
 /*
  * @implemented
  */
@@ -2936,6 +2984,7 @@ NtQuerySystemInformation(
     ULONG ResultLength = 0;
     ULONG Alignment = TYPE_ALIGNMENT(ULONG);
     NTSTATUS FStatus = STATUS_NOT_IMPLEMENTED;
+    QSSI_CALLS *QueryCalls;
 
     PAGED_CODE();
 
@@ -2947,8 +2996,8 @@ NtQuerySystemInformation(
         /*
          * Check if the request is valid.
          */
-        if (SystemInformationClass < MIN_SYSTEM_INFO_CLASS ||
-            SystemInformationClass >= MAX_SYSTEM_INFO_CLASS)
+        QueryCalls = ExpGetQueryCalls(SystemInformationClass);
+        if (QueryCalls == NULL)
         {
             _SEH2_YIELD(return STATUS_INVALID_INFO_CLASS);
         }
@@ -2972,21 +3021,21 @@ NtQuerySystemInformation(
         /*
          * Check if the request is valid.
          */
-        if (SystemInformationClass < MIN_SYSTEM_INFO_CLASS ||
-            SystemInformationClass >= MAX_SYSTEM_INFO_CLASS)
+        QueryCalls = ExpGetQueryCalls(SystemInformationClass);
+        if (QueryCalls == NULL)
         {
             _SEH2_YIELD(return STATUS_INVALID_INFO_CLASS);
         }
 #endif
 
-        if (NULL != CallQS [SystemInformationClass].Query)
+        if (NULL != QueryCalls->Query)
         {
             /*
              * Hand the request to a subhandler.
              */
-            FStatus = CallQS [SystemInformationClass].Query(SystemInformation,
-                                                            Length,
-                                                            &ResultLength);
+            FStatus = QueryCalls->Query(SystemInformation,
+                                        Length,
+                                        &ResultLength);
 
             /* Save the result length to the caller */
             if (UnsafeResultLength)
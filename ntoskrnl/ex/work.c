@@ -22,14 +22,48 @@
 /* Magic flag for dynamic worker threads */
 #define EX_DYNAMIC_WORK_THREAD                      0x80000000
 
+/* The worker thread context also holds the processor of its queue */
+#define EX_WORK_THREAD_QUEUE_TYPE_MASK              0xFF
+#define EX_WORK_THREAD_PROCESSOR_SHIFT              8
+
+/* Dynamic worker threads exit after being idle for a minute */
+#define EX_DYNAMIC_THREAD_TIMEOUT                   60
+
+/* Maximum number of dynamic threads for each processor queue */
+#define EX_MAXIMUM_DYNAMIC_THREADS                  16
+
+/* The balance set manager runs every 250ms */
+#define EX_WORKER_BALANCE_INTERVAL                  250
+
+/* Queueing delay (in ms) above which a queue gets an additional thread */
+#define EX_MAXIMUM_QUEUE_DELAY                      50
+
 /* Worker thread priority increments (added to base priority) */
 #define EX_HYPERCRITICAL_QUEUE_PRIORITY_INCREMENT   7
 #define EX_CRITICAL_QUEUE_PRIORITY_INCREMENT        5
 #define EX_DELAYED_QUEUE_PRIORITY_INCREMENT         4
 
-/* The actual worker queue array */
+/* The actual worker queue array, these are the queues of the boot processor */
 EX_WORK_QUEUE ExWorkerQueue[MaximumWorkQueue];
 
+/* Work queue of a processor */
+typedef struct _EXP_PROCESSOR_WORK_QUEUE
+{
+    PEX_WORK_QUEUE WorkQueue;
+    LIST_ENTRY StealRequest;
+    LONG StealRequestPending;
+    ULONG WorkItemsStolen;
+    ULONG QueueDelay;
+} EXP_PROCESSOR_WORK_QUEUE, *PEXP_PROCESSOR_WORK_QUEUE;
+
+/*
+ * Critical and delayed work items are queued to the processor queuing them,
+ * idle workers of the other processors steal them when the local workers are
+ * busy. The hypercritical queue only has one thread and is never split.
+ */
+EXP_PROCESSOR_WORK_QUEUE ExpProcessorWorkQueue[MaximumWorkQueue][MAXIMUM_PROCESSORS];
+ULONG ExpNumberOfWorkQueues = 1;
+
 /* Accounting of the total threads and registry hacked threads */
 ULONG ExCriticalWorkerThreads;
 ULONG ExDelayedWorkerThreads;
@@ -51,6 +85,142 @@ PETHREAD ExpLastWorkerThread;
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
+FORCEINLINE
+PEXP_PROCESSOR_WORK_QUEUE
+ExpGetProcessorWorkQueue(IN WORK_QUEUE_TYPE WorkQueueType,
+                         IN ULONG Processor)
+{
+    /* The hypercritical queue is shared by all processors */
+    if ((WorkQueueType == HyperCriticalWorkQueue) ||
+        (Processor >= ExpNumberOfWorkQueues))
+    {
+        Processor = 0;
+    }
+
+    return &ExpProcessorWorkQueue[WorkQueueType][Processor];
+}
+
+/*++
+ * @name ExpStealWorkItem
+ *
+ *     The ExpStealWorkItem routine removes a pending work item from the queue
+ *     of another processor.
+ *
+ * @param WorkQueueType
+ *        Type of the queue to steal from.
+ *
+ * @param Processor
+ *        Processor of the queue of the calling worker thread.
+ *
+ * @param WaitMode
+ *        Wait mode of the calling worker thread.
+ *
+ * @return The queue entry of the work item, or NULL if the other processors
+ *         have nothing pending.
+ *
+ * @remarks The queues are scanned starting with the next processor, so that
+ *          the thieves don't all fall on the same victim.
+ *
+ *--*/
+PLIST_ENTRY
+NTAPI
+ExpStealWorkItem(IN WORK_QUEUE_TYPE WorkQueueType,
+                 IN ULONG Processor,
+                 IN KPROCESSOR_MODE WaitMode)
+{
+    PEXP_PROCESSOR_WORK_QUEUE Victim;
+    PLIST_ENTRY QueueEntry;
+    LARGE_INTEGER Timeout;
+    ULONG i;
+
+    /* The hypercritical queue is not split */
+    if (WorkQueueType == HyperCriticalWorkQueue) return NULL;
+
+    /* Don't wait on the other queues */
+    Timeout.QuadPart = 0;
+
+    for (i = 1; i < ExpNumberOfWorkQueues; i++)
+    {
+        Victim = &ExpProcessorWorkQueue[WorkQueueType]
+                                       [(Processor + i) % ExpNumberOfWorkQueues];
+
+        /* Skip queues without pending work */
+        if (IsListEmpty(&Victim->WorkQueue->WorkerQueue.EntryListHead)) continue;
+
+        /* Try to take an item, someone may have been faster */
+        QueueEntry = KeRemoveQueue(&Victim->WorkQueue->WorkerQueue,
+                                   WaitMode,
+                                   &Timeout);
+        if (((NTSTATUS)(ULONG_PTR)QueueEntry == STATUS_TIMEOUT) ||
+            ((NTSTATUS)(ULONG_PTR)QueueEntry == STATUS_USER_APC))
+        {
+            continue;
+        }
+
+        /* This is a steal request for the victim, we are already handling it */
+        if (QueueEntry == &Victim->StealRequest)
+        {
+            InterlockedExchange(&Victim->StealRequestPending, 0);
+            continue;
+        }
+
+        /* Got one */
+        InterlockedIncrement((PLONG)&Victim->WorkQueue->WorkItemsProcessed);
+        InterlockedIncrement((PLONG)&Victim->WorkItemsStolen);
+        return QueueEntry;
+    }
+
+    /* Nothing to steal */
+    return NULL;
+}
+
+/*++
+ * @name ExpRequestWorkSteal
+ *
+ *     The ExpRequestWorkSteal routine wakes up an idle worker thread of
+ *     another processor, so that it steals work from the given processor.
+ *
+ * @param WorkQueueType
+ *        Type of the queue which has pending work.
+ *
+ * @param Processor
+ *        Processor of the queue which has pending work.
+ *
+ * @return None.
+ *
+ * @remarks Each processor queue has a single steal request, so that a burst
+ *          of work items doesn't flood the idle workers with requests. Once
+ *          woken up, a thief keeps stealing until there is nothing left.
+ *
+ *--*/
+VOID
+NTAPI
+ExpRequestWorkSteal(IN WORK_QUEUE_TYPE WorkQueueType,
+                    IN ULONG Processor)
+{
+    PEXP_PROCESSOR_WORK_QUEUE Thief;
+    ULONG i;
+
+    /* The hypercritical queue is not split */
+    if (WorkQueueType == HyperCriticalWorkQueue) return;
+
+    for (i = 1; i < ExpNumberOfWorkQueues; i++)
+    {
+        Thief = &ExpProcessorWorkQueue[WorkQueueType]
+                                      [(Processor + i) % ExpNumberOfWorkQueues];
+
+        /* Look for a queue with an idle worker */
+        if (IsListEmpty(&Thief->WorkQueue->WorkerQueue.Header.WaitListHead)) continue;
+
+        /* Skip it if it was already asked to steal */
+        if (InterlockedCompareExchange(&Thief->StealRequestPending, 1, 0)) continue;
+
+        /* Wake it up */
+        KeInsertQueue(&Thief->WorkQueue->WorkerQueue, &Thief->StealRequest);
+        return;
+    }
+}
+
 /*++
  * @name ExpWorkerThreadEntryPoint
  *
@@ -58,14 +228,17 @@ PETHREAD ExpLastWorkerThread;
  *     worker thread created by teh system.
  *
  * @param Context
- *        Contains the work queue type masked with a flag specifing whether the
- *        thread is dynamic or not.
+ *        Contains the work queue type and processor masked with a flag
+ *        specifing whether the thread is dynamic or not.
  *
  * @return None.
  *
- * @remarks A dynamic thread can timeout after 10 minutes of waiting on a queue
+ * @remarks A dynamic thread can timeout after a minute of waiting on a queue
  *          while a static thread will never timeout.
  *
+ *          Before waiting on the queue of its processor, a worker thread
+ *          steals the pending work of the other processors.
+ *
  *          Worker threads must return at IRQL == PASSIVE_LEVEL, must not have
  *          active impersonation info, and must not have disabled APCs.
  *
@@ -80,6 +253,8 @@ ExpWorkerThreadEntryPoint(IN PVOID Context)
     PWORK_QUEUE_ITEM WorkItem;
     PLIST_ENTRY QueueEntry;
     WORK_QUEUE_TYPE WorkQueueType;
+    ULONG Processor;
+    PEXP_PROCESSOR_WORK_QUEUE ProcessorQueue;
     PEX_WORK_QUEUE WorkQueue;
     LARGE_INTEGER Timeout;
     PLARGE_INTEGER TimeoutPointer = NULL;
@@ -90,15 +265,18 @@ ExpWorkerThreadEntryPoint(IN PVOID Context)
     /* Check if this is a dyamic thread */
     if ((ULONG_PTR)Context & EX_DYNAMIC_WORK_THREAD)
     {
-        /* It is, which means we will eventually time out after 10 minutes */
-        Timeout.QuadPart = Int32x32To64(10, -10000000 * 60);
+        /* It is, which means we will eventually time out */
+        Timeout.QuadPart = Int32x32To64(EX_DYNAMIC_THREAD_TIMEOUT, -10000000);
         TimeoutPointer = &Timeout;
     }
 
-    /* Get Queue Type and Worker Queue */
+    /* Get Queue Type, Processor and Worker Queue */
     WorkQueueType = (WORK_QUEUE_TYPE)((ULONG_PTR)Context &
-                                      ~EX_DYNAMIC_WORK_THREAD);
-    WorkQueue = &ExWorkerQueue[WorkQueueType];
+                                      EX_WORK_THREAD_QUEUE_TYPE_MASK);
+    Processor = (ULONG)(((ULONG_PTR)Context & ~EX_DYNAMIC_WORK_THREAD) >>
+                        EX_WORK_THREAD_PROCESSOR_SHIFT);
+    ProcessorQueue = ExpGetProcessorWorkQueue(WorkQueueType, Processor);
+    WorkQueue = ProcessorQueue->WorkQueue;
 
     /* Select the wait mode */
     WaitMode = (UCHAR)WorkQueue->Info.WaitMode;
@@ -137,16 +315,33 @@ ExpWorkerThreadEntryPoint(IN PVOID Context)
 ProcessLoop:
     for (;;)
     {
-        /* Wait for something to happen on the queue */
-        QueueEntry = KeRemoveQueue(&WorkQueue->WorkerQueue,
-                                   WaitMode,
-                                   TimeoutPointer);
+        /* Help the other processors if our queue is empty */
+        QueueEntry = NULL;
+        if (IsListEmpty(&WorkQueue->WorkerQueue.EntryListHead))
+        {
+            QueueEntry = ExpStealWorkItem(WorkQueueType, Processor, WaitMode);
+        }
 
-        /* Check if we timed out and quit this loop in that case */
-        if ((NTSTATUS)(ULONG_PTR)QueueEntry == STATUS_TIMEOUT) break;
+        if (!QueueEntry)
+        {
+            /* Wait for something to happen on the queue */
+            QueueEntry = KeRemoveQueue(&WorkQueue->WorkerQueue,
+                                       WaitMode,
+                                       TimeoutPointer);
 
-        /* Increment Processed Work Items */
-        InterlockedIncrement((PLONG)&WorkQueue->WorkItemsProcessed);
+            /* Check if we timed out and quit this loop in that case */
+            if ((NTSTATUS)(ULONG_PTR)QueueEntry == STATUS_TIMEOUT) break;
+
+            /* Check if another processor wants us to steal its work */
+            if (QueueEntry == &ProcessorQueue->StealRequest)
+            {
+                InterlockedExchange(&ProcessorQueue->StealRequestPending, 0);
+                continue;
+            }
+
+            /* Increment Processed Work Items */
+            InterlockedIncrement((PLONG)&WorkQueue->WorkItemsProcessed);
+        }
 
         /* Get the Work Item */
         WorkItem = CONTAINING_RECORD(QueueEntry, WORK_QUEUE_ITEM, List);
@@ -234,6 +429,10 @@ ProcessLoop:
  *          - CriticalWorkQueue
  *          - HyperCriticalWorkQueue
  *
+ * @param Processor
+ *        Processor of the queue to use for this thread. The thread prefers
+ *        running on it.
+ *
  * @param Dynamic
  *        Specifies whether or not this thread is a dynamic thread.
  *
@@ -248,15 +447,20 @@ ProcessLoop:
 VOID
 NTAPI
 ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
+                      IN ULONG Processor,
                       IN BOOLEAN Dynamic)
 {
     PETHREAD Thread;
     HANDLE hThread;
     ULONG Context;
     KPRIORITY Priority;
+    PEX_WORK_QUEUE WorkQueue;
+
+    /* Get the queue of the thread */
+    WorkQueue = ExpGetProcessorWorkQueue(WorkQueueType, Processor)->WorkQueue;
 
     /* Check if this is going to be a dynamic thread */
-    Context = WorkQueueType;
+    Context = WorkQueueType | (Processor << EX_WORK_THREAD_PROCESSOR_SHIFT);
 
     /* Add the dynamic mask */
     if (Dynamic) Context |= EX_DYNAMIC_WORK_THREAD;
@@ -274,7 +478,7 @@ ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
     if (Dynamic)
     {
         /* Increase the count */
-        InterlockedIncrement(&ExWorkerQueue[WorkQueueType].DynamicThreadCount);
+        InterlockedIncrement(&WorkQueue->DynamicThreadCount);
     }
 
     /* Set the priority */
@@ -305,54 +509,87 @@ ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
     /* Set the Priority */
     KeSetBasePriorityThread(&Thread->Tcb, Priority);
 
+    /* Prefer the processor of the queue, work can still be stolen anywhere */
+    if (WorkQueueType != HyperCriticalWorkQueue)
+    {
+        KeSetIdealProcessorThread(&Thread->Tcb, (UCHAR)Processor);
+    }
+
     /* Dereference and close handle */
     ObDereferenceObject(Thread);
     ObCloseHandle(hThread, KernelMode);
 }
 
 /*++
- * @name ExpDetectWorkerThreadDeadlock
+ * @name ExpCheckWorkerQueueDelays
  *
- *     The ExpDetectWorkerThreadDeadlock routine checks every queue and creates
- *     a dynamic thread if the queue seems to be deadlocked.
+ *     The ExpCheckWorkerQueueDelays routine checks every queue and creates
+ *     a dynamic thread if the items wait on the queue for too long.
  *
  * @param None
  *
  * @return None.
  *
- * @remarks The algorithm for deciding if a new thread must be created is based
- *          on whether the queue has processed no new items in the last second,
- *          and new items are still enqueued.
+ * @remarks The time spent by the items on a queue is estimated from its depth
+ *          and the number of items processed since the last pass. A queue
+ *          that processed nothing while having pending items is deadlocked,
+ *          and gets a new thread as well. The queue must have been late for
+ *          two passes in a row, so that short bursts don't create threads.
  *
  *--*/
 VOID
 NTAPI
-ExpDetectWorkerThreadDeadlock(VOID)
+ExpCheckWorkerQueueDelays(VOID)
 {
-    ULONG i;
+    ULONG i, j, Count;
+    ULONG Depth, Processed, Delay;
+    PEXP_PROCESSOR_WORK_QUEUE ProcessorQueue;
     PEX_WORK_QUEUE Queue;
 
     /* Loop the 3 queues */
     for (i = 0; i < MaximumWorkQueue; i++)
     {
-        /* Get the queue */
-        Queue = &ExWorkerQueue[i];
-        ASSERT(Queue->DynamicThreadCount <= 16);
-
-        /* Check if stuff is on the queue that still is unprocessed */
-        if ((Queue->QueueDepthLastPass) &&
-            (Queue->WorkItemsProcessed == Queue->WorkItemsProcessedLastPass) &&
-            (Queue->DynamicThreadCount < 16))
+        /* And the queue of each processor */
+        Count = (i == HyperCriticalWorkQueue) ? 1 : ExpNumberOfWorkQueues;
+        for (j = 0; j < Count; j++)
         {
-            /* Stuff is still on the queue and nobody did anything about it */
-            DPRINT1("EX: Work Queue Deadlock detected: %lu\n", i);
-            ExpCreateWorkerThread(i, TRUE);
-            DPRINT1("Dynamic threads queued %d\n", Queue->DynamicThreadCount);
-        }
+            /* Get the queue */
+            ProcessorQueue = ExpGetProcessorWorkQueue(i, j);
+            Queue = ProcessorQueue->WorkQueue;
+            ASSERT(Queue->DynamicThreadCount <= EX_MAXIMUM_DYNAMIC_THREADS);
+
+            /* Estimate how long the pending items have to wait */
+            Depth = KeReadStateQueue(&Queue->WorkerQueue);
+            Processed = Queue->WorkItemsProcessed - Queue->WorkItemsProcessedLastPass;
+            if (!Depth)
+            {
+                Delay = 0;
+            }
+            else if (!Processed)
+            {
+                /* Stuff is still on the queue and nobody did anything about it */
+                Delay = MAXULONG;
+            }
+            else
+            {
+                Delay = (ULONG)(((ULONGLONG)Depth * EX_WORKER_BALANCE_INTERVAL) / Processed);
+            }
+            ProcessorQueue->QueueDelay = Delay;
 
-        /* Update our data */
-        Queue->WorkItemsProcessedLastPass = Queue->WorkItemsProcessed;
-        Queue->QueueDepthLastPass = KeReadStateQueue(&Queue->WorkerQueue);
+            /* Check if the queue is late since the last pass */
+            if ((Queue->QueueDepthLastPass) &&
+                (Delay > EX_MAXIMUM_QUEUE_DELAY) &&
+                (Queue->DynamicThreadCount < EX_MAXIMUM_DYNAMIC_THREADS))
+            {
+                DPRINT("EX: Work Queue %lu of processor %lu is late: %lu ms\n",
+                       i, j, Delay);
+                ExpCreateWorkerThread(i, j, TRUE);
+            }
+
+            /* Update our data */
+            Queue->WorkItemsProcessedLastPass = Queue->WorkItemsProcessed;
+            Queue->QueueDepthLastPass = Depth;
+        }
     }
 }
 
@@ -374,25 +611,30 @@ VOID
 NTAPI
 ExpCheckDynamicThreadCount(VOID)
 {
-    ULONG i;
+    ULONG i, j, Count;
     PEX_WORK_QUEUE Queue;
 
     /* Loop the 3 queues */
     for (i = 0; i < MaximumWorkQueue; i++)
     {
-        /* Get the queue */
-        Queue = &ExWorkerQueue[i];
-
-        /* Check if still need a new thread. See ExQueueWorkItem */
-        if ((Queue->Info.MakeThreadsAsNecessary) &&
-            (!IsListEmpty(&Queue->WorkerQueue.EntryListHead)) &&
-            (Queue->WorkerQueue.CurrentCount <
-             Queue->WorkerQueue.MaximumCount) &&
-            (Queue->DynamicThreadCount < 16))
+        /* And the queue of each processor */
+        Count = (i == HyperCriticalWorkQueue) ? 1 : ExpNumberOfWorkQueues;
+        for (j = 0; j < Count; j++)
         {
-            /* Create a new thread */
-            DPRINT1("EX: Creating new dynamic thread as requested\n");
-            ExpCreateWorkerThread(i, TRUE);
+            /* Get the queue */
+            Queue = ExpGetProcessorWorkQueue(i, j)->WorkQueue;
+
+            /* Check if still need a new thread. See ExQueueWorkItem */
+            if ((Queue->Info.MakeThreadsAsNecessary) &&
+                (!IsListEmpty(&Queue->WorkerQueue.EntryListHead)) &&
+                (Queue->WorkerQueue.CurrentCount <
+                 Queue->WorkerQueue.MaximumCount) &&
+                (Queue->DynamicThreadCount < EX_MAXIMUM_DYNAMIC_THREADS))
+            {
+                /* Create a new thread */
+                DPRINT1("EX: Creating new dynamic thread as requested\n");
+                ExpCreateWorkerThread(i, j, TRUE);
+            }
         }
     }
 }
@@ -408,7 +650,7 @@ ExpCheckDynamicThreadCount(VOID)
  *
  * @return None.
  *
- * @remarks The worker thread balance set manager listens every second, but can
+ * @remarks The worker thread balance set manager listens every 250ms, but can
  *          also be woken up by an event when a new thread is needed, or by the
  *          special shutdown event. This thread runs at priority 7.
  *
@@ -432,7 +674,7 @@ ExpWorkerThreadBalanceManager(IN PVOID Context)
 
     /* Setup the timer */
     KeInitializeTimer(&Timer);
-    Timeout.QuadPart = Int32x32To64(-1, 10000000);
+    Timeout.QuadPart = Int32x32To64(EX_WORKER_BALANCE_INTERVAL, -10000);
 
     /* We'll wait on the periodic timer and also the emergency event */
     WaitEvents[0] = &Timer;
@@ -454,8 +696,8 @@ ExpWorkerThreadBalanceManager(IN PVOID Context)
                                           NULL);
         if (Status == 0)
         {
-            /* Our timer expired. Check for deadlocks */
-            ExpDetectWorkerThreadDeadlock();
+            /* Our timer expired. Check for late or deadlocked queues */
+            ExpCheckWorkerQueueDelays();
         }
         else if (Status == 1)
         {
@@ -518,7 +760,8 @@ ExpInitializeWorkerThreads(VOID)
     ULONG CriticalThreads, DelayedThreads;
     HANDLE ThreadHandle;
     PETHREAD Thread;
-    ULONG i;
+    PEX_WORK_QUEUE WorkQueue, ProcessorQueues;
+    ULONG i, j;
 
     /* Setup the stack swap support */
     ExInitializeFastMutex(&ExpWorkerSwapinMutex);
@@ -550,30 +793,72 @@ ExpInitializeWorkerThreads(VOID)
     /* Dynamic threads are only used for the critical queue */
     ExWorkerQueue[CriticalWorkQueue].Info.MakeThreadsAsNecessary = TRUE;
 
+    /* The other processors get their own critical and delayed queues */
+    ProcessorQueues = NULL;
+    if (KeNumberProcessors > 1)
+    {
+        ProcessorQueues = ExAllocatePoolWithTag(NonPagedPool,
+                                                (KeNumberProcessors - 1) * 2 *
+                                                sizeof(EX_WORK_QUEUE),
+                                                TAG_WORKER_QUEUE);
+    }
+
+    /* Fall back to the shared queues if that failed */
+    ExpNumberOfWorkQueues = ProcessorQueues ? KeNumberProcessors : 1;
+
+    /* Initialize the processor queues */
+    for (WorkQueueType = 0; WorkQueueType < MaximumWorkQueue; WorkQueueType++)
+    {
+        for (i = 0; i < ExpNumberOfWorkQueues; i++)
+        {
+            /* The boot processor, and the hypercritical queue, use the array */
+            if ((i == 0) || (WorkQueueType == HyperCriticalWorkQueue))
+            {
+                WorkQueue = &ExWorkerQueue[WorkQueueType];
+            }
+            else
+            {
+                /* Otherwise, copy the settings of the shared queue */
+                WorkQueue = ProcessorQueues++;
+                RtlZeroMemory(WorkQueue, sizeof(EX_WORK_QUEUE));
+                KeInitializeQueue(&WorkQueue->WorkerQueue, 0);
+                WorkQueue->Info = ExWorkerQueue[WorkQueueType].Info;
+            }
+
+            ExpProcessorWorkQueue[WorkQueueType][i].WorkQueue = WorkQueue;
+        }
+    }
+
     /* Initialize the balance set manager events */
     KeInitializeEvent(&ExpThreadSetManagerEvent, SynchronizationEvent, FALSE);
     KeInitializeEvent(&ExpThreadSetManagerShutdownEvent,
                       NotificationEvent,
                       FALSE);
 
+    /* Every processor queue needs at least one thread */
+    DelayedThreads = max(DelayedThreads, ExpNumberOfWorkQueues);
+    CriticalThreads = max(CriticalThreads, ExpNumberOfWorkQueues);
+
     /* Create the built-in worker threads for the critical queue */
-    for (i = 0; i < CriticalThreads; i++)
+    for (i = 0, j = 0; i < CriticalThreads; i++)
     {
-        /* Create the thread */
-        ExpCreateWorkerThread(CriticalWorkQueue, FALSE);
+        /* Create the thread, spreading them over the processors */
+        ExpCreateWorkerThread(CriticalWorkQueue, j, FALSE);
         ExCriticalWorkerThreads++;
+        if (++j == ExpNumberOfWorkQueues) j = 0;
     }
 
     /* Create the built-in worker threads for the delayed queue */
-    for (i = 0; i < DelayedThreads; i++)
+    for (i = 0, j = 0; i < DelayedThreads; i++)
     {
-        /* Create the thread */
-        ExpCreateWorkerThread(DelayedWorkQueue, FALSE);
+        /* Create the thread, spreading them over the processors */
+        ExpCreateWorkerThread(DelayedWorkQueue, j, FALSE);
         ExDelayedWorkerThreads++;
+        if (++j == ExpNumberOfWorkQueues) j = 0;
     }
 
     /* Create the built-in worker thread for the hypercritical queue */
-    ExpCreateWorkerThread(HyperCriticalWorkQueue, FALSE);
+    ExpCreateWorkerThread(HyperCriticalWorkQueue, 0, FALSE);
 
     /* Create the balance set manager thread */
     PsCreateSystemThread(&ThreadHandle,
@@ -705,14 +990,20 @@ Next:
  *
  *          Callers of this routine must be running at IRQL <= DISPATCH_LEVEL.
  *
+ *          The item is queued to the queue of the current processor. If all
+ *          the workers of that queue are busy, an idle worker of another
+ *          processor is asked to steal it.
+ *
  *--*/
 VOID
 NTAPI
 ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
                 IN WORK_QUEUE_TYPE QueueType)
 {
-    PEX_WORK_QUEUE WorkQueue = &ExWorkerQueue[QueueType];
+    ULONG Processor = KeGetCurrentProcessorNumber();
+    PEX_WORK_QUEUE WorkQueue;
     ASSERT(QueueType < MaximumWorkQueue);
+    WorkQueue = ExpGetProcessorWorkQueue(QueueType, Processor)->WorkQueue;
     ASSERT(WorkItem->List.Flink == NULL);
 
     /* Don't try to trick us */
@@ -730,6 +1021,12 @@ ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
     KeInsertQueue(&WorkQueue->WorkerQueue, &WorkItem->List);
     ASSERT(!WorkQueue->Info.QueueDisabled);
 
+    /* If no worker of this processor took it, find one elsewhere */
+    if (!IsListEmpty(&WorkQueue->WorkerQueue.EntryListHead))
+    {
+        ExpRequestWorkSteal(QueueType, Processor);
+    }
+
     /*
      * Check if we need a new thread. Our decision is as follows:
      *  - This queue type must support Dynamic Threads (duh!)
@@ -741,7 +1038,7 @@ ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
         (!IsListEmpty(&WorkQueue->WorkerQueue.EntryListHead)) &&
         (WorkQueue->WorkerQueue.CurrentCount <
          WorkQueue->WorkerQueue.MaximumCount) &&
-        (WorkQueue->DynamicThreadCount < 16))
+        (WorkQueue->DynamicThreadCount < EX_MAXIMUM_DYNAMIC_THREADS))
     {
         /* Let the balance manager know about it */
         DPRINT1("Requesting a new thread. CurrentCount: %lu. MaxCount: %lu\n",
@@ -751,4 +1048,43 @@ ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
     }
 }
 
+#if DBG && defined(KDBG)
+BOOLEAN ExpKdbgExtWorkQueues(ULONG Argc, PCHAR Argv[])
+{
+    static const PCSTR QueueNames[MaximumWorkQueue] = { "Critical", "Delayed", "HyperCritical" };
+    PEXP_PROCESSOR_WORK_QUEUE ProcessorQueue;
+    PEX_WORK_QUEUE Queue;
+    ULONG i, j, Count;
+
+    KdbpPrint("Queue          CPU Depth  Processed   Stolen Dynamic Delay\n");
+
+    for (i = 0; i < MaximumWorkQueue; i++)
+    {
+        Count = (i == HyperCriticalWorkQueue) ? 1 : ExpNumberOfWorkQueues;
+        for (j = 0; j < Count; j++)
+        {
+            ProcessorQueue = ExpGetProcessorWorkQueue(i, j);
+            Queue = ProcessorQueue->WorkQueue;
+            if (!Queue) continue;
+
+            KdbpPrint("%-13s %4lu %5ld %10lu %8lu %7ld ",
+                      QueueNames[i],
+                      j,
+                      KeReadStateQueue(&Queue->WorkerQueue),
+                      Queue->WorkItemsProcessed,
+                      ProcessorQueue->WorkItemsStolen,
+                      Queue->DynamicThreadCount);
+
+            /* The delay is estimated by the balance set manager on each pass */
+            if (ProcessorQueue->QueueDelay == MAXULONG)
+                KdbpPrint("stalled\n");
+            else
+                KdbpPrint("%lu ms\n", ProcessorQueue->QueueDelay);
+        }
+    }
+
+    return TRUE;
+}
+#endif // DBG && KDBG
+
 /* EOF */
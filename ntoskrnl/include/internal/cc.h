@@ -167,13 +167,21 @@ typedef struct _PFSN_PREFETCHER_GLOBALS
     LONG ActivePrefetches;
 } PFSN_PREFETCHER_GLOBALS, *PPFSN_PREFETCHER_GLOBALS;
 
+/* The VACBs of a shared cache map are indexed by their view number, in
+ * blocks of VACB_INDEX_BLOCK_SIZE entries that are allocated on demand */
+#define VACB_INDEX_BLOCK_SHIFT 9
+#define VACB_INDEX_BLOCK_SIZE (1 << VACB_INDEX_BLOCK_SHIFT)
+#define VACB_INDEX_BLOCK_MASK (VACB_INDEX_BLOCK_SIZE - 1)
+
+/* Number of buckets the BCBs of a shared cache map are hashed into */
+#define BCB_HASH_BUCKETS 32
+
 typedef struct _ROS_SHARED_CACHE_MAP
 {
     CSHORT NodeTypeCode;
     CSHORT NodeByteSize;
     ULONG OpenCount;
     LARGE_INTEGER FileSize;
-    LIST_ENTRY BcbList;
     LARGE_INTEGER SectionSize;
     LARGE_INTEGER ValidDataLength;
     PFILE_OBJECT FileObject;
@@ -191,8 +199,11 @@ typedef struct _ROS_SHARED_CACHE_MAP
 
     /* ROS specific */
     LIST_ENTRY CacheMapVacbListHead;
+    struct _ROS_VACB ***VacbIndex;
+    ULONG VacbIndexBlocks;
     BOOLEAN PinAccess;
     KSPIN_LOCK CacheMapLock;
+    LIST_ENTRY BcbList[BCB_HASH_BUCKETS]; /* hashed by view number */
 #if DBG
     BOOLEAN Trace; /* enable extra trace output for this cache map and it's VACBs */
 #endif
@@ -283,6 +294,11 @@ typedef enum _WORK_QUEUE_FUNCTIONS
 
 extern LAZY_WRITER LazyWriter;
 
+/* Bounds of the per handle read ahead window. It doubles every time a
+ * sequential reader consumes data that was read ahead */
+#define CC_MIN_READ_AHEAD (64 * 1024)
+#define CC_MAX_READ_AHEAD (4 * 1024 * 1024)
+
 #define NODE_TYPE_DEFERRED_WRITE 0x02FC
 #define NODE_TYPE_PRIVATE_MAP    0x02FE
 #define NODE_TYPE_SHARED_MAP     0x02FF
@@ -344,6 +360,10 @@ CcRosLookupVacb(
     LONGLONG FileOffset
 );
 
+VOID
+CcRosUnlinkVacb(
+    PROS_VACB Vacb);
+
 VOID
 NTAPI
 CcInitCacheZeroPage(VOID);
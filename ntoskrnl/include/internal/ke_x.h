@@ -1334,6 +1334,39 @@ KxUnwaitThreadForEvent(IN PKEVENT Event,
     } while (WaitEntry != WaitList);
 }
 
+//
+// This routine accounts for a thread which starts running on the PRCB, using
+// the tick count at which it became ready to compute its ready latency.
+//
+FORCEINLINE
+VOID
+KiAccountThreadDispatch(IN PKPRCB Prcb,
+                        IN PKTHREAD Thread)
+{
+    PSYSTEM_SCHEDULER_STATISTICS_INFORMATION Statistics;
+    ULONG Latency, Bucket;
+
+    /* The idle thread never waits on the ready lists */
+    if (Thread == Prcb->IdleThread) return;
+
+    /* Get how many clock ticks the thread has been ready for */
+    Statistics = &KiSchedulerStatistics[Prcb->Number];
+    Latency = KeTickCount.LowPart - Thread->WaitTime;
+
+    /* Find its bucket, see SYSTEM_SCHEDULER_STATISTICS_INFORMATION */
+    Bucket = 0;
+    if (Latency)
+    {
+        BitScanReverse(&Bucket, Latency);
+        Bucket = min(Bucket + 1, SCHEDULER_READY_LATENCY_BUCKETS - 1);
+    }
+
+    /* Update the statistics, only this processor writes them */
+    Statistics->ReadyLatency[Bucket]++;
+    Statistics->MaximumReadyLatency = max(Statistics->MaximumReadyLatency, Latency);
+    Statistics->Dispatches++;
+}
+
 //
 // This routine queues a thread that is ready on the PRCB's ready lists.
 // If this thread cannot currently run on this CPU, then the thread is
@@ -144,6 +144,51 @@ typedef union
     ULARGE_INTEGER Alignment;
 } ALIGNEDNAME;
 
+//
+// Directory hash tables start with the buckets of the directory itself, and
+// grow by OBP_DIRECTORY_GROWTH when there are more than OBP_DIRECTORY_LOAD_FACTOR
+// entries per bucket. The bucket count must fit in OBP_LOOKUP_CONTEXT.HashIndex
+//
+#define OBP_DIRECTORY_LOAD_FACTOR                       4
+#define OBP_DIRECTORY_GROWTH                            4
+#define OBP_MAXIMUM_DIRECTORY_BUCKETS                   38229
+
+typedef struct _OBP_DIRECTORY_HASH_TABLE
+{
+    POBJECT_DIRECTORY_ENTRY *Buckets;
+    ULONG BucketCount;
+    ULONG EntryCount;
+    ULONG Lookups;
+    ULONG ChainSteps;
+    ULONG Resizes;
+} OBP_DIRECTORY_HASH_TABLE, *POBP_DIRECTORY_HASH_TABLE;
+
+//
+// Body of directory objects
+//
+typedef struct _OBP_DIRECTORY
+{
+    OBJECT_DIRECTORY Directory;
+    OBP_DIRECTORY_HASH_TABLE HashTable;
+} OBP_DIRECTORY, *POBP_DIRECTORY;
+
+#define ObpGetDirectoryHashTable(x) \
+    (&CONTAINING_RECORD((x), OBP_DIRECTORY, Directory)->HashTable)
+
+//
+// Directory lookup statistics
+//
+typedef struct _OBP_DIRECTORY_STATISTICS
+{
+    ULONG BucketCount;
+    ULONG UsedBuckets;
+    ULONG EntryCount;
+    ULONG LongestChain;
+    ULONG Lookups;
+    ULONG ChainSteps;
+    ULONG Resizes;
+} OBP_DIRECTORY_STATISTICS, *POBP_DIRECTORY_STATISTICS;
+
 //
 // Private Temporary Buffer for Lookup Routines
 //
@@ -198,6 +243,19 @@ ObpLookupEntryDirectory(
     IN POBP_LOOKUP_CONTEXT Context
 );
 
+VOID
+NTAPI
+ObpDeleteDirectory(
+    IN PVOID ObjectBody
+);
+
+VOID
+NTAPI
+ObpQueryDirectoryStatistics(
+    IN POBJECT_DIRECTORY Directory,
+    OUT POBP_DIRECTORY_STATISTICS Statistics
+);
+
 //
 // Symbolic Link Functions
 //
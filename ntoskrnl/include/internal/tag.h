@@ -7,6 +7,9 @@
 #define TAG_PRIVATE_CACHE_MAP   'cPcC'
 #define TAG_BCB                 'cBcC'
 
+/* Executive Worker Queues */
+#define TAG_WORKER_QUEUE        'QkrW'
+
 /* Executive Callbacks */
 #define TAG_CALLBACK_ROUTINE_BLOCK 'brbC'
 #define TAG_CALLBACK_REGISTRATION  'eRBC'
@@ -98,6 +98,9 @@ BOOLEAN ExpKdbgExtFileCache(ULONG Argc, PCHAR Argv[]);
 BOOLEAN ExpKdbgExtDefWrites(ULONG Argc, PCHAR Argv[]);
 BOOLEAN ExpKdbgExtIrpFind(ULONG Argc, PCHAR Argv[]);
 BOOLEAN ExpKdbgExtHandle(ULONG Argc, PCHAR Argv[]);
+BOOLEAN ExpKdbgExtDirStats(ULONG Argc, PCHAR Argv[]);
+BOOLEAN ExpKdbgExtSchedStats(ULONG Argc, PCHAR Argv[]);
+BOOLEAN ExpKdbgExtWorkQueues(ULONG Argc, PCHAR Argv[]);
 
 #ifdef __ROS_DWARF__
 static BOOLEAN KdbpCmdPrintStruct(ULONG Argc, PCHAR Argv[]);
@@ -394,6 +397,9 @@ static const struct
     { "!defwrites", "!defwrites", "Display cache write values.", ExpKdbgExtDefWrites },
     { "!irpfind", "!irpfind [Pool [startaddress [criteria data]]]", "Lists IRPs potentially matching criteria.", ExpKdbgExtIrpFind },
     { "!handle", "!handle [Handle]", "Displays info about handles.", ExpKdbgExtHandle },
+    { "!dirstats", "!dirstats [Directory]", "Display object directory hash table statistics.", ExpKdbgExtDirStats },
+    { "!schedstats", "!schedstats", "Display scheduler ready latency statistics.", ExpKdbgExtSchedStats },
+    { "!workqueues", "!workqueues", "Display system worker queue statistics.", ExpKdbgExtWorkQueues },
 };
 
 /* FUNCTIONS *****************************************************************/
@@ -71,6 +71,7 @@ KiDpcInterruptHandler(VOID)
 
         /* The thread is now running */
         NewThread->State = Running;
+        KiAccountThreadDispatch(Prcb, NewThread);
         OldThread->WaitReason = WrDispatchInt;
 
         /* Make the old thread ready */
@@ -95,6 +96,19 @@ KeZeroPages(IN PVOID Address,
     RtlZeroMemory(Address, Size);
 }
 
+VOID
+KiXmmiZeroPages(IN PVOID Address,
+                IN ULONG Size);
+
+VOID
+FASTCALL
+KeZeroPagesFromIdleThread(IN PVOID Address,
+                          IN ULONG Size)
+{
+    /* These pages won't be used soon, so don't pollute the caches with them */
+    KiXmmiZeroPages(Address, Size);
+}
+
 PVOID
 KiSwitchKernelStackHelper(
     LONG_PTR StackOffset,
@@ -211,6 +225,7 @@ KiIdleLoop(VOID)
 
             /* The thread is now running */
             NewThread->State = Running;
+            KiAccountThreadDispatch(Prcb, NewThread);
 
             /* Do the swap at SYNCH_LEVEL */
             KfRaiseIrql(SYNCH_LEVEL);
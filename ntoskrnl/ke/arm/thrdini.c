@@ -192,6 +192,7 @@ KiIdleLoop(VOID)
 
             /* The thread is now running */
             NewThread->State = Running;
+            KiAccountThreadDispatch(Prcb, NewThread);
 
             /* Switch away from the idle thread */
             KiSwapContext(APC_LEVEL, OldThread);
@@ -334,6 +335,7 @@ KiDispatchInterrupt(VOID)
 
         /* The thread is now running */
         NewThread->State = Running;
+        KiAccountThreadDispatch(Prcb, NewThread);
         OldThread->WaitReason = WrDispatchInt;
 
         /* Make the old thread ready */
@@ -541,6 +541,7 @@ KiQuantumEnd(VOID)
 
     /* Set thread to running and the switch reason to Quantum End */
     NextThread->State = Running;
+    KiAccountThreadDispatch(Prcb, NextThread);
     Thread->WaitReason = WrQuantumEnd;
 
     /* Queue it on the ready lists */
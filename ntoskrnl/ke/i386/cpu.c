@@ -1138,6 +1138,27 @@ KeZeroPages(IN PVOID Address,
     RtlZeroMemory(Address, Size);
 }
 
+VOID
+FASTCALL
+KiXmmiZeroPages(IN PVOID Address,
+                IN ULONG Size);
+
+VOID
+FASTCALL
+KeZeroPagesFromIdleThread(IN PVOID Address,
+                          IN ULONG Size)
+{
+    /* These pages won't be used soon, so don't pollute the caches with them */
+    if (KeFeatureBits & KF_XMMI64)
+    {
+        KiXmmiZeroPages(Address, Size);
+    }
+    else
+    {
+        RtlZeroMemory(Address, Size);
+    }
+}
+
 VOID
 NTAPI
 KiSaveProcessorState(IN PKTRAP_FRAME TrapFrame,
@@ -24,6 +24,7 @@
 
 ULONG_PTR KiIdleSummary;
 ULONG_PTR KiIdleSMTSummary;
+SYSTEM_SCHEDULER_STATISTICS_INFORMATION KiSchedulerStatistics[MAXIMUM_PROCESSORS];
 
 /* FUNCTIONS *****************************************************************/
 
@@ -83,6 +84,7 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     ULONG Processor = 0;
     KPRIORITY OldPriority;
     PKTHREAD NextThread;
+    PSYSTEM_SCHEDULER_STATISTICS_INFORMATION Statistics;
 
     /* Sanity checks */
     ASSERT(Thread->State == DeferredReady);
@@ -228,11 +230,19 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     OldPriority = Thread->Priority;
     Thread->Preempted = FALSE;
 
+    /* The thread is ready from now on, whichever way it gets to run */
+    Thread->WaitTime = KeTickCount.LowPart;
+
     /* Queue the thread on CPU 0 and get the PRCB and lock it */
     Thread->NextProcessor = 0;
     Prcb = KiProcessorBlock[0];
     KiAcquirePrcbLock(Prcb);
 
+    /* Account for looking for an idle CPU on the CPU doing it, which is
+       also the only one writing its statistics */
+    Statistics = &KiSchedulerStatistics[KeGetCurrentPrcb()->Number];
+    Statistics->IdleScans++;
+
     /* Check if we have an idle summary */
     if (KiIdleSummary)
     {
@@ -246,6 +256,9 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
         return;
     }
 
+    /* No CPU was idle */
+    Statistics->IdleScanMisses++;
+
     /* Set the CPU number */
     Thread->NextProcessor = (UCHAR)Processor;
 
@@ -261,6 +274,7 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
         {
             /* Preempt the thread */
             NextThread->Preempted = TRUE;
+            Statistics->Preemptions++;
 
             /* Put this one as the next one */
             Thread->State = Standby;
@@ -281,7 +295,11 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
         if (OldPriority > NextThread->Priority)
         {
             /* Preempt it if it's already running */
-            if (NextThread->State == Running) NextThread->Preempted = TRUE;
+            if (NextThread->State == Running)
+            {
+                NextThread->Preempted = TRUE;
+                Statistics->Preemptions++;
+            }
 
             /* Set the thread on standby and as the next thread */
             Thread->State = Standby;
@@ -305,7 +323,6 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
 
     /* Set this thread as ready */
     Thread->State = Ready;
-    Thread->WaitTime = KeTickCount.LowPart;
 
     /* Insert this thread in the appropriate order */
     Preempted ? InsertHeadList(&Prcb->DispatcherReadyListHead[OldPriority],
@@ -372,6 +389,7 @@ KiSwapThread(IN PKTHREAD CurrentThread,
         Prcb->NextThread = NULL;
         Prcb->CurrentThread = NextThread;
         NextThread->State = Running;
+        KiAccountThreadDispatch(Prcb, NextThread);
     }
     else
     {
@@ -382,6 +400,7 @@ KiSwapThread(IN PKTHREAD CurrentThread,
             /* Switch to it */
             Prcb->CurrentThread = NextThread;
             NextThread->State = Running;
+            KiAccountThreadDispatch(Prcb, NextThread);
         }
         else
         {
@@ -789,6 +808,7 @@ NtYieldExecution(VOID)
             Prcb->NextThread = NULL;
             Prcb->CurrentThread = NextThread;
             NextThread->State = Running;
+            KiAccountThreadDispatch(Prcb, NextThread);
 
             /* Setup a yield wait and queue the thread */
             Thread->WaitReason = WrYieldExecution;
@@ -816,3 +836,60 @@ NtYieldExecution(VOID)
     KeLowerIrql(OldIrql);
     return Status;
 }
+
+#if DBG && defined(KDBG)
+BOOLEAN ExpKdbgExtSchedStats(ULONG Argc, PCHAR Argv[])
+{
+    PSYSTEM_SCHEDULER_STATISTICS_INFORMATION Statistics;
+    ULONG Processor, Bucket;
+    ULONGLONG MaximumLatencyMs;
+
+    for (Processor = 0; Processor < (ULONG)KeNumberProcessors; Processor++)
+    {
+        Statistics = &KiSchedulerStatistics[Processor];
+
+        KdbpPrint("CPU %lu: %lu dispatches, %lu preemptions\n",
+                  Processor,
+                  Statistics->Dispatches,
+                  Statistics->Preemptions);
+        KdbpPrint("  Idle CPU lookups: %lu, %lu without an idle CPU\n",
+                  Statistics->IdleScans,
+                  Statistics->IdleScanMisses);
+
+        /* Latencies are in ticks, show them in milliseconds too. Ticks are
+           not a whole number of milliseconds, so convert from 100 ns units */
+        MaximumLatencyMs = UInt32x32To64(Statistics->MaximumReadyLatency,
+                                         KeMaximumIncrement);
+        MaximumLatencyMs = (MaximumLatencyMs + 5000) / 10000;
+        KdbpPrint("  Maximum ready latency: %lu ticks (%I64u ms)\n",
+                  Statistics->MaximumReadyLatency,
+                  MaximumLatencyMs);
+
+        /* Dump the non empty buckets of the histogram */
+        for (Bucket = 0; Bucket < SCHEDULER_READY_LATENCY_BUCKETS; Bucket++)
+        {
+            if (!Statistics->ReadyLatency[Bucket]) continue;
+
+            if (Bucket == 0)
+            {
+                KdbpPrint("  < 1 tick:          %lu\n", Statistics->ReadyLatency[Bucket]);
+            }
+            else if (Bucket == SCHEDULER_READY_LATENCY_BUCKETS - 1)
+            {
+                KdbpPrint("  >= %5lu ticks:    %lu\n",
+                          1UL << (Bucket - 1),
+                          Statistics->ReadyLatency[Bucket]);
+            }
+            else
+            {
+                KdbpPrint("  %5lu-%5lu ticks: %lu\n",
+                          1UL << (Bucket - 1),
+                          (1UL << Bucket) - 1,
+                          Statistics->ReadyLatency[Bucket]);
+            }
+        }
+    }
+
+    return TRUE;
+}
+#endif // DBG && KDBG
@@ -241,6 +241,7 @@ KiExitDispatcher(IN KIRQL OldIrql)
 
     /* Set thread to running */
     NextThread->State = Running;
+    KiAccountThreadDispatch(Prcb, NextThread);
 
     /* Queue it on the ready lists */
     KxQueueReadyThread(Thread, Prcb);
@@ -30,9 +30,13 @@ typedef struct _POOL_DPC_CONTEXT
     SIZE_T PoolTrackTableSizeExpansion;
 } POOL_DPC_CONTEXT, *PPOOL_DPC_CONTEXT;
 
+#define EXP_MAXIMUM_POOLS 16
+
 ULONG ExpNumberOfPagedPools;
+ULONG ExpNumberOfNonPagedPools = 1;
 POOL_DESCRIPTOR NonPagedPoolDescriptor;
-PPOOL_DESCRIPTOR ExpPagedPoolDescriptor[16 + 1];
+PPOOL_DESCRIPTOR ExpPagedPoolDescriptor[EXP_MAXIMUM_POOLS + 1];
+PPOOL_DESCRIPTOR ExpNonPagedPoolDescriptor[EXP_MAXIMUM_POOLS];
 PPOOL_DESCRIPTOR PoolVector[2];
 PKGUARDED_MUTEX ExpPagedPoolMutex;
 SIZE_T PoolTrackTableSize, PoolTrackTableMask;
@@ -1203,6 +1207,7 @@ InitializePool(IN POOL_TYPE PoolType,
         // Initialize the nonpaged pool descriptor
         //
         PoolVector[NonPagedPool] = &NonPagedPoolDescriptor;
+        ExpNonPagedPoolDescriptor[0] = &NonPagedPoolDescriptor;
         ExInitializePoolDescriptor(PoolVector[NonPagedPool],
                                    NonPagedPool,
                                    0,
@@ -1257,19 +1262,135 @@ InitializePool(IN POOL_TYPE PoolType,
     }
 }
 
+CODE_SEG("INIT")
+VOID
+NTAPI
+ExpInitializeProcessorPools(VOID)
+{
+    PPOOL_DESCRIPTOR Descriptor;
+    ULONG i, Count;
+
+    //
+    // All the processors are running now, so give each of them its own pool
+    // descriptors, up to the maximum we support. The boot descriptors stay
+    // in use for the first processor, and for the blocks they already own.
+    //
+    Count = min((ULONG)KeNumberProcessors, EXP_MAXIMUM_POOLS);
+    if (Count <= 1) return;
+
+    for (i = 1; i < Count; i++)
+    {
+        //
+        // Nonpaged pool descriptors come with their own spin lock
+        //
+        Descriptor = ExAllocatePoolWithTag(NonPagedPool,
+                                           sizeof(POOL_DESCRIPTOR) +
+                                           sizeof(KSPIN_LOCK),
+                                           'looP');
+        if (!Descriptor) break;
+
+        KeInitializeSpinLock((PKSPIN_LOCK)(Descriptor + 1));
+        ExInitializePoolDescriptor(Descriptor,
+                                   NonPagedPool,
+                                   i,
+                                   NonPagedPoolDescriptor.Threshold,
+                                   Descriptor + 1);
+        ExpNonPagedPoolDescriptor[i] = Descriptor;
+
+        //
+        // And paged pool descriptors with their own guarded mutex
+        //
+        Descriptor = ExAllocatePoolWithTag(NonPagedPool,
+                                           sizeof(POOL_DESCRIPTOR) +
+                                           sizeof(KGUARDED_MUTEX),
+                                           'looP');
+        if (!Descriptor)
+        {
+            ExFreePoolWithTag(ExpNonPagedPoolDescriptor[i], 'looP');
+            ExpNonPagedPoolDescriptor[i] = NULL;
+            break;
+        }
+
+        KeInitializeGuardedMutex((PKGUARDED_MUTEX)(Descriptor + 1));
+        ExInitializePoolDescriptor(Descriptor,
+                                   PagedPool,
+                                   i,
+                                   ExpPagedPoolDescriptor[0]->Threshold,
+                                   Descriptor + 1);
+        ExpPagedPoolDescriptor[i] = Descriptor;
+    }
+
+    //
+    // Publish the new descriptors only once they are fully set up, other
+    // threads may already be allocating
+    //
+    KeMemoryBarrier();
+    ExpNumberOfNonPagedPools = i;
+    ExpNumberOfPagedPools = i - 1;
+    DPRINT("EXPOOL: Using %lu pool descriptors of each type\n", i);
+}
+
+FORCEINLINE
+PPOOL_DESCRIPTOR
+ExpGetProcessorPoolDescriptor(IN POOL_TYPE PoolType,
+                              IN PKPRCB Prcb)
+{
+    //
+    // Spread the allocations over the descriptors by processor, so that they
+    // don't all serialize on the same pool lock
+    //
+    if (PoolType == NonPagedPool)
+    {
+        return ExpNonPagedPoolDescriptor[Prcb->Number % ExpNumberOfNonPagedPools];
+    }
+    else
+    {
+        return ExpPagedPoolDescriptor[Prcb->Number % (ExpNumberOfPagedPools + 1)];
+    }
+}
+
+FORCEINLINE
+PPOOL_DESCRIPTOR
+ExpGetEntryPoolDescriptor(IN POOL_TYPE PoolType,
+                          IN PPOOL_HEADER Entry)
+{
+    //
+    // Blocks always go back to the descriptor which owns their page
+    //
+    if (PoolType == NonPagedPool)
+    {
+        ASSERT(Entry->PoolIndex < ExpNumberOfNonPagedPools);
+        return ExpNonPagedPoolDescriptor[Entry->PoolIndex];
+    }
+    else
+    {
+        ASSERT(Entry->PoolIndex <= ExpNumberOfPagedPools);
+        return ExpPagedPoolDescriptor[Entry->PoolIndex];
+    }
+}
+
 FORCEINLINE
 KIRQL
 ExLockPool(IN PPOOL_DESCRIPTOR Descriptor)
 {
+    KIRQL OldIrql;
+
     //
     // Check if this is nonpaged pool
     //
     if ((Descriptor->PoolType & BASE_POOL_TYPE_MASK) == NonPagedPool)
     {
         //
-        // Use the queued spin lock
+        // The boot descriptor uses the queued spin lock, the others have
+        // their own
         //
-        return KeAcquireQueuedSpinLock(LockQueueNonPagedPoolLock);
+        if (!Descriptor->LockAddress)
+        {
+            return KeAcquireQueuedSpinLock(LockQueueNonPagedPoolLock);
+        }
+
+        KeAcquireSpinLock(Descriptor->LockAddress, &OldIrql);
+        return OldIrql;
     }
     else
     {
@@ -1292,9 +1413,16 @@ ExUnlockPool(IN PPOOL_DESCRIPTOR Descriptor,
     if ((Descriptor->PoolType & BASE_POOL_TYPE_MASK) == NonPagedPool)
     {
         //
-        // Use the queued spin lock
+        // Use the queued spin lock, or the descriptor's own
         //
-        KeReleaseQueuedSpinLock(LockQueueNonPagedPoolLock, OldIrql);
+        if (!Descriptor->LockAddress)
+        {
+            KeReleaseQueuedSpinLock(LockQueueNonPagedPoolLock, OldIrql);
+        }
+        else
+        {
+            KeReleaseSpinLock(Descriptor->LockAddress, OldIrql);
+        }
     }
     else
     {
@@ -1753,10 +1881,9 @@ ExQueryPoolUsage(OUT PULONG PagedPoolPages,
     // If the system has more than one non-paged pool, copy the other descriptor
     // totals as well
     //
-#if 0
     if (ExpNumberOfNonPagedPools > 1)
     {
-        for (i = 0; i < ExpNumberOfNonPagedPools; i++)
+        for (i = 1; i < ExpNumberOfNonPagedPools; i++)
         {
             PoolDesc = ExpNonPagedPoolDescriptor[i];
             *NonPagedPoolPages += PoolDesc->TotalPages + PoolDesc->TotalBigPages;
@@ -1764,7 +1891,6 @@ ExQueryPoolUsage(OUT PULONG PagedPoolPages,
             *NonPagedPoolFrees += PoolDesc->RunningDeAllocs;
         }
     }
-#endif
 
     //
     // Get the amount of hits in the system lookaside lists
@@ -2077,6 +2203,12 @@ ExAllocatePoolWithTag(IN POOL_TYPE PoolType,
         }
     }
 
+    //
+    // Big pages are accounted in the boot descriptor, but blocks come from
+    // the descriptor of the current processor
+    //
+    PoolDesc = ExpGetProcessorPoolDescriptor(PoolType, Prcb);
+
     //
     // Loop in the free lists looking for a block if this size. Start with the
     // list optimized for this kind of size lookup
@@ -2204,6 +2336,8 @@ ExAllocatePoolWithTag(IN POOL_TYPE PoolType,
                 // Now our (allocation) entry is the right size
                 //
                 Entry->BlockSize = i;
+                Entry->PoolIndex = PoolDesc->PoolIndex;
+                FragmentEntry->PoolIndex = PoolDesc->PoolIndex;
 
                 //
                 // And the next entry is now the free fragment which contains
@@ -2334,6 +2468,7 @@ ExAllocatePoolWithTag(IN POOL_TYPE PoolType,
     Entry->Ulong1 = 0;
     Entry->BlockSize = i;
     Entry->PoolType = OriginalType + 1;
+    Entry->PoolIndex = PoolDesc->PoolIndex;
 
     //
     // This page will have two entries -- one for the allocation (which we just
@@ -2346,6 +2481,7 @@ ExAllocatePoolWithTag(IN POOL_TYPE PoolType,
     FragmentEntry->Ulong1 = 0;
     FragmentEntry->BlockSize = BlockSize;
     FragmentEntry->PreviousSize = i;
+    FragmentEntry->PoolIndex = PoolDesc->PoolIndex;
 
     //
     // Increment required counters
@@ -2611,11 +2747,11 @@ ExFreePoolWithTag(IN PVOID P,
 
     //
     // Get the size of the entry, and it's pool type, then load the descriptor
-    // for this pool type
+    // which owns this block
     //
     BlockSize = Entry->BlockSize;
     PoolType = (Entry->PoolType - 1) & BASE_POOL_TYPE_MASK;
-    PoolDesc = PoolVector[PoolType];
+    PoolDesc = ExpGetEntryPoolDescriptor(PoolType, Entry);
 
     //
     // Make sure that the IRQL makes sense
@@ -108,7 +108,8 @@ MiUnmapPageInHyperSpace(IN PEPROCESS Process,
 
 PVOID
 NTAPI
-MiMapPagesInZeroSpace(IN PMMPFN Pfn1,
+MiMapPagesInZeroSpace(IN PMMPTE ZeroingPte,
+                      IN PMMPFN Pfn1,
                       IN PFN_NUMBER NumberOfPages)
 {
     MMPTE TempPte;
@@ -123,9 +124,9 @@ MiMapPagesInZeroSpace(IN PMMPFN Pfn1,
     ASSERT(NumberOfPages <= MI_ZERO_PTES);
 
     //
-    // Pick the first zeroing PTE
+    // Pick the first zeroing PTE of the caller's set
     //
-    PointerPte = MiFirstReservedZeroingPte;
+    PointerPte = ZeroingPte;
 
     //
     // Now get the first free PTE
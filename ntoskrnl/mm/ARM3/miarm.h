@@ -390,8 +390,10 @@ typedef struct _POOL_TRACKER_BIG_PAGES
 } POOL_TRACKER_BIG_PAGES, *PPOOL_TRACKER_BIG_PAGES;
 
 extern ULONG ExpNumberOfPagedPools;
+extern ULONG ExpNumberOfNonPagedPools;
 extern POOL_DESCRIPTOR NonPagedPoolDescriptor;
 extern PPOOL_DESCRIPTOR ExpPagedPoolDescriptor[16 + 1];
+extern PPOOL_DESCRIPTOR ExpNonPagedPoolDescriptor[16];
 extern PPOOL_TRACKER_TABLE PoolTrackTable;
 
 //
@@ -640,6 +642,10 @@ extern PFN_NUMBER MmSystemPageDirectory[PPE_PER_PAGE];
 extern PMMPTE MmSharedUserDataPte;
 extern LIST_ENTRY MmProcessList;
 extern KEVENT MmZeroingPageEvent;
+extern KEVENT MiZeroingHelperEvent;
+extern PFN_NUMBER MiZeroedPageTarget;
+extern ULONG MiPrezeroedPagesUsed;
+extern ULONG MiInlineZeroedPages;
 extern ULONG MmSystemPageColor;
 extern ULONG MmProcessColorSeed;
 extern PMMWSL MmWorkingSetList;
@@ -684,6 +690,22 @@ MiIsMemoryTypeInvisible(TYPE_OF_MEMORY MemoryType)
             (MemoryType == LoaderBBTMemory));
 }
 
+//
+// Gets the zeroing helpers going if the zeroed list runs low, once per wait.
+// The PFN lock must be held.
+//
+FORCEINLINE
+VOID
+MiWakeZeroingHelpers(VOID)
+{
+    if ((MmZeroedPageListHead.Total < MiZeroedPageTarget) &&
+        (MmFreePageListHead.Total != 0) &&
+        !KeReadStateEvent(&MiZeroingHelperEvent))
+    {
+        KeSetEvent(&MiZeroingHelperEvent, IO_NO_INCREMENT, FALSE);
+    }
+}
+
 #ifdef _M_AMD64
 FORCEINLINE
 BOOLEAN
@@ -1838,6 +1860,12 @@ InitializePool(           //
     IN ULONG Threshold    //
 );                        //
 
+VOID
+NTAPI
+ExpInitializeProcessorPools(
+    VOID
+);
+
 // FIXFIX: THIS ONE TOO
 VOID
 NTAPI
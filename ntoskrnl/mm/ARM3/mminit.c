@@ -2150,8 +2150,9 @@ MmArmInitSystem(IN ULONG Phase,
         /* Initialize the Loader Lock */
         KeInitializeMutant(&MmSystemLoadLock, FALSE);
 
-        /* Set up the zero page event */
+        /* Set up the zero page events */
         KeInitializeEvent(&MmZeroingPageEvent, NotificationEvent, FALSE);
+        KeInitializeEvent(&MiZeroingHelperEvent, NotificationEvent, FALSE);
 
         /* Initialize the dead stack S-LIST */
         InitializeSListHead(&MmDeadStackSListHead);
@@ -673,6 +673,10 @@ MiResolveDemandZeroFault(IN PVOID Address,
             /* We'll need a free page and zero it manually */
             PageFrameNumber = MiRemoveAnyPage(Color);
             NeedZero = TRUE;
+            MiInlineZeroedPages++;
+
+            /* The zeroed list ran dry, get the zeroing helpers to refill it */
+            MiWakeZeroingHelpers();
         }
     }
     else
@@ -583,8 +583,19 @@ MiRemoveZeroPage(IN ULONG Color)
     PageIndex = MiRemovePageByColor(PageIndex, Color);
     ASSERT(Pfn1 == MI_PFN_ELEMENT(PageIndex));
 
-    /* Zero it, if needed */
-    if (Zero) MiZeroPhysicalPage(PageIndex);
+    /* Zero it, if needed, and keep track of how much zeroed pages are needed */
+    if (Zero)
+    {
+        MiInlineZeroedPages++;
+        MiZeroPhysicalPage(PageIndex);
+    }
+    else
+    {
+        MiPrezeroedPagesUsed++;
+    }
+
+    /* Get the zeroing helpers going if the zeroed list runs low */
+    MiWakeZeroingHelpers();
 
     /* Sanity checks */
     ASSERT(Pfn1->u3.e2.ReferenceCount == 0);
@@ -17,7 +17,26 @@
 
 /* GLOBALS ********************************************************************/
 
+/* Pages zeroed at once, each batch is mapped and zeroed in one go */
+#define MI_ZERO_BATCH_PAGES         16
+
+/* Bounds of the number of zeroed pages we try to keep ready for faults */
+#define MI_MINIMUM_ZEROED_PAGES     256
+#define MI_MAXIMUM_ZEROED_PAGES     (64 * 1024)
+
+/* How often the fault rate is sampled, in 100ns units */
+#define MI_ZERO_SAMPLE_INTERVAL     (1000 * 10000)
+
+#define MI_MAXIMUM_ZEROING_HELPERS  8
+
 KEVENT MmZeroingPageEvent;
+KEVENT MiZeroingHelperEvent;
+PFN_NUMBER MiZeroedPageTarget = MI_MINIMUM_ZEROED_PAGES;
+ULONG MiPrezeroedPagesUsed;
+ULONG MiInlineZeroedPages;
+ULONG MiLastZeroedPageDemand;
+ULONGLONG MiLastZeroedPageSample;
+PMMPTE MiZeroingHelperPtes[MI_MAXIMUM_ZEROING_HELPERS];
 
 /* PRIVATE FUNCTIONS **********************************************************/
 
@@ -31,6 +50,193 @@ NTAPI
 MiFreeInitializationCode(IN PVOID StartVa,
 IN PVOID EndVa);
 
+static
+BOOLEAN
+MiZeroFreePages(IN PMMPTE ZeroingPte,
+                IN PFN_NUMBER Target,
+                IN PKEVENT Event)
+{
+    KIRQL OldIrql;
+    PVOID ZeroAddress;
+    PFN_NUMBER PageIndex, FreePage;
+    PFN_NUMBER Pages[MI_ZERO_BATCH_PAGES];
+    ULONG Count, i;
+    PMMPFN Pfn1, LastPfn;
+
+    /* Grab a batch of free pages, unless there's enough zeroed ones already */
+    Count = 0;
+    LastPfn = (PMMPFN)LIST_HEAD;
+    OldIrql = MiAcquirePfnLock();
+    while ((Count < MI_ZERO_BATCH_PAGES) &&
+           (MmFreePageListHead.Total != 0) &&
+           (!Target || (MmZeroedPageListHead.Total + Count < Target)))
+    {
+        PageIndex = MmFreePageListHead.Flink;
+        ASSERT(PageIndex != LIST_HEAD);
+        Pfn1 = MiGetPfnEntry(PageIndex);
+        MI_SET_USAGE(MI_USAGE_ZERO_LOOP);
+        MI_SET_PROCESS2("Kernel 0 Loop");
+        FreePage = MiRemoveAnyPage(MI_GET_PAGE_COLOR(PageIndex));
+
+        /* The first global free page should also be the first on its own list */
+        if (FreePage != PageIndex)
+        {
+            KeBugCheckEx(PFN_LIST_CORRUPT,
+                         0x8F,
+                         FreePage,
+                         PageIndex,
+                         0);
+        }
+
+        /* Chain the pages for MiMapPagesInZeroSpace */
+        Pfn1->u1.Flink = (PFN_NUMBER)LastPfn;
+        LastPfn = Pfn1;
+        Pages[Count++] = PageIndex;
+    }
+
+    /* Nothing left to do, go back to sleep */
+    if (!Count)
+    {
+        KeClearEvent(Event);
+        MiReleasePfnLock(OldIrql);
+        return FALSE;
+    }
+    MiReleasePfnLock(OldIrql);
+
+    ZeroAddress = MiMapPagesInZeroSpace(ZeroingPte, LastPfn, Count);
+    ASSERT(ZeroAddress);
+    KeZeroPagesFromIdleThread(ZeroAddress, Count * PAGE_SIZE);
+    MiUnmapPagesInZeroSpace(ZeroAddress, Count);
+
+    OldIrql = MiAcquirePfnLock();
+    for (i = 0; i < Count; i++)
+    {
+        MiInsertPageInList(&MmZeroedPageListHead, Pages[i]);
+    }
+    MiReleasePfnLock(OldIrql);
+
+    return TRUE;
+}
+
+static
+VOID
+MiUpdateZeroedPageTarget(VOID)
+{
+    KIRQL OldIrql;
+    ULONGLONG Now, Elapsed;
+    ULONG Demand, Rate;
+    PFN_NUMBER Target;
+
+    Now = KeQueryInterruptTime();
+    Elapsed = Now - MiLastZeroedPageSample;
+    if (Elapsed < MI_ZERO_SAMPLE_INTERVAL) return;
+
+    OldIrql = MiAcquirePfnLock();
+
+    /* Get how many zeroed pages faults asked for per second since last time */
+    Demand = MiPrezeroedPagesUsed + MiInlineZeroedPages;
+    Rate = (ULONG)(((ULONGLONG)(Demand - MiLastZeroedPageDemand) * 10000000) / Elapsed);
+    MiLastZeroedPageDemand = Demand;
+    MiLastZeroedPageSample = Now;
+
+    /* Try to always have two seconds worth of zeroed pages */
+    Target = max((PFN_NUMBER)Rate * 2, MI_MINIMUM_ZEROED_PAGES);
+    Target = min(Target, MI_MAXIMUM_ZEROED_PAGES);
+    Target = min(Target, MmAvailablePages / 2);
+    MiZeroedPageTarget = Target;
+
+    if ((MmZeroedPageListHead.Total < Target) && (MmFreePageListHead.Total != 0))
+    {
+        KeSetEvent(&MiZeroingHelperEvent, IO_NO_INCREMENT, FALSE);
+    }
+
+    MiReleasePfnLock(OldIrql);
+
+    DPRINT("Zeroed pages: %lu target %lu, inline zeroed: %lu\n",
+           MmZeroedPageListHead.Total, Target, MiInlineZeroedPages);
+}
+
+static
+PMMPTE
+MiReserveZeroingPtes(VOID)
+{
+    PMMPTE ZeroingPte;
+
+    /* Same layout as MiFirstReservedZeroingPte: a counter, then the mapping PTEs */
+    ZeroingPte = MiReserveSystemPtes(MI_ZERO_PTES + 1, SystemPteSpace);
+    if (!ZeroingPte) return NULL;
+
+    RtlZeroMemory(ZeroingPte, (MI_ZERO_PTES + 1) * sizeof(MMPTE));
+    ZeroingPte->u.Hard.PageFrameNumber = MI_ZERO_PTES;
+    return ZeroingPte;
+}
+
+static
+VOID
+NTAPI
+MiZeroingHelperThread(IN PVOID Context)
+{
+    PKTHREAD Thread = KeGetCurrentThread();
+    ULONG Processor = PtrToUlong(Context);
+    PMMPTE ZeroingPte = MiZeroingHelperPtes[Processor - 1];
+
+    /* Stay on our processor, the zeroing PTEs are only flushed from its TB */
+    KeSetSystemAffinityThread(AFFINITY_MASK(Processor));
+
+    /* Only use idle time, like the main zero page thread */
+    Thread->BasePriority = 0;
+    KeSetPriorityThread(Thread, 0);
+
+    while (TRUE)
+    {
+        KeWaitForSingleObject(&MiZeroingHelperEvent,
+                              WrFreePage,
+                              KernelMode,
+                              FALSE,
+                              NULL);
+
+        /* Help until there's enough zeroed pages for the current fault rate */
+        while (MiZeroFreePages(ZeroingPte, MiZeroedPageTarget, &MiZeroingHelperEvent));
+    }
+}
+
+static
+VOID
+MiCreateZeroingHelpers(VOID)
+{
+    NTSTATUS Status;
+    HANDLE ThreadHandle;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    ULONG i, Count;
+
+    /* One helper for every other processor */
+    Count = min((ULONG)KeNumberProcessors - 1, MI_MAXIMUM_ZEROING_HELPERS);
+    for (i = 1; i <= Count; i++)
+    {
+        MiZeroingHelperPtes[i - 1] = MiReserveZeroingPtes();
+        if (!MiZeroingHelperPtes[i - 1]) break;
+
+        InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+        Status = PsCreateSystemThread(&ThreadHandle,
+                                      THREAD_ALL_ACCESS,
+                                      &ObjectAttributes,
+                                      NULL,
+                                      NULL,
+                                      MiZeroingHelperThread,
+                                      UlongToPtr(i));
+        if (!NT_SUCCESS(Status))
+        {
+            MiReleaseSystemPtes(MiZeroingHelperPtes[i - 1], MI_ZERO_PTES + 1, SystemPteSpace);
+            MiZeroingHelperPtes[i - 1] = NULL;
+            break;
+        }
+
+        ZwClose(ThreadHandle);
+    }
+
+    DPRINT("Created %lu zeroing helper threads\n", i - 1);
+}
+
 VOID
 NTAPI
 MmZeroPageThread(VOID)
@@ -38,16 +244,16 @@ MmZeroPageThread(VOID)
     PKTHREAD Thread = KeGetCurrentThread();
     PVOID StartAddress, EndAddress;
     PVOID WaitObjects[2];
-    KIRQL OldIrql;
-    PVOID ZeroAddress;
-    PFN_NUMBER PageIndex, FreePage;
-    PMMPFN Pfn1;
+    LARGE_INTEGER Timeout;
 
     /* Get the discardable sections to free them */
     MiFindInitializationCode(&StartAddress, &EndAddress);
     if (StartAddress) MiFreeInitializationCode(StartAddress, EndAddress);
     DPRINT("Free pages: %lx\n", MmAvailablePages);
 
+    /* All the processors are started now, let the others help */
+    MiCreateZeroingHelpers();
+
     /* Set our priority to 0 */
     Thread->BasePriority = 0;
     KeSetPriorityThread(Thread, 0);
@@ -56,6 +262,9 @@ MmZeroPageThread(VOID)
     WaitObjects[0] = &MmZeroingPageEvent;
 //    WaitObjects[1] = &PoSystemIdleTimer; FIXME: Implement idle timer
 
+    /* Wake up regularly to follow the fault rate */
+    Timeout.QuadPart = -MI_ZERO_SAMPLE_INTERVAL;
+
     while (TRUE)
     {
         KeWaitForMultipleObjects(1, // 2
@@ -64,47 +273,14 @@ MmZeroPageThread(VOID)
                                  WrFreePage,
                                  KernelMode,
                                  FALSE,
-                                 NULL,
+                                 &Timeout,
                                  NULL);
-        OldIrql = MiAcquirePfnLock();
+        MiUpdateZeroedPageTarget();
 
-        while (TRUE)
+        /* Zero everything that is free, one batch at a time */
+        while (MiZeroFreePages(MiFirstReservedZeroingPte, 0, &MmZeroingPageEvent))
         {
-            if (!MmFreePageListHead.Total)
-            {
-                KeClearEvent(&MmZeroingPageEvent);
-                MiReleasePfnLock(OldIrql);
-                break;
-            }
-
-            PageIndex = MmFreePageListHead.Flink;
-            ASSERT(PageIndex != LIST_HEAD);
-            Pfn1 = MiGetPfnEntry(PageIndex);
-            MI_SET_USAGE(MI_USAGE_ZERO_LOOP);
-            MI_SET_PROCESS2("Kernel 0 Loop");
-            FreePage = MiRemoveAnyPage(MI_GET_PAGE_COLOR(PageIndex));
-
-            /* The first global free page should also be the first on its own list */
-            if (FreePage != PageIndex)
-            {
-                KeBugCheckEx(PFN_LIST_CORRUPT,
-                             0x8F,
-                             FreePage,
-                             PageIndex,
-                             0);
-            }
-
-            Pfn1->u1.Flink = LIST_HEAD;
-            MiReleasePfnLock(OldIrql);
-
-            ZeroAddress = MiMapPagesInZeroSpace(Pfn1, 1);
-            ASSERT(ZeroAddress);
-            RtlZeroMemory(ZeroAddress, PAGE_SIZE);
-            MiUnmapPagesInZeroSpace(ZeroAddress, 1);
-
-            OldIrql = MiAcquirePfnLock();
-
-            MiInsertPageInList(&MmZeroedPageListHead, PageIndex);
+            MiUpdateZeroedPageTarget();
         }
     }
 }
@@ -226,6 +226,9 @@ MmInitSystem(IN ULONG Phase,
 
     MmKernelAddressSpace = &PsIdleProcess->Vm;
 
+    /* All the processors are started, spread the pool over them */
+    ExpInitializeProcessorPools();
+
     /* Intialize system memory areas */
     MiInitSystemMemoryAreas();
 
@@ -21,6 +21,78 @@ POBJECT_TYPE ObpDirectoryObjectType = NULL;
 
 /* PRIVATE FUNCTIONS ******************************************************/
 
+FORCEINLINE
+POBJECT_DIRECTORY_ENTRY*
+ObpGetDirectoryBucket(IN POBJECT_DIRECTORY Directory,
+                      IN ULONG HashValue)
+{
+    POBP_DIRECTORY_HASH_TABLE HashTable = ObpGetDirectoryHashTable(Directory);
+
+    /* The directory must be locked, the table can grow otherwise */
+    return &HashTable->Buckets[HashValue % HashTable->BucketCount];
+}
+
+/*++
+* @name ObpGrowDirectory
+*
+*     The ObpGrowDirectory routine moves the entries of a directory to a
+*     larger set of hash buckets.
+*
+* @param Directory
+*        Directory to grow. It must be locked exclusively.
+*
+* @return None.
+*
+* @remarks If the new buckets can't be allocated, the directory keeps using
+*          the current ones, only with longer chains.
+*
+*--*/
+static
+VOID
+ObpGrowDirectory(IN POBJECT_DIRECTORY Directory)
+{
+    POBP_DIRECTORY_HASH_TABLE HashTable = ObpGetDirectoryHashTable(Directory);
+    POBJECT_DIRECTORY_ENTRY *NewBuckets;
+    POBJECT_DIRECTORY_ENTRY Entry;
+    ULONG NewCount, i, NewIndex;
+
+    /* Get the new size, if we can still grow */
+    NewCount = min(HashTable->BucketCount * OBP_DIRECTORY_GROWTH + 1,
+                   OBP_MAXIMUM_DIRECTORY_BUCKETS);
+    if (NewCount <= HashTable->BucketCount) return;
+
+    /* Allocate the new buckets */
+    NewBuckets = ExAllocatePoolWithTag(PagedPool,
+                                       NewCount * sizeof(POBJECT_DIRECTORY_ENTRY),
+                                       OB_DIR_TAG);
+    if (!NewBuckets) return;
+    RtlZeroMemory(NewBuckets, NewCount * sizeof(POBJECT_DIRECTORY_ENTRY));
+
+    /* Move all the entries, using the hash we saved when inserting them */
+    for (i = 0; i < HashTable->BucketCount; i++)
+    {
+        while ((Entry = HashTable->Buckets[i]))
+        {
+            HashTable->Buckets[i] = Entry->ChainLink;
+
+            NewIndex = Entry->HashValue % NewCount;
+            Entry->ChainLink = NewBuckets[NewIndex];
+            NewBuckets[NewIndex] = Entry;
+        }
+    }
+
+    /* Free the previous buckets, unless they are the ones of the directory */
+    if (HashTable->Buckets != Directory->HashBuckets)
+    {
+        ExFreePoolWithTag(HashTable->Buckets, OB_DIR_TAG);
+    }
+
+    /* And use the new ones */
+    HashTable->Buckets = NewBuckets;
+    HashTable->BucketCount = NewCount;
+    HashTable->Resizes++;
+}
+
 /*++
 * @name ObpInsertEntryDirectory
 *
@@ -49,6 +121,7 @@ ObpInsertEntryDirectory(IN POBJECT_DIRECTORY Parent,
     POBJECT_DIRECTORY_ENTRY *AllocatedEntry;
     POBJECT_DIRECTORY_ENTRY NewEntry;
     POBJECT_HEADER_NAME_INFO HeaderNameInfo;
+    POBP_DIRECTORY_HASH_TABLE HashTable;
 
     /* Make sure we have a name */
     ASSERT(ObjectHeader->NameInfoOffset != 0);
@@ -77,12 +150,21 @@ ObpInsertEntryDirectory(IN POBJECT_DIRECTORY Parent,
     /* Get the Object Name Information */
     HeaderNameInfo = OBJECT_HEADER_TO_NAME_INFO(ObjectHeader);
 
+    /* Grow the hash table if the chains are getting too long */
+    HashTable = ObpGetDirectoryHashTable(Parent);
+    if (HashTable->EntryCount >= HashTable->BucketCount * OBP_DIRECTORY_LOAD_FACTOR)
+    {
+        ObpGrowDirectory(Parent);
+    }
+
     /* Get the Allocated entry */
-    AllocatedEntry = &Parent->HashBuckets[Context->HashIndex];
+    AllocatedEntry = ObpGetDirectoryBucket(Parent, Context->HashValue);
+    Context->HashIndex = (USHORT)(AllocatedEntry - HashTable->Buckets);
 
     /* Set it */
     NewEntry->ChainLink = *AllocatedEntry;
     *AllocatedEntry = NewEntry;
+    HashTable->EntryCount++;
 
     /* Associate the Object */
     NewEntry->Object = &ObjectHeader->Body;
@@ -171,6 +253,8 @@ ObpLookupEntryDirectory(IN POBJECT_DIRECTORY Directory,
     POBJECT_DIRECTORY_ENTRY *AllocatedEntry;
     POBJECT_DIRECTORY_ENTRY *LookupBucket;
     POBJECT_DIRECTORY_ENTRY CurrentEntry;
+    POBP_DIRECTORY_HASH_TABLE HashTable;
+    ULONG ChainSteps;
     PVOID FoundObject = NULL;
     PWSTR Buffer;
     POBJECT_DIRECTORY ShadowDirectory;
@@ -207,18 +291,10 @@ ObpLookupEntryDirectory(IN POBJECT_DIRECTORY Directory,
         else HashValue += (CurrentChar - ('a'-'A'));
     }
 
-    /* Merge it with our number of hash buckets */
-    HashIndex = HashValue % 37;
-
     /* Save the result */
     Context->HashValue = HashValue;
-    Context->HashIndex = (USHORT)HashIndex;
 
 DoItAgain:
-    /* Get the root entry and set it as our lookup bucket */
-    AllocatedEntry = &Directory->HashBuckets[HashIndex];
-    LookupBucket = AllocatedEntry;
-
     /* Check if the directory is already locked */
     if (!Context->DirectoryLocked)
     {
@@ -226,9 +302,20 @@ DoItAgain:
         ObpAcquireDirectoryLockShared(Directory, Context);
     }
 
+    /* Merge the hash with the number of hash buckets, now that it can't change */
+    HashTable = ObpGetDirectoryHashTable(Directory);
+    HashIndex = HashValue % HashTable->BucketCount;
+
+    /* Get the root entry and set it as our lookup bucket */
+    AllocatedEntry = &HashTable->Buckets[HashIndex];
+    LookupBucket = AllocatedEntry;
+
     /* Start looping */
+    ChainSteps = 0;
     while ((CurrentEntry = *AllocatedEntry))
     {
+        ChainSteps++;
+
         /* Do the hashes match? */
         if (CurrentEntry->HashValue == HashValue)
         {
@@ -251,6 +338,10 @@ DoItAgain:
         AllocatedEntry = &CurrentEntry->ChainLink;
     }
 
+    /* Update the lookup statistics */
+    InterlockedIncrement((PLONG)&HashTable->Lookups);
+    InterlockedExchangeAdd((PLONG)&HashTable->ChainSteps, ChainSteps);
+
     /* Check if we still have an entry */
     if (CurrentEntry)
     {
@@ -359,13 +450,14 @@ ObpDeleteEntryDirectory(POBP_LOOKUP_CONTEXT Context)
     Directory = Context->Directory;
     if (!Directory) return FALSE;
 
-    /* Get the Entry */
-    AllocatedEntry = &Directory->HashBuckets[Context->HashIndex];
+    /* Get the Entry, the lookup moved it to the head of its bucket */
+    AllocatedEntry = ObpGetDirectoryBucket(Directory, Context->HashValue);
     CurrentEntry = *AllocatedEntry;
 
     /* Unlink the Entry */
     *AllocatedEntry = CurrentEntry->ChainLink;
     CurrentEntry->ChainLink = NULL;
+    ObpGetDirectoryHashTable(Directory)->EntryCount--;
 
     /* Free it */
     ExFreePoolWithTag(CurrentEntry, OB_DIR_TAG);
@@ -374,6 +466,81 @@ ObpDeleteEntryDirectory(POBP_LOOKUP_CONTEXT Context)
     return TRUE;
 }
 
+/*++
+* @name ObpDeleteDirectory
+*
+*     The ObpDeleteDirectory routine is the delete procedure of directory
+*     objects.
+*
+* @param ObjectBody
+*        Directory being deleted.
+*
+* @return None.
+*
+* @remarks None.
+*
+*--*/
+VOID
+NTAPI
+ObpDeleteDirectory(IN PVOID ObjectBody)
+{
+    POBJECT_DIRECTORY Directory = ObjectBody;
+    POBP_DIRECTORY_HASH_TABLE HashTable = ObpGetDirectoryHashTable(Directory);
+
+    /* Free the hash buckets if the directory had grown */
+    if (HashTable->Buckets != Directory->HashBuckets)
+    {
+        ExFreePoolWithTag(HashTable->Buckets, OB_DIR_TAG);
+    }
+}
+
+/*++
+* @name ObpQueryDirectoryStatistics
+*
+*     The ObpQueryDirectoryStatistics routine returns the size of the hash
+*     table of a directory, how its entries are spread and how much lookups
+*     cost so far.
+*
+* @param Directory
+*        Directory to query.
+*
+* @param Statistics
+*        Receives the statistics.
+*
+* @return None.
+*
+* @remarks The directory must be locked, or the system frozen by the kernel
+*          debugger.
+*
+*--*/
+VOID
+NTAPI
+ObpQueryDirectoryStatistics(IN POBJECT_DIRECTORY Directory,
+                            OUT POBP_DIRECTORY_STATISTICS Statistics)
+{
+    POBP_DIRECTORY_HASH_TABLE HashTable = ObpGetDirectoryHashTable(Directory);
+    POBJECT_DIRECTORY_ENTRY Entry;
+    ULONG i, Length;
+
+    Statistics->BucketCount = HashTable->BucketCount;
+    Statistics->EntryCount = HashTable->EntryCount;
+    Statistics->Lookups = HashTable->Lookups;
+    Statistics->ChainSteps = HashTable->ChainSteps;
+    Statistics->Resizes = HashTable->Resizes;
+    Statistics->UsedBuckets = 0;
+    Statistics->LongestChain = 0;
+
+    /* Measure the chains */
+    for (i = 0; i < HashTable->BucketCount; i++)
+    {
+        Length = 0;
+        for (Entry = HashTable->Buckets[i]; Entry; Entry = Entry->ChainLink) Length++;
+
+        if (Length) Statistics->UsedBuckets++;
+        Statistics->LongestChain = max(Statistics->LongestChain, Length);
+    }
+}
+
 /* FUNCTIONS **************************************************************/
 
 /*++
@@ -512,6 +679,7 @@ NtQueryDirectoryObject(IN HANDLE DirectoryHandle,
     ULONG Length, TotalLength;
     ULONG Count, CurrentEntry;
     ULONG Hash;
+    POBP_DIRECTORY_HASH_TABLE HashTable;
     POBJECT_DIRECTORY_ENTRY Entry;
     POBJECT_HEADER ObjectHeader;
     POBJECT_HEADER_NAME_INFO ObjectNameInfo;
@@ -586,10 +754,11 @@ NtQueryDirectoryObject(IN HANDLE DirectoryHandle,
 
     /* Set default status and start looping */
     Status = STATUS_NO_MORE_ENTRIES;
-    for (Hash = 0; Hash < 37; Hash++)
+    HashTable = ObpGetDirectoryHashTable(Directory);
+    for (Hash = 0; Hash < HashTable->BucketCount; Hash++)
     {
         /* Get this entry and loop all of them */
-        Entry = Directory->HashBuckets[Hash];
+        Entry = HashTable->Buckets[Hash];
         while (Entry)
         {
             /* Check if we should process this entry */
@@ -802,16 +971,18 @@ NtCreateDirectoryObject(OUT PHANDLE DirectoryHandle,
                             ObjectAttributes,
                             PreviousMode,
                             NULL,
-                            sizeof(OBJECT_DIRECTORY),
+                            sizeof(OBP_DIRECTORY),
                             0,
                             0,
                             (PVOID*)&Directory);
     if (!NT_SUCCESS(Status)) return Status;
 
-    /* Setup the object */
-    RtlZeroMemory(Directory, sizeof(OBJECT_DIRECTORY));
+    /* Setup the object, it starts with its own hash buckets */
+    RtlZeroMemory(Directory, sizeof(OBP_DIRECTORY));
     ExInitializePushLock(&Directory->Lock);
     Directory->SessionId = -1;
+    ObpGetDirectoryHashTable(Directory)->Buckets = Directory->HashBuckets;
+    ObpGetDirectoryHashTable(Directory)->BucketCount = NUMBER_HASH_BUCKETS;
 
     /* Insert it into the handle table */
     Status = ObInsertObject((PVOID)Directory,
@@ -838,4 +1009,79 @@ NtCreateDirectoryObject(OUT PHANDLE DirectoryHandle,
     return Status;
 }
 
+#if DBG && defined(KDBG)
+static
+VOID
+ObpKdbgDumpDirectoryStatistics(IN POBJECT_DIRECTORY Directory,
+                               IN ULONG Depth)
+{
+    OBP_DIRECTORY_STATISTICS Statistics;
+    POBP_DIRECTORY_HASH_TABLE HashTable;
+    POBJECT_HEADER_NAME_INFO NameInfo;
+    POBJECT_DIRECTORY_ENTRY Entry;
+    POBJECT_HEADER ObjectHeader;
+    ULONG i;
+
+    ObpQueryDirectoryStatistics(Directory, &Statistics);
+    NameInfo = OBJECT_HEADER_TO_NAME_INFO(OBJECT_TO_OBJECT_HEADER(Directory));
+
+    KdbpPrint("%p %-32wZ %6lu %6lu %6lu %4lu %8lu %5lu.%02lu %3lu\n",
+              Directory,
+              NameInfo ? &NameInfo->Name : NULL,
+              Statistics.EntryCount,
+              Statistics.BucketCount,
+              Statistics.UsedBuckets,
+              Statistics.LongestChain,
+              Statistics.Lookups,
+              Statistics.Lookups ? Statistics.ChainSteps / Statistics.Lookups : 0,
+              Statistics.Lookups ? (Statistics.ChainSteps * 100 / Statistics.Lookups) % 100 : 0,
+              Statistics.Resizes);
+
+    /* Don't go too deep, the namespace is not supposed to have loops though */
+    if (Depth == 0) return;
+
+    /* Dump the child directories */
+    HashTable = ObpGetDirectoryHashTable(Directory);
+    for (i = 0; i < HashTable->BucketCount; i++)
+    {
+        for (Entry = HashTable->Buckets[i]; Entry; Entry = Entry->ChainLink)
+        {
+            ObjectHeader = OBJECT_TO_OBJECT_HEADER(Entry->Object);
+            if (ObjectHeader->Type == ObpDirectoryObjectType)
+            {
+                ObpKdbgDumpDirectoryStatistics(Entry->Object, Depth - 1);
+            }
+        }
+    }
+}
+
+BOOLEAN ExpKdbgExtDirStats(ULONG Argc, PCHAR Argv[])
+{
+    POBJECT_DIRECTORY Directory;
+    ULONG Depth = 8;
+
+    if (Argc > 1)
+    {
+        /* Only dump the given directory */
+        if (!KdbpGetHexNumber(Argv[1], (PVOID)&Directory))
+        {
+            KdbpPrint("Invalid parameter: %s\n", Argv[1]);
+            return TRUE;
+        }
+
+        Depth = 0;
+    }
+    else
+    {
+        /* Dump the whole namespace */
+        Directory = ObpRootDirectoryObject;
+    }
+
+    KdbpPrint("Directory Name                              Entries Buckets  Used Chain  Lookups Steps Resizes\n");
+    ObpKdbgDumpDirectoryStatistics(Directory, Depth);
+
+    return TRUE;
+}
+#endif // DBG && KDBG
+
 /* EOF */
@@ -97,6 +97,13 @@ RtlpGetMode(VOID)
    return KernelMode;
 }
 
+ULONG
+NTAPI
+RtlpGetHeapAffinity(VOID)
+{
+    return KeGetCurrentProcessorNumber();
+}
+
 PVOID
 NTAPI
 RtlpAllocateMemory(ULONG Bytes,
@@ -313,6 +313,12 @@ typedef enum _SYSTEM_INFORMATION_CLASS
     SystemPrefetchPathInformation,
     SystemVerifierFaultsInformation,
     MaxSystemInfoClass,
+
+    //
+    // ReactOS specific classes, numbered far above the ones of Windows so
+    // that no Windows caller can reach them
+    //
+    SystemSchedulerStatisticsInformation = 0x10000,
 } SYSTEM_INFORMATION_CLASS;
 
 //
@@ -1532,6 +1538,27 @@ typedef struct _SYSTEM_MEMORY_LIST_INFORMATION
     SIZE_T ModifiedPageCountPageFile;
 } SYSTEM_MEMORY_LIST_INFORMATION, *PSYSTEM_MEMORY_LIST_INFORMATION;
 
+//
+// Class 0x10000 (ReactOS specific)
+//
+// Ready latencies are in clock ticks: bucket 0 counts the threads which ran
+// in the tick they became ready, bucket n those which waited from 2^(n-1) to
+// 2^n - 1 ticks. The last bucket also counts all the longer latencies.
+// Dispatches are counted by the processor running the thread, the idle CPU
+// lookups and preemptions by the processor readying it.
+//
+#define SCHEDULER_READY_LATENCY_BUCKETS 16
+
+typedef struct _SYSTEM_SCHEDULER_STATISTICS_INFORMATION
+{
+    ULONG ReadyLatency[SCHEDULER_READY_LATENCY_BUCKETS];
+    ULONG MaximumReadyLatency;
+    ULONG Dispatches;
+    ULONG Preemptions;
+    ULONG IdleScans;
+    ULONG IdleScanMisses;
+} SYSTEM_SCHEDULER_STATISTICS_INFORMATION, *PSYSTEM_SCHEDULER_STATISTICS_INFORMATION;
+
 #ifdef __cplusplus
 }; // extern "C"
 #endif
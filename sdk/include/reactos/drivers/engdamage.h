@@ -0,0 +1,54 @@
+/*
+ * PROJECT:         ReactOS win32 subsystem
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            include/reactos/drivers/engdamage.h
+ * PURPOSE:         Damage tracking of the display surface, for framebuffer
+ *                  and remote display drivers
+ */
+#ifndef _ENGDAMAGE_H_
+#define _ENGDAMAGE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Once EngEnableDamage(hdev, TRUE) was called, GDI records the areas of the
+ * primary surface of hdev that its drawing operations write to. The driver
+ * collects them with EngQueryDamage, typically when it is about to transfer
+ * the surface, instead of comparing or sending whole frames.
+ *
+ * The rectangles are clipped to the surface, neighbouring ones are merged
+ * when that adds little area, and there are at most DAMAGE_MAX_RECTS of them.
+ * When more would be needed, GDI falls back to their bounding rectangle.
+ */
+#define DAMAGE_MAX_RECTS    16
+
+/* EngQueryDamage flags */
+#define QDAMAGE_RESET       0x00000001 /* Forget the damage that was returned */
+
+BOOL
+APIENTRY
+EngEnableDamage(
+    _In_ HDEV hdev,
+    _In_ BOOL bEnable);
+
+/*
+ * Returns the number of damage rectangles, or DDI_ERROR when damage tracking
+ * is not enabled for hdev. When prcl is given and cRects is large enough, the
+ * rectangles are copied to it; when cRects is smaller, only their bounding
+ * rectangle is, and 1 is returned.
+ */
+ULONG
+APIENTRY
+EngQueryDamage(
+    _In_ HDEV hdev,
+    _In_ ULONG cRects,
+    _Out_writes_opt_(cRects) PRECTL prcl,
+    _In_ FLONG fl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ENGDAMAGE_H_ */
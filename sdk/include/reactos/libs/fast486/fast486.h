@@ -116,6 +116,27 @@
 C_ASSERT((FAST486_CACHE_SIZE >= sizeof(ULONG))
          && (FAST486_CACHE_SIZE <= FAST486_PAGE_SIZE));
 
+#define FAST486_BLOCK_CACHE_ENTRIES     1024
+#define FAST486_BLOCK_MAX_INSTRUCTIONS  16
+#define FAST486_BLOCK_MAX_SIZE          64
+#define FAST486_BLOCK_CHUNK_SHIFT       7
+#define FAST486_BLOCK_CHUNKS            0x20000
+
+/*
+ * The block cache is direct-mapped, so the number of entries must be a power
+ * of two. A block never spans more than two write-tracking chunks, and the
+ * chunks cover the first 16 MB of physical memory.
+ */
+C_ASSERT((FAST486_BLOCK_CACHE_ENTRIES & (FAST486_BLOCK_CACHE_ENTRIES - 1)) == 0);
+C_ASSERT((FAST486_BLOCK_MAX_SIZE <= (1 << FAST486_BLOCK_CHUNK_SHIFT))
+         && (FAST486_BLOCK_MAX_SIZE <= FAST486_PAGE_SIZE));
+
+#define FAST486_MAX_RAM_RANGES          8
+#define FAST486_HOST_TLB_ENTRIES        256
+
+/* The host TLB is direct-mapped too */
+C_ASSERT((FAST486_HOST_TLB_ENTRIES & (FAST486_HOST_TLB_ENTRIES - 1)) == 0);
+
 struct _FAST486_STATE;
 typedef struct _FAST486_STATE FAST486_STATE, *PFAST486_STATE;
 
@@ -511,6 +532,60 @@ typedef union _FAST486_FPU_CONTROL_REG
     };
 } FAST486_FPU_CONTROL_REG, *PFAST486_FPU_CONTROL_REG;
 
+typedef struct _FAST486_BLOCK_INSTRUCTION
+{
+    PVOID Handler;
+    ULONG PrefixFlags;
+    UCHAR Start;
+    UCHAR OpcodeOffset;
+    UCHAR Opcode;
+    UCHAR SegmentOverride;
+} FAST486_BLOCK_INSTRUCTION, *PFAST486_BLOCK_INSTRUCTION;
+
+typedef struct _FAST486_BLOCK
+{
+    ULONG Address;
+    ULONG PhysicalAddress;
+    ULONG PageDirectory;
+    ULONG Generation;
+    ULONG Versions[2];
+    UCHAR Cpl;
+    BOOLEAN Paging;
+    UCHAR Size;
+    UCHAR InstructionCount;
+    FAST486_BLOCK_INSTRUCTION Instructions[FAST486_BLOCK_MAX_INSTRUCTIONS];
+    UCHAR Code[FAST486_BLOCK_MAX_SIZE];
+} FAST486_BLOCK, *PFAST486_BLOCK;
+
+typedef struct _FAST486_BLOCK_CACHE
+{
+    ULONG Generation;
+    ULONG Hits;
+    ULONG Misses;
+    ULONG Versions[FAST486_BLOCK_CHUNKS];
+    FAST486_BLOCK Blocks[FAST486_BLOCK_CACHE_ENTRIES];
+} FAST486_BLOCK_CACHE, *PFAST486_BLOCK_CACHE;
+
+/*
+ * A range of guest physical memory that is plain RAM, backed by a host buffer.
+ * Accesses to it don't go through the memory callbacks, so it must not contain
+ * anything the embedder needs to be notified about (MMIO, video memory...).
+ */
+typedef struct _FAST486_RAM_RANGE
+{
+    ULONG Address;
+    ULONG Size;
+    PUCHAR HostAddress;
+} FAST486_RAM_RANGE, *PFAST486_RAM_RANGE;
+
+typedef struct _FAST486_HOST_TLB_ENTRY
+{
+    ULONG ReadTag;
+    ULONG WriteTag;
+    ULONG PhysicalPage;
+    PUCHAR HostPage;
+} FAST486_HOST_TLB_ENTRY, *PFAST486_HOST_TLB_ENTRY;
+
 struct _FAST486_STATE
 {
     FAST486_MEM_READ_PROC MemReadCallback;
@@ -539,6 +614,14 @@ struct _FAST486_STATE
     BOOLEAN DoNotInterrupt;
     PULONG Tlb;
     BOOLEAN TlbEmpty;
+    PFAST486_BLOCK_CACHE BlockCache;
+    PFAST486_BLOCK CurrentBlock;
+    ULONG BlockIndex;
+    BOOLEAN BlockRecording;
+    BOOLEAN BlockFetch;
+    ULONG RamRangeCount;
+    FAST486_RAM_RANGE RamRanges[FAST486_MAX_RAM_RANGES];
+    FAST486_HOST_TLB_ENTRY HostTlb[FAST486_HOST_TLB_ENTRIES];
 #ifndef FAST486_NO_PREFETCH
     BOOLEAN PrefetchValid;
     ULONG PrefetchAddress;
@@ -619,6 +702,22 @@ VOID
 NTAPI
 Fast486Rewind(PFAST486_STATE State);
 
+VOID
+NTAPI
+Fast486SetBlockCache(PFAST486_STATE State, PFAST486_BLOCK_CACHE BlockCache);
+
+VOID
+NTAPI
+Fast486InvalidateBlockCache(PFAST486_STATE State, ULONG Address, ULONG Size);
+
+BOOLEAN
+NTAPI
+Fast486RegisterRam(PFAST486_STATE State, ULONG Address, ULONG Size, PVOID HostAddress);
+
+VOID
+NTAPI
+Fast486UnregisterRam(PFAST486_STATE State, ULONG Address);
+
 #endif // _FAST486_H_
 
 /* EOF */
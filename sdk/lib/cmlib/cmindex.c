@@ -24,6 +24,10 @@
     ((HBLOCK_SIZE - (sizeof(HBIN) + sizeof(HCELL) +     \
                      FIELD_OFFSET(CM_KEY_INDEX, List))) / sizeof(HCELL_INDEX) - 1)
 
+#define CM_SUBKEY_INDEX_END             0xFFFFFFFF
+#define CM_SUBKEY_INDEX_MIN_SUBKEYS     16
+#define CM_SUBKEY_INDEX_INITIAL_SIZE    256
+
 /* FUNCTIONS *****************************************************************/
 
 LONG
@@ -678,6 +682,349 @@ CmpFindSubKeyByHash(IN PHHIVE Hive,
     return HCELL_NIL;
 }
 
+static
+ULONG
+CmpSubKeyIndexBucket(IN PCM_SUBKEY_INDEX Index,
+                     IN PCM_KEY_NODE Parent,
+                     IN ULONG HashKey)
+{
+    ULONG Hash;
+
+    /* Mix the address of the parent with the hash of the name */
+    Hash = ((ULONG)((ULONG_PTR)Parent >> 2) ^ HashKey) * 0x9E3779B1;
+    return (Hash ^ (Hash >> 16)) & (Index->BucketCount - 1);
+}
+
+static
+VOID
+CmpFlushSubKeyIndex(IN PCM_SUBKEY_INDEX Index)
+{
+    ULONG i;
+
+    /* Empty all the buckets */
+    for (i = 0; i < Index->BucketCount; i++)
+    {
+        Index->Buckets[i] = CM_SUBKEY_INDEX_END;
+    }
+
+    /* And put every entry back on the free list */
+    for (i = 0; i < Index->EntryCount; i++)
+    {
+        Index->Entries[i].Next = i + 1;
+    }
+    Index->Entries[Index->EntryCount - 1].Next = CM_SUBKEY_INDEX_END;
+
+    Index->FreeEntry = 0;
+    Index->UsedCount = 0;
+}
+
+static
+BOOLEAN
+CmpGrowSubKeyIndex(IN PHHIVE Hive,
+                   IN PCM_SUBKEY_INDEX Index)
+{
+    PULONG Buckets;
+    PCM_SUBKEY_INDEX_ENTRY Entries;
+    ULONG OldCount = Index->EntryCount, NewCount, Bucket, i;
+
+    /* We only grow once every entry is in use */
+    ASSERT(Index->UsedCount == OldCount);
+
+    /* Double the size of the index, without overflowing */
+    if (OldCount >= (MAXULONG / 2 / sizeof(CM_SUBKEY_INDEX_ENTRY))) return FALSE;
+    NewCount = OldCount * 2;
+
+    /* Allocate the new tables */
+    Buckets = Hive->Allocate(NewCount * sizeof(ULONG), TRUE, TAG_CM);
+    Entries = Hive->Allocate(NewCount * sizeof(CM_SUBKEY_INDEX_ENTRY), TRUE, TAG_CM);
+    if (!Buckets || !Entries)
+    {
+        /* Keep using the old ones */
+        if (Buckets) Hive->Free(Buckets, 0);
+        if (Entries) Hive->Free(Entries, 0);
+        return FALSE;
+    }
+
+    /* Copy the entries and free the old tables */
+    RtlCopyMemory(Entries, Index->Entries, OldCount * sizeof(CM_SUBKEY_INDEX_ENTRY));
+    Hive->Free(Index->Buckets, 0);
+    Hive->Free(Index->Entries, 0);
+
+    Index->Buckets = Buckets;
+    Index->Entries = Entries;
+    Index->BucketCount = NewCount;
+    Index->EntryCount = NewCount;
+
+    /* Rehash the existing entries */
+    for (i = 0; i < NewCount; i++) Buckets[i] = CM_SUBKEY_INDEX_END;
+    for (i = 0; i < OldCount; i++)
+    {
+        Bucket = CmpSubKeyIndexBucket(Index, Entries[i].Parent, Entries[i].HashKey);
+        Entries[i].Next = Buckets[Bucket];
+        Buckets[Bucket] = i;
+    }
+
+    /* The new entries are all free */
+    for (i = OldCount; i < NewCount; i++) Entries[i].Next = i + 1;
+    Entries[NewCount - 1].Next = CM_SUBKEY_INDEX_END;
+    Index->FreeEntry = OldCount;
+    return TRUE;
+}
+
+static
+PULONG
+CmpFindSubKeyIndexLink(IN PCM_SUBKEY_INDEX Index,
+                       IN PCM_KEY_NODE Parent,
+                       IN ULONG HashKey,
+                       IN HCELL_INDEX Cell)
+{
+    PULONG Link;
+    PCM_SUBKEY_INDEX_ENTRY Entry;
+
+    /* Return the link pointing to the entry, so that it can be unlinked */
+    Link = &Index->Buckets[CmpSubKeyIndexBucket(Index, Parent, HashKey)];
+    while (*Link != CM_SUBKEY_INDEX_END)
+    {
+        Entry = &Index->Entries[*Link];
+        if ((Entry->Parent == Parent) &&
+            (Entry->HashKey == HashKey) &&
+            (Entry->Cell == Cell))
+        {
+            return Link;
+        }
+
+        Link = &Entry->Next;
+    }
+
+    return NULL;
+}
+
+static
+BOOLEAN
+CmpInsertSubKeyIndex(IN PHHIVE Hive,
+                     IN PCM_KEY_NODE Parent,
+                     IN ULONG HashKey,
+                     IN HCELL_INDEX Cell)
+{
+    PCM_SUBKEY_INDEX Index = Hive->SubKeyIndex;
+    PCM_SUBKEY_INDEX_ENTRY Entry;
+    ULONG EntryIndex, Bucket;
+
+    /* Make room for the entry if needed */
+    if ((Index->FreeEntry == CM_SUBKEY_INDEX_END) &&
+        !CmpGrowSubKeyIndex(Hive, Index))
+    {
+        return FALSE;
+    }
+
+    /* Take a free entry */
+    EntryIndex = Index->FreeEntry;
+    Entry = &Index->Entries[EntryIndex];
+    Index->FreeEntry = Entry->Next;
+
+    /* Fill it and link it in its bucket */
+    Entry->Parent = Parent;
+    Entry->Cell = Cell;
+    Entry->HashKey = HashKey;
+    Bucket = CmpSubKeyIndexBucket(Index, Parent, HashKey);
+    Entry->Next = Index->Buckets[Bucket];
+    Index->Buckets[Bucket] = EntryIndex;
+    Index->UsedCount++;
+    return TRUE;
+}
+
+static
+VOID
+CmpDeleteSubKeyIndex(IN PCM_SUBKEY_INDEX Index,
+                     IN PCM_KEY_NODE Parent,
+                     IN ULONG HashKey,
+                     IN HCELL_INDEX Cell)
+{
+    PULONG Link;
+    ULONG EntryIndex;
+
+    /* Find the entry */
+    Link = CmpFindSubKeyIndexLink(Index, Parent, HashKey, Cell);
+    if (!Link) return;
+
+    /* Unlink it and put it back on the free list */
+    EntryIndex = *Link;
+    *Link = Index->Entries[EntryIndex].Next;
+    Index->Entries[EntryIndex].Next = Index->FreeEntry;
+    Index->FreeEntry = EntryIndex;
+    Index->UsedCount--;
+}
+
+static
+BOOLEAN
+CmpComputeKeyNodeHashKey(IN PHHIVE Hive,
+                         IN HCELL_INDEX Cell,
+                         OUT PULONG HashKey)
+{
+    PCM_KEY_NODE Node;
+    UNICODE_STRING Name;
+    WCHAR Char;
+    ULONG i;
+
+    /* Get the node */
+    Node = (PCM_KEY_NODE)HvGetCell(Hive, Cell);
+    if (!Node) return FALSE;
+
+    /* Check if it's compressed */
+    if (Node->Flags & KEY_COMP_NAME)
+    {
+        /* Hash it one character at a time, as if it was expanded */
+        Name.Buffer = &Char;
+        Name.Length = sizeof(WCHAR);
+        Name.MaximumLength = sizeof(WCHAR);
+
+        *HashKey = 0;
+        for (i = 0; i < Node->NameLength; i++)
+        {
+            Char = (WCHAR)((PUCHAR)Node->Name)[i];
+            *HashKey = CmpComputeHashKey(*HashKey, &Name, TRUE);
+        }
+    }
+    else
+    {
+        /* Hash the Unicode name directly */
+        Name.Buffer = Node->Name;
+        Name.Length = Node->NameLength;
+        Name.MaximumLength = Name.Length;
+        *HashKey = CmpComputeHashKey(0, &Name, FALSE);
+    }
+
+    /* Release the cell */
+    HvReleaseCell(Hive, Cell);
+    return TRUE;
+}
+
+static
+BOOLEAN
+CmpIndexSubKeyList(IN PHHIVE Hive,
+                   IN PCM_KEY_NODE Parent,
+                   IN HCELL_INDEX ListCell)
+{
+    PCM_KEY_INDEX Index;
+    PCM_KEY_FAST_INDEX FastIndex;
+    HCELL_INDEX Cell;
+    ULONG HashKey, i;
+    BOOLEAN Result = TRUE;
+
+    /* Get the index */
+    Index = (PCM_KEY_INDEX)HvGetCell(Hive, ListCell);
+    if (!Index) return FALSE;
+    FastIndex = (PCM_KEY_FAST_INDEX)Index;
+
+    for (i = 0; Result && (i < Index->Count); i++)
+    {
+        /* Check if this is a root */
+        if (Index->Signature == CM_KEY_INDEX_ROOT)
+        {
+            /* Index all the leaves in it */
+            Result = CmpIndexSubKeyList(Hive, Parent, Index->List[i]);
+            continue;
+        }
+
+        /* Check what kind of leaf this is */
+        if (Index->Signature == CM_KEY_HASH_LEAF)
+        {
+            /* Hash leaves already have the hash of the name */
+            Cell = FastIndex->List[i].Cell;
+            HashKey = FastIndex->List[i].HashKey;
+        }
+        else
+        {
+            /* Otherwise, compute it from the key node */
+            if (Index->Signature == CM_KEY_FAST_LEAF)
+                Cell = FastIndex->List[i].Cell;
+            else
+                Cell = Index->List[i];
+
+            Result = CmpComputeKeyNodeHashKey(Hive, Cell, &HashKey);
+            if (!Result) break;
+        }
+
+        /* Add the subkey to the index */
+        Result = CmpInsertSubKeyIndex(Hive, Parent, HashKey, Cell);
+    }
+
+    /* Release the index */
+    HvReleaseCell(Hive, ListCell);
+    return Result;
+}
+
+static
+BOOLEAN
+CmpBuildSubKeyIndex(IN PHHIVE Hive,
+                    IN PCM_KEY_NODE Parent)
+{
+    ULONG i;
+
+    /* Index the subkeys of every storage type */
+    for (i = 0; i < Hive->StorageTypeCount; i++)
+    {
+        if (!Parent->SubKeyCounts[i]) continue;
+        if (!CmpIndexSubKeyList(Hive, Parent, Parent->SubKeyLists[i])) goto Failure;
+    }
+
+    /* Now mark the parent as indexed */
+    if (CmpInsertSubKeyIndex(Hive, Parent, 0, HCELL_NIL)) return TRUE;
+
+Failure:
+    /* Don't leave a partially indexed parent behind */
+    DPRINT1("Failed to index the subkeys of %p, flushing the index\n", Parent);
+    CmpFlushSubKeyIndex(Hive->SubKeyIndex);
+    return FALSE;
+}
+
+static
+BOOLEAN
+CmpFindSubKeyInIndex(IN PHHIVE Hive,
+                     IN PCM_KEY_NODE Parent,
+                     IN PCUNICODE_STRING SearchName,
+                     OUT PHCELL_INDEX SubKey)
+{
+    PCM_SUBKEY_INDEX Index = Hive->SubKeyIndex;
+    PCM_SUBKEY_INDEX_ENTRY Entry;
+    ULONG HashKey, EntryIndex, Count = 0, i;
+
+    /* Small subkey lists are quick enough to search directly */
+    for (i = 0; i < Hive->StorageTypeCount; i++) Count += Parent->SubKeyCounts[i];
+    if (Count < CM_SUBKEY_INDEX_MIN_SUBKEYS) return FALSE;
+
+    /* Index the parent the first time it's used */
+    if (!CmpFindSubKeyIndexLink(Index, Parent, 0, HCELL_NIL) &&
+        !CmpBuildSubKeyIndex(Hive, Parent))
+    {
+        return FALSE;
+    }
+
+    /* Compute the hash key for the name and look it up */
+    HashKey = CmpComputeHashKey(0, SearchName, FALSE);
+    EntryIndex = Index->Buckets[CmpSubKeyIndexBucket(Index, Parent, HashKey)];
+    while (EntryIndex != CM_SUBKEY_INDEX_END)
+    {
+        Entry = &Index->Entries[EntryIndex];
+
+        /* Compare the hash first, then the full name */
+        if ((Entry->Parent == Parent) &&
+            (Entry->HashKey == HashKey) &&
+            (Entry->Cell != HCELL_NIL) &&
+            !(CmpDoCompareKeyName(Hive, SearchName, Entry->Cell)))
+        {
+            *SubKey = Entry->Cell;
+            return TRUE;
+        }
+
+        EntryIndex = Entry->Next;
+    }
+
+    /* All the subkeys are indexed, so it doesn't exist */
+    *SubKey = HCELL_NIL;
+    return TRUE;
+}
+
 HCELL_INDEX
 NTAPI
 CmpFindSubKeyByName(IN PHHIVE Hive,
@@ -689,6 +1036,13 @@ CmpFindSubKeyByName(IN PHHIVE Hive,
     HCELL_INDEX SubKey, CellToRelease;
     ULONG Found;
 
+    /* Use the subkey index if this hive has one */
+    if ((Hive->SubKeyIndex) &&
+        (CmpFindSubKeyInIndex(Hive, Parent, SearchName, &SubKey)))
+    {
+        return SubKey;
+    }
+
     /* Loop each storage type */
     for (i = 0; i < Hive->StorageTypeCount; i++)
     {
@@ -1669,6 +2023,18 @@ CmpAddSubKey(IN PHHIVE Hive,
     /* Update the key counts */
     KeyNode->SubKeyCounts[Type]++;
 
+    /* Keep the subkey index up to date if the parent is indexed */
+    if ((Hive->SubKeyIndex) &&
+        (CmpFindSubKeyIndexLink(Hive->SubKeyIndex, KeyNode, 0, HCELL_NIL)) &&
+        !(CmpInsertSubKeyIndex(Hive,
+                               KeyNode,
+                               CmpComputeHashKey(0, &Name, FALSE),
+                               Child)))
+    {
+        /* The parent would be missing a subkey, so drop the whole index */
+        CmpFlushSubKeyIndex(Hive->SubKeyIndex);
+    }
+
     /* Check if caller wants us to return the leaf */
     if (RootPointer)
     {
@@ -1860,6 +2226,15 @@ CmpRemoveSubKey(IN PHHIVE Hive,
         }
     }
 
+    /* Remove the subkey from the index too */
+    if (Hive->SubKeyIndex)
+    {
+        CmpDeleteSubKeyIndex(Hive->SubKeyIndex,
+                             Node,
+                             CmpComputeHashKey(0, &SearchName, FALSE),
+                             TargetKey);
+    }
+
     /* If we got here, now we're done */
     Result = TRUE;
 
@@ -1878,3 +2253,65 @@ Exit:
     /* Return the result */
     return Result;
 }
+
+BOOLEAN
+NTAPI
+CmpInitializeSubKeyIndex(IN PHHIVE Hive)
+{
+    PCM_SUBKEY_INDEX Index;
+
+    /* Nothing to do if the hive already has an index */
+    if (Hive->SubKeyIndex) return TRUE;
+
+    /* Allocate the index and its tables */
+    Index = Hive->Allocate(sizeof(CM_SUBKEY_INDEX), TRUE, TAG_CM);
+    if (!Index) return FALSE;
+
+    Index->BucketCount = CM_SUBKEY_INDEX_INITIAL_SIZE;
+    Index->EntryCount = CM_SUBKEY_INDEX_INITIAL_SIZE;
+    Index->Buckets = Hive->Allocate(Index->BucketCount * sizeof(ULONG), TRUE, TAG_CM);
+    Index->Entries = Hive->Allocate(Index->EntryCount * sizeof(CM_SUBKEY_INDEX_ENTRY),
+                                    TRUE,
+                                    TAG_CM);
+    if (!Index->Buckets || !Index->Entries)
+    {
+        /* Free what we got and fail */
+        if (Index->Buckets) Hive->Free(Index->Buckets, 0);
+        if (Index->Entries) Hive->Free(Index->Entries, 0);
+        Hive->Free(Index, 0);
+        return FALSE;
+    }
+
+    /* Start empty, parents are indexed when they are first looked up */
+    CmpFlushSubKeyIndex(Index);
+    Hive->SubKeyIndex = Index;
+    return TRUE;
+}
+
+VOID
+NTAPI
+CmpFreeSubKeyIndex(IN PHHIVE Hive)
+{
+    PCM_SUBKEY_INDEX Index = Hive->SubKeyIndex;
+
+    if (!Index) return;
+
+    Hive->SubKeyIndex = NULL;
+    Hive->Free(Index->Buckets, 0);
+    Hive->Free(Index->Entries, 0);
+    Hive->Free(Index, 0);
+}
+
+VOID
+NTAPI
+CmpRemoveKeyFromSubKeyIndex(IN PHHIVE Hive,
+                            IN PCM_KEY_NODE Node)
+{
+    if (!Hive->SubKeyIndex) return;
+
+    /* Keys only go away once all their subkeys are gone */
+    ASSERT(Node->SubKeyCounts[Stable] + Node->SubKeyCounts[Volatile] == 0);
+
+    /* So only the entry marking the key as indexed can be left */
+    CmpDeleteSubKeyIndex(Hive->SubKeyIndex, Node, 0, HCELL_NIL);
+}
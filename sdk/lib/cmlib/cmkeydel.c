@@ -224,6 +224,9 @@ CmpFreeKeyByCell(IN PHHIVE Hive,
         CmpFreeSecurityDescriptor(Hive, Cell);
     }
 
+    /* The node may be reused for another key, so forget about its subkeys */
+    CmpRemoveKeyFromSubKeyIndex(Hive, CellData);
+
     /* Free the key body itself, and then return our status */
     if (!CmpFreeKeyBody(Hive, Cell)) return STATUS_INSUFFICIENT_RESOURCES;
     return STATUS_SUCCESS;
@@ -308,6 +308,31 @@ typedef struct _HV_TRACK_CELL_REF
     USHORT StaticCount;
 } HV_TRACK_CELL_REF, *PHV_TRACK_CELL_REF;
 
+//
+// Subkey Lookup Index
+//
+// Maps a parent key node and the hash of a subkey name (as stored in hash
+// leaves) to the subkey cell. A parent is only indexed once it has enough
+// subkeys, and is marked as such by an entry with a HCELL_NIL cell.
+//
+typedef struct _CM_SUBKEY_INDEX_ENTRY
+{
+    PCM_KEY_NODE Parent;
+    HCELL_INDEX Cell;
+    ULONG HashKey;
+    ULONG Next;
+} CM_SUBKEY_INDEX_ENTRY, *PCM_SUBKEY_INDEX_ENTRY;
+
+typedef struct _CM_SUBKEY_INDEX
+{
+    ULONG BucketCount;
+    ULONG EntryCount;
+    ULONG UsedCount;
+    ULONG FreeEntry;
+    PULONG Buckets;
+    PCM_SUBKEY_INDEX_ENTRY Entries;
+} CM_SUBKEY_INDEX, *PCM_SUBKEY_INDEX;
+
 extern ULONG CmlibTraceLevel;
 
 //
@@ -547,6 +572,25 @@ CmpMarkIndexDirty(
     HCELL_INDEX TargetKey
 );
 
+BOOLEAN
+NTAPI
+CmpInitializeSubKeyIndex(
+    IN PHHIVE Hive
+);
+
+VOID
+NTAPI
+CmpFreeSubKeyIndex(
+    IN PHHIVE Hive
+);
+
+VOID
+NTAPI
+CmpRemoveKeyFromSubKeyIndex(
+    IN PHHIVE Hive,
+    IN PCM_KEY_NODE Node
+);
+
 
 //
 // Name Functions
@@ -329,6 +329,9 @@ typedef struct _HHIVE
     ULONG StorageTypeCount;
     ULONG Version;
     DUAL Storage[HTYPE_COUNT];
+
+    /* ReactOS-specific: optional subkey lookup index */
+    struct _CM_SUBKEY_INDEX *SubKeyIndex;
 } HHIVE, *PHHIVE;
 
 #define IsFreeCell(Cell)    ((Cell)->Size >= 0)
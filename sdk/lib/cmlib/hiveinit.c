@@ -623,6 +623,9 @@ VOID CMAPI
 HvFree(
     PHHIVE RegistryHive)
 {
+    /* Free the subkey index, if any */
+    CmpFreeSubKeyIndex(RegistryHive);
+
     if (!RegistryHive->ReadOnly)
     {
         /* Release hive bitmap */
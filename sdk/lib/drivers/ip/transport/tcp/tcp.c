@@ -180,6 +180,45 @@ VOID TCPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
     LibIPInsertPacket(Interface->TCPContext, IPPacket->Header, IPPacket->TotalSize);
 }
 
+static VOID TCPReadCongestionControl(VOID)
+/*
+ * FUNCTION: Applies the congestion control algorithm chosen with the
+ *           TcpCongestionControl value ("reno" or "cubic") of the
+ *           Tcpip\Parameters key, new connections use it
+ */
+{
+    RTL_QUERY_REGISTRY_TABLE QueryTable[2];
+    UNICODE_STRING Name;
+    ANSI_STRING AnsiName;
+    NTSTATUS Status;
+
+    RtlZeroMemory(QueryTable, sizeof(QueryTable));
+    RtlInitUnicodeString(&Name, NULL);
+    QueryTable[0].Flags = RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND;
+    QueryTable[0].Name = L"TcpCongestionControl";
+    QueryTable[0].EntryContext = &Name;
+
+    Status = RtlQueryRegistryValues(RTL_REGISTRY_SERVICES, L"Tcpip\\Parameters",
+                                    QueryTable, NULL, NULL);
+    if (!NT_SUCCESS(Status) || Name.Buffer == NULL)
+    {
+        /* Keep the lwIP default */
+        return;
+    }
+
+    Status = RtlUnicodeStringToAnsiString(&AnsiName, &Name, TRUE);
+    RtlFreeUnicodeString(&Name);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    if (LibTCPSetDefaultCongestionControl(AnsiName.Buffer) != ERR_OK)
+    {
+        TI_DbgPrint(MIN_TRACE, ("Unknown congestion control algorithm %Z\n", &AnsiName));
+    }
+
+    RtlFreeAnsiString(&AnsiName);
+}
+
 NTSTATUS TCPStartup(VOID)
 /*
  * FUNCTION: Initializes the TCP subsystem
@@ -204,6 +243,7 @@ NTSTATUS TCPStartup(VOID)
                                     0);
     
     /* Initialize our IP library */
+    TCPReadCongestionControl();
     LibIPInitialize();
     
     /* Register this protocol with IP layer */
@@ -830,6 +830,54 @@ pbuf_dechain(struct pbuf *p)
   return ((tail_gone > 0) ? NULL : q);
 }
 
+#if LWIP_TCP && TCP_QUEUE_OOSEQ && LWIP_WND_SCALE
+/**
+ * Split a pbuf chain into two parts: the first one is the longest run of
+ * pbufs whose total length still fits into a u16_t.
+ *
+ * With window scaling, TCP can chain more than 64k of in-sequence data.
+ * The tot_len fields of such a chain have wrapped around, but they are
+ * correct modulo 2^16, which is enough to fix them up here.
+ *
+ * @param p pbuf chain to split, its tot_len is fixed up
+ * @param rest set to the remainder of the chain, or NULL if everything fit
+ */
+void
+pbuf_split_64k(struct pbuf *p, struct pbuf **rest)
+{
+  *rest = NULL;
+  if ((p != NULL) && (p->next != NULL)) {
+    u16_t tot_len_front = p->len;
+    struct pbuf *i = p;
+    struct pbuf *r = p->next;
+
+    /* continue until the total length (summed up as u16_t) overflows */
+    while ((r != NULL) && ((u16_t)(tot_len_front + r->len) > tot_len_front)) {
+      tot_len_front += r->len;
+      i = r;
+      r = r->next;
+    }
+    /* i now points to the last pbuf of the first part */
+    i->next = NULL;
+
+    if (r != NULL) {
+      /* the totals of the first part still include the rest */
+      for (i = p; i != NULL; i = i->next) {
+        i->tot_len -= r->tot_len;
+        LWIP_ASSERT("tot_len/len mismatch in last pbuf",
+                    (i->next != NULL) || (i->tot_len == i->len));
+      }
+      if (p->flags & PBUF_FLAG_TCP_FIN) {
+        /* the FIN belongs to the end of the data */
+        p->flags &= ~PBUF_FLAG_TCP_FIN;
+        r->flags |= PBUF_FLAG_TCP_FIN;
+      }
+      *rest = r;
+    }
+  }
+}
+#endif /* LWIP_TCP && TCP_QUEUE_OOSEQ && LWIP_WND_SCALE */
+
 /**
  *
  * Create PBUF_RAM copies of pbufs.
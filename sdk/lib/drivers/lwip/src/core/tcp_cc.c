@@ -0,0 +1,281 @@
+/**
+ * @file
+ * Transmission Control Protocol, congestion control algorithms
+ *
+ * The generic code in tcp_in.c and tcp_out.c does slow start, fast
+ * retransmit and fast recovery. The algorithms in this file decide how
+ * the congestion window grows above ssthresh and how far it is reduced
+ * when a loss is detected.
+ *
+ * This file is part of the lwIP TCP/IP stack and is distributed under
+ * the same terms, see COPYING.
+ */
+
+#include "lwip/opt.h"
+
+#if LWIP_TCP /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/def.h"
+#include "lwip/sys.h"
+#include "lwip/tcp_impl.h"
+
+#include <string.h>
+
+/* CUBIC (RFC 8312) with C = 0.4 and beta = 0.7. Time is kept in units of
+   1/1024 s so that the curve can be computed with shifts only. */
+#define CUBIC_C_SCALED      410UL         /* C * 1024 */
+#define CUBIC_K_FACTOR      2681735677UL  /* 2^40 / CUBIC_C_SCALED */
+#define CUBIC_MAX_OFFSET    65535UL       /* 64 s, keeps the cube below 2^48 */
+#define CUBIC_MAX_ELAPSED   60000UL       /* in milliseconds */
+
+const struct tcp_cc_ops *tcp_cc_default = TCP_CC_DEFAULT;
+
+static void
+tcp_reno_init(struct tcp_pcb *pcb)
+{
+  LWIP_UNUSED_ARG(pcb);
+}
+
+static void
+tcp_reno_cong_avoid(struct tcp_pcb *pcb, tcpwnd_size_t acked)
+{
+  tcpwnd_size_t new_cwnd = (tcpwnd_size_t)(pcb->cwnd + pcb->mss * pcb->mss / pcb->cwnd);
+
+  LWIP_UNUSED_ARG(acked);
+  if (new_cwnd > pcb->cwnd) {
+    pcb->cwnd = new_cwnd;
+  }
+}
+
+static tcpwnd_size_t
+tcp_reno_ssthresh(struct tcp_pcb *pcb)
+{
+  /* Half of the minimum of the current cwnd and the advertised window,
+     but at least 2 MSS */
+  tcpwnd_size_t eff_wnd = LWIP_MIN(pcb->cwnd, pcb->snd_wnd);
+
+  return LWIP_MAX(eff_wnd / 2, (tcpwnd_size_t)(2 * pcb->mss));
+}
+
+const struct tcp_cc_ops tcp_cc_reno = {
+  "reno",
+  tcp_reno_init,
+  tcp_reno_cong_avoid,
+  tcp_reno_ssthresh
+};
+
+/** Integer cube root, for values below 2^54 */
+static u32_t
+tcp_cubic_cbrt(u64_t a)
+{
+  u32_t x = 0, y;
+  int shift;
+
+  for (shift = 17; shift >= 0; shift--) {
+    y = x | (1UL << shift);
+    if ((u64_t)y * y * y <= a) {
+      x = y;
+    }
+  }
+  return x;
+}
+
+static void
+tcp_cubic_init(struct tcp_pcb *pcb)
+{
+  memset(&pcb->cc_state, 0, sizeof(pcb->cc_state));
+}
+
+static void
+tcp_cubic_cong_avoid(struct tcp_pcb *pcb, tcpwnd_size_t acked)
+{
+  struct tcp_cc_state *st = &pcb->cc_state;
+  u32_t now = sys_now();
+  u32_t t, offs, thr;
+  u64_t delta, target;
+
+  if (st->epoch_start == 0) {
+    /* First growth after a reduction: start a new curve which levels off
+       at the window the loss happened at */
+    st->epoch_start = (now != 0) ? now : 1;
+    st->ack_cnt = 0;
+    st->est_cnt = 0;
+    st->w_est = pcb->cwnd;
+    if (pcb->cwnd < st->w_max) {
+      st->k = tcp_cubic_cbrt((u64_t)((st->w_max - pcb->cwnd) / pcb->mss) * CUBIC_K_FACTOR);
+      st->origin = st->w_max;
+    } else {
+      st->k = 0;
+      st->origin = pcb->cwnd;
+    }
+  }
+
+  /* The window computed now is in effect one round-trip time later */
+  t = now - st->epoch_start + (u32_t)(pcb->sa >> 3) * TCP_SLOW_INTERVAL;
+  t = (LWIP_MIN(t, CUBIC_MAX_ELAPSED) << 10) / 1000;
+  offs = (t < st->k) ? (st->k - t) : (t - st->k);
+  offs = LWIP_MIN(offs, CUBIC_MAX_OFFSET);
+
+  /* C * offs^3 segments */
+  delta = ((((u64_t)CUBIC_C_SCALED * offs * offs * offs) >> 30) * pcb->mss) >> 10;
+  if (t >= st->k) {
+    target = st->origin + delta;
+  } else if (delta < st->origin) {
+    target = st->origin - delta;
+  } else {
+    target = 0;
+  }
+
+  /* Never grow slower than Reno would: 3 * (1 - beta) / (1 + beta) = 9/17
+     segments per round-trip time */
+  st->est_cnt += acked;
+  thr = pcb->cwnd / 9 * 17;
+  while (st->est_cnt >= thr) {
+    st->est_cnt -= thr;
+    st->w_est += pcb->mss;
+  }
+  if (st->w_est > target) {
+    target = st->w_est;
+  }
+
+  /* Don't grow faster than slow start */
+  target = LWIP_MIN(target, (u64_t)pcb->cwnd + pcb->cwnd / 2);
+
+  if (target > pcb->cwnd) {
+    /* Reach the target within the next round-trip time */
+    thr = (u32_t)LWIP_MIN((u64_t)(pcb->cwnd / (u32_t)(target - pcb->cwnd)) * pcb->mss, 0xffffffffUL);
+  } else {
+    /* Probe very slowly for more bandwidth at the plateau */
+    thr = (u32_t)LWIP_MIN((u64_t)pcb->cwnd * 100, 0xffffffffUL);
+  }
+  st->ack_cnt += acked;
+  while (st->ack_cnt >= thr) {
+    st->ack_cnt -= thr;
+    if ((tcpwnd_size_t)(pcb->cwnd + pcb->mss) > pcb->cwnd) {
+      pcb->cwnd += pcb->mss;
+    }
+  }
+}
+
+static tcpwnd_size_t
+tcp_cubic_ssthresh(struct tcp_pcb *pcb)
+{
+  struct tcp_cc_state *st = &pcb->cc_state;
+  tcpwnd_size_t eff_wnd = LWIP_MIN(pcb->cwnd, pcb->snd_wnd);
+
+  st->epoch_start = 0;
+  /* Fast convergence: if the window didn't reach the previous maximum,
+     other flows are competing, so leave them some more room */
+  if (eff_wnd < st->w_max) {
+    st->w_max = eff_wnd / 20 * 17;
+  } else {
+    st->w_max = eff_wnd;
+  }
+  return LWIP_MAX(eff_wnd / 10 * 7, (tcpwnd_size_t)(2 * pcb->mss));
+}
+
+const struct tcp_cc_ops tcp_cc_cubic = {
+  "cubic",
+  tcp_cubic_init,
+  tcp_cubic_cong_avoid,
+  tcp_cubic_ssthresh
+};
+
+static const struct tcp_cc_ops * const tcp_cc_list[] = {
+  &tcp_cc_reno,
+  &tcp_cc_cubic
+};
+
+static const struct tcp_cc_ops *
+tcp_cc_find(const char *name)
+{
+  u8_t i;
+
+  for (i = 0; i < sizeof(tcp_cc_list) / sizeof(tcp_cc_list[0]); i++) {
+    if (strcmp(tcp_cc_list[i]->name, name) == 0) {
+      return tcp_cc_list[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Selects the congestion control algorithm of a connection.
+ *
+ * @param pcb the tcp_pcb to change
+ * @param name the algorithm, "reno" or "cubic"
+ * @return ERR_OK, or ERR_VAL if the algorithm is unknown
+ */
+err_t
+tcp_set_cc(struct tcp_pcb *pcb, const char *name)
+{
+  const struct tcp_cc_ops *cc;
+
+  LWIP_ASSERT("don't call tcp_set_cc for listen-pcbs",
+    pcb->state != LISTEN);
+
+  cc = tcp_cc_find(name);
+  if (cc == NULL) {
+    return ERR_VAL;
+  }
+  if (pcb->cc != cc) {
+    pcb->cc = cc;
+    cc->init(pcb);
+  }
+  return ERR_OK;
+}
+
+/**
+ * Selects the congestion control algorithm of connections created from
+ * now on, overriding TCP_CC_DEFAULT.
+ *
+ * @param name the algorithm, "reno" or "cubic"
+ * @return ERR_OK, or ERR_VAL if the algorithm is unknown
+ */
+err_t
+tcp_set_default_cc(const char *name)
+{
+  const struct tcp_cc_ops *cc;
+
+  cc = tcp_cc_find(name);
+  if (cc == NULL) {
+    return ERR_VAL;
+  }
+  tcp_cc_default = cc;
+  return ERR_OK;
+}
+
+#if TCP_CONN_STATS
+/**
+ * Returns the counters of a connection together with a snapshot of its
+ * congestion control state.
+ *
+ * @param pcb the tcp_pcb to query
+ * @param stats filled in with the statistics
+ */
+void
+tcp_get_conn_stats(struct tcp_pcb *pcb, struct tcp_conn_stats *stats)
+{
+  *stats = pcb->conn_stats;
+  stats->cwnd = pcb->cwnd;
+  stats->ssthresh = pcb->ssthresh;
+  stats->snd_wnd = pcb->snd_wnd;
+  stats->rcv_wnd = pcb->rcv_wnd;
+  stats->srtt_ms = (u32_t)(pcb->sa >> 3) * TCP_SLOW_INTERVAL;
+#if LWIP_WND_SCALE
+  stats->snd_scale = (pcb->flags & TF_WND_SCALE) ? pcb->snd_scale : 0;
+  stats->rcv_scale = (pcb->flags & TF_WND_SCALE) ? pcb->rcv_scale : 0;
+#else
+  stats->snd_scale = 0;
+  stats->rcv_scale = 0;
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK
+  stats->sack = (pcb->flags & TF_SACK) ? 1 : 0;
+#else
+  stats->sack = 0;
+#endif /* LWIP_TCP_SACK */
+  stats->cc_name = pcb->cc->name;
+}
+#endif /* TCP_CONN_STATS */
+
+#endif /* LWIP_TCP */
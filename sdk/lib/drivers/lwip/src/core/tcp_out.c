@@ -105,7 +105,7 @@ tcp_output_alloc_header(struct tcp_pcb *pcb, u16_t optlen, u16_t datalen,
     tcphdr->seqno = seqno_be;
     tcphdr->ackno = htonl(pcb->rcv_nxt);
     TCPH_HDRLEN_FLAGS_SET(tcphdr, (5 + optlen / 4), TCP_ACK);
-    tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+    tcphdr->wnd = htons(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd));
     tcphdr->chksum = 0;
     tcphdr->urgp = 0;
 
@@ -306,7 +306,7 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
 
   /* fail on too much data */
   if (len > pcb->snd_buf) {
-    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_write: too much data (len=%"U16_F" > snd_buf=%"U16_F")\n",
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_write: too much data (len=%"U16_F" > snd_buf=%"TCPWNDSIZE_F")\n",
       len, pcb->snd_buf));
     pcb->flags |= TF_NAGLEMEMERR;
     return ERR_MEM;
@@ -370,7 +370,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 #endif /* TCP_CHECKSUM_ON_COPY */
   err_t err;
   /* don't allocate segments bigger than half the maximum window we ever received */
-  u16_t mss_local = LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
+  u16_t mss_local = (u16_t)LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
 
 #if LWIP_NETIF_TX_SINGLE_PBUF
   /* Always copy to try to create single pbufs for TX */
@@ -742,6 +742,17 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
 
   if (flags & TCP_SYN) {
     optflags = TF_SEG_OPTS_MSS;
+#if LWIP_WND_SCALE
+    /* A SYN|ACK may only carry the option if the remote host sent it */
+    if ((pcb->state != SYN_RCVD) || (pcb->flags & TF_WND_SCALE)) {
+      optflags |= TF_SEG_OPTS_WND_SCALE;
+    }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK
+    if ((pcb->state != SYN_RCVD) || (pcb->flags & TF_SACK)) {
+      optflags |= TF_SEG_OPTS_SACK_PERM;
+    }
+#endif /* LWIP_TCP_SACK */
   }
 #if LWIP_TCP_TIMESTAMPS
   if ((pcb->flags & TF_TIMESTAMP)) {
@@ -834,6 +845,72 @@ tcp_build_timestamp_option(struct tcp_pcb *pcb, u32_t *opts)
 }
 #endif
 
+#if LWIP_TCP_SACK && TCP_QUEUE_OOSEQ
+/* Count the SACK blocks describing the out-of-sequence queue, limited to
+ * what fits into the option space left after optlen bytes of other options
+ *
+ * @param pcb tcp_pcb
+ * @param optlen length of the options already present
+ * @return number of SACK blocks to send
+ */
+static u8_t
+tcp_get_num_sacks(struct tcp_pcb *pcb, u8_t optlen)
+{
+  struct tcp_seg *seg;
+  u8_t max_sacks = (u8_t)((40 - optlen - 4) / 8);
+  u8_t num_sacks = 0;
+  u32_t right = 0;
+
+  /* Adjacent segments of the queue are reported as one block (the headers
+     of queued segments are already in host byte order) */
+  for (seg = pcb->ooseq; seg != NULL; seg = seg->next) {
+    if ((num_sacks == 0) || (seg->tcphdr->seqno != right)) {
+      if (num_sacks == max_sacks) {
+        break;
+      }
+      num_sacks++;
+    }
+    right = seg->tcphdr->seqno + TCP_TCPLEN(seg);
+  }
+  return num_sacks;
+}
+
+/* Build a SACK option with num_sacks blocks at the specified options pointer
+ *
+ * @param pcb tcp_pcb
+ * @param opts option pointer where to store the SACK option
+ * @param num_sacks number of blocks as returned by tcp_get_num_sacks()
+ */
+static void
+tcp_build_sack_option(struct tcp_pcb *pcb, u32_t *opts, u8_t num_sacks)
+{
+  struct tcp_seg *seg;
+  u32_t left = 0, right = 0;
+  u8_t i = 0;
+
+  /* Pad with two NOP options to make everything nicely aligned */
+  opts[0] = htonl(0x01010500 | (2 + num_sacks * 8));
+  for (seg = pcb->ooseq; seg != NULL; seg = seg->next) {
+    if ((i > 0) && (seg->tcphdr->seqno == right)) {
+      right += TCP_TCPLEN(seg);
+      continue;
+    }
+    if (i > 0) {
+      opts[2 * i - 1] = htonl(left);
+      opts[2 * i] = htonl(right);
+    }
+    if (i == num_sacks) {
+      return;
+    }
+    i++;
+    left = seg->tcphdr->seqno;
+    right = left + TCP_TCPLEN(seg);
+  }
+  opts[2 * i - 1] = htonl(left);
+  opts[2 * i] = htonl(right);
+}
+#endif /* LWIP_TCP_SACK && TCP_QUEUE_OOSEQ */
+
 /** Send an ACK without data.
  *
  * @param pcb Protocol control block for the TCP connection to send the ACK
@@ -844,12 +921,22 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   struct pbuf *p;
   struct tcp_hdr *tcphdr;
   u8_t optlen = 0;
+#if LWIP_TCP_SACK && TCP_QUEUE_OOSEQ
+  u8_t num_sacks = 0;
+#endif
 
 #if LWIP_TCP_TIMESTAMPS
   if (pcb->flags & TF_TIMESTAMP) {
     optlen = LWIP_TCP_OPT_LENGTH(TF_SEG_OPTS_TS);
   }
 #endif
+#if LWIP_TCP_SACK && TCP_QUEUE_OOSEQ
+  /* Tell the remote host about the data we already have beyond the hole */
+  if ((pcb->flags & TF_SACK) && (pcb->ooseq != NULL)) {
+    num_sacks = tcp_get_num_sacks(pcb, optlen);
+    optlen += 4 + num_sacks * 8;
+  }
+#endif
 
   p = tcp_output_alloc_header(pcb, optlen, 0, htonl(pcb->snd_nxt));
   if (p == NULL) {
@@ -870,6 +957,12 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
     tcp_build_timestamp_option(pcb, (u32_t *)(tcphdr + 1));
   }
 #endif 
+#if LWIP_TCP_SACK && TCP_QUEUE_OOSEQ
+  if (num_sacks > 0) {
+    tcp_build_sack_option(pcb, (u32_t *)(tcphdr + 1) + (optlen - 4 - num_sacks * 8) / 4, num_sacks);
+  }
+#endif
+  TCP_CONN_STATS_INC(pcb, segs_out);
 
 #if CHECKSUM_GEN_TCP
   tcphdr->chksum = inet_chksum_pseudo(p, &(pcb->local_ip), &(pcb->remote_ip),
@@ -945,13 +1038,13 @@ tcp_output(struct tcp_pcb *pcb)
 #endif /* TCP_OUTPUT_DEBUG */
 #if TCP_CWND_DEBUG
   if (seg == NULL) {
-    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"U16_F
-                                 ", cwnd %"U16_F", wnd %"U32_F
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"TCPWNDSIZE_F
+                                 ", cwnd %"TCPWNDSIZE_F", wnd %"U32_F
                                  ", seg == NULL, ack %"U32_F"\n",
                                  pcb->snd_wnd, pcb->cwnd, wnd, pcb->lastack));
   } else {
     LWIP_DEBUGF(TCP_CWND_DEBUG, 
-                ("tcp_output: snd_wnd %"U16_F", cwnd %"U16_F", wnd %"U32_F
+                ("tcp_output: snd_wnd %"TCPWNDSIZE_F", cwnd %"TCPWNDSIZE_F", wnd %"U32_F
                  ", effwnd %"U32_F", seq %"U32_F", ack %"U32_F"\n",
                  pcb->snd_wnd, pcb->cwnd, wnd,
                  ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len,
@@ -975,7 +1068,7 @@ tcp_output(struct tcp_pcb *pcb)
       break;
     }
 #if TCP_CWND_DEBUG
-    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"U16_F", cwnd %"U16_F", wnd %"U32_F", effwnd %"U32_F", seq %"U32_F", ack %"U32_F", i %"S16_F"\n",
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"TCPWNDSIZE_F", cwnd %"TCPWNDSIZE_F", wnd %"U32_F", effwnd %"U32_F", seq %"U32_F", ack %"U32_F", i %"S16_F"\n",
                             pcb->snd_wnd, pcb->cwnd, wnd,
                             ntohl(seg->tcphdr->seqno) + seg->len -
                             pcb->lastack,
@@ -1054,13 +1147,22 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
 
   /** @bug Exclude retransmitted segments from this count. */
   snmp_inc_tcpoutsegs();
+  TCP_CONN_STATS_INC(pcb, segs_out);
 
   /* The TCP header has already been constructed, but the ackno and
    wnd fields remain. */
   seg->tcphdr->ackno = htonl(pcb->rcv_nxt);
 
   /* advertise our receive window size in this TCP segment */
-  seg->tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+#if LWIP_WND_SCALE
+  if (TCPH_FLAGS(seg->tcphdr) & TCP_SYN) {
+    /* The window field of a SYN segment is never scaled */
+    seg->tcphdr->wnd = htons(TCPWND_MIN16(pcb->rcv_ann_wnd));
+  } else
+#endif /* LWIP_WND_SCALE */
+  {
+    seg->tcphdr->wnd = htons(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd));
+  }
 
   pcb->rcv_ann_right_edge = pcb->rcv_nxt + pcb->rcv_ann_wnd;
 
@@ -1077,6 +1179,20 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
     *opts = TCP_BUILD_MSS_OPTION(mss);
     opts += 1;
   }
+#if LWIP_WND_SCALE
+  if (seg->flags & TF_SEG_OPTS_WND_SCALE) {
+    /* Pad with one NOP option to make everything nicely aligned */
+    *opts = PP_HTONL(0x01030300 | TCP_RCV_SCALE);
+    opts += 1;
+  }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK
+  if (seg->flags & TF_SEG_OPTS_SACK_PERM) {
+    /* Pad with two NOP options to make everything nicely aligned */
+    *opts = PP_HTONL(0x01010402);
+    opts += 1;
+  }
+#endif /* LWIP_TCP_SACK */
 #if LWIP_TCP_TIMESTAMPS
   pcb->ts_lastacksent = pcb->rcv_nxt;
 
@@ -1212,7 +1328,7 @@ tcp_rst(u32_t seqno, u32_t ackno,
   tcphdr->seqno = htonl(seqno);
   tcphdr->ackno = htonl(ackno);
   TCPH_HDRLEN_FLAGS_SET(tcphdr, TCP_HLEN/4, TCP_RST | TCP_ACK);
-  tcphdr->wnd = PP_HTONS(TCP_WND);
+  tcphdr->wnd = PP_HTONS(TCPWND_MIN16(TCP_WND));
   tcphdr->chksum = 0;
   tcphdr->urgp = 0;
 
@@ -1244,6 +1360,14 @@ tcp_rexmit_rto(struct tcp_pcb *pcb)
     return;
   }
 
+  /* A timeout ends fast recovery, and the remote host may have dropped
+     the data it SACKed, so everything is sent again */
+  pcb->flags &= ~TF_INFR;
+  for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+    seg->flags &= ~(TF_SEG_SACKED | TF_SEG_REXMIT);
+    TCP_CONN_STATS_INC(pcb, rexmits);
+  }
+
   /* Move all unacked segments to the head of the unsent queue */
   for (seg = pcb->unacked; seg->next != NULL; seg = seg->next);
   /* concatenate unsent queue after unacked queue */
@@ -1265,27 +1389,21 @@ tcp_rexmit_rto(struct tcp_pcb *pcb)
 }
 
 /**
- * Requeue the first unacked segment for retransmission
+ * Move an unacked segment back to the unsent queue
  *
- * Called by tcp_receive() for fast retramsmit.
- *
- * @param pcb the tcp_pcb for which to retransmit the first unacked segment
+ * @param pcb the tcp_pcb owning the segment
+ * @param link the pointer to the segment in the unacked queue
  */
-void
-tcp_rexmit(struct tcp_pcb *pcb)
+static void
+tcp_rexmit_unacked(struct tcp_pcb *pcb, struct tcp_seg **link)
 {
   struct tcp_seg *seg;
   struct tcp_seg **cur_seg;
 
-  if (pcb->unacked == NULL) {
-    return;
-  }
+  seg = *link;
+  *link = seg->next;
 
-  /* Move the first unacked segment to the unsent queue */
   /* Keep the unsent queue sorted. */
-  seg = pcb->unacked;
-  pcb->unacked = seg->next;
-
   cur_seg = &(pcb->unsent);
   while (*cur_seg &&
     TCP_SEQ_LT(ntohl((*cur_seg)->tcphdr->seqno), ntohl(seg->tcphdr->seqno))) {
@@ -1299,18 +1417,72 @@ tcp_rexmit(struct tcp_pcb *pcb)
     pcb->unsent_oversize = 0;
   }
 #endif /* TCP_OVERSIZE */
-
-  ++pcb->nrtx;
+  seg->flags |= TF_SEG_REXMIT;
 
   /* Don't take any rtt measurements after retransmitting. */
   pcb->rttest = 0;
 
   /* Do the actual retransmission. */
   snmp_inc_tcpretranssegs();
+  TCP_CONN_STATS_INC(pcb, rexmits);
   /* No need to call tcp_output: we are always called from tcp_input()
      and thus tcp_output directly returns. */
 }
 
+/**
+ * Requeue the first unacked segment for retransmission
+ *
+ * Called by tcp_receive() for fast retramsmit.
+ *
+ * @param pcb the tcp_pcb for which to retransmit the first unacked segment
+ */
+void
+tcp_rexmit(struct tcp_pcb *pcb)
+{
+  if (pcb->unacked == NULL) {
+    return;
+  }
+
+  /* Move the first unacked segment to the unsent queue */
+  tcp_rexmit_unacked(pcb, &pcb->unacked);
+
+  ++pcb->nrtx;
+}
+
+/**
+ * Requeue the first unacked segment the remote host is still missing and
+ * that was not retransmitted during this fast recovery yet
+ *
+ * Called by tcp_receive() for partial acknowledgements and duplicate ACKs
+ * during fast recovery. Without SACK information, only the first unacked
+ * segment is known to be missing.
+ *
+ * @param pcb the tcp_pcb for which to retransmit the next hole
+ */
+void
+tcp_rexmit_hole(struct tcp_pcb *pcb)
+{
+  struct tcp_seg **link;
+  struct tcp_seg *seg;
+
+  for (link = &pcb->unacked; (seg = *link) != NULL; link = &seg->next) {
+    if (!(seg->flags & (TF_SEG_SACKED | TF_SEG_REXMIT))) {
+      LWIP_DEBUGF(TCP_FR_DEBUG, ("tcp_rexmit_hole: retransmit %"U32_F"\n",
+                                 ntohl(seg->tcphdr->seqno)));
+      tcp_rexmit_unacked(pcb, link);
+      return;
+    }
+#if LWIP_TCP_SACK
+    /* Data is only known to be lost below the highest SACKed byte */
+    if (!(pcb->flags & TF_SACK) || (seg->next == NULL) ||
+        !TCP_SEQ_LT(ntohl(seg->next->tcphdr->seqno), pcb->sack_high)) {
+      return;
+    }
+#else /* LWIP_TCP_SACK */
+    return;
+#endif /* LWIP_TCP_SACK */
+  }
+}
 
 /**
  * Handle retransmission after three dupacks received
@@ -1328,25 +1500,14 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
                  (u16_t)pcb->dupacks, pcb->lastack,
                  ntohl(pcb->unacked->tcphdr->seqno)));
     tcp_rexmit(pcb);
+    TCP_CONN_STATS_INC(pcb, fast_rexmits);
 
-    /* Set ssthresh to half of the minimum of the current
-     * cwnd and the advertised window */
-    if (pcb->cwnd > pcb->snd_wnd) {
-      pcb->ssthresh = pcb->snd_wnd / 2;
-    } else {
-      pcb->ssthresh = pcb->cwnd / 2;
-    }
-    
-    /* The minimum value for ssthresh should be 2 MSS */
-    if (pcb->ssthresh < 2*pcb->mss) {
-      LWIP_DEBUGF(TCP_FR_DEBUG, 
-                  ("tcp_receive: The minimum value for ssthresh %"U16_F
-                   " should be min 2 mss %"U16_F"...\n",
-                   pcb->ssthresh, 2*pcb->mss));
-      pcb->ssthresh = 2*pcb->mss;
-    }
+    /* Let the congestion control algorithm reduce ssthresh */
+    pcb->ssthresh = pcb->cc->ssthresh(pcb);
     
     pcb->cwnd = pcb->ssthresh + 3 * pcb->mss;
+    /* Recovery ends once everything sent so far is acknowledged */
+    pcb->recover = pcb->snd_nxt;
     pcb->flags |= TF_INFR;
   } 
 }
@@ -23,6 +23,7 @@ realloc(void *mem, size_t size);
 typedef unsigned char u8_t;
 typedef unsigned short u16_t;
 typedef unsigned long u32_t;
+typedef unsigned long long u64_t;
 
 /* Signed int types */
 typedef signed char s8_t;
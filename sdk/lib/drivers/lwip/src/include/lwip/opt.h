@@ -1068,6 +1068,51 @@
 #define TCP_WND_UPDATE_THRESHOLD   (TCP_WND / 4)
 #endif
 
+/**
+ * LWIP_WND_SCALE and TCP_RCV_SCALE:
+ * Set LWIP_WND_SCALE to 1 to enable the window scale option (RFC 1323).
+ * The receive window is then announced as TCP_WND >> TCP_RCV_SCALE, so
+ * TCP_WND may be larger than 0xffff as long as it fits in 16 bits after
+ * the shift. The remote host has to support the option too, otherwise
+ * the window stays limited to 0xffff for that connection.
+ */
+#ifndef LWIP_WND_SCALE
+#define LWIP_WND_SCALE                  0
+#endif
+#ifndef TCP_RCV_SCALE
+#define TCP_RCV_SCALE                   0
+#endif
+
+/**
+ * LWIP_TCP_SACK==1: support selective acknowledgments (RFC 2018).
+ * Received out-of-sequence data is reported to the remote host and SACK
+ * blocks it sends are used to retransmit only the missing segments.
+ * Needs TCP_QUEUE_OOSEQ to report anything.
+ */
+#ifndef LWIP_TCP_SACK
+#define LWIP_TCP_SACK                   0
+#endif
+
+/**
+ * TCP_CC_DEFAULT: congestion control algorithm used by new connections.
+ * tcp_cc_reno is the classic slow start/congestion avoidance, tcp_cc_cubic
+ * grows the window independently of the round-trip time (RFC 8312) and
+ * is better suited to paths with a large bandwidth-delay product.
+ * The algorithm can also be changed with tcp_set_default_cc() and
+ * tcp_set_cc() at runtime.
+ */
+#ifndef TCP_CC_DEFAULT
+#define TCP_CC_DEFAULT                  (&tcp_cc_reno)
+#endif
+
+/**
+ * TCP_CONN_STATS==1: keep per-connection counters (retransmissions,
+ * duplicate ACKs, SACK blocks...) which can be read with tcp_get_conn_stats().
+ */
+#ifndef TCP_CONN_STATS
+#define TCP_CONN_STATS                  0
+#endif
+
 /**
  * LWIP_EVENT_API and LWIP_CALLBACK_API: Only one of these should be set to 1.
  *     LWIP_EVENT_API==1: The user defines lwip_tcp_event() to receive all
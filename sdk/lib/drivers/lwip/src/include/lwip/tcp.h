@@ -47,6 +47,21 @@ extern "C" {
 #endif
 
 struct tcp_pcb;
+struct tcp_cc_ops;
+
+#if LWIP_WND_SCALE
+typedef u32_t tcpwnd_size_t;
+#define TCPWNDSIZE_F U32_F
+#else
+typedef u16_t tcpwnd_size_t;
+#define TCPWNDSIZE_F U16_F
+#endif
+
+#if LWIP_WND_SCALE || LWIP_TCP_SACK
+typedef u16_t tcpflags_t;
+#else
+typedef u8_t tcpflags_t;
+#endif
 
 /** Function prototype for tcp accept callback functions. Called when a new
  * connection can be accepted on a listening pcb.
@@ -164,6 +179,47 @@ enum tcp_state {
   u16_t local_port
 
 
+/** State of the congestion control algorithm of a connection */
+struct tcp_cc_state {
+  u32_t epoch_start;    /* time the window started growing again, 0 if unset */
+  u32_t k;              /* time to grow back to origin, in 1/1024 s */
+  tcpwnd_size_t w_max;  /* window before the last reduction */
+  tcpwnd_size_t origin; /* window the growth curve levels off at */
+  tcpwnd_size_t w_est;  /* window Reno would have reached */
+  u32_t ack_cnt;        /* acknowledged bytes not yet turned into cwnd growth */
+  u32_t est_cnt;        /* acknowledged bytes not yet turned into w_est growth */
+};
+
+#if TCP_CONN_STATS
+/** Per-connection counters, see tcp_get_conn_stats() */
+struct tcp_conn_stats {
+  u32_t segs_out;       /* segments sent, retransmissions included */
+  u32_t segs_in;        /* segments received */
+  u32_t bytes_acked;    /* bytes acknowledged by the remote host */
+  u32_t rexmits;        /* segments retransmitted */
+  u32_t fast_rexmits;   /* fast retransmissions */
+  u32_t rto_expired;    /* retransmission timeouts */
+  u32_t dupacks_in;     /* duplicate ACKs received */
+  u32_t sack_blocks_in; /* SACK blocks received */
+  u32_t ooseq_in;       /* out-of-sequence segments received */
+  /* Filled in by tcp_get_conn_stats() */
+  u32_t cwnd;
+  u32_t ssthresh;
+  u32_t snd_wnd;
+  u32_t rcv_wnd;
+  u32_t srtt_ms;
+  u8_t snd_scale;
+  u8_t rcv_scale;
+  u8_t sack;
+  const char *cc_name;
+};
+#define TCP_CONN_STATS_INC(pcb, x) ++(pcb)->conn_stats.x
+#define TCP_CONN_STATS_ADD(pcb, x, n) (pcb)->conn_stats.x += (n)
+#else
+#define TCP_CONN_STATS_INC(pcb, x)
+#define TCP_CONN_STATS_ADD(pcb, x, n)
+#endif /* TCP_CONN_STATS */
+
 /* the TCP protocol control block */
 struct tcp_pcb {
 /** common PCB members */
@@ -174,15 +230,21 @@ struct tcp_pcb {
   /* ports are in host byte order */
   u16_t remote_port;
   
-  u8_t flags;
-#define TF_ACK_DELAY   ((u8_t)0x01U)   /* Delayed ACK. */
-#define TF_ACK_NOW     ((u8_t)0x02U)   /* Immediate ACK. */
-#define TF_INFR        ((u8_t)0x04U)   /* In fast recovery. */
-#define TF_TIMESTAMP   ((u8_t)0x08U)   /* Timestamp option enabled */
-#define TF_RXCLOSED    ((u8_t)0x10U)   /* rx closed by tcp_shutdown */
-#define TF_FIN         ((u8_t)0x20U)   /* Connection was closed locally (FIN segment enqueued). */
-#define TF_NODELAY     ((u8_t)0x40U)   /* Disable Nagle algorithm */
-#define TF_NAGLEMEMERR ((u8_t)0x80U)   /* nagle enabled, memerr, try to output to prevent delayed ACK to happen */
+  tcpflags_t flags;
+#define TF_ACK_DELAY   ((tcpflags_t)0x01U)   /* Delayed ACK. */
+#define TF_ACK_NOW     ((tcpflags_t)0x02U)   /* Immediate ACK. */
+#define TF_INFR        ((tcpflags_t)0x04U)   /* In fast recovery. */
+#define TF_TIMESTAMP   ((tcpflags_t)0x08U)   /* Timestamp option enabled */
+#define TF_RXCLOSED    ((tcpflags_t)0x10U)   /* rx closed by tcp_shutdown */
+#define TF_FIN         ((tcpflags_t)0x20U)   /* Connection was closed locally (FIN segment enqueued). */
+#define TF_NODELAY     ((tcpflags_t)0x40U)   /* Disable Nagle algorithm */
+#define TF_NAGLEMEMERR ((tcpflags_t)0x80U)   /* nagle enabled, memerr, try to output to prevent delayed ACK to happen */
+#if LWIP_WND_SCALE
+#define TF_WND_SCALE   ((tcpflags_t)0x0100U) /* Window scale option enabled */
+#endif
+#if LWIP_TCP_SACK
+#define TF_SACK        ((tcpflags_t)0x0200U) /* Selective acknowledgments enabled */
+#endif
 
   /* the rest of the fields are in host byte order
      as we have to do some math with them */
@@ -194,8 +256,8 @@ struct tcp_pcb {
 
   /* receiver variables */
   u32_t rcv_nxt;   /* next seqno expected */
-  u16_t rcv_wnd;   /* receiver window available */
-  u16_t rcv_ann_wnd; /* receiver window to announce */
+  tcpwnd_size_t rcv_wnd;   /* receiver window available */
+  tcpwnd_size_t rcv_ann_wnd; /* receiver window to announce */
   u32_t rcv_ann_right_edge; /* announced right edge of window */
 
   /* Retransmission timer. */
@@ -216,20 +278,23 @@ struct tcp_pcb {
   u32_t lastack; /* Highest acknowledged seqno. */
 
   /* congestion avoidance/control variables */
-  u16_t cwnd;
-  u16_t ssthresh;
+  tcpwnd_size_t cwnd;
+  tcpwnd_size_t ssthresh;
+  u32_t recover;   /* snd_nxt when fast recovery was entered */
+  const struct tcp_cc_ops *cc;
+  struct tcp_cc_state cc_state;
 
   /* sender variables */
   u32_t snd_nxt;   /* next new seqno to be sent */
   u32_t snd_wl1, snd_wl2; /* Sequence and acknowledgement numbers of last
                              window update. */
   u32_t snd_lbb;       /* Sequence number of next byte to be buffered. */
-  u16_t snd_wnd;   /* sender window */
-  u16_t snd_wnd_max; /* the maximum sender window announced by the remote host */
+  tcpwnd_size_t snd_wnd;   /* sender window */
+  tcpwnd_size_t snd_wnd_max; /* the maximum sender window announced by the remote host */
 
-  u16_t acked;
+  tcpwnd_size_t acked;
 
-  u16_t snd_buf;   /* Available buffer space for sending (in bytes). */
+  tcpwnd_size_t snd_buf;   /* Available buffer space for sending (in bytes). */
 #define TCP_SNDQUEUELEN_OVERFLOW (0xffffU-3)
   u16_t snd_queuelen; /* Available buffer space for sending (in tcp_segs). */
 
@@ -279,6 +344,17 @@ struct tcp_pcb {
 
   /* KEEPALIVE counter */
   u8_t keep_cnt_sent;
+
+#if LWIP_WND_SCALE
+  u8_t snd_scale;
+  u8_t rcv_scale;
+#endif
+#if LWIP_TCP_SACK
+  u32_t sack_high; /* right edge of the highest block SACKed by the remote host */
+#endif
+#if TCP_CONN_STATS
+  struct tcp_conn_stats conn_stats;
+#endif
 };
 
 struct tcp_pcb_listen {  
@@ -329,6 +405,16 @@ void             tcp_err     (struct tcp_pcb *pcb, tcp_err_fn err);
 #define          tcp_nagle_enable(pcb)    ((pcb)->flags &= ~TF_NODELAY)
 #define          tcp_nagle_disabled(pcb)  (((pcb)->flags & TF_NODELAY) != 0)
 
+/* Congestion control algorithms, see TCP_CC_DEFAULT */
+extern const struct tcp_cc_ops tcp_cc_reno;
+extern const struct tcp_cc_ops tcp_cc_cubic;
+
+err_t            tcp_set_cc  (struct tcp_pcb *pcb, const char *name);
+err_t            tcp_set_default_cc(const char *name);
+#if TCP_CONN_STATS
+void             tcp_get_conn_stats(struct tcp_pcb *pcb, struct tcp_conn_stats *stats);
+#endif /* TCP_CONN_STATS */
+
 #if TCP_LISTEN_BACKLOG
 #define          tcp_accepted(pcb) do { \
   LWIP_ASSERT("pcb->state == LISTEN (called for wrong pcb?)", pcb->state == LISTEN); \
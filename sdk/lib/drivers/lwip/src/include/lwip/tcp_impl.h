@@ -69,6 +69,7 @@ err_t            tcp_send_empty_ack(struct tcp_pcb *pcb);
 void             tcp_rexmit  (struct tcp_pcb *pcb);
 void             tcp_rexmit_rto  (struct tcp_pcb *pcb);
 void             tcp_rexmit_fast (struct tcp_pcb *pcb);
+void             tcp_rexmit_hole (struct tcp_pcb *pcb);
 u32_t            tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb);
 err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 
@@ -292,12 +293,48 @@ struct tcp_seg {
 #define TF_SEG_OPTS_TS          (u8_t)0x02U /* Include timestamp option. */
 #define TF_SEG_DATA_CHECKSUMMED (u8_t)0x04U /* ALL data (not the header) is
                                                checksummed into 'chksum' */
+#define TF_SEG_OPTS_WND_SCALE   (u8_t)0x08U /* Include window scale option. */
+#define TF_SEG_OPTS_SACK_PERM   (u8_t)0x10U /* Include SACK permitted option. */
+#define TF_SEG_SACKED           (u8_t)0x20U /* Selectively acknowledged by the
+                                               remote host. */
+#define TF_SEG_REXMIT           (u8_t)0x40U /* Retransmitted during the current
+                                               fast recovery. */
   struct tcp_hdr *tcphdr;  /* the TCP header */
 };
 
-#define LWIP_TCP_OPT_LENGTH(flags)              \
-  (flags & TF_SEG_OPTS_MSS ? 4  : 0) +          \
-  (flags & TF_SEG_OPTS_TS  ? 12 : 0)
+#define LWIP_TCP_OPT_LENGTH(flags)                    \
+  ((flags & TF_SEG_OPTS_MSS       ? 4  : 0) +         \
+   (flags & TF_SEG_OPTS_TS        ? 12 : 0) +         \
+   (flags & TF_SEG_OPTS_WND_SCALE ? 4  : 0) +         \
+   (flags & TF_SEG_OPTS_SACK_PERM ? 4  : 0))
+
+/** Largest number of SACK blocks parsed from an incoming segment */
+#define LWIP_TCP_MAX_SACK_IN 4
+
+#if LWIP_WND_SCALE
+#define TCPWND_MIN16(x)         ((u16_t)LWIP_MIN((x), 0xFFFF))
+#define TCP_WND_MAX(pcb)        ((tcpwnd_size_t)(((pcb)->flags & TF_WND_SCALE) ? TCP_WND : TCPWND_MIN16(TCP_WND)))
+#define SND_WND_SCALE(pcb, wnd) (((tcpwnd_size_t)(wnd) << (pcb)->snd_scale))
+#define RCV_WND_SCALE(pcb, wnd) (TCPWND_MIN16((wnd) >> (pcb)->rcv_scale))
+#else
+#define TCPWND_MIN16(x)         ((u16_t)(x))
+#define TCP_WND_MAX(pcb)        TCP_WND
+#define SND_WND_SCALE(pcb, wnd) (wnd)
+#define RCV_WND_SCALE(pcb, wnd) (wnd)
+#endif /* LWIP_WND_SCALE */
+
+/** A congestion control algorithm, see TCP_CC_DEFAULT */
+struct tcp_cc_ops {
+  const char *name;
+  /** Resets the algorithm state of a new connection */
+  void (*init)(struct tcp_pcb *pcb);
+  /** Grows cwnd for newly acknowledged data once it reached ssthresh */
+  void (*cong_avoid)(struct tcp_pcb *pcb, tcpwnd_size_t acked);
+  /** Returns ssthresh to use after a loss was detected */
+  tcpwnd_size_t (*ssthresh)(struct tcp_pcb *pcb);
+};
+
+extern const struct tcp_cc_ops *tcp_cc_default;
 
 /** This returns a TCP header option for MSS in an u32_t */
 #define TCP_BUILD_MSS_OPTION(mss) htonl(0x02040000 | ((mss) & 0xFFFF))
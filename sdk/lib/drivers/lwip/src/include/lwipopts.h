@@ -64,10 +64,20 @@
  * add support for other transport mediums */
 #define TCP_MSS                         1460
 
-#define TCP_WND                         0xFFFF
+#define LWIP_WND_SCALE                  1
+
+#define TCP_RCV_SCALE                   3
+
+#define TCP_WND                         0x40000
 
 #define TCP_SND_BUF                     TCP_WND
 
+#define LWIP_TCP_SACK                   1
+
+#define TCP_CC_DEFAULT                  (&tcp_cc_cubic)
+
+#define TCP_CONN_STATS                  1
+
 #define TCP_MAXRTX                      8
 
 #define TCP_SYNMAXRTX                   4
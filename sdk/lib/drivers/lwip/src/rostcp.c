@@ -48,6 +48,21 @@ LibTCPDumpPcb(PVOID SocketContext)
     (addr >> 8) & 0xFF,
     addr & 0xFF,
     pcb->remote_port);
+#if TCP_CONN_STATS
+    if (pcb->state != LISTEN)
+    {
+        struct tcp_conn_stats stats;
+
+        tcp_get_conn_stats(pcb, &stats);
+        DbgPrint("\tCongestion control: %s | cwnd: %lu | ssthresh: %lu | srtt: %lu ms\n",
+                 stats.cc_name, stats.cwnd, stats.ssthresh, stats.srtt_ms);
+        DbgPrint("\tWindows: send %lu (scale %u) | receive %lu (scale %u) | SACK: %s\n",
+                 stats.snd_wnd, stats.snd_scale, stats.rcv_wnd, stats.rcv_scale,
+                 stats.sack ? "Yes" : "No");
+        DbgPrint("\tRetransmissions: %lu | fast: %lu | timeouts: %lu\n",
+                 stats.rexmits, stats.fast_rexmits, stats.rto_expired);
+    }
+#endif
 }
 
 static
@@ -854,6 +869,14 @@ LibTCPSetNoDelay(
         pcb->flags &= ~TF_NODELAY;
 }
 
+err_t
+LibTCPSetDefaultCongestionControl(
+    const char *Name)
+{
+    /* Called before the tcpip thread is started */
+    return tcp_set_default_cc(Name);
+}
+
 void
 LibTCPGetSocketStatus(
     PTCP_PCB pcb,
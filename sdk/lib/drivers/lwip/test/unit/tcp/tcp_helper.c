@@ -92,8 +92,8 @@ tcp_create_segment_wnd(ip_addr_t* src_ip, ip_addr_t* dst_ip,
 
   /* calculate checksum */
 
-  tcphdr->chksum = inet_chksum_pseudo(p,
-          IP_PROTO_TCP, p->tot_len, src_ip, dst_ip);
+  tcphdr->chksum = inet_chksum_pseudo(p, src_ip, dst_ip,
+          IP_PROTO_TCP, p->tot_len);
 
   pbuf_header(p, sizeof(struct ip_hdr));
 
@@ -107,7 +107,7 @@ tcp_create_segment(ip_addr_t* src_ip, ip_addr_t* dst_ip,
                    u32_t seqno, u32_t ackno, u8_t headerflags)
 {
   return tcp_create_segment_wnd(src_ip, dst_ip, src_port, dst_port, data,
-    data_len, seqno, ackno, headerflags, TCP_WND);
+    data_len, seqno, ackno, headerflags, (u16_t)LWIP_MIN(TCP_WND, 0xffff));
 }
 
 /** Create a TCP segment usable for passing to tcp_input
@@ -118,8 +118,8 @@ struct pbuf*
 tcp_create_rx_segment(struct tcp_pcb* pcb, void* data, size_t data_len, u32_t seqno_offset,
                       u32_t ackno_offset, u8_t headerflags)
 {
-  return tcp_create_segment(&pcb->remote_ip, &pcb->local_ip, pcb->remote_port, pcb->local_port,
-    data, data_len, pcb->rcv_nxt + seqno_offset, pcb->lastack + ackno_offset, headerflags);
+  return tcp_create_rx_segment_wnd(pcb, data, data_len, seqno_offset, ackno_offset,
+    headerflags, TCP_WND);
 }
 
 /** Create a TCP segment usable for passing to tcp_input
@@ -128,10 +128,12 @@ tcp_create_rx_segment(struct tcp_pcb* pcb, void* data, size_t data_len, u32_t se
  * - TCP window can be adjusted
  */
 struct pbuf* tcp_create_rx_segment_wnd(struct tcp_pcb* pcb, void* data, size_t data_len,
-                   u32_t seqno_offset, u32_t ackno_offset, u8_t headerflags, u16_t wnd)
+                   u32_t seqno_offset, u32_t ackno_offset, u8_t headerflags, u32_t wnd)
 {
+  /* the window is scaled the way the remote host agreed on with pcb */
   return tcp_create_segment_wnd(&pcb->remote_ip, &pcb->local_ip, pcb->remote_port, pcb->local_port,
-    data, data_len, pcb->rcv_nxt + seqno_offset, pcb->lastack + ackno_offset, headerflags, wnd);
+    data, data_len, pcb->rcv_nxt + seqno_offset, pcb->lastack + ackno_offset, headerflags,
+    (u16_t)LWIP_MIN(wnd >> pcb->snd_scale, 0xffff));
 }
 
 /** Safely bring a tcp_pcb into the requested state */
@@ -148,6 +150,15 @@ tcp_set_state(struct tcp_pcb* pcb, enum tcp_state state, ip_addr_t* local_ip,
     pcb->local_port = local_port;
     pcb->remote_ip.addr = remote_ip->addr;
     pcb->remote_port = remote_port;
+#if LWIP_WND_SCALE
+    /* act as if window scaling was agreed on in the handshake, so that the
+       tests can use all of TCP_WND */
+    pcb->flags |= TF_WND_SCALE;
+    pcb->snd_scale = TCP_RCV_SCALE;
+    pcb->rcv_scale = TCP_RCV_SCALE;
+    pcb->rcv_wnd = pcb->rcv_ann_wnd = TCP_WND;
+    pcb->snd_wnd = pcb->snd_wnd_max = TCP_WND;
+#endif /* LWIP_WND_SCALE */
   } else if(state == LISTEN) {
     TCP_REG(&tcp_listen_pcbs.pcbs, pcb);
     pcb->local_ip.addr = local_ip->addr;
@@ -239,18 +250,16 @@ void test_tcp_input(struct pbuf *p, struct netif *inp)
 {
   struct ip_hdr *iphdr = (struct ip_hdr*)p->payload;
   /* these lines are a hack, don't use them as an example :-) */
-  ip_addr_copy(*ipX_current_dest_addr(), iphdr->dest);
-  ip_addr_copy(*ipX_current_src_addr(), iphdr->src);
+  ip_addr_copy(*ip_current_dest_addr(), iphdr->dest);
+  ip_addr_copy(*ip_current_src_addr(), iphdr->src);
   ip_current_netif() = inp;
   ip_current_header() = iphdr;
 
-  /* since adding IPv6, p->payload must point to tcp header, not ip header */
-  pbuf_header(p, -(s16_t)sizeof(struct ip_hdr));
-
+  /* tcp_input() skips the IP header itself */
   tcp_input(p, inp);
 
-  ipX_current_dest_addr()->addr = 0;
-  ipX_current_src_addr()->addr = 0;
+  ip_current_dest_addr()->addr = 0;
+  ip_current_src_addr()->addr = 0;
   ip_current_netif() = NULL;
   ip_current_header() = NULL;
 }
@@ -26,6 +26,9 @@ struct test_tcp_txcounters {
   struct pbuf *tx_packets;
 };
 
+/* Time returned by sys_now(), see lwip_unittests.c */
+extern u32_t lwip_sys_now;
+
 /* Helper functions */
 void tcp_remove_all(void);
 
@@ -35,7 +38,7 @@ struct pbuf* tcp_create_segment(ip_addr_t* src_ip, ip_addr_t* dst_ip,
 struct pbuf* tcp_create_rx_segment(struct tcp_pcb* pcb, void* data, size_t data_len,
                    u32_t seqno_offset, u32_t ackno_offset, u8_t headerflags);
 struct pbuf* tcp_create_rx_segment_wnd(struct tcp_pcb* pcb, void* data, size_t data_len,
-                   u32_t seqno_offset, u32_t ackno_offset, u8_t headerflags, u16_t wnd);
+                   u32_t seqno_offset, u32_t ackno_offset, u8_t headerflags, u32_t wnd);
 void tcp_set_state(struct tcp_pcb* pcb, enum tcp_state state, ip_addr_t* local_ip,
                    ip_addr_t* remote_ip, u16_t local_port, u16_t remote_port);
 void test_tcp_counters_err(void* arg, err_t err);
@@ -323,7 +323,7 @@ START_TEST(test_tcp_fast_rexmit_wraparound)
   err_t err;
 #define SEQNO1 (0xFFFFFF00 - TCP_MSS)
 #define ISS    6510
-  u16_t i, sent_total = 0;
+  u32_t i, sent_total = 0;
   u32_t seqnos[] = {
     SEQNO1,
     SEQNO1 + (1 * TCP_MSS),
@@ -353,6 +353,9 @@ START_TEST(test_tcp_fast_rexmit_wraparound)
   pcb->mss = TCP_MSS;
   /* disable initial congestion window (we don't send a SYN here...) */
   pcb->cwnd = 2*TCP_MSS;
+  /* start in congestion avoidance, so that one ACK opens the window by
+     less than a segment */
+  pcb->ssthresh = pcb->cwnd;
 
   /* send 6 mss-sized segments */
   for (i = 0; i < 6; i++) {
@@ -420,7 +423,7 @@ START_TEST(test_tcp_rto_rexmit_wraparound)
   err_t err;
 #define SEQNO1 (0xFFFFFF00 - TCP_MSS)
 #define ISS    6510
-  u16_t i, sent_total = 0;
+  u32_t i, sent_total = 0;
   u32_t seqnos[] = {
     SEQNO1,
     SEQNO1 + (1 * TCP_MSS),
@@ -508,7 +511,7 @@ static void test_tcp_tx_full_window_lost(u8_t zero_window_probe_from_unsent)
   ip_addr_t remote_ip, local_ip, netmask;
   u16_t remote_port = 0x100, local_port = 0x101;
   err_t err;
-  u16_t sent_total, i;
+  u32_t sent_total, i;
   u8_t expected = 0xFE;
 
   for (i = 0; i < sizeof(tx_data); i++) {
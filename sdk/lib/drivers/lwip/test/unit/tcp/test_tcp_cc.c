@@ -0,0 +1,484 @@
+#include "test_tcp_cc.h"
+
+#include "lwip/tcp_impl.h"
+#include "lwip/stats.h"
+#include "lwip/inet_chksum.h"
+#include "tcp_helper.h"
+
+#if !LWIP_STATS || !TCP_STATS || !MEMP_STATS
+#error "This tests needs TCP- and MEMP-statistics enabled"
+#endif
+#if !LWIP_WND_SCALE || (TCP_WND <= 0xffff) || !LWIP_TCP_SACK || !TCP_QUEUE_OOSEQ
+#error "This tests needs window scaling with TCP_WND > 0xffff, SACK and TCP_QUEUE_OOSEQ enabled"
+#endif
+#if !TCP_CONN_STATS
+#error "This tests needs TCP_CONN_STATS enabled"
+#endif
+
+/* Both ends of a connection run in this stack, each one on its own netif.
+   Everything sent is queued on a simulated link and delivered one step
+   later, so one round trip takes two steps. A step is one fast timer tick,
+   which is also how far sys_now() moves on. */
+
+#define LINK_DELAY      1
+#define LINK_MAX_STEPS  4000
+#define LINK_QUEUE_LEN  1024
+#define TRANSFER_LEN    (512 * 1024UL)
+
+struct link_packet {
+  struct pbuf *p;
+  u32_t due;
+};
+
+static struct link_packet link_queue[LINK_QUEUE_LEN];
+static u32_t link_head, link_count;
+static u32_t link_step;
+/* Data segments sent by the client, and the ones to drop (0-terminated) */
+static u32_t link_data_segs;
+static const u32_t *link_drop;
+
+static struct netif client_netif, server_netif;
+static ip_addr_t client_ip, server_ip, netmask;
+
+static struct tcp_pcb *client_pcb, *server_pcb, *listen_pcb;
+static u32_t client_sent, server_received, server_errors;
+static u8_t client_connected;
+
+/* The client's algorithm, with ssthresh() wrapped to see the window it
+   is called with */
+static struct tcp_cc_ops client_cc;
+static const struct tcp_cc_ops *client_cc_real;
+static tcpwnd_size_t client_loss_wnd;
+
+static u8_t
+test_tcp_cc_pattern(u32_t offset)
+{
+  return (u8_t)(offset * 7 + (offset >> 8));
+}
+
+static err_t
+link_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  struct ip_hdr *iphdr = (struct ip_hdr *)p->payload;
+  struct tcp_hdr *tcphdr;
+  struct pbuf *q;
+  u16_t datalen;
+  u32_t i;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  tcphdr = (struct tcp_hdr *)((u8_t *)iphdr + IPH_HL(iphdr) * 4);
+  datalen = ntohs(IPH_LEN(iphdr)) - IPH_HL(iphdr) * 4 - TCPH_HDRLEN(tcphdr) * 4;
+  if (ip_addr_cmp(&iphdr->src, &client_ip) && (datalen > 0)) {
+    link_data_segs++;
+    for (i = 0; link_drop[i] != 0; i++) {
+      if (link_drop[i] == link_data_segs) {
+        return ERR_OK;
+      }
+    }
+  }
+
+  EXPECT_RETX(link_count < LINK_QUEUE_LEN, ERR_MEM);
+  q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+  EXPECT_RETX(q != NULL, ERR_MEM);
+  EXPECT(pbuf_copy(q, p) == ERR_OK);
+  i = (link_head + link_count) % LINK_QUEUE_LEN;
+  link_queue[i].p = q;
+  link_queue[i].due = link_step + LINK_DELAY;
+  link_count++;
+  return ERR_OK;
+}
+
+static void
+link_init_netif(struct netif *netif, ip_addr_t *ip_addr)
+{
+  memset(netif, 0, sizeof(struct netif));
+  netif->output = link_output;
+  netif->flags |= NETIF_FLAG_UP;
+  netif->mtu = TCP_MSS + 40;
+  ip_addr_copy(netif->netmask, netmask);
+  ip_addr_copy(netif->ip_addr, *ip_addr);
+  netif->next = netif_list;
+  netif_list = netif;
+}
+
+/** Delivers what is due and runs the TCP timers, one step is a fast timer tick */
+static void
+link_run_step(void)
+{
+  struct link_packet *pkt;
+  struct ip_hdr *iphdr;
+
+  link_step++;
+  lwip_sys_now += TCP_TMR_INTERVAL;
+  while ((link_count > 0) && (link_queue[link_head].due <= link_step)) {
+    pkt = &link_queue[link_head];
+    link_head = (link_head + 1) % LINK_QUEUE_LEN;
+    link_count--;
+    iphdr = (struct ip_hdr *)pkt->p->payload;
+    if (ip_addr_cmp(&iphdr->dest, &server_ip)) {
+      test_tcp_input(pkt->p, &server_netif);
+    } else {
+      test_tcp_input(pkt->p, &client_netif);
+    }
+  }
+  tcp_fasttmr();
+  if (link_step & 1) {
+    tcp_slowtmr();
+  }
+}
+
+static void
+client_send_more(struct tcp_pcb *pcb)
+{
+  u8_t buf[1024];
+  u16_t len, i;
+
+  while (client_sent < TRANSFER_LEN) {
+    len = (u16_t)LWIP_MIN(sizeof(buf), TRANSFER_LEN - client_sent);
+    len = (u16_t)LWIP_MIN(len, tcp_sndbuf(pcb));
+    if (len == 0) {
+      break;
+    }
+    for (i = 0; i < len; i++) {
+      buf[i] = test_tcp_cc_pattern(client_sent + i);
+    }
+    if (tcp_write(pcb, buf, len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+      break;
+    }
+    client_sent += len;
+  }
+  tcp_output(pcb);
+}
+
+static err_t
+client_sent_fn(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(len);
+  client_send_more(pcb);
+  return ERR_OK;
+}
+
+static err_t
+client_connected_fn(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  EXPECT(err == ERR_OK);
+  client_connected = 1;
+  client_send_more(pcb);
+  return ERR_OK;
+}
+
+static err_t
+server_recv_fn(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  struct pbuf *q;
+  u16_t i;
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+
+  if (p == NULL) {
+    return ERR_OK;
+  }
+  for (q = p; q != NULL; q = q->next) {
+    for (i = 0; i < q->len; i++) {
+      if (((u8_t *)q->payload)[i] != test_tcp_cc_pattern(server_received + i)) {
+        server_errors++;
+      }
+    }
+    server_received += q->len;
+  }
+  tcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static tcpwnd_size_t
+client_cc_ssthresh(struct tcp_pcb *pcb)
+{
+  client_loss_wnd = LWIP_MIN(pcb->cwnd, pcb->snd_wnd);
+  return client_cc_real->ssthresh(pcb);
+}
+
+static err_t
+server_accept_fn(void *arg, struct tcp_pcb *newpcb, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  EXPECT(err == ERR_OK);
+  server_pcb = newpcb;
+  tcp_recv(newpcb, server_recv_fn);
+  return ERR_OK;
+}
+
+/** Runs a transfer from the client to the server with the given algorithm
+ * and drop list, and returns the client's statistics */
+static void
+test_tcp_cc_transfer(const char *cc, const u32_t *drop, struct tcp_conn_stats *stats)
+{
+  err_t err;
+
+  memset(stats, 0, sizeof(*stats));
+  link_drop = drop;
+  err = tcp_set_default_cc(cc);
+  EXPECT_RET(err == ERR_OK);
+
+  listen_pcb = tcp_new();
+  EXPECT_RET(listen_pcb != NULL);
+  err = tcp_bind(listen_pcb, &server_ip, 80);
+  EXPECT_RET(err == ERR_OK);
+  listen_pcb = tcp_listen(listen_pcb);
+  EXPECT_RET(listen_pcb != NULL);
+  tcp_accept(listen_pcb, server_accept_fn);
+
+  client_pcb = tcp_new();
+  EXPECT_RET(client_pcb != NULL);
+  client_cc_real = client_pcb->cc;
+  client_cc = *client_cc_real;
+  client_cc.ssthresh = client_cc_ssthresh;
+  client_pcb->cc = &client_cc;
+  err = tcp_bind(client_pcb, &client_ip, 0);
+  EXPECT_RET(err == ERR_OK);
+  tcp_sent(client_pcb, client_sent_fn);
+  err = tcp_connect(client_pcb, &server_ip, 80, client_connected_fn);
+  EXPECT_RET(err == ERR_OK);
+
+  /* Run until the client has seen the last ACK */
+  while (((server_received < TRANSFER_LEN) || (client_pcb->unacked != NULL)) &&
+         (link_step < LINK_MAX_STEPS)) {
+    link_run_step();
+  }
+
+  EXPECT(client_connected);
+  EXPECT(server_received == TRANSFER_LEN);
+  EXPECT(server_errors == 0);
+  tcp_get_conn_stats(client_pcb, stats);
+}
+
+/* Setups/teardown functions */
+
+static void
+tcp_cc_setup(void)
+{
+  tcp_remove_all();
+  IP4_ADDR(&client_ip, 192, 168, 1, 1);
+  IP4_ADDR(&server_ip, 192, 168, 2, 1);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  netif_list = NULL;
+  link_init_netif(&client_netif, &client_ip);
+  link_init_netif(&server_netif, &server_ip);
+
+  link_head = link_count = 0;
+  link_step = 0;
+  lwip_sys_now = 0;
+  link_data_segs = 0;
+  client_pcb = server_pcb = listen_pcb = NULL;
+  client_sent = server_received = server_errors = 0;
+  client_connected = 0;
+  client_loss_wnd = 0;
+}
+
+static void
+tcp_cc_teardown(void)
+{
+  /* tcp_abort() doesn't handle listening pcbs */
+  if (listen_pcb != NULL) {
+    tcp_close(listen_pcb);
+  }
+  tcp_remove_all();
+  /* This includes the RSTs sent by tcp_remove_all() */
+  while (link_count > 0) {
+    pbuf_free(link_queue[link_head].p);
+    link_head = (link_head + 1) % LINK_QUEUE_LEN;
+    link_count--;
+  }
+  netif_list = NULL;
+  netif_default = NULL;
+  tcp_set_default_cc("reno");
+}
+
+
+/* Test functions */
+
+/** Unknown algorithms are refused, known ones can be switched at any time */
+START_TEST(test_tcp_cc_select)
+{
+  struct tcp_pcb *pcb;
+  struct tcp_conn_stats stats;
+  LWIP_UNUSED_ARG(_i);
+
+  EXPECT(tcp_set_default_cc("vegas") == ERR_VAL);
+  EXPECT(tcp_set_default_cc("cubic") == ERR_OK);
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  tcp_get_conn_stats(pcb, &stats);
+  EXPECT(strcmp(stats.cc_name, "cubic") == 0);
+  EXPECT(tcp_set_cc(pcb, "vegas") == ERR_VAL);
+  EXPECT(tcp_set_cc(pcb, "reno") == ERR_OK);
+  tcp_get_conn_stats(pcb, &stats);
+  EXPECT(strcmp(stats.cc_name, "reno") == 0);
+  tcp_abort(pcb);
+}
+END_TEST
+
+/** A lossless transfer negotiates window scaling and SACK and grows the
+ * window beyond 64k */
+START_TEST(test_tcp_cc_wnd_scale)
+{
+  static const u32_t drop[] = {0};
+  struct tcp_conn_stats stats;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_cc_transfer("cubic", drop, &stats);
+  EXPECT(stats.snd_scale == TCP_RCV_SCALE);
+  EXPECT(stats.rcv_scale == TCP_RCV_SCALE);
+  EXPECT(stats.sack == 1);
+  EXPECT(stats.snd_wnd > 0xffff);
+  EXPECT(stats.cwnd > 0xffff);
+  EXPECT(stats.rexmits == 0);
+  EXPECT(stats.bytes_acked >= TRANSFER_LEN);
+}
+END_TEST
+
+/** Several segments lost in one window are all recovered without waiting
+ * for the retransmission timer */
+static void
+test_tcp_cc_loss(const char *cc, struct tcp_conn_stats *stats)
+{
+  static const u32_t drop[] = {60, 61, 64, 70, 0};
+
+  test_tcp_cc_transfer(cc, drop, stats);
+  EXPECT(strcmp(stats->cc_name, cc) == 0);
+  EXPECT(stats->fast_rexmits == 1);
+  EXPECT(stats->rto_expired == 0);
+  EXPECT(stats->rexmits >= 4);
+  EXPECT(stats->sack_blocks_in > 0);
+  EXPECT(stats->dupacks_in >= 3);
+  EXPECT(client_loss_wnd > 0);
+}
+
+/** Reno halves the window */
+START_TEST(test_tcp_cc_loss_reno)
+{
+  struct tcp_conn_stats stats;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_cc_loss("reno", &stats);
+  EXPECT(stats.ssthresh == client_loss_wnd / 2);
+}
+END_TEST
+
+/** CUBIC only backs off to 70% and remembers where the loss happened */
+START_TEST(test_tcp_cc_loss_cubic)
+{
+  struct tcp_conn_stats stats;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_cc_loss("cubic", &stats);
+  EXPECT(stats.ssthresh == client_loss_wnd / 10 * 7);
+  EXPECT(client_pcb->cc_state.w_max == client_loss_wnd);
+  /* the window grew along the curve after the recovery */
+  EXPECT(client_pcb->cc_state.epoch_start != 0);
+  EXPECT(stats.cwnd > stats.ssthresh);
+}
+END_TEST
+
+/** Acknowledges rtts windows segment by segment, with ms milliseconds
+ * passing in each round trip */
+static void
+test_tcp_cc_ack_rtts(struct tcp_pcb *pcb, u32_t rtts, u32_t ms)
+{
+  u32_t i, segs;
+
+  while (rtts-- > 0) {
+    lwip_sys_now += ms;
+    segs = pcb->cwnd / pcb->mss;
+    for (i = 0; i < segs; i++) {
+      pcb->cc->cong_avoid(pcb, pcb->mss);
+    }
+  }
+}
+
+/** Lets pcb react to a loss at a window of segs segments */
+static void
+test_tcp_cc_cubic_loss(struct tcp_pcb *pcb, u32_t segs)
+{
+  pcb->cc->init(pcb);
+  pcb->cwnd = segs * pcb->mss;
+  pcb->ssthresh = pcb->cc->ssthresh(pcb);
+  pcb->cwnd = pcb->ssthresh;
+}
+
+/** CUBIC grows the window with the time since the loss, not with the number
+ * of ACKs: concave up to the window of the loss, flat around it, convex
+ * beyond it */
+START_TEST(test_tcp_cc_cubic_growth)
+{
+  struct tcp_pcb *pcb;
+  tcpwnd_size_t wnd_4s, wnd_5s, wnd_7s, wnd_9s;
+  LWIP_UNUSED_ARG(_i);
+
+  pcb = tcp_new();
+  EXPECT_RET(pcb != NULL);
+  EXPECT(tcp_set_cc(pcb, "cubic") == ERR_OK);
+  pcb->mss = 1000;
+  pcb->snd_wnd = TCP_WND;
+  pcb->sa = 0;
+  lwip_sys_now = 1000;
+
+  test_tcp_cc_cubic_loss(pcb, 100);
+  EXPECT(pcb->cwnd == 70 * 1000);
+  EXPECT(pcb->cc_state.w_max == 100 * 1000);
+
+  /* ACKs without time passing only move the Reno friendly estimate,
+     which grows slower than Reno itself (80 segments after 10 RTTs) */
+  test_tcp_cc_ack_rtts(pcb, 10, 0);
+  EXPECT(pcb->cwnd > 70 * 1000);
+  EXPECT(pcb->cwnd < 80 * 1000);
+
+  /* With 100ms round trips the curve reaches the old window after
+     K = cbrt(30 / 0.4) = 4.2s, and it is ahead of Reno after 1s */
+  test_tcp_cc_cubic_loss(pcb, 100);
+  test_tcp_cc_ack_rtts(pcb, 10, 100);
+  EXPECT(pcb->cwnd >= 84 * 1000);
+  test_tcp_cc_ack_rtts(pcb, 30, 100);
+  wnd_4s = pcb->cwnd;
+  EXPECT(wnd_4s >= 97 * 1000);
+  EXPECT(wnd_4s <= 100 * 1000);
+  test_tcp_cc_ack_rtts(pcb, 10, 100);
+  wnd_5s = pcb->cwnd;
+  EXPECT(wnd_5s - wnd_4s <= 2 * 1000);
+
+  /* Beyond it, the window probes faster and faster */
+  test_tcp_cc_ack_rtts(pcb, 20, 100);
+  wnd_7s = pcb->cwnd;
+  test_tcp_cc_ack_rtts(pcb, 20, 100);
+  wnd_9s = pcb->cwnd;
+  EXPECT(wnd_7s - wnd_5s > wnd_5s - wnd_4s);
+  EXPECT(wnd_9s - wnd_7s > wnd_7s - wnd_5s);
+  EXPECT(wnd_9s > 120 * 1000);
+
+  /* A loss below the last maximum releases bandwidth (fast convergence) */
+  pcb->cwnd = 90 * 1000;
+  pcb->ssthresh = pcb->cc->ssthresh(pcb);
+  EXPECT(pcb->ssthresh == 63 * 1000);
+  EXPECT(pcb->cc_state.w_max == 90 * 1000 / 20 * 17);
+
+  tcp_abort(pcb);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+tcp_cc_suite(void)
+{
+  TFun tests[] = {
+    test_tcp_cc_select,
+    test_tcp_cc_wnd_scale,
+    test_tcp_cc_loss_reno,
+    test_tcp_cc_loss_cubic,
+    test_tcp_cc_cubic_growth
+  };
+  return create_suite("TCP_CC", tests, sizeof(tests)/sizeof(TFun), tcp_cc_setup, tcp_cc_teardown);
+}
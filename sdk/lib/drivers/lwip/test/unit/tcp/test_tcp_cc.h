@@ -0,0 +1,8 @@
+#ifndef __TEST_TCP_CC_H__
+#define __TEST_TCP_CC_H__
+
+#include "../lwip_check.h"
+
+Suite *tcp_cc_suite(void);
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * Fast486 386/486 CPU Emulation Library
+ * blockcache.c
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The block cache remembers, for every instruction of a straight-line run of
+ * code, the prefixes that were decoded and the opcode handler that was used,
+ * together with a copy of the code bytes. Replaying a cached instruction skips
+ * the prefix decoding and serves the operand fetches from the saved bytes
+ * instead of going through the memory callbacks.
+ *
+ * Blocks are keyed by their linear address, the CPL and the paging state.
+ * They are invalidated by writes to the physical memory they were read from
+ * (tracked with per-chunk version counters) and whenever the TLB is flushed.
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include "builddep.h"
+
+#include <fast486.h>
+#include "common.h"
+#include "opcodes.h"
+#include "blockcache.h"
+
+/* PRIVATE FUNCTIONS **********************************************************/
+
+static inline BOOLEAN
+FASTCALL
+Fast486BlockUsable(PFAST486_STATE State,
+                   PFAST486_BLOCK Block,
+                   ULONG Offset,
+                   ULONG Start)
+{
+    PFAST486_BLOCK_CACHE BlockCache = State->BlockCache;
+    PFAST486_SEG_REG CodeSegment = &State->SegmentRegs[FAST486_REG_CS];
+    BOOLEAN Paging = !!(State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG);
+
+    /* Check if the block was invalidated */
+    if ((Block->Generation != BlockCache->Generation)
+        || (Block->Versions[0] != BlockCache->Versions[Block->PhysicalAddress
+                                                       >> FAST486_BLOCK_CHUNK_SHIFT])
+        || (Block->Versions[1] != BlockCache->Versions[(Block->PhysicalAddress + Block->Size - 1)
+                                                       >> FAST486_BLOCK_CHUNK_SHIFT]))
+    {
+        return FALSE;
+    }
+
+    /* Check if it was recorded with the same translation and privilege level */
+    if ((Block->Paging != Paging)
+        || (Paging && (Block->PageDirectory != State->ControlRegisters[FAST486_REG_CR3]))
+        || (Block->Cpl != Fast486GetCurrentPrivLevel(State)))
+    {
+        return FALSE;
+    }
+
+    /* The saved code bytes must not be fetched beyond the CS limit */
+    if ((Offset > CodeSegment->Limit)
+        || ((CodeSegment->Limit - Offset) < (ULONG)(Block->Size - Start - 1)))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static PFAST486_BLOCK
+FASTCALL
+Fast486BlockCreate(PFAST486_STATE State,
+                   ULONG LinearAddress,
+                   ULONG Offset)
+{
+    PFAST486_BLOCK_CACHE BlockCache = State->BlockCache;
+    PFAST486_SEG_REG CodeSegment = &State->SegmentRegs[FAST486_REG_CS];
+    PFAST486_BLOCK Block = &BlockCache->Blocks[BLOCK_CACHE_HASH(LinearAddress)];
+    ULONG PhysicalAddress = LinearAddress;
+    ULONG Size = FAST486_BLOCK_MAX_SIZE;
+    INT Cpl = Fast486GetCurrentPrivLevel(State);
+    BOOLEAN Paging = !!(State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG);
+
+    /* Let the interpreter raise the exception */
+    if (Offset > CodeSegment->Limit) return NULL;
+
+    /* A block never crosses a page boundary or the CS limit */
+    Size = min(Size, FAST486_PAGE_SIZE - PAGE_OFFSET(LinearAddress));
+    if ((CodeSegment->Limit - Offset) < (Size - 1)) Size = CodeSegment->Limit - Offset + 1;
+
+    /* The 16-bit instruction pointer wraps around */
+    if (!CodeSegment->Size) Size = min(Size, 0x10000 - Offset);
+
+    if (Paging)
+    {
+        FAST486_PAGE_TABLE TableEntry;
+
+        TableEntry.Value = Fast486GetPageTableEntry(State, LinearAddress, FALSE);
+        if (!TableEntry.Present || (!TableEntry.Usermode && (Cpl > 0))) return NULL;
+
+        PhysicalAddress = (TableEntry.Address << 12) | PAGE_OFFSET(LinearAddress);
+    }
+
+    /* Only writes to the beginning of the physical memory are tracked */
+    if (((PhysicalAddress + Size - 1) >> FAST486_BLOCK_CHUNK_SHIFT) >= FAST486_BLOCK_CHUNKS)
+    {
+        return NULL;
+    }
+
+    /* Save the code bytes */
+    State->MemReadCallback(State, PhysicalAddress, Block->Code, Size);
+
+    Block->Address = LinearAddress;
+    Block->PhysicalAddress = PhysicalAddress;
+    Block->PageDirectory = State->ControlRegisters[FAST486_REG_CR3];
+    Block->Generation = BlockCache->Generation;
+    Block->Versions[0] = BlockCache->Versions[PhysicalAddress >> FAST486_BLOCK_CHUNK_SHIFT];
+    Block->Versions[1] = BlockCache->Versions[(PhysicalAddress + Size - 1)
+                                              >> FAST486_BLOCK_CHUNK_SHIFT];
+    Block->Cpl = (UCHAR)Cpl;
+    Block->Paging = Paging;
+    Block->Size = (UCHAR)Size;
+    Block->InstructionCount = 0;
+
+    return Block;
+}
+
+/* PUBLIC FUNCTIONS ***********************************************************/
+
+BOOLEAN
+FASTCALL
+Fast486BlockCacheStep(PFAST486_STATE State)
+{
+    PFAST486_BLOCK_CACHE BlockCache = State->BlockCache;
+    PFAST486_SEG_REG CodeSegment = &State->SegmentRegs[FAST486_REG_CS];
+    PFAST486_BLOCK Block = State->CurrentBlock;
+    PFAST486_BLOCK_INSTRUCTION Instruction;
+    ULONG Offset, LinearAddress;
+
+    ASSERT(BlockCache != NULL);
+    ASSERT(State->PrefixFlags == 0);
+
+    Offset = (CodeSegment->Size) ? State->InstPtr.Long
+                                 : State->InstPtr.LowWord;
+    LinearAddress = CodeSegment->Base + Offset;
+
+    if (Block != NULL)
+    {
+        if (State->BlockRecording)
+        {
+            /* Keep recording as long as execution falls through inside the block */
+            if ((Block->InstructionCount > 0)
+                && (LinearAddress > (Block->Address
+                                  + Block->Instructions[Block->InstructionCount - 1].Start))
+                && (LinearAddress < (Block->Address + Block->Size)))
+            {
+                return FALSE;
+            }
+
+            State->BlockRecording = FALSE;
+            Block = NULL;
+        }
+        else if ((State->BlockIndex >= Block->InstructionCount)
+                 || (LinearAddress != (Block->Address
+                                       + Block->Instructions[State->BlockIndex].Start))
+                 || !Fast486BlockUsable(State,
+                                        Block,
+                                        Offset,
+                                        Block->Instructions[State->BlockIndex].Start))
+        {
+            /* Execution left the block */
+            Block = NULL;
+        }
+    }
+
+    if (Block == NULL)
+    {
+        /* Look up the block starting at this address */
+        Block = &BlockCache->Blocks[BLOCK_CACHE_HASH(LinearAddress)];
+
+        if ((Block->Address != LinearAddress)
+            || (Block->InstructionCount == 0)
+            || !Fast486BlockUsable(State, Block, Offset, 0))
+        {
+            BlockCache->Misses++;
+
+            /* Record a new block while the interpreter executes it */
+            State->CurrentBlock = Fast486BlockCreate(State, LinearAddress, Offset);
+            State->BlockRecording = (State->CurrentBlock != NULL);
+            State->BlockIndex = 0;
+            return FALSE;
+        }
+
+        BlockCache->Hits++;
+        State->CurrentBlock = Block;
+        State->BlockIndex = 0;
+    }
+
+    Instruction = &Block->Instructions[State->BlockIndex++];
+
+    /* Restore the decoded prefixes and skip them along with the opcode */
+    State->PrefixFlags = Instruction->PrefixFlags;
+    State->SegmentOverride = Instruction->SegmentOverride;
+
+    if (CodeSegment->Size) State->InstPtr.Long += Instruction->OpcodeOffset + 1;
+    else State->InstPtr.LowWord += Instruction->OpcodeOffset + 1;
+
+    /* Call the opcode handler, fetching the operands from the block */
+    State->BlockFetch = TRUE;
+    ((FAST486_OPCODE_HANDLER_PROC)Instruction->Handler)(State, Instruction->Opcode);
+    State->BlockFetch = FALSE;
+
+    return TRUE;
+}
+
+VOID
+FASTCALL
+Fast486BlockCacheRecord(PFAST486_STATE State,
+                        FAST486_OPCODE_HANDLER_PROC Handler,
+                        UCHAR Opcode)
+{
+    PFAST486_BLOCK Block = State->CurrentBlock;
+    PFAST486_SEG_REG CodeSegment = &State->SegmentRegs[FAST486_REG_CS];
+    PFAST486_BLOCK_INSTRUCTION Instruction;
+    ULONG Start, OpcodeOffset;
+
+    ASSERT(State->BlockRecording && (Block != NULL));
+    ASSERT(Block->InstructionCount < FAST486_BLOCK_MAX_INSTRUCTIONS);
+
+    if (CodeSegment->Size)
+    {
+        Start = CodeSegment->Base + State->SavedInstPtr.Long - Block->Address;
+        OpcodeOffset = State->InstPtr.Long - State->SavedInstPtr.Long - 1;
+    }
+    else
+    {
+        Start = CodeSegment->Base + State->SavedInstPtr.LowWord - Block->Address;
+        OpcodeOffset = (USHORT)(State->InstPtr.LowWord - State->SavedInstPtr.LowWord - 1);
+    }
+
+    if ((Start >= Block->Size) || (OpcodeOffset >= (ULONG)(Block->Size - Start)))
+    {
+        /* The instruction doesn't start inside the block, stop here */
+        State->BlockRecording = FALSE;
+        return;
+    }
+
+    Instruction = &Block->Instructions[Block->InstructionCount++];
+    State->BlockIndex = Block->InstructionCount;
+
+    Instruction->Handler = (PVOID)Handler;
+    Instruction->PrefixFlags = State->PrefixFlags;
+    Instruction->Start = (UCHAR)Start;
+    Instruction->OpcodeOffset = (UCHAR)OpcodeOffset;
+    Instruction->Opcode = Opcode;
+    Instruction->SegmentOverride = (UCHAR)State->SegmentOverride;
+
+    /* Check if the block is full */
+    if (Block->InstructionCount == FAST486_BLOCK_MAX_INSTRUCTIONS) State->BlockRecording = FALSE;
+}
+
+/* EOF */
@@ -0,0 +1,49 @@
+/*
+ * Fast486 386/486 CPU Emulation Library
+ * blockcache.h
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _BLOCKCACHE_H_
+#define _BLOCKCACHE_H_
+
+#pragma once
+
+/* DEFINES ********************************************************************/
+
+#define BLOCK_CACHE_HASH(x) (((x) ^ ((x) >> 10)) & (FAST486_BLOCK_CACHE_ENTRIES - 1))
+
+/* FUNCTIONS ******************************************************************/
+
+BOOLEAN
+FASTCALL
+Fast486BlockCacheStep
+(
+    PFAST486_STATE State
+);
+
+VOID
+FASTCALL
+Fast486BlockCacheRecord
+(
+    PFAST486_STATE State,
+    FAST486_OPCODE_HANDLER_PROC Handler,
+    UCHAR Opcode
+);
+
+#endif // _BLOCKCACHE_H_
+
+/* EOF */
@@ -0,0 +1,76 @@
+/*
+ * Fast486 386/486 CPU Emulation Library
+ * builddep.h
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _BUILDDEP_H_
+#define _BUILDDEP_H_
+
+#pragma once
+
+#ifdef FAST486_HOST
+
+/* Definitions native to the host on which we're building */
+
+#include <typedefs.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#define FORCEINLINE __forceinline
+#else
+#define FORCEINLINE static __inline__ __attribute__((always_inline))
+#endif
+
+#if !defined(_M_IX86) && !defined(__i386__)
+/* Only x86 has a fastcall convention */
+#define FASTCALL
+#endif
+
+#define C_ASSERT(expr) extern char (*c_assert(void)) [(expr) ? 1 : -1]
+#define UNREFERENCED_PARAMETER(P) ((void)(P))
+
+#ifndef min
+#define min(a, b)  (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifndef max
+#define max(a, b)  (((a) > (b)) ? (a) : (b))
+#endif
+
+#define RtlFillMemory(Destination, Length, Fill) memset(Destination, Fill, Length)
+#define DbgPrint printf
+#define UlongToPtr(ul) ((PVOID)(ULONG_PTR)(ul))
+
+typedef LONGLONG *PLONGLONG;
+typedef ULONGLONG *PULONGLONG;
+
+#else /* ! defined(FAST486_HOST) */
+
+/* ReactOS definitions */
+
+#include <windef.h>
+
+// #define NDEBUG
+#include <debug.h>
+
+#endif /* FAST486_HOST */
+
+#endif // _BUILDDEP_H_
+
+/* EOF */
@@ -21,10 +21,7 @@
 
 /* INCLUDES *******************************************************************/
 
-#include <windef.h>
-
-// #define NDEBUG
-#include <debug.h>
+#include "builddep.h"
 
 #include <fast486.h>
 #include "common.h"
@@ -246,6 +243,66 @@ Fast486WriteMemory(PFAST486_STATE State,
     return Fast486WriteLinearMemory(State, LinearAddress, Buffer, Size, TRUE);
 }
 
+PFAST486_HOST_TLB_ENTRY
+FASTCALL
+Fast486FillHostTlb(PFAST486_STATE State,
+                   ULONG LinearAddress,
+                   BOOLEAN Write,
+                   ULONG Tag)
+{
+    PFAST486_HOST_TLB_ENTRY Entry = &State->HostTlb[(LinearAddress >> 12)
+                                                    & (FAST486_HOST_TLB_ENTRIES - 1)];
+    ULONG PhysicalPage = PAGE_ALIGN(LinearAddress);
+    PUCHAR HostPage = NULL;
+    ULONG i;
+
+    if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
+    {
+        FAST486_PAGE_TABLE TableEntry;
+
+        /* Get the table entry */
+        TableEntry.Value = Fast486GetPageTableEntry(State, PAGE_ALIGN(LinearAddress), Write);
+
+        /* Anything that would fault is left to the slow path */
+        if (!TableEntry.Present) return NULL;
+        if ((Tag & HOST_TLB_USER) && !TableEntry.Usermode) return NULL;
+
+        if (Write
+            && (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_WP)
+            && !TableEntry.Writeable)
+        {
+            return NULL;
+        }
+
+        PhysicalPage = TableEntry.Address << 12;
+    }
+
+    /* Find the RAM range containing the page */
+    for (i = 0; i < State->RamRangeCount; i++)
+    {
+        PFAST486_RAM_RANGE Range = &State->RamRanges[i];
+
+        if ((PhysicalPage - Range->Address) < Range->Size)
+        {
+            HostPage = Range->HostAddress + (PhysicalPage - Range->Address);
+            break;
+        }
+    }
+
+    /* Everything else is MMIO and must go through the callbacks */
+    if (HostPage == NULL) return NULL;
+
+    /* The write permission is only kept if the entry maps the same page */
+    if (Entry->ReadTag != Tag) Entry->WriteTag = 0;
+
+    Entry->ReadTag = Tag;
+    if (Write) Entry->WriteTag = Tag;
+    Entry->PhysicalPage = PhysicalPage;
+    Entry->HostPage = HostPage;
+
+    return Entry;
+}
+
 static inline BOOLEAN
 FASTCALL
 Fast486GetIntVector(PFAST486_STATE State,
@@ -70,6 +70,8 @@ if (State->PrefixFlags & FAST486_PREFIX_LOCK)\
 #define GET_ADDR_PTE(x) (((x) >> 12) & 0x3FF)
 #define INVALID_TLB_FIELD 0xFFFFFFFF
 #define NUM_TLB_ENTRIES 0x100000
+#define HOST_TLB_VALID  (1 << 0)
+#define HOST_TLB_USER   (1 << 1)
 
 typedef struct _FAST486_MOD_REG_RM
 {
@@ -159,6 +161,16 @@ Fast486WriteMemory
     ULONG Size
 );
 
+PFAST486_HOST_TLB_ENTRY
+FASTCALL
+Fast486FillHostTlb
+(
+    PFAST486_STATE State,
+    ULONG LinearAddress,
+    BOOLEAN Write,
+    ULONG Tag
+);
+
 BOOLEAN
 FASTCALL
 Fast486PerformInterrupt
@@ -60,6 +60,56 @@ Fast486GetCurrentPrivLevel(PFAST486_STATE State)
     return (!State->Flags.Vm) ? State->Cpl : 3;
 }
 
+FORCEINLINE
+VOID
+FASTCALL
+Fast486FlushBlockCache(PFAST486_STATE State)
+{
+    PFAST486_BLOCK_CACHE BlockCache = State->BlockCache;
+
+    if (BlockCache == NULL) return;
+
+    /* Blocks from older generations are never used again */
+    if (++BlockCache->Generation == 0)
+    {
+        /* The counter wrapped, so make sure no stale block can match */
+        RtlZeroMemory(BlockCache->Blocks, sizeof(BlockCache->Blocks));
+        BlockCache->Generation = 1;
+    }
+
+    State->CurrentBlock = NULL;
+    State->BlockRecording = FALSE;
+    State->BlockFetch = FALSE;
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486BlockCacheWrite(PFAST486_STATE State,
+                       ULONG PhysicalAddress,
+                       ULONG Size)
+{
+    PFAST486_BLOCK_CACHE BlockCache = State->BlockCache;
+    PFAST486_BLOCK Block = State->CurrentBlock;
+    ULONG Chunk, LastChunk;
+
+    if ((BlockCache == NULL) || (Size == 0)) return;
+
+    /* Bump the version of every chunk that was written to */
+    Chunk = PhysicalAddress >> FAST486_BLOCK_CHUNK_SHIFT;
+    LastChunk = min((PhysicalAddress + Size - 1) >> FAST486_BLOCK_CHUNK_SHIFT,
+                    FAST486_BLOCK_CHUNKS - 1);
+    for (; Chunk <= LastChunk; Chunk++) BlockCache->Versions[Chunk]++;
+
+    if (State->BlockFetch
+        && (PhysicalAddress < (Block->PhysicalAddress + Block->Size))
+        && ((PhysicalAddress + Size) > Block->PhysicalAddress))
+    {
+        /* The current instruction modified itself, fetch the rest from memory */
+        State->BlockFetch = FALSE;
+    }
+}
+
 FORCEINLINE
 ULONG
 FASTCALL
@@ -100,6 +150,9 @@ Fast486GetPageTableEntry(PFAST486_STATE State,
                                 PageDirectory + PdeIndex * sizeof(ULONG),
                                 &DirectoryEntry.Value,
                                 sizeof(DirectoryEntry));
+        Fast486BlockCacheWrite(State,
+                               PageDirectory + PdeIndex * sizeof(ULONG),
+                               sizeof(DirectoryEntry));
     }
 
     /* Read the table entry */
@@ -125,6 +178,10 @@ Fast486GetPageTableEntry(PFAST486_STATE State,
                                 + PteIndex * sizeof(ULONG),
                                 &TableEntry.Value,
                                 sizeof(TableEntry));
+        Fast486BlockCacheWrite(State,
+                               (DirectoryEntry.TableAddress << 12)
+                               + PteIndex * sizeof(ULONG),
+                               sizeof(TableEntry));
     }
 
     /*
@@ -145,11 +202,85 @@ Fast486GetPageTableEntry(PFAST486_STATE State,
     return TableEntry.Value;
 }
 
+FORCEINLINE
+VOID
+FASTCALL
+Fast486FlushHostTlb(PFAST486_STATE State)
+{
+    if (State->RamRangeCount == 0) return;
+    RtlZeroMemory(State->HostTlb, sizeof(State->HostTlb));
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486InvalidateHostTlb(PFAST486_STATE State, ULONG LinearAddress)
+{
+    PFAST486_HOST_TLB_ENTRY Entry = &State->HostTlb[(LinearAddress >> 12)
+                                                    & (FAST486_HOST_TLB_ENTRIES - 1)];
+
+    Entry->ReadTag = Entry->WriteTag = 0;
+}
+
+FORCEINLINE
+PFAST486_HOST_TLB_ENTRY
+FASTCALL
+Fast486GetHostTlbEntry(PFAST486_STATE State,
+                       ULONG LinearAddress,
+                       BOOLEAN Write)
+{
+    PFAST486_HOST_TLB_ENTRY Entry = &State->HostTlb[(LinearAddress >> 12)
+                                                    & (FAST486_HOST_TLB_ENTRIES - 1)];
+    ULONG Tag = PAGE_ALIGN(LinearAddress) | HOST_TLB_VALID;
+
+    /* Entries filled by supervisor code can't be used by user code */
+    if (Fast486GetCurrentPrivLevel(State) > 0) Tag |= HOST_TLB_USER;
+
+    if ((Write ? Entry->WriteTag : Entry->ReadTag) == Tag)
+    {
+        /* TLB hit */
+        return Entry;
+    }
+
+    return Fast486FillHostTlb(State, LinearAddress, Write, Tag);
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486CopyHostMemory(PVOID Destination,
+                      PVOID Source,
+                      ULONG Address,
+                      ULONG Size)
+{
+    /* Aligned accesses are done with a single load and store */
+    if ((Size == sizeof(ULONG)) && !(Address & (sizeof(ULONG) - 1)))
+    {
+        *(PULONG)Destination = *(PULONG)Source;
+    }
+    else if ((Size == sizeof(USHORT)) && !(Address & (sizeof(USHORT) - 1)))
+    {
+        *(PUSHORT)Destination = *(PUSHORT)Source;
+    }
+    else if (Size == sizeof(UCHAR))
+    {
+        *(PUCHAR)Destination = *(PUCHAR)Source;
+    }
+    else
+    {
+        RtlCopyMemory(Destination, Source, Size);
+    }
+}
+
 FORCEINLINE
 VOID
 FASTCALL
 Fast486FlushTlb(PFAST486_STATE State)
 {
+    /* The cached blocks depend on the address translation */
+    Fast486FlushBlockCache(State);
+    Fast486FlushHostTlb(State);
+
     if (!State->Tlb || State->TlbEmpty) return;
     RtlFillMemory(State->Tlb, NUM_TLB_ENTRIES * sizeof(ULONG), 0xFF);
     State->TlbEmpty = TRUE;
@@ -164,6 +295,22 @@ Fast486ReadLinearMemory(PFAST486_STATE State,
                         ULONG Size,
                         BOOLEAN CheckPrivilege)
 {
+    if (State->RamRangeCount && CheckPrivilege
+        && ((PAGE_OFFSET(LinearAddress) + Size) <= FAST486_PAGE_SIZE))
+    {
+        PFAST486_HOST_TLB_ENTRY Entry = Fast486GetHostTlbEntry(State, LinearAddress, FALSE);
+
+        if (Entry != NULL)
+        {
+            /* The page is RAM, read it directly */
+            Fast486CopyHostMemory(Buffer,
+                                  Entry->HostPage + PAGE_OFFSET(LinearAddress),
+                                  LinearAddress,
+                                  Size);
+            return TRUE;
+        }
+    }
+
     /* Check if paging is enabled */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
     {
@@ -234,6 +381,25 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
                          ULONG Size,
                          BOOLEAN CheckPrivilege)
 {
+    if (State->RamRangeCount && CheckPrivilege
+        && ((PAGE_OFFSET(LinearAddress) + Size) <= FAST486_PAGE_SIZE))
+    {
+        PFAST486_HOST_TLB_ENTRY Entry = Fast486GetHostTlbEntry(State, LinearAddress, TRUE);
+
+        if (Entry != NULL)
+        {
+            /* The page is RAM, write it directly */
+            Fast486CopyHostMemory(Entry->HostPage + PAGE_OFFSET(LinearAddress),
+                                  Buffer,
+                                  LinearAddress,
+                                  Size);
+            Fast486BlockCacheWrite(State,
+                                   Entry->PhysicalPage | PAGE_OFFSET(LinearAddress),
+                                   Size);
+            return TRUE;
+        }
+    }
+
     /* Check if paging is enabled */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
     {
@@ -285,6 +451,7 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
                                     (TableEntry.Address << 12) | PageOffset,
                                     (PVOID)((ULONG_PTR)Buffer + BufferOffset),
                                     PageLength);
+            Fast486BlockCacheWrite(State, (TableEntry.Address << 12) | PageOffset, PageLength);
 
             BufferOffset += PageLength;
         }
@@ -293,6 +460,7 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
     {
         /* Write the memory */
         State->MemWriteCallback(State, LinearAddress, Buffer, Size);
+        Fast486BlockCacheWrite(State, LinearAddress, Size);
     }
 
     return TRUE;
@@ -861,18 +1029,17 @@ Fast486FetchByte(PFAST486_STATE State,
 {
     PFAST486_SEG_REG CachedDescriptor;
     ULONG Offset;
-#ifndef FAST486_NO_PREFETCH
     ULONG LinearAddress;
-#endif
 
     /* Get the cached descriptor of CS */
     CachedDescriptor = &State->SegmentRegs[FAST486_REG_CS];
 
     Offset = (CachedDescriptor->Size) ? State->InstPtr.Long
                                       : State->InstPtr.LowWord;
-#ifndef FAST486_NO_PREFETCH
     LinearAddress = CachedDescriptor->Base + Offset;
 
+#ifndef FAST486_NO_PREFETCH
+
     if (State->PrefetchValid
         && (LinearAddress >= State->PrefetchAddress)
         && ((LinearAddress + sizeof(UCHAR)) <= (State->PrefetchAddress + FAST486_CACHE_SIZE)))
@@ -881,6 +1048,14 @@ Fast486FetchByte(PFAST486_STATE State,
     }
     else
 #endif
+    if (State->BlockFetch
+        && (LinearAddress >= State->CurrentBlock->Address)
+        && ((LinearAddress + sizeof(UCHAR)) <= (State->CurrentBlock->Address + State->CurrentBlock->Size)))
+    {
+        /* Use the code bytes saved in the block */
+        *Data = *(PUCHAR)&State->CurrentBlock->Code[LinearAddress - State->CurrentBlock->Address];
+    }
+    else
     {
         /* Read from memory */
         if (!Fast486ReadMemory(State,
@@ -910,18 +1085,16 @@ Fast486FetchWord(PFAST486_STATE State,
 {
     PFAST486_SEG_REG CachedDescriptor;
     ULONG Offset;
-#ifndef FAST486_NO_PREFETCH
     ULONG LinearAddress;
-#endif
 
     /* Get the cached descriptor of CS */
     CachedDescriptor = &State->SegmentRegs[FAST486_REG_CS];
 
     Offset = (CachedDescriptor->Size) ? State->InstPtr.Long
                                       : State->InstPtr.LowWord;
+    LinearAddress = CachedDescriptor->Base + Offset;
 
 #ifndef FAST486_NO_PREFETCH
-    LinearAddress = CachedDescriptor->Base + Offset;
 
     if (State->PrefetchValid
         && (LinearAddress >= State->PrefetchAddress)
@@ -931,6 +1104,14 @@ Fast486FetchWord(PFAST486_STATE State,
     }
     else
 #endif
+    if (State->BlockFetch
+        && (LinearAddress >= State->CurrentBlock->Address)
+        && ((LinearAddress + sizeof(USHORT)) <= (State->CurrentBlock->Address + State->CurrentBlock->Size)))
+    {
+        /* Use the code bytes saved in the block */
+        *Data = *(PUSHORT)&State->CurrentBlock->Code[LinearAddress - State->CurrentBlock->Address];
+    }
+    else
     {
         /* Read from memory */
         // FIXME: Fix byte order on big-endian machines
@@ -961,18 +1142,16 @@ Fast486FetchDword(PFAST486_STATE State,
 {
     PFAST486_SEG_REG CachedDescriptor;
     ULONG Offset;
-#ifndef FAST486_NO_PREFETCH
     ULONG LinearAddress;
-#endif
 
     /* Get the cached descriptor of CS */
     CachedDescriptor = &State->SegmentRegs[FAST486_REG_CS];
 
     Offset = (CachedDescriptor->Size) ? State->InstPtr.Long
                                       : State->InstPtr.LowWord;
+    LinearAddress = CachedDescriptor->Base + Offset;
 
 #ifndef FAST486_NO_PREFETCH
-    LinearAddress = CachedDescriptor->Base + Offset;
 
     if (State->PrefetchValid
         && (LinearAddress >= State->PrefetchAddress)
@@ -982,6 +1161,14 @@ Fast486FetchDword(PFAST486_STATE State,
     }
     else
 #endif
+    if (State->BlockFetch
+        && (LinearAddress >= State->CurrentBlock->Address)
+        && ((LinearAddress + sizeof(ULONG)) <= (State->CurrentBlock->Address + State->CurrentBlock->Size)))
+    {
+        /* Use the code bytes saved in the block */
+        *Data = *(PULONG)&State->CurrentBlock->Code[LinearAddress - State->CurrentBlock->Address];
+    }
+    else
     {
         /* Read from memory */
         // FIXME: Fix byte order on big-endian machines
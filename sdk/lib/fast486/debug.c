@@ -21,15 +21,13 @@
 
 /* INCLUDES *******************************************************************/
 
-#include <windef.h>
-
-// #define NDEBUG
-#include <debug.h>
+#include "builddep.h"
 
 #include <fast486.h>
 #include "common.h"
 #include "opcodes.h"
 #include "fpu.h"
+#include "blockcache.h"
 
 /* DEFINES ********************************************************************/
 
@@ -66,6 +64,13 @@ NextInst:
             {
                 State->SavedInstPtr = State->InstPtr;
                 State->SavedStackPtr = State->GeneralRegs[FAST486_REG_ESP];
+
+                /* Try to execute it from the block cache */
+                if (State->BlockCache && Fast486BlockCacheStep(State))
+                {
+                    State->PrefixFlags = 0;
+                    goto Executed;
+                }
             }
 
             /* Perform an instruction fetch */
@@ -80,6 +85,13 @@ NextInst:
 
             /* Call the opcode handler */
             CurrentHandler = Fast486OpcodeHandlers[Opcode];
+
+            if (State->BlockRecording && (CurrentHandler != Fast486OpcodePrefix))
+            {
+                /* Save the decoded instruction in the block being recorded */
+                Fast486BlockCacheRecord(State, CurrentHandler, Opcode);
+            }
+
             CurrentHandler(State, Opcode);
 
             /* If this is a prefix, go to the next instruction immediately */
@@ -89,6 +101,7 @@ NextInst:
             State->PrefixFlags = 0;
         }
 
+Executed:
         /*
          * Check if there is an interrupt to execute, or a hardware interrupt signal
          * while interrupts are enabled.
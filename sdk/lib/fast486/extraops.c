@@ -21,10 +21,7 @@
 
 /* INCLUDES *******************************************************************/
 
-#include <windef.h>
-
-// #define NDEBUG
-#include <debug.h>
+#include "builddep.h"
 
 #include <fast486.h>
 #include "opcodes.h"
@@ -645,6 +642,11 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeLoadControlReg)
         /* Flush the TLB */
         Fast486FlushTlb(State);
     }
+    else if (ModRegRm.Register == (INT)FAST486_REG_CR0)
+    {
+        /* The host TLB depends on the paging and write protection bits */
+        Fast486FlushHostTlb(State);
+    }
 
     /* Load a value to the control register */
     State->ControlRegisters[ModRegRm.Register] = Value;
@@ -21,10 +21,7 @@
 
 /* INCLUDES *******************************************************************/
 
-#include <windef.h>
-
-// #define NDEBUG
-#include <debug.h>
+#include "builddep.h"
 
 #include <fast486.h>
 #include "common.h"
@@ -122,6 +119,10 @@ Fast486Initialize(PFAST486_STATE         State,
     /* Set the TLB (if given) */
     State->Tlb = Tlb;
 
+    /* The block cache and the RAM ranges are set up later by the caller */
+    State->BlockCache = NULL;
+    State->RamRangeCount = 0;
+
     /* Reset the CPU */
     Fast486Reset(State);
 }
@@ -132,7 +133,7 @@ Fast486Reset(PFAST486_STATE State)
 {
     FAST486_SEG_REGS i;
 
-    /* Save the callbacks and TLB */
+    /* Save the callbacks, TLB, block cache and RAM ranges */
     FAST486_MEM_READ_PROC  MemReadCallback  = State->MemReadCallback;
     FAST486_MEM_WRITE_PROC MemWriteCallback = State->MemWriteCallback;
     FAST486_IO_READ_PROC   IoReadCallback   = State->IoReadCallback;
@@ -141,6 +142,11 @@ Fast486Reset(PFAST486_STATE State)
     FAST486_INT_ACK_PROC   IntAckCallback   = State->IntAckCallback;
     FAST486_FPU_PROC       FpuCallback      = State->FpuCallback;
     PULONG                 Tlb              = State->Tlb;
+    PFAST486_BLOCK_CACHE   BlockCache       = State->BlockCache;
+    ULONG                  RamRangeCount    = State->RamRangeCount;
+    FAST486_RAM_RANGE      RamRanges[FAST486_MAX_RAM_RANGES];
+
+    RtlCopyMemory(RamRanges, State->RamRanges, sizeof(RamRanges));
 
     /* Clear the entire structure */
     RtlZeroMemory(State, sizeof(*State));
@@ -186,7 +192,7 @@ Fast486Reset(PFAST486_STATE State)
     State->FpuTag = 0xFFFF;
 #endif
 
-    /* Restore the callbacks and TLB */
+    /* Restore the callbacks, TLB, block cache and RAM ranges */
     State->MemReadCallback  = MemReadCallback;
     State->MemWriteCallback = MemWriteCallback;
     State->IoReadCallback   = IoReadCallback;
@@ -195,8 +201,11 @@ Fast486Reset(PFAST486_STATE State)
     State->IntAckCallback   = IntAckCallback;
     State->FpuCallback      = FpuCallback;
     State->Tlb              = Tlb;
+    State->BlockCache       = BlockCache;
+    State->RamRangeCount    = RamRangeCount;
+    RtlCopyMemory(State->RamRanges, RamRanges, sizeof(RamRanges));
 
-    /* Flush the TLB */
+    /* Flush the TLB and the block cache */
     Fast486FlushTlb(State);
 }
 
@@ -258,6 +267,81 @@ Fast486Rewind(PFAST486_STATE State)
 #ifndef FAST486_NO_PREFETCH
     State->PrefetchValid = FALSE;
 #endif
+
+    /* Restart the instruction from memory */
+    State->BlockFetch = FALSE;
+}
+
+VOID
+NTAPI
+Fast486SetBlockCache(PFAST486_STATE State, PFAST486_BLOCK_CACHE BlockCache)
+{
+    if (BlockCache != NULL)
+    {
+        /* Start with an empty cache */
+        RtlZeroMemory(BlockCache, sizeof(*BlockCache));
+        BlockCache->Generation = 1;
+    }
+
+    State->BlockCache = BlockCache;
+    State->CurrentBlock = NULL;
+    State->BlockRecording = FALSE;
+    State->BlockFetch = FALSE;
+}
+
+VOID
+NTAPI
+Fast486InvalidateBlockCache(PFAST486_STATE State, ULONG Address, ULONG Size)
+{
+    /* This must be called when physical memory is modified without the CPU */
+    Fast486BlockCacheWrite(State, Address, Size);
+}
+
+BOOLEAN
+NTAPI
+Fast486RegisterRam(PFAST486_STATE State, ULONG Address, ULONG Size, PVOID HostAddress)
+{
+    PFAST486_RAM_RANGE Range;
+
+    /* The range must cover whole pages and the host buffer must be aligned */
+    if ((Size == 0)
+        || PAGE_OFFSET(Address)
+        || PAGE_OFFSET(Size)
+        || ((Address + Size - 1) < Address)
+        || ((ULONG_PTR)HostAddress & (sizeof(ULONG) - 1)))
+    {
+        return FALSE;
+    }
+
+    if (State->RamRangeCount == FAST486_MAX_RAM_RANGES) return FALSE;
+
+    Range = &State->RamRanges[State->RamRangeCount++];
+    Range->Address = Address;
+    Range->Size = Size;
+    Range->HostAddress = (PUCHAR)HostAddress;
+
+    /* Pages that were MMIO before may be RAM now */
+    RtlZeroMemory(State->HostTlb, sizeof(State->HostTlb));
+    return TRUE;
+}
+
+VOID
+NTAPI
+Fast486UnregisterRam(PFAST486_STATE State, ULONG Address)
+{
+    ULONG i;
+
+    for (i = 0; i < State->RamRangeCount; i++)
+    {
+        if (State->RamRanges[i].Address != Address) continue;
+
+        /* Move the last range in its place */
+        State->RamRanges[i] = State->RamRanges[--State->RamRangeCount];
+        break;
+    }
+
+    /* Make sure no stale host pointer is used */
+    RtlZeroMemory(State->HostTlb, sizeof(State->HostTlb));
 }
 
 /* EOF */
@@ -21,10 +21,7 @@
 
 /* INCLUDES *******************************************************************/
 
-#include <windef.h>
-
-// #define NDEBUG
-#include <debug.h>
+#include "builddep.h"
 
 #include <fast486.h>
 #include "common.h"
@@ -21,10 +21,7 @@
 
 /* INCLUDES *******************************************************************/
 
-#include <windef.h>
-
-// #define NDEBUG
-#include <debug.h>
+#include "builddep.h"
 
 #include <fast486.h>
 #include "opcodes.h"
@@ -2284,6 +2281,11 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeGroup0F01)
                 State->Tlb[ModRegRm.MemoryAddress >> 12] = INVALID_TLB_FIELD;
             }
 
+            Fast486InvalidateHostTlb(State, ModRegRm.MemoryAddress);
+
+            /* Blocks on that page may now be translated differently */
+            Fast486FlushBlockCache(State);
+
             break;
         }
 
@@ -195,6 +195,10 @@ RtlpInitializeHeap(OUT PHEAP Heap,
     /* Initialise the Heap Virtual Allocated Blocks list */
     InitializeListHead(&Heap->VirtualAllocdBlocks);
 
+    /* No front end heap until it's explicitly enabled */
+    Heap->FrontEndHeap = NULL;
+    Heap->FrontEndHeapType = HEAP_FRONT_NONE;
+
     /* Initialise the Heap UnCommitted Region lists */
     InitializeListHead(&Heap->UCRSegments);
     InitializeListHead(&Heap->UCRList);
@@ -1968,6 +1972,7 @@ RtlAllocateHeap(IN PVOID HeapPtr,
     BOOLEAN HeapLocked = FALSE;
     PHEAP_VIRTUAL_ALLOC_ENTRY VirtualBlock = NULL;
     PHEAP_ENTRY_EXTRA Extra;
+    PVOID BaseAddress;
     NTSTATUS Status;
 
     /* Force flags */
@@ -2017,6 +2022,15 @@ RtlAllocateHeap(IN PVOID HeapPtr,
 
     Index = AllocationSize >> HEAP_ENTRY_SHIFT;
 
+    /* Small blocks without extra stuff go to the low fragmentation heap if it's enabled */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP &&
+        Index < HEAP_LFH_BUCKETS &&
+        !(EntryFlags & HEAP_ENTRY_EXTRA_PRESENT))
+    {
+        BaseAddress = RtlpLowFragHeapAllocate(Heap, Flags, Size, Index);
+        if (BaseAddress) return BaseAddress;
+    }
+
     /* Acquire the lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2229,7 +2243,8 @@ BOOLEAN NTAPI RtlFreeHeap(
         /* Check this entry, fail if it's invalid */
         if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY) ||
             (((ULONG_PTR)Ptr & 0x7) != 0) ||
-            (HeapEntry->SegmentOffset >= HEAP_SEGMENTS))
+            (HeapEntry->SegmentOffset >= HEAP_SEGMENTS &&
+             HeapEntry->SegmentOffset != HEAP_LFH_INDEX))
         {
             /* This is an invalid block */
             DPRINT1("HEAP: Trying to free an invalid address %p!\n", Ptr);
@@ -2246,6 +2261,10 @@ BOOLEAN NTAPI RtlFreeHeap(
     }
     _SEH2_END;
 
+    /* Blocks of the low fragmentation heap are freed without taking the lock */
+    if (HeapEntry->SegmentOffset == HEAP_LFH_INDEX)
+        return RtlpLowFragHeapFree(Heap, HeapEntry);
+
     /* Lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2661,6 +2680,10 @@ RtlReAllocateHeap(HANDLE HeapPtr,
         return NULL;
     }
 
+    /* Blocks of the low fragmentation heap are handled by it */
+    if ((((PHEAP_ENTRY)Ptr)-1)->SegmentOffset == HEAP_LFH_INDEX)
+        return RtlpLowFragHeapReAllocate(Heap, Flags, Ptr, Size);
+
     /* Calculate allocation size and index */
     if (Size)
         AllocationSize = Size;
@@ -3236,6 +3259,13 @@ RtlpValidateHeapEntry(
     if ((ULONG_PTR)HeapEntry & (HEAP_ENTRY_SIZE - 1)) goto invalid_entry;
     if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY)) goto invalid_entry;
 
+    /* Blocks of the low fragmentation heap live inside of a subsegment */
+    if (HeapEntry->SegmentOffset == HEAP_LFH_INDEX)
+    {
+        if (!RtlpLowFragHeapGetSubSegment(Heap, HeapEntry)) goto invalid_entry;
+        return TRUE;
+    }
+
     BigAllocation = HeapEntry->Flags & HEAP_ENTRY_VIRTUAL_ALLOC;
     Segment = Heap->Segments[HeapEntry->SegmentOffset];
 
@@ -3989,6 +4019,8 @@ RtlSetHeapInformation(IN HANDLE HeapHandle OPTIONAL,
                       IN PVOID HeapInformation,
                       IN SIZE_T HeapInformationLength)
 {
+    PHEAP Heap = (PHEAP)HeapHandle;
+
     /* Setting heap information is not really supported except for enabling LFH */
     if (HeapInformationClass == HeapCompatibilityInformation)
     {
@@ -4000,13 +4032,20 @@ RtlSetHeapInformation(IN HANDLE HeapHandle OPTIONAL,
         }
 
         /* Check for a special magic value for enabling LFH */
-        if (*(PULONG)HeapInformation != 2)
+        if (*(PULONG)HeapInformation != HEAP_FRONT_LOWFRAGHEAP)
         {
             return STATUS_UNSUCCESSFUL;
         }
 
-        DPRINT1("RtlSetHeapInformation() needs to enable LFH\n");
-        return STATUS_SUCCESS;
+        /* Page heap has its own structure and can't have a front end */
+        if (!Heap ||
+            (Heap->ForceFlags & HEAP_FLAG_PAGE_ALLOCS) ||
+            Heap->Signature != HEAP_SIGNATURE)
+        {
+            return STATUS_UNSUCCESSFUL;
+        }
+
+        return RtlpActivateLowFragHeap(Heap);
     }
 
     return STATUS_SUCCESS;
@@ -55,6 +55,19 @@
 /* Segment flags */
 #define HEAP_USER_ALLOCATED    0x1
 
+/* Front end heap types */
+#define HEAP_FRONT_NONE         0
+#define HEAP_FRONT_LOOKASIDE    1
+#define HEAP_FRONT_LOWFRAGHEAP  2
+
+/* Low Fragmentation Heap definitions */
+#define HEAP_LFH_BUCKETS              128
+#define HEAP_LFH_AFFINITY_SLOTS       8
+#define HEAP_LFH_INDEX                0xFF
+#define HEAP_LFH_SUBSEGMENT_SIZE      0x4000
+#define HEAP_LFH_MIN_BLOCKS           16
+#define HEAP_LFH_SUBSEGMENT_SIGNATURE 0x5346484C /* 'LHFS' */
+
 /* A handy inline to distinguis normal heap, special "debug heap" and special "page heap" */
 FORCEINLINE BOOLEAN
 RtlpHeapIsSpecial(ULONG Flags)
@@ -309,6 +322,33 @@ typedef struct _HEAP_ENTRY_EXTRA
 
 typedef HEAP_ENTRY_EXTRA HEAP_FREE_ENTRY_EXTRA, *PHEAP_FREE_ENTRY_EXTRA;
 
+/* Low Fragmentation Heap structures */
+typedef struct _HEAP_LFH_BUCKET
+{
+    SLIST_HEADER AffinitySlots[HEAP_LFH_AFFINITY_SLOTS];
+    ULONG BlockUnits;
+    volatile LONG SubSegmentCount;
+    volatile LONG TotalBlocks;
+    volatile LONG BusyBlocks;
+} HEAP_LFH_BUCKET, *PHEAP_LFH_BUCKET;
+
+typedef struct _HEAP_LFH
+{
+    struct _HEAP *Heap;
+    HEAP_LFH_BUCKET Buckets[HEAP_LFH_BUCKETS];
+} HEAP_LFH, *PHEAP_LFH;
+
+typedef struct _HEAP_LFH_SUBSEGMENT
+{
+    ULONG Signature;
+    ULONG BlockCount;
+    PHEAP_LFH LowFragHeap;
+    PHEAP_LFH_BUCKET Bucket;
+} HEAP_LFH_SUBSEGMENT, *PHEAP_LFH_SUBSEGMENT;
+
+/* Blocks of a subsegment start right after its header */
+#define HEAP_LFH_SUBSEGMENT_HEADER_SIZE ROUND_UP(sizeof(HEAP_LFH_SUBSEGMENT), sizeof(HEAP_ENTRY))
+
 typedef struct _HEAP_VIRTUAL_ALLOC_ENTRY
 {
     LIST_ENTRY Entry;
@@ -397,6 +437,30 @@ RtlDebugSizeHeap(HANDLE HeapPtr,
                  ULONG Flags,
                  PVOID Ptr);
 
+/* heaplfh.c */
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap);
+
+PVOID NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size,
+                        SIZE_T Index);
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry);
+
+PVOID NTAPI
+RtlpLowFragHeapReAllocate(PHEAP Heap,
+                          ULONG Flags,
+                          PVOID Ptr,
+                          SIZE_T Size);
+
+PHEAP_LFH_SUBSEGMENT NTAPI
+RtlpLowFragHeapGetSubSegment(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry);
+
 /* heappage.c */
 
 HANDLE NTAPI
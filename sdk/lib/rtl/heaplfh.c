@@ -0,0 +1,334 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS system libraries
+ * FILE:            lib/rtl/heaplfh.c
+ * PURPOSE:         RTL Low Fragmentation Heap front end
+ */
+
+/* Useful references:
+   http://illmatics.com/Understanding_the_LFH.pdf
+*/
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl.h>
+#include <heap.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/*
+ * The LFH front end keeps one bucket per block size (in HEAP_ENTRY units)
+ * for blocks smaller than HEAP_LFH_BUCKETS units. Blocks are carved out of
+ * subsegments, which are ordinary busy blocks of the back end heap. Free
+ * blocks of a bucket are kept in per-affinity interlocked S-Lists, so the
+ * common allocate / free path never takes the heap lock. Subsegments are
+ * never given back to the back end, they go away with the heap itself.
+ *
+ * A block owned by the front end is recognized by its SegmentOffset being
+ * HEAP_LFH_INDEX, and its PreviousSize holds the block index inside the
+ * subsegment, which allows to find the subsegment header.
+ */
+
+/* FUNCTIONS *****************************************************************/
+
+FORCEINLINE
+PSLIST_HEADER
+RtlpLowFragHeapGetSlot(PHEAP_LFH_BUCKET Bucket)
+{
+    return &Bucket->AffinitySlots[RtlpGetHeapAffinity() % HEAP_LFH_AFFINITY_SLOTS];
+}
+
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH LowFragHeap;
+    ULONG BucketIndex, Slot;
+
+    /* Nothing to do if it's already enabled */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP)
+        return STATUS_SUCCESS;
+
+    /* The front end can't be used together with heap debugging features
+       or on a heap which is not serialized */
+    if (RtlpHeapIsSpecial(Heap->Flags | Heap->ForceFlags) ||
+        (Heap->Flags & (HEAP_NO_SERIALIZE |
+                        HEAP_TAIL_CHECKING_ENABLED |
+                        HEAP_FREE_CHECKING_ENABLED)))
+    {
+        DPRINT1("HEAP: Can't enable LFH for heap %p with flags 0x%08x\n", Heap, Heap->Flags);
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    /* Allocate the front end structure from the heap itself */
+    LowFragHeap = RtlAllocateHeap(Heap, HEAP_ZERO_MEMORY, sizeof(HEAP_LFH));
+    if (!LowFragHeap) return STATUS_NO_MEMORY;
+
+    /* Initialize the buckets */
+    LowFragHeap->Heap = Heap;
+    for (BucketIndex = 0; BucketIndex < HEAP_LFH_BUCKETS; BucketIndex++)
+    {
+        LowFragHeap->Buckets[BucketIndex].BlockUnits = BucketIndex;
+
+        for (Slot = 0; Slot < HEAP_LFH_AFFINITY_SLOTS; Slot++)
+            RtlInitializeSListHead(&LowFragHeap->Buckets[BucketIndex].AffinitySlots[Slot]);
+    }
+
+    /* Publish it under the heap lock, in case of a concurrent activation */
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+    if (Heap->FrontEndHeapType == HEAP_FRONT_NONE)
+    {
+        /* The pointer must be visible before the type is */
+        InterlockedExchangePointer(&Heap->FrontEndHeap, LowFragHeap);
+        Heap->FrontEndHeapType = HEAP_FRONT_LOWFRAGHEAP;
+        LowFragHeap = NULL;
+    }
+
+    RtlLeaveHeapLock(Heap->LockVariable);
+
+    /* Somebody was faster, release our copy */
+    if (LowFragHeap) RtlFreeHeap(Heap, 0, LowFragHeap);
+
+    DPRINT("HEAP: LFH enabled for heap %p\n", Heap);
+    return STATUS_SUCCESS;
+}
+
+static
+PSLIST_ENTRY
+RtlpLowFragHeapGrowBucket(PHEAP Heap,
+                          PHEAP_LFH_BUCKET Bucket,
+                          ULONG Flags)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    PHEAP_ENTRY HeapEntry;
+    PSLIST_HEADER SListHead;
+    SIZE_T BlockSize;
+    ULONG BlockCount, i;
+
+    /* Calculate how many blocks fit into a subsegment */
+    BlockSize = Bucket->BlockUnits << HEAP_ENTRY_SHIFT;
+    BlockCount = (ULONG)((HEAP_LFH_SUBSEGMENT_SIZE - HEAP_LFH_SUBSEGMENT_HEADER_SIZE) / BlockSize);
+    if (BlockCount < HEAP_LFH_MIN_BLOCKS) BlockCount = HEAP_LFH_MIN_BLOCKS;
+
+    /* Get it from the back end. Its size is always too big for the front end */
+    SubSegment = RtlAllocateHeap(Heap,
+                                 Flags & HEAP_NO_SERIALIZE,
+                                 HEAP_LFH_SUBSEGMENT_HEADER_SIZE + BlockCount * BlockSize);
+    if (!SubSegment) return NULL;
+
+    SubSegment->Signature = HEAP_LFH_SUBSEGMENT_SIGNATURE;
+    SubSegment->BlockCount = BlockCount;
+    SubSegment->LowFragHeap = (PHEAP_LFH)Heap->FrontEndHeap;
+    SubSegment->Bucket = Bucket;
+
+    /* Initialize all blocks, and give away all but the first one to our slot */
+    HeapEntry = (PHEAP_ENTRY)((ULONG_PTR)SubSegment + HEAP_LFH_SUBSEGMENT_HEADER_SIZE);
+    SListHead = RtlpLowFragHeapGetSlot(Bucket);
+
+    for (i = 0; i < BlockCount; i++)
+    {
+        HeapEntry->Size = (USHORT)Bucket->BlockUnits;
+        HeapEntry->Flags = 0;
+        HeapEntry->SmallTagIndex = 0;
+        HeapEntry->PreviousSize = (USHORT)i;
+        HeapEntry->SegmentOffset = HEAP_LFH_INDEX;
+        HeapEntry->UnusedBytes = 0;
+
+        if (i != 0)
+            RtlInterlockedPushEntrySList(SListHead, (PSLIST_ENTRY)(HeapEntry + 1));
+
+        HeapEntry += Bucket->BlockUnits;
+    }
+
+    /* Update the bucket statistics */
+    InterlockedIncrement(&Bucket->SubSegmentCount);
+    InterlockedExchangeAdd(&Bucket->TotalBlocks, BlockCount);
+
+    /* Return the first block */
+    return (PSLIST_ENTRY)((PHEAP_ENTRY)((ULONG_PTR)SubSegment + HEAP_LFH_SUBSEGMENT_HEADER_SIZE) + 1);
+}
+
+PVOID NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size,
+                        SIZE_T Index)
+{
+    PHEAP_LFH LowFragHeap = (PHEAP_LFH)Heap->FrontEndHeap;
+    PHEAP_LFH_BUCKET Bucket;
+    PSLIST_ENTRY ListEntry;
+    PHEAP_ENTRY HeapEntry;
+    ULONG Slot, i;
+
+    ASSERT(Index < HEAP_LFH_BUCKETS);
+    Bucket = &LowFragHeap->Buckets[Index];
+
+    /* Take a free block from our own slot */
+    Slot = RtlpGetHeapAffinity() % HEAP_LFH_AFFINITY_SLOTS;
+    ListEntry = RtlInterlockedPopEntrySList(&Bucket->AffinitySlots[Slot]);
+
+    /* Steal one from the other slots before growing the bucket */
+    for (i = 1; !ListEntry && i < HEAP_LFH_AFFINITY_SLOTS; i++)
+    {
+        ListEntry = RtlInterlockedPopEntrySList(&Bucket->AffinitySlots[(Slot + i) % HEAP_LFH_AFFINITY_SLOTS]);
+    }
+
+    /* Still nothing, get a new subsegment */
+    if (!ListEntry)
+    {
+        ListEntry = RtlpLowFragHeapGrowBucket(Heap, Bucket, Flags);
+        if (!ListEntry) return NULL;
+    }
+
+    /* Initialize this block */
+    HeapEntry = (PHEAP_ENTRY)ListEntry - 1;
+    ASSERT(HeapEntry->SegmentOffset == HEAP_LFH_INDEX);
+    ASSERT(HeapEntry->Size == Index);
+
+    HeapEntry->Flags = HEAP_ENTRY_BUSY | ((Flags & HEAP_SETTABLE_USER_FLAGS) >> 4);
+    HeapEntry->UnusedBytes = (UCHAR)((Index << HEAP_ENTRY_SHIFT) - Size);
+
+    InterlockedIncrement(&Bucket->BusyBlocks);
+
+    /* Zero memory if that was requested */
+    if (Flags & HEAP_ZERO_MEMORY)
+        RtlZeroMemory(HeapEntry + 1, Size);
+
+    /* User data starts right after the entry's header */
+    return HeapEntry + 1;
+}
+
+PHEAP_LFH_SUBSEGMENT NTAPI
+RtlpLowFragHeapGetSubSegment(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment = NULL;
+
+    /* The front end must be enabled in this heap */
+    if (Heap->FrontEndHeapType != HEAP_FRONT_LOWFRAGHEAP ||
+        HeapEntry->SegmentOffset != HEAP_LFH_INDEX ||
+        HeapEntry->Size == 0 ||
+        HeapEntry->Size >= HEAP_LFH_BUCKETS)
+    {
+        return NULL;
+    }
+
+    _SEH2_TRY
+    {
+        /* Go back to the subsegment header and make sure it's ours */
+        SubSegment = (PHEAP_LFH_SUBSEGMENT)((ULONG_PTR)(HeapEntry - HeapEntry->PreviousSize * HeapEntry->Size) -
+                                            HEAP_LFH_SUBSEGMENT_HEADER_SIZE);
+
+        if (SubSegment->Signature != HEAP_LFH_SUBSEGMENT_SIGNATURE ||
+            SubSegment->LowFragHeap != (PHEAP_LFH)Heap->FrontEndHeap ||
+            SubSegment->Bucket->BlockUnits != HeapEntry->Size ||
+            HeapEntry->PreviousSize >= SubSegment->BlockCount)
+        {
+            SubSegment = NULL;
+        }
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        SubSegment = NULL;
+    }
+    _SEH2_END;
+
+    return SubSegment;
+}
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+
+    /* Find the subsegment this block belongs to */
+    SubSegment = RtlpLowFragHeapGetSubSegment(Heap, HeapEntry);
+    if (!SubSegment)
+    {
+        DPRINT1("HEAP: Trying to free an invalid LFH block %p!\n", HeapEntry + 1);
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    /* Mark it as free and put it into our slot */
+    HeapEntry->Flags = 0;
+    HeapEntry->UnusedBytes = 0;
+
+    InterlockedDecrement(&SubSegment->Bucket->BusyBlocks);
+    RtlInterlockedPushEntrySList(RtlpLowFragHeapGetSlot(SubSegment->Bucket),
+                                 (PSLIST_ENTRY)(HeapEntry + 1));
+
+    return TRUE;
+}
+
+PVOID NTAPI
+RtlpLowFragHeapReAllocate(PHEAP Heap,
+                          ULONG Flags,
+                          PVOID Ptr,
+                          SIZE_T Size)
+{
+    PHEAP_ENTRY HeapEntry = (PHEAP_ENTRY)Ptr - 1;
+    SIZE_T AllocationSize, OldSize;
+    PVOID NewBaseAddress;
+
+    /* Make sure this block really belongs to one of our subsegments */
+    if (!RtlpLowFragHeapGetSubSegment(Heap, HeapEntry))
+    {
+        DPRINT1("HEAP: Trying to reallocate an invalid LFH block %p!\n", Ptr);
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    /* If that entry is not really in-use, we have a problem */
+    if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY))
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    OldSize = (HeapEntry->Size << HEAP_ENTRY_SHIFT) - HeapEntry->UnusedBytes;
+
+    /* Calculate the new allocation size */
+    AllocationSize = ((Size ? Size : 1) + Heap->AlignRound) & Heap->AlignMask;
+
+    /* The new size still lands in the same bucket, so just update the block */
+    if ((AllocationSize >> HEAP_ENTRY_SHIFT) == HeapEntry->Size)
+    {
+        if ((Flags & HEAP_ZERO_MEMORY) && Size > OldSize)
+            RtlZeroMemory((PCHAR)Ptr + OldSize, Size - OldSize);
+
+        HeapEntry->UnusedBytes = (UCHAR)(AllocationSize - Size);
+        return Ptr;
+    }
+
+    /* Otherwise the block has to move */
+    if (Flags & HEAP_REALLOC_IN_PLACE_ONLY)
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_NO_MEMORY);
+        return NULL;
+    }
+
+    NewBaseAddress = RtlAllocateHeap(Heap, Flags & ~HEAP_ZERO_MEMORY, Size);
+    if (!NewBaseAddress) return NULL;
+
+    /* Copy the contents, zero the rest if needed, and free the old block */
+    if (Size > OldSize)
+    {
+        RtlMoveMemory(NewBaseAddress, Ptr, OldSize);
+
+        if (Flags & HEAP_ZERO_MEMORY)
+            RtlZeroMemory((PCHAR)NewBaseAddress + OldSize, Size - OldSize);
+    }
+    else
+    {
+        RtlMoveMemory(NewBaseAddress, Ptr, Size);
+    }
+
+    RtlpLowFragHeapFree(Heap, HeapEntry);
+
+    return NewBaseAddress;
+}
+
+/* EOF */
@@ -98,6 +98,10 @@ KPROCESSOR_MODE
 NTAPI
 RtlpGetMode(VOID);
 
+ULONG
+NTAPI
+RtlpGetHeapAffinity(VOID);
+
 BOOLEAN
 NTAPI
 RtlpCaptureStackLimits(
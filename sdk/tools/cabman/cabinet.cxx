@@ -97,6 +97,13 @@ CCabinet::CCabinet()
     BytesLeftInBlock = 0;
     ReuseBlock       = false;
     CurrentDataNode  = NULL;
+
+#ifndef CAB_READ_ONLY
+    CompressionThreads = std::thread::hardware_concurrency();
+    if (CompressionThreads == 0)
+        CompressionThreads = 1;
+    StopWorkers = false;
+#endif /* CAB_READ_ONLY */
 }
 
 
@@ -112,6 +119,10 @@ CCabinet::~CCabinet()
         CabinetReservedFileSize = 0;
     }
 
+#ifndef CAB_READ_ONLY
+    StopCompressionThreads();
+#endif /* CAB_READ_ONLY */
+
     if (CodecSelected)
         delete Codec;
 }
@@ -1015,6 +1026,28 @@ bool CCabinet::IsCodecSelected()
     return CodecSelected;
 }
 
+CCABCodec* CCabinet::CreateCodec(LONG Id)
+/*
+ * FUNCTION: Creates a codec engine
+ * ARGUMENTS:
+ *     Id = Codec identifier
+ * RETURNS:
+ *     Pointer to codec, NULL if the codec is not supported
+ */
+{
+    switch (Id)
+    {
+        case CAB_CODEC_RAW:
+            return new CRawCodec();
+
+        case CAB_CODEC_MSZIP:
+            return new CMSZipCodec();
+
+        default:
+            return NULL;
+    }
+}
+
 void CCabinet::SelectCodec(LONG Id)
 /*
  * FUNCTION: Selects codec engine to use
@@ -1031,19 +1064,9 @@ void CCabinet::SelectCodec(LONG Id)
         delete Codec;
     }
 
-    switch (Id)
-    {
-        case CAB_CODEC_RAW:
-            Codec = new CRawCodec();
-            break;
-
-        case CAB_CODEC_MSZIP:
-            Codec = new CMSZipCodec();
-            break;
-
-        default:
-            return;
-    }
+    Codec = CreateCodec(Id);
+    if (!Codec)
+        return;
 
     CodecId       = Id;
     CodecSelected = true;
@@ -1401,6 +1424,11 @@ ULONG CCabinet::CommitDisk(ULONG MoreDisks)
 {
     ULONG Status;
 
+    /* All data blocks must be in the scratch file before the sizes are written */
+    Status = FlushDataBlocks();
+    if (Status != CAB_STATUS_SUCCESS)
+        return Status;
+
     OnCabinetName(CurrentDiskNumber, CabinetName);
 
     /* Create file, fail if it already exists */
@@ -1483,6 +1511,8 @@ ULONG CCabinet::CloseCabinet()
 {
     ULONG Status;
 
+    StopCompressionThreads();
+
     DestroyFileNodes();
 
     DestroyFolderNodes();
@@ -1727,6 +1757,19 @@ void CCabinet::SetMaxDiskSize(ULONG Size)
     MaxDiskSize = Size;
 }
 
+void CCabinet::SetCompressionThreads(ULONG Count)
+/*
+ * FUNCTION: Sets the number of threads used to compress data blocks
+ * ARGUMENTS:
+ *     Count = Number of threads (0 or 1 means compress serially)
+ * NOTES:
+ *     Every data block is compressed on its own and written in order,
+ *     so the cabinet does not depend on the number of threads
+ */
+{
+    CompressionThreads = (Count > 0) ? Count : 1;
+}
+
 #endif /* CAB_READ_ONLY */
 
 
@@ -2759,6 +2802,14 @@ ULONG CCabinet::WriteDataBlock()
     ULONG BytesWritten;
     PCFDATA_NODE DataNode;
 
+    /* The compressed size is only needed right away when the disk size is limited */
+    if (!BlockIsSplit && (MaxDiskSize == 0) && StartCompressionThreads())
+        return QueueDataBlock();
+
+    Status = FlushDataBlocks();
+    if (Status != CAB_STATUS_SUCCESS)
+        return Status;
+
     if (!BlockIsSplit)
     {
         Status = Codec->Compress(OutputBuffer,
@@ -2835,6 +2886,257 @@ ULONG CCabinet::WriteDataBlock()
     return CAB_STATUS_SUCCESS;
 }
 
+
+bool CCabinet::StartCompressionThreads()
+/*
+ * FUNCTION: Starts the compression threads if they are not running yet
+ * RETURNS:
+ *     true if data blocks can be compressed in the background
+ */
+{
+    if (!Workers.empty())
+        return true;
+
+    if (CompressionThreads <= 1)
+        return false;
+
+    StopWorkers = false;
+
+    try
+    {
+        while (Workers.size() < CompressionThreads)
+            Workers.emplace_back(&CCabinet::CompressionThread, this);
+    }
+    catch (const std::system_error&)
+    {
+        DPRINT(MIN_TRACE, ("Cannot create compression thread. Using (%u) threads.\n",
+            (UINT)Workers.size()));
+    }
+
+    return !Workers.empty();
+}
+
+
+void CCabinet::StopCompressionThreads()
+/*
+ * FUNCTION: Stops the compression threads and frees all jobs
+ */
+{
+    {
+        std::lock_guard<std::mutex> Lock(JobLock);
+        StopWorkers = true;
+        QueuedJobs.clear();
+    }
+    JobQueued.notify_all();
+
+    for (std::thread& Worker : Workers)
+        Worker.join();
+    Workers.clear();
+
+    /* The data nodes of unfinished jobs belong to their folders */
+    FreeJobs.insert(FreeJobs.end(), PendingJobs.begin(), PendingJobs.end());
+    PendingJobs.clear();
+
+    for (PCFDATA_JOB Job : FreeJobs)
+    {
+        free(Job->InputBuffer);
+        free(Job->OutputBuffer);
+        delete Job;
+    }
+    FreeJobs.clear();
+}
+
+
+void CCabinet::CompressionThread()
+/*
+ * FUNCTION: Compresses queued data blocks until told to stop
+ */
+{
+    CCABCodec* ThreadCodec;
+    PCFDATA_JOB Job;
+
+    /* Codecs keep per-block state, so every thread needs its own */
+    ThreadCodec = CreateCodec(CodecId);
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> Lock(JobLock);
+            JobQueued.wait(Lock, [this] { return StopWorkers || !QueuedJobs.empty(); });
+            if (StopWorkers)
+                break;
+
+            Job = QueuedJobs.front();
+            QueuedJobs.pop_front();
+        }
+
+        if (ThreadCodec)
+        {
+            Job->Status = ThreadCodec->Compress(Job->OutputBuffer,
+                Job->InputBuffer,
+                Job->InputSize,
+                &Job->OutputSize);
+        }
+        else
+        {
+            Job->Status = CS_NOMEMORY;
+        }
+
+        {
+            std::lock_guard<std::mutex> Lock(JobLock);
+            Job->Done = true;
+        }
+        JobDone.notify_all();
+    }
+
+    delete ThreadCodec;
+}
+
+
+ULONG CCabinet::QueueDataBlock()
+/*
+ * FUNCTION: Hands the current data block to the compression threads
+ * RETURNS:
+ *     Status of operation
+ */
+{
+    PCFDATA_JOB Job;
+    ULONG Status;
+
+    /* Limit the memory used by blocks in flight */
+    if (PendingJobs.size() >= CompressionThreads * CAB_JOBS_PER_THREAD)
+    {
+        Status = FinishDataBlock();
+        if (Status != CAB_STATUS_SUCCESS)
+            return Status;
+    }
+
+    if (!FreeJobs.empty())
+    {
+        Job = FreeJobs.back();
+        FreeJobs.pop_back();
+    }
+    else
+    {
+        Job = new CFDATA_JOB;
+        Job->InputBuffer  = malloc(CAB_BLOCKSIZE + 12);
+        Job->OutputBuffer = malloc(CAB_BLOCKSIZE + 12);
+        if ((!Job->InputBuffer) || (!Job->OutputBuffer))
+        {
+            DPRINT(MIN_TRACE, ("Insufficient memory.\n"));
+            free(Job->InputBuffer);
+            free(Job->OutputBuffer);
+            delete Job;
+            return CAB_STATUS_NOMEMORY;
+        }
+    }
+
+    Job->DataNode = NewDataNode(CurrentFolderNode);
+    if (!Job->DataNode)
+    {
+        DPRINT(MIN_TRACE, ("Insufficient memory.\n"));
+        FreeJobs.push_back(Job);
+        return CAB_STATUS_NOMEMORY;
+    }
+
+    Job->FolderNode = CurrentFolderNode;
+    Job->DataNode->Data.UncompSize = (USHORT)CurrentIBufferSize;
+    Job->InputSize  = CurrentIBufferSize;
+    Job->OutputSize = 0;
+    Job->Status     = CS_SUCCESS;
+    Job->Done       = false;
+
+    /* Trade buffers instead of copying the block */
+    std::swap(Job->InputBuffer, InputBuffer);
+
+    LastBlockStart += CurrentIBufferSize;
+
+    CurrentIBufferSize = 0;
+    CurrentIBuffer     = InputBuffer;
+
+    PendingJobs.push_back(Job);
+    {
+        std::lock_guard<std::mutex> Lock(JobLock);
+        QueuedJobs.push_back(Job);
+    }
+    JobQueued.notify_one();
+
+    return CAB_STATUS_SUCCESS;
+}
+
+
+ULONG CCabinet::FinishDataBlock()
+/*
+ * FUNCTION: Waits for the oldest queued data block and writes it to the scratch file
+ * RETURNS:
+ *     Status of operation
+ */
+{
+    PCFDATA_JOB Job;
+    PCFDATA_NODE DataNode;
+    PCFFOLDER_NODE FolderNode;
+    ULONG BytesWritten;
+    ULONG Status;
+
+    Job = PendingJobs.front();
+    {
+        std::unique_lock<std::mutex> Lock(JobLock);
+        JobDone.wait(Lock, [Job] { return Job->Done; });
+    }
+    PendingJobs.pop_front();
+    FreeJobs.push_back(Job);
+
+    if (Job->Status != CS_SUCCESS)
+    {
+        DPRINT(MIN_TRACE, ("Cannot compress data block (%u).\n", (UINT)Job->Status));
+        return CAB_STATUS_FAILURE;
+    }
+
+    DataNode   = Job->DataNode;
+    FolderNode = Job->FolderNode;
+
+    DataNode->Data.CompSize       = (USHORT)Job->OutputSize;
+    DataNode->Data.Checksum       = 0;
+    DataNode->ScratchFilePosition = ScratchFile->Position();
+
+    DPRINT(MAX_TRACE, ("Writing block. Checksum (0x%X)  CompSize (%u)  UncompSize (%u).\n",
+        (UINT)DataNode->Data.Checksum,
+        DataNode->Data.CompSize,
+        DataNode->Data.UncompSize));
+
+    Status = ScratchFile->WriteBlock(&DataNode->Data,
+        Job->OutputBuffer, &BytesWritten);
+    if (Status != CAB_STATUS_SUCCESS)
+        return Status;
+
+    DiskSize += sizeof(CFDATA) + BytesWritten;
+
+    FolderNode->TotalFolderSize += (BytesWritten + sizeof(CFDATA));
+    FolderNode->Folder.DataBlockCount++;
+
+    return CAB_STATUS_SUCCESS;
+}
+
+
+ULONG CCabinet::FlushDataBlocks()
+/*
+ * FUNCTION: Writes all queued data blocks to the scratch file
+ * RETURNS:
+ *     Status of operation
+ */
+{
+    ULONG Status;
+
+    while (!PendingJobs.empty())
+    {
+        Status = FinishDataBlock();
+        if (Status != CAB_STATUS_SUCCESS)
+            return Status;
+    }
+
+    return CAB_STATUS_SUCCESS;
+}
+
 #if !defined(_WIN32)
 
 void CCabinet::ConvertDateAndTime(time_t* Time,
@@ -27,6 +27,11 @@
 #include <limits.h>
 #include <string>
 #include <list>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #ifndef PATH_MAX
 #define PATH_MAX MAX_PATH
@@ -299,6 +304,26 @@ public:
 #define CAB_CODEC_MSZIP 0x02
 
 
+#ifndef CAB_READ_ONLY
+
+/* Maximum number of data blocks in flight per compression thread */
+#define CAB_JOBS_PER_THREAD 4
+
+typedef struct _CFDATA_JOB
+{
+    PCFFOLDER_NODE  FolderNode = nullptr;   // Folder the data block belongs to
+    PCFDATA_NODE    DataNode = nullptr;     // Data block node, CompSize not yet known
+    void*           InputBuffer = nullptr;  // Uncompressed data
+    ULONG           InputSize = 0;          // Number of bytes in InputBuffer
+    void*           OutputBuffer = nullptr; // Compressed data
+    ULONG           OutputSize = 0;         // Number of bytes in OutputBuffer
+    ULONG           Status = CS_SUCCESS;    // Codec status
+    bool            Done = false;           // true when the block is compressed
+} CFDATA_JOB, *PCFDATA_JOB;
+
+#endif /* CAB_READ_ONLY */
+
+
 
 /* Classes */
 
@@ -377,6 +402,8 @@ public:
     ULONG AddFile(const std::string& FileName, const std::string& TargetFolder);
     /* Sets the maximum size of the current disk */
     void SetMaxDiskSize(ULONG Size);
+    /* Sets the number of threads used to compress data blocks */
+    void SetCompressionThreads(ULONG Count);
 #endif /* CAB_READ_ONLY */
 
     /* Default event handlers */
@@ -407,6 +434,7 @@ private:
     PCFFOLDER_NODE NewFolderNode();
     PCFFILE_NODE NewFileNode();
     PCFDATA_NODE NewDataNode(PCFFOLDER_NODE FolderNode);
+    static CCABCodec* CreateCodec(LONG Id);
     void DestroyDataNodes(PCFFOLDER_NODE FolderNode);
     void DestroyFileNodes();
     void DestroyDeletedFileNodes();
@@ -422,6 +450,12 @@ private:
     ULONG WriteFileEntries();
     ULONG CommitDataBlocks(PCFFOLDER_NODE FolderNode);
     ULONG WriteDataBlock();
+    bool StartCompressionThreads();
+    void StopCompressionThreads();
+    void CompressionThread();
+    ULONG QueueDataBlock();
+    ULONG FinishDataBlock();
+    ULONG FlushDataBlocks();
     ULONG GetAttributesOnFile(PCFFILE_NODE File);
     ULONG SetAttributesOnFile(char* FileName, USHORT FileAttributes);
     ULONG GetFileTimes(FILE* FileHandle, PCFFILE_NODE File);
@@ -484,6 +518,16 @@ private:
     ULONG TotalBytesLeft;
     bool BlockIsSplit;                  // true if current data block is split
     ULONG NextFolderNumber;     // Zero based folder number
+
+    ULONG CompressionThreads;           // Number of compression threads (1 = compress serially)
+    std::vector<std::thread> Workers;
+    std::deque<PCFDATA_JOB> QueuedJobs;     // Blocks waiting for a compression thread
+    std::deque<PCFDATA_JOB> PendingJobs;    // Blocks not yet in the scratch file, in cabinet order
+    std::vector<PCFDATA_JOB> FreeJobs;      // Jobs with buffers ready for reuse
+    std::mutex JobLock;                     // Protects QueuedJobs, Done and StopWorkers
+    std::condition_variable JobQueued;
+    std::condition_variable JobDone;
+    bool StopWorkers;
 #endif /* CAB_READ_ONLY */
 };
 
@@ -192,8 +192,8 @@ void CCABManager::Usage()
 {
     printf("ReactOS Cabinet Manager\n\n");
     printf("CABMAN [-D | -E] [-A] [-L dir] cabinet [filename ...]\n");
-    printf("CABMAN [-M mode] -C dirfile [-I] [-RC file] [-P dir]\n");
-    printf("CABMAN [-M mode] -S cabinet filename [-F folder] [filename] [...]\n");
+    printf("CABMAN [-M mode] [-T count] -C dirfile [-I] [-RC file] [-P dir]\n");
+    printf("CABMAN [-M mode] [-T count] -S cabinet filename [-F folder] [filename] [...]\n");
     printf("  cabinet   Cabinet file.\n");
     printf("  filename  Name of the file to add to or extract from the cabinet.\n");
     printf("            Wild cards and multiple filenames\n");
@@ -218,6 +218,9 @@ void CCABManager::Usage()
     printf("            (size must be less than 64KB).\n");
     printf("  -S        Create simple cabinet.\n");
     printf("  -P dir    Files in the .dff are relative to this directory.\n");
+    printf("  -T count  Number of threads used for compression\n");
+    printf("            (default is the number of processors).\n");
+    printf("            The created cabinet does not depend on it.\n");
     printf("  -V        Verbose mode (prints more messages).\n");
 }
 
@@ -361,6 +364,18 @@ bool CCABManager::ParseCmdline(int argc, char* argv[])
 
                     break;
 
+                case 't':
+                case 'T':
+                    if (argv[i][2] == 0)
+                    {
+                        i++;
+                        SetCompressionThreads(strtoul(&argv[i][0], NULL, 10));
+                    }
+                    else
+                        SetCompressionThreads(strtoul(&argv[i][2], NULL, 10));
+
+                    break;
+
                 case 'V':
                     Verbose = true;
                     break;
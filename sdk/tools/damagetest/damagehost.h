@@ -0,0 +1,37 @@
+/*
+ * PROJECT:         ReactOS Damage List Test
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            tools/damagetest/damagehost.h
+ * PURPOSE:         What win32k provides to damagelist.c, for the host build
+ */
+
+#pragma once
+
+#include <string.h>
+#include <typedefs.h>
+
+#define APIENTRY
+#define _In_
+#define _Inout_
+#define _Out_writes_opt_(s)
+
+typedef ULONG FLONG;
+typedef HANDLE HDEV;
+
+typedef struct _RECTL
+{
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+} RECTL, *PRECTL;
+
+#ifndef min
+#define min(a, b)  (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b)  (((a) > (b)) ? (a) : (b))
+#endif
+
+#include <engdamage.h>
+#include "damagelist.h"
@@ -0,0 +1,301 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS Damage List Test
+ * FILE:            tools/damagetest/damagetest.c
+ * PURPOSE:         Checks that the win32k damage list covers everything that
+ *                  was added to it, against a coverage bitmap
+ */
+
+#include <stdio.h>
+
+#include "damagehost.h"
+
+/* DEFINES ********************************************************************/
+
+#define GRID_SIZE           64
+#define RANDOM_RUNS         20000
+
+static ULONG Seed = 1;
+static ULONG Failures;
+static UCHAR Damaged[GRID_SIZE][GRID_SIZE];
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { printf(__VA_ARGS__); Failures++; } } while (0)
+
+/* HELPERS ********************************************************************/
+
+static ULONG
+Random(VOID)
+{
+    /* Numerical Recipes LCG, good enough for test patterns */
+    Seed = Seed * 1664525 + 1013904223;
+    return Seed >> 8;
+}
+
+static RECTL
+MakeRect(LONG left, LONG top, LONG right, LONG bottom)
+{
+    RECTL rcl;
+
+    rcl.left = left;
+    rcl.top = top;
+    rcl.right = right;
+    rcl.bottom = bottom;
+    return rcl;
+}
+
+static BOOL
+RectEqual(const RECTL *prcl1, const RECTL *prcl2)
+{
+    return (prcl1->left == prcl2->left && prcl1->top == prcl2->top &&
+            prcl1->right == prcl2->right && prcl1->bottom == prcl2->bottom);
+}
+
+static BOOL
+RectContains(const RECTL *prclOuter, const RECTL *prclInner)
+{
+    return (prclOuter->left <= prclInner->left &&
+            prclOuter->top <= prclInner->top &&
+            prclOuter->right >= prclInner->right &&
+            prclOuter->bottom >= prclInner->bottom);
+}
+
+static VOID
+Add(PDAMAGELIST pdl, LONG left, LONG top, LONG right, LONG bottom)
+{
+    RECTL rcl = MakeRect(left, top, right, bottom);
+    LONG x, y;
+
+    for (y = top; y < bottom; y++)
+        for (x = left; x < right; x++)
+            Damaged[y][x] = 1;
+
+    DAMAGE_vAddToList(pdl, &rcl);
+}
+
+static VOID
+Reset(PDAMAGELIST pdl)
+{
+    memset(pdl, 0, sizeof(*pdl));
+    memset(Damaged, 0, sizeof(Damaged));
+}
+
+/*
+ * Every damaged pixel has to be in a rectangle of the list and in its bounds.
+ * The list must not be empty, over the cap, or hold a rectangle that another
+ * one contains.
+ */
+static VOID
+CheckList(PDAMAGELIST pdl, const char *Name)
+{
+    ULONG i, j;
+    LONG x, y;
+    BOOL Covered;
+
+    if (pdl->cRects == 0 || pdl->cRects > DAMAGE_MAX_RECTS)
+    {
+        printf("%s: %u rects\n", Name, pdl->cRects);
+        Failures++;
+        return;
+    }
+
+    for (i = 0; i < pdl->cRects; i++)
+    {
+        CHECK(RectContains(&pdl->rclBounds, &pdl->arcl[i]),
+              "%s: rect %u is outside the bounds\n", Name, i);
+
+        for (j = 0; j < pdl->cRects; j++)
+        {
+            CHECK(i == j || !RectContains(&pdl->arcl[i], &pdl->arcl[j]),
+                  "%s: rect %u contains rect %u\n", Name, i, j);
+        }
+    }
+
+    for (y = 0; y < GRID_SIZE; y++)
+    {
+        for (x = 0; x < GRID_SIZE; x++)
+        {
+            if (!Damaged[y][x])
+                continue;
+
+            Covered = FALSE;
+            for (i = 0; i < pdl->cRects && !Covered; i++)
+            {
+                Covered = (x >= pdl->arcl[i].left && x < pdl->arcl[i].right &&
+                           y >= pdl->arcl[i].top && y < pdl->arcl[i].bottom);
+            }
+
+            if (!Covered)
+            {
+                printf("%s: pixel %d,%d is not covered\n", Name, (int)x, (int)y);
+                Failures++;
+                return;
+            }
+        }
+    }
+}
+
+/* TESTS **********************************************************************/
+
+static VOID
+TestContainment(VOID)
+{
+    DAMAGELIST dl;
+    RECTL rcl = MakeRect(0, 0, 40, 40);
+
+    /* A rectangle that another one contains is dropped */
+    Reset(&dl);
+    Add(&dl, 0, 0, 40, 40);
+    Add(&dl, 10, 10, 20, 20);
+    CHECK(dl.cRects == 1 && RectEqual(&dl.arcl[0], &rcl),
+          "Contained: %u rects\n", dl.cRects);
+
+    /* A rectangle that contains others replaces all of them */
+    Reset(&dl);
+    Add(&dl, 1, 1, 3, 3);
+    Add(&dl, 50, 50, 52, 52);
+    Add(&dl, 10, 30, 12, 32);
+    Add(&dl, 30, 10, 32, 12);
+    Add(&dl, 0, 0, 40, 40);
+    CheckList(&dl, "Containing");
+    CHECK(dl.cRects == 2, "Containing: %u rects, expected 2\n", dl.cRects);
+}
+
+static VOID
+TestMerge(VOID)
+{
+    DAMAGELIST dl;
+    RECTL rcl = MakeRect(0, 0, 30, 10);
+
+    /* Two apart, then the one between them: all three become one, which
+       needs a second pass over the list after the first merge */
+    Reset(&dl);
+    Add(&dl, 0, 0, 10, 10);
+    Add(&dl, 20, 0, 30, 10);
+    CHECK(dl.cRects == 2, "Apart: %u rects, expected 2\n", dl.cRects);
+    Add(&dl, 10, 0, 20, 10);
+    CheckList(&dl, "Bridge");
+    CHECK(dl.cRects == 1 && RectEqual(&dl.arcl[0], &rcl),
+          "Bridge: %u rects, expected 1\n", dl.cRects);
+
+    /* Diagonal neighbours would waste area, so they stay apart */
+    Reset(&dl);
+    Add(&dl, 0, 0, 10, 10);
+    Add(&dl, 10, 10, 20, 20);
+    CheckList(&dl, "Diagonal");
+    CHECK(dl.cRects == 2, "Diagonal: %u rects, expected 2\n", dl.cRects);
+}
+
+static VOID
+TestCap(VOID)
+{
+    DAMAGELIST dl;
+    RECTL rcl;
+    ULONG i;
+
+    /* DAMAGE_MAX_RECTS + 1 rectangles that can't be merged */
+    Reset(&dl);
+    for (i = 0; i <= DAMAGE_MAX_RECTS; i++)
+        Add(&dl, (i % 8) * 8, (i / 8) * 8, (i % 8) * 8 + 2, (i / 8) * 8 + 2);
+
+    rcl = MakeRect(0, 0, 7 * 8 + 2, (DAMAGE_MAX_RECTS / 8) * 8 + 2);
+    CheckList(&dl, "Cap");
+    CHECK(dl.cRects == 1 && RectEqual(&dl.arcl[0], &rcl),
+          "Cap: %u rects, expected the bounding rect\n", dl.cRects);
+}
+
+static VOID
+TestQuery(VOID)
+{
+    DAMAGELIST dl;
+    RECTL arcl[DAMAGE_MAX_RECTS];
+    RECTL rcl = MakeRect(0, 0, 22, 22);
+    ULONG cRects;
+
+    Reset(&dl);
+    Add(&dl, 0, 0, 2, 2);
+    Add(&dl, 10, 10, 12, 12);
+    Add(&dl, 20, 20, 22, 22);
+
+    /* The count only */
+    cRects = DAMAGE_cQueryList(&dl, 0, NULL, 0);
+    CHECK(cRects == 3, "Count: %u, expected 3\n", cRects);
+
+    /* No room, nothing is returned and nothing is reset */
+    cRects = DAMAGE_cQueryList(&dl, 0, arcl, QDAMAGE_RESET);
+    CHECK(cRects == 3 && dl.cRects == 3, "No room: %u, %u left\n", cRects, dl.cRects);
+
+    /* All of them */
+    cRects = DAMAGE_cQueryList(&dl, DAMAGE_MAX_RECTS, arcl, 0);
+    CHECK(cRects == 3 && memcmp(arcl, dl.arcl, 3 * sizeof(RECTL)) == 0,
+          "All: %u\n", cRects);
+
+    /* A short buffer gets the bounds, and the reset forgets the rest */
+    memset(arcl, 0, sizeof(arcl));
+    cRects = DAMAGE_cQueryList(&dl, 2, arcl, QDAMAGE_RESET);
+    CHECK(cRects == 1 && RectEqual(&arcl[0], &rcl), "Short: %u\n", cRects);
+    CHECK(dl.cRects == 0, "Short: %u left after the reset\n", dl.cRects);
+
+    /* It starts over after a reset */
+    Add(&dl, 5, 5, 6, 6);
+    rcl = MakeRect(5, 5, 6, 6);
+    CHECK(dl.cRects == 1 && RectEqual(&dl.rclBounds, &rcl),
+          "After reset: %u rects\n", dl.cRects);
+
+    /* The count can be reset as well */
+    cRects = DAMAGE_cQueryList(&dl, 0, NULL, QDAMAGE_RESET);
+    CHECK(cRects == 1 && dl.cRects == 0, "Count reset: %u, %u left\n", cRects, dl.cRects);
+}
+
+/* Random sequences of small and large, thin and square rectangles */
+static VOID
+TestRandom(VOID)
+{
+    DAMAGELIST dl;
+    LONG left, top, right, bottom;
+    ULONG Run, Count, i;
+
+    for (Run = 0; Run < RANDOM_RUNS; Run++)
+    {
+        Reset(&dl);
+        Count = 1 + Random() % 40;
+        for (i = 0; i < Count; i++)
+        {
+            left = Random() % (GRID_SIZE - 1);
+            top = Random() % (GRID_SIZE - 1);
+            right = left + 1 + Random() % ((i & 1) ? 4 : 20);
+            bottom = top + 1 + Random() % ((i & 1) ? 20 : 4);
+            Add(&dl, left, top, min(right, GRID_SIZE), min(bottom, GRID_SIZE));
+            CheckList(&dl, "Random");
+        }
+
+        if (Failures != 0)
+        {
+            printf("Random run %u failed\n", Run);
+            return;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+        Seed = strtoul(argv[1], NULL, 0);
+
+    TestContainment();
+    TestMerge();
+    TestCap();
+    TestQuery();
+    TestRandom();
+
+    if (Failures != 0)
+    {
+        printf("%u test(s) failed\n", Failures);
+        return 1;
+    }
+
+    printf("The damage list covers everything that was added to it\n");
+    return 0;
+}
+
+/* EOF */
@@ -0,0 +1,309 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS DIB AlphaBlend Test
+ * FILE:            tools/dibblendtest/dibblendtest.c
+ * PURPOSE:         Checks that the win32k AlphaBlend span kernels give the
+ *                  same pixels as the per-pixel code
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <typedefs.h>
+#include "blendspan.h"
+
+/* DEFINES ********************************************************************/
+
+#define TEST_PIXELS         4096
+
+typedef union
+{
+    ULONG ul;
+    struct
+    {
+        UCHAR red;
+        UCHAR green;
+        UCHAR blue;
+        UCHAR alpha;
+    } col;
+} NICEPIXEL32;
+
+typedef union
+{
+    USHORT us;
+    struct
+    {
+        USHORT blue  :5;
+        USHORT green :6;
+        USHORT red   :5;
+    } col;
+} NICEPIXEL16_565;
+
+typedef union
+{
+    USHORT us;
+    struct
+    {
+        USHORT blue  :5;
+        USHORT green :5;
+        USHORT red   :5;
+        USHORT xxxx  :1;
+    } col;
+} NICEPIXEL16_555;
+
+static ULONG Seed = 1;
+static ULONG Failures;
+
+/* REFERENCE ******************************************************************/
+
+/*
+ * The per-pixel code of DIB_32BPP_AlphaBlend and DIB_16BPP_AlphaBlend for
+ * a 32bpp source, which the kernels have to match exactly.
+ */
+
+static UCHAR
+Clamp8(ULONG val)
+{
+    return (val > 255) ? 255 : (UCHAR)val;
+}
+
+static UCHAR
+Clamp6(ULONG val)
+{
+    return (val > 63) ? 63 : (UCHAR)val;
+}
+
+static UCHAR
+Clamp5(ULONG val)
+{
+    return (val > 31) ? 31 : (UCHAR)val;
+}
+
+static ULONG
+Reference32(ULONG Dst, ULONG Src, UCHAR ConstAlpha, BOOLEAN SrcAlpha)
+{
+    NICEPIXEL32 DstPixel, SrcPixel;
+    UCHAR Alpha;
+
+    SrcPixel.ul = Src;
+    SrcPixel.col.red = (SrcPixel.col.red * ConstAlpha) / 255;
+    SrcPixel.col.green = (SrcPixel.col.green * ConstAlpha) / 255;
+    SrcPixel.col.blue = (SrcPixel.col.blue * ConstAlpha) / 255;
+    SrcPixel.col.alpha = (SrcPixel.col.alpha * ConstAlpha) / 255;
+
+    Alpha = SrcAlpha ? SrcPixel.col.alpha : ConstAlpha;
+
+    DstPixel.ul = Dst;
+    DstPixel.col.red = Clamp8((DstPixel.col.red * (255 - Alpha)) / 255 + SrcPixel.col.red);
+    DstPixel.col.green = Clamp8((DstPixel.col.green * (255 - Alpha)) / 255 + SrcPixel.col.green);
+    DstPixel.col.blue = Clamp8((DstPixel.col.blue * (255 - Alpha)) / 255 + SrcPixel.col.blue);
+    DstPixel.col.alpha = Clamp8((DstPixel.col.alpha * (255 - Alpha)) / 255 + SrcPixel.col.alpha);
+    return DstPixel.ul;
+}
+
+static ULONG
+SwapRB(ULONG Color)
+{
+    return (Color & 0xff00ff00) | ((Color & 0xff) << 16) | ((Color >> 16) & 0xff);
+}
+
+static USHORT
+Reference565(USHORT Dst, ULONG Src, UCHAR ConstAlpha, BOOLEAN SrcAlpha, BOOLEAN Swap)
+{
+    NICEPIXEL16_565 DstPixel16;
+    NICEPIXEL32 SrcPixel32;
+    UCHAR Alpha, Alpha6, Alpha5;
+
+    SrcPixel32.ul = Swap ? SwapRB(Src) : Src;
+    SrcPixel32.col.red = (SrcPixel32.col.red * ConstAlpha) / 255;
+    SrcPixel32.col.green = (SrcPixel32.col.green * ConstAlpha) / 255;
+    SrcPixel32.col.blue = (SrcPixel32.col.blue * ConstAlpha) / 255;
+
+    Alpha = SrcAlpha ? (SrcPixel32.col.alpha * ConstAlpha) / 255 : ConstAlpha;
+    Alpha6 = Alpha >> 2;
+    Alpha5 = Alpha >> 3;
+
+    DstPixel16.us = Dst;
+    SrcPixel32.col.red >>= 3;
+    SrcPixel32.col.green >>= 2;
+    SrcPixel32.col.blue >>= 3;
+
+    DstPixel16.col.red = Clamp5((DstPixel16.col.red * (31 - Alpha5)) / 31 + SrcPixel32.col.red);
+    DstPixel16.col.green = Clamp6((DstPixel16.col.green * (63 - Alpha6)) / 63 + SrcPixel32.col.green);
+    DstPixel16.col.blue = Clamp5((DstPixel16.col.blue * (31 - Alpha5)) / 31 + SrcPixel32.col.blue);
+    return DstPixel16.us;
+}
+
+static USHORT
+Reference555(USHORT Dst, ULONG Src, UCHAR ConstAlpha, BOOLEAN SrcAlpha, BOOLEAN Swap)
+{
+    NICEPIXEL16_555 DstPixel16;
+    NICEPIXEL32 SrcPixel32;
+    UCHAR Alpha;
+
+    SrcPixel32.ul = Swap ? SwapRB(Src) : Src;
+    SrcPixel32.col.red = (SrcPixel32.col.red * ConstAlpha) / 255;
+    SrcPixel32.col.green = (SrcPixel32.col.green * ConstAlpha) / 255;
+    SrcPixel32.col.blue = (SrcPixel32.col.blue * ConstAlpha) / 255;
+
+    Alpha = SrcAlpha ? (SrcPixel32.col.alpha * ConstAlpha) / 255 : ConstAlpha;
+    Alpha >>= 3;
+
+    DstPixel16.us = Dst;
+    SrcPixel32.col.red >>= 3;
+    SrcPixel32.col.green >>= 3;
+    SrcPixel32.col.blue >>= 3;
+
+    DstPixel16.col.red = Clamp5((DstPixel16.col.red * (31 - Alpha)) / 31 + SrcPixel32.col.red);
+    DstPixel16.col.green = Clamp5((DstPixel16.col.green * (31 - Alpha)) / 31 + SrcPixel32.col.green);
+    DstPixel16.col.blue = Clamp5((DstPixel16.col.blue * (31 - Alpha)) / 31 + SrcPixel32.col.blue);
+    return DstPixel16.us;
+}
+
+/* TESTS **********************************************************************/
+
+static ULONG
+Random(VOID)
+{
+    /* Numerical Recipes LCG, good enough for test patterns */
+    Seed = Seed * 1664525 + 1013904223;
+    return Seed;
+}
+
+/* Random pixels, with plenty of the transparent and opaque ones that icons
+   and themed controls are made of, and some that aren't premultiplied */
+static VOID
+FillSource(PULONG Src, ULONG Count)
+{
+    ULONG i, Color, Alpha, Scale;
+
+    for (i = 0; i < Count; i++)
+    {
+        Color = Random();
+        Alpha = Color >> 24;
+        switch ((Color >> 8) & 7)
+        {
+            case 0:
+                Src[i] = 0;
+                break;
+
+            case 1:
+                Src[i] = Random() | 0xff000000;
+                break;
+
+            case 2:
+                /* Not premultiplied */
+                Src[i] = Random();
+                break;
+
+            default:
+                /* Premultiplied */
+                Color = Random();
+                Scale = Alpha + 1;
+                Src[i] = (Alpha << 24) |
+                         ((((Color >> 16) & 0xff) * Scale >> 8) << 16) |
+                         ((((Color >> 8) & 0xff) * Scale >> 8) << 8) |
+                         ((Color & 0xff) * Scale >> 8);
+                break;
+        }
+    }
+}
+
+static VOID
+Test32(VOID)
+{
+    static ULONG Src[TEST_PIXELS], Dst[TEST_PIXELS], Expected[TEST_PIXELS];
+    ULONG ConstAlpha, i;
+    BOOLEAN SrcAlpha;
+
+    for (ConstAlpha = 0; ConstAlpha <= 255; ConstAlpha++)
+    {
+        for (SrcAlpha = FALSE; SrcAlpha <= TRUE; SrcAlpha++)
+        {
+            FillSource(Src, TEST_PIXELS);
+            for (i = 0; i < TEST_PIXELS; i++)
+            {
+                Dst[i] = Random();
+                Expected[i] = Reference32(Dst[i], Src[i], (UCHAR)ConstAlpha, SrcAlpha);
+            }
+
+            DIB_32BPP_BlendSpan(Dst, Src, TEST_PIXELS, (UCHAR)ConstAlpha, SrcAlpha);
+
+            for (i = 0; i < TEST_PIXELS; i++)
+            {
+                if (Dst[i] != Expected[i])
+                {
+                    printf("32bpp: ConstAlpha %u SrcAlpha %u pixel %u: got %08X, expected %08X\n",
+                           ConstAlpha, SrcAlpha, i, Dst[i], Expected[i]);
+                    Failures++;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static VOID
+Test16(BOOLEAN Is555)
+{
+    static ULONG Src[TEST_PIXELS];
+    static USHORT Dst[TEST_PIXELS], Expected[TEST_PIXELS];
+    ULONG ConstAlpha, i;
+    BOOLEAN SrcAlpha, Swap;
+
+    for (ConstAlpha = 0; ConstAlpha <= 255; ConstAlpha++)
+    {
+        for (SrcAlpha = FALSE; SrcAlpha <= TRUE; SrcAlpha++)
+        {
+            for (Swap = FALSE; Swap <= TRUE; Swap++)
+            {
+                FillSource(Src, TEST_PIXELS);
+                for (i = 0; i < TEST_PIXELS; i++)
+                {
+                    Dst[i] = (USHORT)Random();
+                    Expected[i] = Is555 ?
+                        Reference555(Dst[i], Src[i], (UCHAR)ConstAlpha, SrcAlpha, Swap) :
+                        Reference565(Dst[i], Src[i], (UCHAR)ConstAlpha, SrcAlpha, Swap);
+                }
+
+                if (Is555)
+                    DIB_16BPP_BlendSpan555(Dst, Src, TEST_PIXELS, (UCHAR)ConstAlpha, SrcAlpha, Swap);
+                else
+                    DIB_16BPP_BlendSpan565(Dst, Src, TEST_PIXELS, (UCHAR)ConstAlpha, SrcAlpha, Swap);
+
+                for (i = 0; i < TEST_PIXELS; i++)
+                {
+                    if (Dst[i] != Expected[i])
+                    {
+                        printf("%s: ConstAlpha %u SrcAlpha %u SwapRB %u pixel %u: got %04X, expected %04X\n",
+                               Is555 ? "555" : "565", ConstAlpha, SrcAlpha, Swap, i,
+                               Dst[i], Expected[i]);
+                        Failures++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+        Seed = strtoul(argv[1], NULL, 0);
+
+    Test32();
+    Test16(FALSE);
+    Test16(TRUE);
+
+    if (Failures != 0)
+    {
+        printf("%u test(s) failed\n", Failures);
+        return 1;
+    }
+
+    printf("All AlphaBlend span kernels match the per-pixel code\n");
+    return 0;
+}
+
+/* EOF */
@@ -0,0 +1,575 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS Fast486 Benchmark
+ * FILE:            tools/fast486bench/fast486bench.c
+ * PURPOSE:         Runs flat binary images on the Fast486 CPU emulator,
+ *                  checks the results and reports the throughput
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include "builddep.h"
+#include <fast486.h>
+
+/* DEFINES ********************************************************************/
+
+#define BENCH_MEMORY_SIZE   0x400000
+#define BENCH_TLB_ENTRIES   0x100000
+#define BENCH_MAX_STEPS     1000000000ULL
+
+/* Memory layout, the same physical addresses are used in both modes */
+#define BENCH_GDT_BASE      0x00800
+#define BENCH_PAGE_DIR      0x03000
+#define BENCH_PAGE_TABLE    0x04000
+#define BENCH_CODE_BASE     0x10000
+#define BENCH_DATA_BASE     0x20000
+#define BENCH_STACK_TOP     0x9FFFC
+#define BENCH_HOST_RAM_BASE 0x10000
+
+#define BENCH_CODE_SELECTOR 0x08
+#define BENCH_DATA_SELECTOR 0x10
+
+/* The BOP that ends a test image */
+#define BENCH_BOP_STOP      0x00
+
+typedef struct _BENCH_TEST
+{
+    const char *Name;
+    const char *Class;
+    BOOLEAN Paging;
+    const UCHAR *Code;
+    ULONG CodeSize;
+    BOOLEAN CheckResult;
+    ULONG Result;
+} BENCH_TEST, *PBENCH_TEST;
+
+typedef struct _BENCH_RESULT
+{
+    ULONG GeneralRegs[FAST486_NUM_GEN_REGS];
+    ULONG Flags;
+    ULONG InstPtr;
+    ULONG Checksum;
+} BENCH_RESULT, *PBENCH_RESULT;
+
+/*
+ * The built-in images only use 32-bit registers, so that the same sequence
+ * runs in real mode (with operand and address size prefixes) and in a flat
+ * 32-bit protected mode segment with paging enabled. EDX points to the data
+ * area in both cases. Each image ends with the BOP 0x00 and leaves its result
+ * in EAX.
+ */
+
+static const UCHAR AluReal[] =
+{
+    0x66, 0xB9, 0x00, 0x00, 0x01, 0x00,             /* mov ecx, 0x10000 */
+    0x66, 0x31, 0xC0,                               /* xor eax, eax */
+    0x66, 0xBB, 0x78, 0x56, 0x34, 0x12,             /* mov ebx, 0x12345678 */
+    0x66, 0x01, 0xD8,                               /* loop: add eax, ebx */
+    0x66, 0x31, 0xC8,                               /* xor eax, ecx */
+    0x66, 0xC1, 0xC3, 0x03,                         /* rol ebx, 0x3 */
+    0x66, 0x2D, 0x11, 0x11, 0x00, 0x00,             /* sub eax, 0x1111 */
+    0x66, 0x81, 0xE3, 0xFF, 0xFF, 0xFF, 0x7F,       /* and ebx, 0x7fffffff */
+    0x66, 0x83, 0xC8, 0x01,                         /* or eax, 0x1 */
+    0x66, 0xD1, 0xE8,                               /* shr eax, 1 */
+    0x66, 0x11, 0xC8,                               /* adc eax, ecx */
+    0x67, 0x66, 0x89, 0x02,                         /* mov dword ptr [edx], eax */
+    0x67, 0x66, 0x03, 0x42, 0x04,                   /* add eax, dword ptr [edx+0x4] */
+    0x67, 0x66, 0x89, 0x5A, 0x04,                   /* mov dword ptr [edx+0x4], ebx */
+    0x66, 0x49,                                     /* dec ecx */
+    0x75, 0xCD,                                     /* jnz loop */
+    0xC4, 0xC4, 0x00,                               /* bop 0x00 */
+};
+
+static const UCHAR StringReal[] =
+{
+    0xFC,                                           /* cld */
+    0x66, 0xBD, 0x00, 0x04, 0x00, 0x00,             /* mov ebp, 0x400 */
+    0x67, 0x66, 0x8D, 0xBA, 0x00, 0x10, 0x00, 0x00, /* loop: lea edi, [edx+0x1000] */
+    0x66, 0x89, 0xE8,                               /* mov eax, ebp */
+    0x66, 0xB9, 0x00, 0x01, 0x00, 0x00,             /* mov ecx, 0x100 */
+    0x66, 0xF3, 0xAB,                               /* rep stosd */
+    0x67, 0x66, 0x8D, 0xB2, 0x00, 0x10, 0x00, 0x00, /* lea esi, [edx+0x1000] */
+    0x67, 0x66, 0x8D, 0xBA, 0x00, 0x20, 0x00, 0x00, /* lea edi, [edx+0x2000] */
+    0x66, 0xB9, 0x00, 0x04, 0x00, 0x00,             /* mov ecx, 0x400 */
+    0xF3, 0xA4,                                     /* rep movsb */
+    0x67, 0x66, 0x8D, 0xB2, 0x00, 0x10, 0x00, 0x00, /* lea esi, [edx+0x1000] */
+    0x67, 0x66, 0x8D, 0xBA, 0x00, 0x20, 0x00, 0x00, /* lea edi, [edx+0x2000] */
+    0x66, 0xB9, 0x00, 0x01, 0x00, 0x00,             /* mov ecx, 0x100 */
+    0x66, 0xF3, 0xA7,                               /* repe cmpsd */
+    0x75, 0x04,                                     /* jne done */
+    0x66, 0x4D,                                     /* dec ebp */
+    0x75, 0xB5,                                     /* jnz loop */
+    0x67, 0x66, 0x8B, 0x82, 0xFC, 0x23, 0x00, 0x00, /* done: mov eax, dword ptr [edx+0x23fc] */
+    0x66, 0x01, 0xC8,                               /* add eax, ecx */
+    0xC4, 0xC4, 0x00,                               /* bop 0x00 */
+};
+
+static const UCHAR FpuReal[] =
+{
+    0x9B, 0xDB, 0xE3,                               /* finit */
+    0x66, 0xB9, 0x10, 0x27, 0x00, 0x00,             /* mov ecx, 0x2710 */
+    0xD9, 0xE8,                                     /* fld1 */
+    0xD9, 0xEE,                                     /* fldz */
+    0xD8, 0xC1,                                     /* loop: fadd st, st(1) */
+    0xD9, 0xC1,                                     /* fld st(1) */
+    0xD8, 0xC8,                                     /* fmul st, st(0) */
+    0xD9, 0xFA,                                     /* fsqrt */
+    0xDE, 0xC1,                                     /* faddp st(1), st */
+    0xD9, 0xE8,                                     /* fld1 */
+    0xDE, 0xC2,                                     /* faddp st(2), st */
+    0x66, 0x49,                                     /* dec ecx */
+    0x75, 0xEE,                                     /* jnz loop */
+    0x67, 0xDB, 0x1A,                               /* fistp dword ptr [edx] */
+    0xDD, 0xD8,                                     /* fstp st(0) */
+    0x67, 0x66, 0x8B, 0x02,                         /* mov eax, dword ptr [edx] */
+    0xC4, 0xC4, 0x00,                               /* bop 0x00 */
+};
+
+static const UCHAR AluPaged[] =
+{
+    0xB9, 0x00, 0x00, 0x01, 0x00,                   /* mov ecx, 0x10000 */
+    0x31, 0xC0,                                     /* xor eax, eax */
+    0xBB, 0x78, 0x56, 0x34, 0x12,                   /* mov ebx, 0x12345678 */
+    0x01, 0xD8,                                     /* loop: add eax, ebx */
+    0x31, 0xC8,                                     /* xor eax, ecx */
+    0xC1, 0xC3, 0x03,                               /* rol ebx, 0x3 */
+    0x2D, 0x11, 0x11, 0x00, 0x00,                   /* sub eax, 0x1111 */
+    0x81, 0xE3, 0xFF, 0xFF, 0xFF, 0x7F,             /* and ebx, 0x7fffffff */
+    0x83, 0xC8, 0x01,                               /* or eax, 0x1 */
+    0xD1, 0xE8,                                     /* shr eax, 1 */
+    0x11, 0xC8,                                     /* adc eax, ecx */
+    0x89, 0x02,                                     /* mov dword ptr [edx], eax */
+    0x03, 0x42, 0x04,                               /* add eax, dword ptr [edx+0x4] */
+    0x89, 0x5A, 0x04,                               /* mov dword ptr [edx+0x4], ebx */
+    0x49,                                           /* dec ecx */
+    0x75, 0xDC,                                     /* jnz loop */
+    0xC4, 0xC4, 0x00,                               /* bop 0x00 */
+};
+
+static const UCHAR StringPaged[] =
+{
+    0xFC,                                           /* cld */
+    0xBD, 0x00, 0x04, 0x00, 0x00,                   /* mov ebp, 0x400 */
+    0x8D, 0xBA, 0x00, 0x10, 0x00, 0x00,             /* loop: lea edi, [edx+0x1000] */
+    0x89, 0xE8,                                     /* mov eax, ebp */
+    0xB9, 0x00, 0x01, 0x00, 0x00,                   /* mov ecx, 0x100 */
+    0xF3, 0xAB,                                     /* rep stosd */
+    0x8D, 0xB2, 0x00, 0x10, 0x00, 0x00,             /* lea esi, [edx+0x1000] */
+    0x8D, 0xBA, 0x00, 0x20, 0x00, 0x00,             /* lea edi, [edx+0x2000] */
+    0xB9, 0x00, 0x04, 0x00, 0x00,                   /* mov ecx, 0x400 */
+    0xF3, 0xA4,                                     /* rep movsb */
+    0x8D, 0xB2, 0x00, 0x10, 0x00, 0x00,             /* lea esi, [edx+0x1000] */
+    0x8D, 0xBA, 0x00, 0x20, 0x00, 0x00,             /* lea edi, [edx+0x2000] */
+    0xB9, 0x00, 0x01, 0x00, 0x00,                   /* mov ecx, 0x100 */
+    0xF3, 0xA7,                                     /* repe cmpsd */
+    0x75, 0x03,                                     /* jne done */
+    0x4D,                                           /* dec ebp */
+    0x75, 0xC6,                                     /* jnz loop */
+    0x8B, 0x82, 0xFC, 0x23, 0x00, 0x00,             /* done: mov eax, dword ptr [edx+0x23fc] */
+    0x01, 0xC8,                                     /* add eax, ecx */
+    0xC4, 0xC4, 0x00,                               /* bop 0x00 */
+};
+
+static const UCHAR FpuPaged[] =
+{
+    0x9B, 0xDB, 0xE3,                               /* finit */
+    0xB9, 0x10, 0x27, 0x00, 0x00,                   /* mov ecx, 0x2710 */
+    0xD9, 0xE8,                                     /* fld1 */
+    0xD9, 0xEE,                                     /* fldz */
+    0xD8, 0xC1,                                     /* loop: fadd st, st(1) */
+    0xD9, 0xC1,                                     /* fld st(1) */
+    0xD8, 0xC8,                                     /* fmul st, st(0) */
+    0xD9, 0xFA,                                     /* fsqrt */
+    0xDE, 0xC1,                                     /* faddp st(1), st */
+    0xD9, 0xE8,                                     /* fld1 */
+    0xDE, 0xC2,                                     /* faddp st(2), st */
+    0x49,                                           /* dec ecx */
+    0x75, 0xEF,                                     /* jnz loop */
+    0xDB, 0x1A,                                     /* fistp dword ptr [edx] */
+    0xDD, 0xD8,                                     /* fstp st(0) */
+    0x8B, 0x02,                                     /* mov eax, dword ptr [edx] */
+    0xC4, 0xC4, 0x00,                               /* bop 0x00 */
+};
+static BENCH_TEST BuiltinTests[] =
+{
+    { "alu",    "ALU",    FALSE, AluReal,     sizeof(AluReal),     TRUE, 0x0007EEF5 },
+    { "alu",    "ALU",    TRUE,  AluPaged,    sizeof(AluPaged),    TRUE, 0x0007EEF5 },
+    { "string", "String", FALSE, StringReal,  sizeof(StringReal),  TRUE, 0x00000001 },
+    { "string", "String", TRUE,  StringPaged, sizeof(StringPaged), TRUE, 0x00000001 },
+    { "fpu",    "FPU",    FALSE, FpuReal,     sizeof(FpuReal),     TRUE, 100010000 },
+    { "fpu",    "FPU",    TRUE,  FpuPaged,    sizeof(FpuPaged),    TRUE, 100010000 },
+};
+
+/* GLOBALS ********************************************************************/
+
+static FAST486_STATE Cpu;
+static PUCHAR Memory;
+static PULONG Tlb;
+static PFAST486_BLOCK_CACHE BlockCache;
+
+static BOOLEAN Stopped;
+static BOOLEAN Continuing;
+static jmp_buf StopJump;
+
+static BOOLEAN UseTlb = FALSE;
+static BOOLEAN UseBlockCache = FALSE;
+static BOOLEAN UseHostRam = FALSE;
+static BOOLEAN ForcePaging = FALSE;
+static ULONG Repeat = 3;
+
+/* CALLBACKS ******************************************************************/
+
+static VOID
+FASTCALL
+BenchReadMemory(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    UNREFERENCED_PARAMETER(State);
+
+    if ((Address >= BENCH_MEMORY_SIZE) || (Size > (BENCH_MEMORY_SIZE - Address)))
+    {
+        /* Open bus */
+        memset(Buffer, 0xFF, Size);
+        return;
+    }
+
+    memcpy(Buffer, &Memory[Address], Size);
+}
+
+static VOID
+FASTCALL
+BenchWriteMemory(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    UNREFERENCED_PARAMETER(State);
+
+    if ((Address >= BENCH_MEMORY_SIZE) || (Size > (BENCH_MEMORY_SIZE - Address)))
+    {
+        /* Ignore writes outside of the RAM */
+        return;
+    }
+
+    memcpy(&Memory[Address], Buffer, Size);
+}
+
+static VOID
+FASTCALL
+BenchBop(PFAST486_STATE State, UCHAR BopCode)
+{
+    UNREFERENCED_PARAMETER(State);
+
+    if (BopCode != BENCH_BOP_STOP)
+        printf("Unknown BOP 0x%02X, stopping\n", BopCode);
+
+    Stopped = TRUE;
+
+    /* Fast486Continue never returns by itself */
+    if (Continuing) longjmp(StopJump, 1);
+}
+
+/* FUNCTIONS ******************************************************************/
+
+static VOID
+SetupMachine(PBENCH_TEST Test, BOOLEAN Reference)
+{
+    ULONG i;
+    ULONG Gdt[6];
+    ULONG PageEntry;
+
+    memset(Memory, 0, BENCH_MEMORY_SIZE);
+    memcpy(&Memory[BENCH_CODE_BASE], Test->Code, Test->CodeSize);
+
+    Fast486Initialize(&Cpu,
+                      BenchReadMemory,
+                      BenchWriteMemory,
+                      NULL,
+                      NULL,
+                      BenchBop,
+                      NULL,
+                      NULL,
+                      UseTlb ? Tlb : NULL);
+
+    /* The reference run always uses the plain interpreter */
+    Fast486SetBlockCache(&Cpu, (UseBlockCache && !Reference) ? BlockCache : NULL);
+
+    if (UseHostRam && !Reference)
+    {
+        /* Leave the first 64 KB (with the GDT and page tables) to the callbacks */
+        Fast486RegisterRam(&Cpu,
+                           BENCH_HOST_RAM_BASE,
+                           BENCH_MEMORY_SIZE - BENCH_HOST_RAM_BASE,
+                           &Memory[BENCH_HOST_RAM_BASE]);
+    }
+
+    if (!Test->Paging)
+    {
+        Fast486SetSegment(&Cpu, FAST486_REG_DS, BENCH_DATA_BASE >> 4);
+        Fast486SetSegment(&Cpu, FAST486_REG_ES, BENCH_DATA_BASE >> 4);
+        Fast486SetStack(&Cpu, (BENCH_STACK_TOP & 0xF0000) >> 4, BENCH_STACK_TOP & 0xFFFF);
+        Fast486ExecuteAt(&Cpu, BENCH_CODE_BASE >> 4, 0);
+        return;
+    }
+
+    /* Null descriptor, flat 32-bit code and data segments */
+    Gdt[0] = 0x00000000; Gdt[1] = 0x00000000;
+    Gdt[2] = 0x0000FFFF; Gdt[3] = 0x00CF9A00;
+    Gdt[4] = 0x0000FFFF; Gdt[5] = 0x00CF9200;
+    memcpy(&Memory[BENCH_GDT_BASE], Gdt, sizeof(Gdt));
+
+    /* Identity map the RAM */
+    for (i = 0; i < BENCH_MEMORY_SIZE / FAST486_PAGE_SIZE; i++)
+    {
+        PageEntry = (i * FAST486_PAGE_SIZE) | 0x07;
+        memcpy(&Memory[BENCH_PAGE_TABLE + i * sizeof(ULONG)], &PageEntry, sizeof(ULONG));
+    }
+
+    PageEntry = BENCH_PAGE_TABLE | 0x07;
+    memcpy(&Memory[BENCH_PAGE_DIR], &PageEntry, sizeof(ULONG));
+
+    Cpu.Gdtr.Size = sizeof(Gdt) - 1;
+    Cpu.Gdtr.Address = BENCH_GDT_BASE;
+    Cpu.ControlRegisters[FAST486_REG_CR3] = BENCH_PAGE_DIR;
+    Cpu.ControlRegisters[FAST486_REG_CR0] |= FAST486_CR0_PE | FAST486_CR0_PG;
+
+    Fast486SetSegment(&Cpu, FAST486_REG_DS, BENCH_DATA_SELECTOR);
+    Fast486SetSegment(&Cpu, FAST486_REG_ES, BENCH_DATA_SELECTOR);
+    Fast486SetStack(&Cpu, BENCH_DATA_SELECTOR, BENCH_STACK_TOP);
+    Fast486ExecuteAt(&Cpu, BENCH_CODE_SELECTOR, BENCH_CODE_BASE);
+
+    Cpu.GeneralRegs[FAST486_REG_EDX].Long = BENCH_DATA_BASE;
+}
+
+static VOID
+SaveResult(PBENCH_RESULT Result)
+{
+    ULONG i;
+
+    for (i = 0; i < FAST486_NUM_GEN_REGS; i++)
+        Result->GeneralRegs[i] = Cpu.GeneralRegs[i].Long;
+
+    Result->Flags = Cpu.Flags.Long;
+    Result->InstPtr = Cpu.InstPtr.Long;
+
+    /* FNV-1a hash of the whole RAM */
+    Result->Checksum = 2166136261U;
+    for (i = 0; i < BENCH_MEMORY_SIZE; i++)
+    {
+        Result->Checksum ^= Memory[i];
+        Result->Checksum *= 16777619U;
+    }
+}
+
+static BOOLEAN
+RunTest(PBENCH_TEST Test)
+{
+    BENCH_RESULT Reference, Result;
+    ULONGLONG Steps = 0;
+    double Seconds, BestSeconds = 0.0;
+    clock_t Start;
+    ULONG i;
+
+    /* Count the instructions with the single-stepping interpreter */
+    SetupMachine(Test, TRUE);
+    Stopped = FALSE;
+    Continuing = FALSE;
+
+    while (!Stopped && (Steps < BENCH_MAX_STEPS))
+    {
+        Fast486StepInto(&Cpu);
+        Steps++;
+    }
+
+    if (!Stopped)
+    {
+        printf("%-12s %-7s %-6s did not stop after %llu instructions\n",
+               Test->Name, Test->Class, Test->Paging ? "paged" : "real",
+               (unsigned long long)Steps);
+        return FALSE;
+    }
+
+    SaveResult(&Reference);
+
+    if (Test->CheckResult && (Reference.GeneralRegs[FAST486_REG_EAX] != Test->Result))
+    {
+        printf("%-12s %-7s %-6s wrong result 0x%08X, expected 0x%08X\n",
+               Test->Name, Test->Class, Test->Paging ? "paged" : "real",
+               Reference.GeneralRegs[FAST486_REG_EAX], Test->Result);
+        return FALSE;
+    }
+
+    for (i = 0; i < Repeat; i++)
+    {
+        SetupMachine(Test, FALSE);
+        Stopped = FALSE;
+        Continuing = TRUE;
+
+        Start = clock();
+        if (setjmp(StopJump) == 0) Fast486Continue(&Cpu);
+        Seconds = (double)(clock() - Start) / CLOCKS_PER_SEC;
+
+        Continuing = FALSE;
+
+        /* The free-running CPU must end up in the same state */
+        SaveResult(&Result);
+        if (memcmp(&Result, &Reference, sizeof(Result)) != 0)
+        {
+            printf("%-12s %-7s %-6s state differs from the single-stepped run\n",
+                   Test->Name, Test->Class, Test->Paging ? "paged" : "real");
+            return FALSE;
+        }
+
+        if ((i == 0) || (Seconds < BestSeconds)) BestSeconds = Seconds;
+    }
+
+    printf("%-12s %-7s %-6s %12llu %10.3f %10.2f\n",
+           Test->Name, Test->Class, Test->Paging ? "paged" : "real",
+           (unsigned long long)Steps, BestSeconds * 1000.0,
+           (BestSeconds > 0.0) ? ((double)Steps / BestSeconds / 1000000.0) : 0.0);
+
+    return TRUE;
+}
+
+static PUCHAR
+LoadImage(const char *FileName, PULONG Size)
+{
+    FILE *File;
+    PUCHAR Buffer;
+    long Length;
+
+    File = fopen(FileName, "rb");
+    if (!File)
+    {
+        printf("Cannot open %s\n", FileName);
+        return NULL;
+    }
+
+    fseek(File, 0, SEEK_END);
+    Length = ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    if ((Length <= 0) || (Length > (BENCH_DATA_BASE - BENCH_CODE_BASE)))
+    {
+        printf("%s must be between 1 and %u bytes long\n",
+               FileName, BENCH_DATA_BASE - BENCH_CODE_BASE);
+        fclose(File);
+        return NULL;
+    }
+
+    Buffer = malloc(Length);
+    if (!Buffer || (fread(Buffer, 1, Length, File) != (size_t)Length))
+    {
+        printf("Cannot read %s\n", FileName);
+        free(Buffer);
+        fclose(File);
+        return NULL;
+    }
+
+    fclose(File);
+    *Size = (ULONG)Length;
+    return Buffer;
+}
+
+static VOID
+Usage(VOID)
+{
+    printf("Fast486 benchmark and conformance test\n"
+           "Syntax: fast486bench [-b] [-t] [-m] [-p] [-r count] [image.bin ...]\n"
+           "  -b        Enable the decoded block cache\n"
+           "  -t        Enable the TLB\n"
+           "  -m        Access RAM above 64 KB directly instead of through the callbacks\n"
+           "  -p        Run the given images in 32-bit protected mode with paging\n"
+           "  -r count  Number of timed runs per test, the best one is reported\n"
+           "\n"
+           "Without images the built-in ALU, string and FPU tests are run in both\n"
+           "real mode and paged protected mode. Images are flat binaries loaded at\n"
+           "physical address 0x%X, with DS:EDX pointing to the data area at 0x%X.\n"
+           "They must end with the BOP C4 C4 00.\n",
+           BENCH_CODE_BASE, BENCH_DATA_BASE);
+}
+
+int main(int argc, char *argv[])
+{
+    BENCH_TEST ImageTest;
+    ULONG Failures = 0;
+    ULONG i;
+    int Arg;
+
+    for (Arg = 1; (Arg < argc) && (argv[Arg][0] == '-'); Arg++)
+    {
+        if (strcmp(argv[Arg], "-b") == 0)
+        {
+            UseBlockCache = TRUE;
+        }
+        else if (strcmp(argv[Arg], "-t") == 0)
+        {
+            UseTlb = TRUE;
+        }
+        else if (strcmp(argv[Arg], "-m") == 0)
+        {
+            UseHostRam = TRUE;
+        }
+        else if (strcmp(argv[Arg], "-p") == 0)
+        {
+            ForcePaging = TRUE;
+        }
+        else if ((strcmp(argv[Arg], "-r") == 0) && ((Arg + 1) < argc))
+        {
+            Repeat = strtoul(argv[++Arg], NULL, 0);
+            if (Repeat == 0) Repeat = 1;
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    Memory = malloc(BENCH_MEMORY_SIZE);
+    Tlb = malloc(BENCH_TLB_ENTRIES * sizeof(ULONG));
+    BlockCache = malloc(sizeof(*BlockCache));
+    if (!Memory || !Tlb || !BlockCache)
+    {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    printf("TLB: %s, block cache: %s, direct RAM: %s\n\n",
+           UseTlb ? "on" : "off", UseBlockCache ? "on" : "off",
+           UseHostRam ? "on" : "off");
+    printf("%-12s %-7s %-6s %12s %10s %10s\n",
+           "Test", "Class", "Mode", "Instructions", "Time (ms)", "MIPS");
+
+    if (Arg == argc)
+    {
+        for (i = 0; i < sizeof(BuiltinTests) / sizeof(BuiltinTests[0]); i++)
+        {
+            if (!RunTest(&BuiltinTests[i])) Failures++;
+        }
+    }
+
+    for (; Arg < argc; Arg++)
+    {
+        memset(&ImageTest, 0, sizeof(ImageTest));
+        ImageTest.Name = strrchr(argv[Arg], '/') ? strrchr(argv[Arg], '/') + 1 : argv[Arg];
+        ImageTest.Class = "Image";
+        ImageTest.Paging = ForcePaging;
+        ImageTest.Code = LoadImage(argv[Arg], &ImageTest.CodeSize);
+
+        if (!ImageTest.Code || !RunTest(&ImageTest)) Failures++;
+
+        free((PVOID)ImageTest.Code);
+    }
+
+    free(BlockCache);
+    free(Tlb);
+    free(Memory);
+
+    if (Failures)
+    {
+        printf("\n%u test(s) failed\n", Failures);
+        return 1;
+    }
+
+    return 0;
+}
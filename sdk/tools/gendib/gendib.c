@@ -77,6 +77,13 @@
  * video memory. Accessing video memory from the CPU is slooooooow, so let's
  * try to do this as little as possible, even if that means we have to do some
  * extra operations using main memory.
+ * The hot rops which only combine bits (SRCINVERT, SRCAND, PATCOPY and
+ * PATINVERT) don't care about pixel boundaries, so when there is no color
+ * translation they are done a whole scanline at a time by span routines,
+ * which work on aligned 32 bit words in an unrolled loop that the compiler
+ * can turn into vector code where the target allows it.
+ * Running "gendib -b file.c" writes a standalone host program which times
+ * those span routines against a per-pixel loop for each depth.
  */
 
 #include <stdarg.h>
@@ -132,6 +139,9 @@ ROPINFO, *PROPINFO;
 #define FLAG_BOTTOMUP            0x04
 #define FLAG_FORCENOUSESSOURCE   0x08
 #define FLAG_FORCERAWSOURCEAVAIL 0x10
+#define FLAG_SPAN                0x20
+
+#define SPAN_UNROLL              4
 
 static PROPINFO
 FindRopInfo(unsigned RopCode)
@@ -243,6 +253,147 @@ CreateShiftTables(FILE *Out)
     Output(Out, "};\n");
 }
 
+static unsigned DestBpp[] =
+{
+    8, 16, 32
+};
+
+static unsigned SpanRops[] =
+{
+    ROPCODE_PATINVERT, ROPCODE_SRCINVERT, ROPCODE_SRCAND, ROPCODE_PATCOPY
+};
+
+static int
+IsSpanRop(PROPINFO RopInfo)
+{
+    unsigned Index;
+
+    for (Index = 0; Index < sizeof(SpanRops) / sizeof(SpanRops[0]); Index++)
+    {
+        if (RopInfo->RopCode == SpanRops[Index])
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void
+CreateSpanOperation(FILE *Out, PROPINFO RopInfo, const char *Dest,
+                    const char *Source, const char *Pattern)
+{
+    const char *Template;
+
+    Output(Out, "%s = ", Dest);
+    for (Template = RopInfo->Operation; '\0' != *Template; Template++)
+    {
+        switch(*Template)
+        {
+        case 'S':
+            Output(Out, "%s", Source);
+            break;
+        case 'P':
+            Output(Out, "%s", Pattern);
+            break;
+        case 'D':
+            Output(Out, "%s", Dest);
+            break;
+        default:
+            Output(Out, "%c", *Template);
+            break;
+        }
+    }
+    Output(Out, ";\n");
+}
+
+static void
+CreateSpanRoutine(FILE *Out, PROPINFO RopInfo)
+{
+    static const char *BytePattern =
+        "(UCHAR) (Pattern >> (8 * ((ULONG_PTR) (DestBytes + i) & 0x3)))";
+    char Dest[32], Source[32];
+    unsigned Partial;
+
+    MARK(Out);
+    Output(Out, "\n");
+    Output(Out, "static __inline void\n");
+    Output(Out, "DIB_Span_%s(PUCHAR DestBytes, %s, ULONG Count)\n",
+           RopInfo->Name,
+           RopInfo->UsesSource ? "const UCHAR *SourceBytes" : "ULONG Pattern");
+    Output(Out, "{\n");
+    Output(Out, "PULONG DestPtr;\n");
+    if (RopInfo->UsesSource)
+    {
+        Output(Out, "const ULONG *SourcePtr;\n");
+    }
+    Output(Out, "ULONG i, Lead, Words;\n");
+    Output(Out, "\n");
+    Output(Out, "Lead = (ULONG)(0 - (ULONG_PTR) DestBytes) & 0x3;\n");
+    Output(Out, "if (Count < Lead)\n");
+    Output(Out, "{\n");
+    Output(Out, "Lead = Count;\n");
+    Output(Out, "}\n");
+    Output(Out, "Words = (Count - Lead) / 4;\n");
+    Output(Out, "\n");
+    Output(Out, "for (i = 0; i < Lead; i++)\n");
+    Output(Out, "{\n");
+    CreateSpanOperation(Out, RopInfo, "DestBytes[i]", "SourceBytes[i]",
+                        BytePattern);
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "DestPtr = (PULONG)(DestBytes + Lead);\n");
+    if (RopInfo->UsesSource)
+    {
+        Output(Out, "SourcePtr = (const ULONG *)(SourceBytes + Lead);\n");
+    }
+    Output(Out, "for (i = 0; i + %u <= Words; i += %u)\n", SPAN_UNROLL, SPAN_UNROLL);
+    Output(Out, "{\n");
+    for (Partial = 0; Partial < SPAN_UNROLL; Partial++)
+    {
+        if (0 == Partial)
+        {
+            strcpy(Dest, "DestPtr[i]");
+            strcpy(Source, "SourcePtr[i]");
+        }
+        else
+        {
+            sprintf(Dest, "DestPtr[i + %u]", Partial);
+            sprintf(Source, "SourcePtr[i + %u]", Partial);
+        }
+        CreateSpanOperation(Out, RopInfo, Dest, Source, "Pattern");
+    }
+    Output(Out, "}\n");
+    Output(Out, "for (; i < Words; i++)\n");
+    Output(Out, "{\n");
+    CreateSpanOperation(Out, RopInfo, "DestPtr[i]", "SourcePtr[i]", "Pattern");
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "Lead += 4 * Words;\n");
+    Output(Out, "DestBytes += Lead;\n");
+    if (RopInfo->UsesSource)
+    {
+        Output(Out, "SourceBytes += Lead;\n");
+    }
+    Output(Out, "for (i = 0; i < Count - Lead; i++)\n");
+    Output(Out, "{\n");
+    CreateSpanOperation(Out, RopInfo, "DestBytes[i]", "SourceBytes[i]",
+                        BytePattern);
+    Output(Out, "}\n");
+    Output(Out, "}\n");
+}
+
+static void
+CreateSpanRoutines(FILE *Out)
+{
+    unsigned Index;
+
+    for (Index = 0; Index < sizeof(SpanRops) / sizeof(SpanRops[0]); Index++)
+    {
+        CreateSpanRoutine(Out, FindRopInfo(SpanRops[Index]));
+    }
+}
+
 static void
 CreateOperation(FILE *Out, unsigned Bpp, PROPINFO RopInfo, unsigned SourceBpp,
                 unsigned Bits)
@@ -302,6 +453,7 @@ static void
 CreateBase(FILE *Out, int Source, int Flags, unsigned Bpp)
 {
     const char *What = (Source ? "Source" : "Dest");
+    int Rounded = Source && Bpp <= 16 && 0 == (Flags & FLAG_SPAN);
 
     MARK(Out);
     Output(Out, "%sBase = (char *) BltInfo->%sSurface->pvScan0 +\n", What, What);
@@ -334,7 +486,7 @@ CreateBase(FILE *Out, int Source, int Flags, unsigned Bpp)
     if (Source)
     {
         Output(Out, "             %sBltInfo->SourcePoint.x",
-               16 < Bpp ? "" : "((");
+               Rounded ? "((" : "");
     }
     else
     {
@@ -348,12 +500,12 @@ CreateBase(FILE *Out, int Source, int Flags, unsigned Bpp)
     {
         Output(Out, " * %u", Bpp / 8);
     }
-    if (Source && Bpp <= 16)
+    if (Rounded)
     {
         Output(Out, ") & ~ 0x3)");
     }
     Output(Out, ";\n", Bpp / 8);
-    if (Source && Bpp <= 16)
+    if (Rounded)
     {
         Output(Out, "BaseSourcePixels = %u - (BltInfo->SourcePoint.x & 0x%x);\n",
                32 / Bpp, 32 / Bpp - 1);
@@ -503,8 +655,34 @@ CreateSetSinglePixel(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
 }
 
 static void
-CreateBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
-              unsigned SourceBpp)
+CreateSpanBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags)
+{
+    MARK(Out);
+    if (RopInfo->UsesSource)
+    {
+        CreateBase(Out, 1, Flags | FLAG_SPAN, Bpp);
+        CreateBase(Out, 0, Flags, Bpp);
+    }
+    Output(Out, "CenterCount = %u * (BltInfo->DestRect.right -\n", Bpp >> 3);
+    Output(Out, "                   BltInfo->DestRect.left);\n");
+    Output(Out, "for (LineIndex = 0; LineIndex < LineCount; LineIndex++)\n");
+    Output(Out, "{\n");
+    Output(Out, "DIB_Span_%s((PUCHAR) DestBase, %s, CenterCount);\n",
+           RopInfo->Name,
+           RopInfo->UsesSource ? "(PUCHAR) SourceBase" : "Pattern");
+    if (RopInfo->UsesSource)
+    {
+        Output(Out, "SourceBase %c= BltInfo->SourceSurface->lDelta;\n",
+               0 == (Flags & FLAG_BOTTOMUP) ? '+' : '-');
+    }
+    Output(Out, "DestBase %c= BltInfo->DestSurface->lDelta;\n",
+           0 == (Flags & FLAG_BOTTOMUP) ? '+' : '-');
+    Output(Out, "}\n");
+}
+
+static void
+CreatePixelBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
+                   unsigned SourceBpp)
 {
     unsigned Partial;
 
@@ -676,6 +854,38 @@ CreateBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
     Output(Out, "}\n");
 }
 
+static void
+CreateBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
+              unsigned SourceBpp)
+{
+    MARK(Out);
+    if (! IsSpanRop(RopInfo) || 0 != (Flags & FLAG_PATTERNSURFACE) ||
+            (RopInfo->UsesSource &&
+             (0 == (Flags & FLAG_TRIVIALXLATE) || Bpp != SourceBpp)))
+    {
+        CreatePixelBitCase(Out, Bpp, RopInfo, Flags, SourceBpp);
+    }
+    else if (RopInfo->UsesSource && 32 != Bpp)
+    {
+        /* The words of the span routine must line up in both surfaces */
+        Output(Out, "if (0 == ((BltInfo->SourcePoint.x ^ BltInfo->DestRect.left) & 0x%x))\n",
+               32 / Bpp - 1);
+        Output(Out, "{\n");
+        CreateSpanBitCase(Out, Bpp, RopInfo, Flags);
+        MARK(Out);
+        Output(Out, "}\n");
+        Output(Out, "else\n");
+        Output(Out, "{\n");
+        CreatePixelBitCase(Out, Bpp, RopInfo, Flags, SourceBpp);
+        MARK(Out);
+        Output(Out, "}\n");
+    }
+    else
+    {
+        CreateSpanBitCase(Out, Bpp, RopInfo, Flags);
+    }
+}
+
 static void
 CreateActionBlock(FILE *Out, unsigned Bpp, PROPINFO RopInfo,
                   int Flags)
@@ -1001,6 +1211,7 @@ Generate(char *OutputDir, unsigned Bpp)
     Output(Out, "\n");
     Output(Out, "#include <win32k.h>\n");
     CreateShiftTables(Out);
+    CreateSpanRoutines(Out);
 
     RopInfo = FindRopInfo(ROPCODE_GENERIC);
     CreatePrimitive(Out, Bpp, RopInfo);
@@ -1018,16 +1229,194 @@ Generate(char *OutputDir, unsigned Bpp)
     fclose(Out);
 }
 
+static void
+CreateBenchmarkRoutines(FILE *Out, unsigned Bpp, PROPINFO RopInfo)
+{
+    static const char *Types[] = { "UCHAR", "USHORT", "", "ULONG" };
+    const char *Type = Types[Bpp / 8 - 1];
+    char Dest[64], Source[64], Pattern[64];
+
+    MARK(Out);
+    sprintf(Dest, "((P%s) DestBytes)[i]", Type);
+    sprintf(Source, "((const %s *) SourceBytes)[i]", Type);
+    sprintf(Pattern, "(%s) Pattern", Type);
+    Output(Out, "\n");
+    Output(Out, "static void\n");
+    Output(Out, "PerPixel_%s_%u(PUCHAR DestBytes, const UCHAR *SourceBytes, "
+           "ULONG Pattern, ULONG Pixels)\n", RopInfo->Name, Bpp);
+    Output(Out, "{\n");
+    Output(Out, "ULONG i;\n");
+    Output(Out, "\n");
+    Output(Out, "for (i = 0; i < Pixels; i++)\n");
+    Output(Out, "{\n");
+    CreateSpanOperation(Out, RopInfo, Dest, Source, Pattern);
+    Output(Out, "}\n");
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "static void\n");
+    Output(Out, "Span_%s_%u(PUCHAR DestBytes, const UCHAR *SourceBytes, "
+           "ULONG Pattern, ULONG Pixels)\n", RopInfo->Name, Bpp);
+    Output(Out, "{\n");
+    Output(Out, "DIB_Span_%s(DestBytes, %s, %u * Pixels);\n", RopInfo->Name,
+           RopInfo->UsesSource ? "SourceBytes" : "Pattern", Bpp / 8);
+    Output(Out, "}\n");
+}
+
+static void
+GenerateBenchmark(char *FileName)
+{
+    FILE *Out;
+    unsigned Index, RopIndex;
+    PROPINFO RopInfo;
+
+    Out = fopen(FileName, "w");
+    if (NULL == Out)
+    {
+        perror("Error opening output file");
+        exit(1);
+    }
+
+    MARK(Out);
+    Output(Out, "/* This is a generated file. Please do not edit */\n");
+    Output(Out, "\n");
+    Output(Out, "#include <stdint.h>\n");
+    Output(Out, "#include <stdio.h>\n");
+    Output(Out, "#include <stdlib.h>\n");
+    Output(Out, "#include <string.h>\n");
+    Output(Out, "#include <time.h>\n");
+    Output(Out, "\n");
+    Output(Out, "typedef uint8_t UCHAR, *PUCHAR;\n");
+    Output(Out, "typedef uint16_t USHORT, *PUSHORT;\n");
+    Output(Out, "typedef uint32_t ULONG, *PULONG;\n");
+    Output(Out, "typedef uintptr_t ULONG_PTR;\n");
+    Output(Out, "\n");
+    Output(Out, "#define BENCH_WIDTH   1001\n");
+    Output(Out, "#define BENCH_LINES   256\n");
+    Output(Out, "#define BENCH_ROUNDS  200\n");
+    CreateSpanRoutines(Out);
+
+    for (Index = 0; Index < sizeof(DestBpp) / sizeof(DestBpp[0]); Index++)
+    {
+        for (RopIndex = 0; RopIndex < sizeof(SpanRops) / sizeof(SpanRops[0]); RopIndex++)
+        {
+            CreateBenchmarkRoutines(Out, DestBpp[Index], FindRopInfo(SpanRops[RopIndex]));
+        }
+    }
+
+    Output(Out, "\n");
+    Output(Out, "static const struct\n");
+    Output(Out, "{\n");
+    Output(Out, "const char *Name;\n");
+    Output(Out, "unsigned Bpp;\n");
+    Output(Out, "ULONG Pattern;\n");
+    Output(Out, "void (*PerPixel)(PUCHAR, const UCHAR *, ULONG, ULONG);\n");
+    Output(Out, "void (*Span)(PUCHAR, const UCHAR *, ULONG, ULONG);\n");
+    Output(Out, "} Variants[] =\n");
+    Output(Out, "{\n");
+    for (Index = 0; Index < sizeof(DestBpp) / sizeof(DestBpp[0]); Index++)
+    {
+        for (RopIndex = 0; RopIndex < sizeof(SpanRops) / sizeof(SpanRops[0]); RopIndex++)
+        {
+            RopInfo = FindRopInfo(SpanRops[RopIndex]);
+            Output(Out, "{ \"%s\", %u, 0x%08x, PerPixel_%s_%u, Span_%s_%u },\n",
+                   RopInfo->Name, DestBpp[Index],
+                   8 == DestBpp[Index] ? 0x5a5a5a5a :
+                   16 == DestBpp[Index] ? 0x12341234 : 0x00123456,
+                   RopInfo->Name, DestBpp[Index], RopInfo->Name, DestBpp[Index]);
+        }
+    }
+    Output(Out, "};\n");
+
+    Output(Out, "\n");
+    Output(Out, "static double\n");
+    Output(Out, "Time(void (*Routine)(PUCHAR, const UCHAR *, ULONG, ULONG),\n");
+    Output(Out, "     PUCHAR Dest, const UCHAR *Source, ULONG Pattern, unsigned Bpp)\n");
+    Output(Out, "{\n");
+    Output(Out, "unsigned Round, Line;\n");
+    Output(Out, "ULONG Delta = (BENCH_WIDTH + 1) * 4;\n");
+    Output(Out, "clock_t Start = clock();\n");
+    Output(Out, "\n");
+    Output(Out, "for (Round = 0; Round < BENCH_ROUNDS; Round++)\n");
+    Output(Out, "{\n");
+    Output(Out, "for (Line = 0; Line < BENCH_LINES; Line++)\n");
+    Output(Out, "{\n");
+    Output(Out, "Routine(Dest + Line * Delta + Bpp / 8, Source + Line * Delta + Bpp / 8,\n");
+    Output(Out, "        Pattern, BENCH_WIDTH);\n");
+    Output(Out, "}\n");
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "return (double) BENCH_ROUNDS * BENCH_LINES * BENCH_WIDTH * (Bpp / 8) /\n");
+    Output(Out, "       ((double) (clock() - Start + 1) / CLOCKS_PER_SEC) / (1024 * 1024);\n");
+    Output(Out, "}\n");
+
+    Output(Out, "\n");
+    Output(Out, "int\n");
+    Output(Out, "main(void)\n");
+    Output(Out, "{\n");
+    Output(Out, "ULONG Size = (BENCH_WIDTH + 1) * 4 * BENCH_LINES;\n");
+    Output(Out, "PUCHAR Source = malloc(Size), Dest = malloc(Size), Check = malloc(Size);\n");
+    Output(Out, "double PerPixel, Span;\n");
+    Output(Out, "unsigned Index, Failures = 0;\n");
+    Output(Out, "ULONG i;\n");
+    Output(Out, "\n");
+    Output(Out, "if (NULL == Source || NULL == Dest || NULL == Check)\n");
+    Output(Out, "{\n");
+    Output(Out, "return 1;\n");
+    Output(Out, "}\n");
+    Output(Out, "for (i = 0; i < Size; i++)\n");
+    Output(Out, "{\n");
+    Output(Out, "Source[i] = (UCHAR) rand();\n");
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "printf(\"%%-10s %%4s %%16s %%16s %%8s\\n\", \"Rop\", \"Bpp\", "
+           "\"Per pixel MB/s\", \"Span MB/s\", \"Speedup\");\n");
+    Output(Out, "for (Index = 0; Index < sizeof(Variants) / sizeof(Variants[0]); Index++)\n");
+    Output(Out, "{\n");
+    Output(Out, "memset(Dest, 0xa5, Size);\n");
+    Output(Out, "memset(Check, 0xa5, Size);\n");
+    Output(Out, "Variants[Index].PerPixel(Check + Variants[Index].Bpp / 8, Source + Variants[Index].Bpp / 8,\n");
+    Output(Out, "                         Variants[Index].Pattern, BENCH_WIDTH);\n");
+    Output(Out, "Variants[Index].Span(Dest + Variants[Index].Bpp / 8, Source + Variants[Index].Bpp / 8,\n");
+    Output(Out, "                     Variants[Index].Pattern, BENCH_WIDTH);\n");
+    Output(Out, "if (0 != memcmp(Dest, Check, Size))\n");
+    Output(Out, "{\n");
+    Output(Out, "printf(\"%%-10s %%4u span result differs\\n\", Variants[Index].Name, Variants[Index].Bpp);\n");
+    Output(Out, "Failures++;\n");
+    Output(Out, "continue;\n");
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "PerPixel = Time(Variants[Index].PerPixel, Check, Source, Variants[Index].Pattern, Variants[Index].Bpp);\n");
+    Output(Out, "Span = Time(Variants[Index].Span, Dest, Source, Variants[Index].Pattern, Variants[Index].Bpp);\n");
+    Output(Out, "printf(\"%%-10s %%4u %%16.0f %%16.0f %%7.2fx\\n\", Variants[Index].Name, Variants[Index].Bpp,\n");
+    Output(Out, "       PerPixel, Span, Span / PerPixel);\n");
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "free(Source);\n");
+    Output(Out, "free(Dest);\n");
+    Output(Out, "free(Check);\n");
+    Output(Out, "return 0 != Failures;\n");
+    Output(Out, "}\n");
+
+    fclose(Out);
+}
+
 int
 main(int argc, char *argv[])
 {
     unsigned Index;
-    static unsigned DestBpp[] =
-    { 8, 16, 32 };
 
     if (argc < 2)
         return 0;
 
+    if (0 == strcmp(argv[1], "-b"))
+    {
+        if (3 <= argc)
+        {
+            GenerateBenchmark(argv[2]);
+        }
+        return 0;
+    }
+
     for (Index = 0; Index < sizeof(DestBpp) / sizeof(DestBpp[0]); Index++)
     {
         Generate(argv[1], DestBpp[Index]);
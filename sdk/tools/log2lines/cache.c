@@ -271,4 +271,72 @@ create_cache(int force, int skipImageBase)
     return 0;
 }
 
+/*
+ * Images are loaded once per run: only their .rossym section is kept,
+ * so translating a long log doesn't reload an image for every address.
+ */
+void *
+symbols_lookup(const char *path)
+{
+    PLIST_MEMBER pentry;
+    PIMAGE_SECTION_HEADER PERosSymSectionHeader;
+    void *FileData;
+    size_t FileSize;
+    size_t Size;
+    int l;
+
+    pentry = entry_lookup(&symbols, (char *)path);
+    if (pentry)
+        return pentry->buf;
+
+    FileData = load_file(path, &FileSize);
+    if (!FileData)
+    {
+        l2l_dbg(0, "An error occured loading '%s'\n", path);
+        return NULL;
+    }
+
+    PERosSymSectionHeader = get_sectionheader(FileData);
+    if (!PERosSymSectionHeader)
+    {
+        free(FileData);
+        return NULL;
+    }
+
+    Size = PERosSymSectionHeader->SizeOfRawData;
+    if (PERosSymSectionHeader->PointerToRawData > FileSize ||
+        Size > FileSize - PERosSymSectionHeader->PointerToRawData)
+    {
+        l2l_dbg(0, "Truncated rossym section in '%s'\n", path);
+        summ.offset_errors++;
+        free(FileData);
+        return NULL;
+    }
+
+    pentry = malloc(sizeof(LIST_MEMBER));
+    l = strlen(path);
+    if (pentry)
+        pentry->buf = malloc(Size + l + 1);
+    if (!pentry || !pentry->buf)
+    {
+        l2l_dbg(1, "Alloc entry failed\n");
+        free(pentry);
+        free(FileData);
+        return NULL;
+    }
+
+    /* The section data comes first to keep it aligned, the name follows */
+    memcpy(pentry->buf, (char *)FileData + PERosSymSectionHeader->PointerToRawData, Size);
+    pentry->name = pentry->buf + Size;
+    strcpy(pentry->name, path);
+    pentry->path = pentry->name;
+    pentry->ImageBase = INVALID_BASE;
+    pentry->RelBase = INVALID_BASE;
+    pentry->Size = Size;
+    entry_insert(&symbols, pentry);
+
+    free(FileData);
+    return pentry->buf;
+}
+
 /* EOF */
@@ -29,7 +29,8 @@ char *verboseUsage =
 "  - The offset of a relocated image MUST be relative.\n\n"
 "  log2lines uses a cache in order to avoid a directory scan at each\n"
 "  image lookup, greatly increasing performance. Only image path and its\n"
-"  base address are cached.\n\n"
+"  base address are cached. The symbols of an image are loaded once per\n"
+"  run, so long logs are translated without rereading the images.\n\n"
 "Options:\n"
 "  -b   Use this combined with '-l'. Enable buffering on logFile.\n"
 "       This may solve loosing output on real hardware (ymmv).\n\n"
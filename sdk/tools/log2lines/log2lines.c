@@ -30,6 +30,7 @@ static const char *kdbg_prompt = KDBG_PROMPT;
 static const char *kdbg_cont   = KDBG_CONT;
 
 LIST sources;
+LIST symbols;
 LINEINFO lastLine;
 FILE *logFile        = NULL;
 LIST cache;
@@ -216,15 +217,11 @@ print_offset(void *data, size_t offset, char *toString)
 }
 
 static int
-process_data(const void *FileData, size_t offset, char *toString)
+process_data(void *RosSymData, size_t offset, char *toString)
 {
     int res;
 
-    PIMAGE_SECTION_HEADER PERosSymSectionHeader = get_sectionheader((char *)FileData);
-    if (!PERosSymSectionHeader)
-        return 2;
-
-    res = print_offset((char *)FileData + PERosSymSectionHeader->PointerToRawData, offset, toString);
+    res = print_offset(RosSymData, offset, toString);
     if (res)
     {
         if (toString)
@@ -241,21 +238,13 @@ process_data(const void *FileData, size_t offset, char *toString)
 static int
 process_file(const char *file_name, size_t offset, char *toString)
 {
-    void *FileData;
-    size_t FileSize;
-    int res = 1;
+    void *RosSymData;
 
-    FileData = load_file(file_name, &FileSize);
-    if (!FileData)
-    {
-        l2l_dbg(0, "An error occured loading '%s'\n", file_name);
-    }
-    else
-    {
-        res = process_data(FileData, offset, toString);
-        free(FileData);
-    }
-    return res;
+    RosSymData = symbols_lookup(file_name);
+    if (!RosSymData)
+        return 1;
+
+    return process_data(RosSymData, offset, toString);
 }
 
 static int
@@ -557,6 +546,7 @@ main(int argc, const char **argv)
 
     memset(&cache, 0, sizeof(LIST));
     memset(&sources, 0, sizeof(LIST));
+    memset(&symbols, 0, sizeof(LIST));
     stat_clear(&summ);
     clearLastLine();
 
@@ -666,6 +656,7 @@ cleanup:
 
     list_clear(&sources);
     list_clear(&cache);
+    list_clear(&symbols);
 
     return res;
 }
@@ -0,0 +1,57 @@
+/*
+ * PROJECT:         ReactOS lwIP Unit Tests
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            tools/lwiptest/arch/cc.h
+ * PURPOSE:         lwIP compiler and platform definitions for the host build
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Unsigned int types */
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef uint64_t u64_t;
+
+/* Signed int types */
+typedef int8_t s8_t;
+typedef int16_t s16_t;
+typedef int32_t s32_t;
+
+/* Memory pointer */
+typedef uintptr_t mem_ptr_t;
+
+/* Printf formatters */
+#define U16_F "hu"
+#define S16_F "hd"
+#define X16_F "hx"
+#define U32_F "u"
+#define S32_F "d"
+#define X32_F "x"
+#define SZT_F "zu"
+
+/* Endianness, all the hosts we build on are little endian */
+#ifndef BYTE_ORDER
+#define BYTE_ORDER LITTLE_ENDIAN
+#endif
+
+/* Checksum calculation algorithm choice */
+#define LWIP_CHKSUM_ALGORITHM 3
+
+/* Diagnostics */
+#define LWIP_PLATFORM_DIAG(x) do { printf x; } while (0)
+#define LWIP_PLATFORM_ASSERT(x) \
+    do { printf("Assertion \"%s\" failed at line %d in %s\n", x, __LINE__, __FILE__); abort(); } while (0)
+
+/* Compiler hints for packing structures */
+#if defined(_MSC_VER)
+#define PACK_STRUCT_USE_INCLUDES
+#define PACK_STRUCT_STRUCT
+#else
+#define PACK_STRUCT_STRUCT __attribute__((packed))
+#endif
@@ -0,0 +1,11 @@
+/*
+ * PROJECT:         ReactOS lwIP Unit Tests
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            tools/lwiptest/arch/perf.h
+ * PURPOSE:         lwIP performance measurement hooks, unused on the host
+ */
+
+#pragma once
+
+#define PERF_START
+#define PERF_STOP(x)
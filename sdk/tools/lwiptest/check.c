@@ -0,0 +1,172 @@
+/*
+ * PROJECT:         ReactOS lwIP Unit Tests
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            tools/lwiptest/check.c
+ * PURPOSE:         Runs the test cases in this process, one after the other
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+
+/* There's a single test running at any time */
+static jmp_buf ck_jump;
+static const char *ck_suite_name;
+static int ck_test_number;
+static int ck_failed;
+
+void
+ck_fail_at(const char *file, int line, const char *msg)
+{
+    printf("%s:%d: %s test %d: %s\n", file, line, ck_suite_name, ck_test_number, msg);
+    ck_failed = 1;
+
+    /* Like check does, a failed assertion ends the test */
+    longjmp(ck_jump, 1);
+}
+
+Suite *
+suite_create(const char *name)
+{
+    Suite *s = calloc(1, sizeof(Suite));
+
+    if (s == NULL)
+        abort();
+
+    s->name = name;
+    return s;
+}
+
+TCase *
+tcase_create(const char *name)
+{
+    TCase *tc = calloc(1, sizeof(TCase));
+
+    if (tc == NULL)
+        abort();
+
+    tc->name = name;
+    return tc;
+}
+
+void
+tcase_add_checked_fixture(TCase *tc, SFun setup, SFun teardown)
+{
+    tc->setup = setup;
+    tc->teardown = teardown;
+}
+
+void
+tcase_add_test(TCase *tc, TFun test)
+{
+    /* lwip_check.h creates one test case per test */
+    tc->test = test;
+}
+
+void
+suite_add_tcase(Suite *s, TCase *tc)
+{
+    TCase **ptc;
+
+    for (ptc = &s->tcases; *ptc != NULL; ptc = &(*ptc)->next);
+    *ptc = tc;
+}
+
+SRunner *
+srunner_create(Suite *s)
+{
+    SRunner *sr = calloc(1, sizeof(SRunner));
+
+    if (sr == NULL)
+        abort();
+
+    sr->suites = s;
+    return sr;
+}
+
+void
+srunner_add_suite(SRunner *sr, Suite *s)
+{
+    Suite **ps;
+
+    for (ps = &sr->suites; *ps != NULL; ps = &(*ps)->next);
+    *ps = s;
+}
+
+void
+srunner_set_fork_status(SRunner *sr, enum fork_status fstat)
+{
+    /* Tests always run in this process */
+    (void)sr;
+    (void)fstat;
+}
+
+void
+srunner_run_all(SRunner *sr, enum print_output print_mode)
+{
+    Suite *s;
+    TCase *tc;
+
+    for (s = sr->suites; s != NULL; s = s->next)
+    {
+        ck_suite_name = s->name;
+        ck_test_number = 0;
+
+        for (tc = s->tcases; tc != NULL; tc = tc->next)
+        {
+            ck_test_number++;
+            ck_failed = 0;
+
+            if (!setjmp(ck_jump))
+            {
+                if (tc->setup)
+                    tc->setup();
+                tc->test(0);
+            }
+
+            /* The teardown runs after failed tests too, it resets the stack */
+            if (!setjmp(ck_jump) && tc->teardown)
+                tc->teardown();
+
+            sr->ntests++;
+            if (ck_failed)
+                sr->nfailed++;
+            else if (print_mode >= CK_VERBOSE)
+                printf("%s test %d: Passed\n", s->name, ck_test_number);
+        }
+    }
+
+    if (print_mode >= CK_MINIMAL)
+    {
+        printf("%d%%: Checks: %d, Failures: %d\n",
+               sr->ntests ? 100 * (sr->ntests - sr->nfailed) / sr->ntests : 0,
+               sr->ntests, sr->nfailed);
+    }
+}
+
+int
+srunner_ntests_failed(SRunner *sr)
+{
+    return sr->nfailed;
+}
+
+void
+srunner_free(SRunner *sr)
+{
+    Suite *s, *snext;
+    TCase *tc, *tcnext;
+
+    for (s = sr->suites; s != NULL; s = snext)
+    {
+        snext = s->next;
+        for (tc = s->tcases; tc != NULL; tc = tcnext)
+        {
+            tcnext = tc->next;
+            free(tc);
+        }
+        free(s);
+    }
+    free(sr);
+}
@@ -0,0 +1,74 @@
+/*
+ * PROJECT:         ReactOS lwIP Unit Tests
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            tools/lwiptest/check.h
+ * PURPOSE:         The part of the check framework the lwIP unit tests use,
+ *                  so that they build on the host without it
+ */
+
+#pragma once
+
+enum fork_status
+{
+    CK_FORK_GETENV,
+    CK_FORK,
+    CK_NOFORK
+};
+
+enum print_output
+{
+    CK_SILENT,
+    CK_MINIMAL,
+    CK_NORMAL,
+    CK_VERBOSE
+};
+
+typedef void (*TFun)(int);
+typedef void (*SFun)(void);
+
+typedef struct TCase
+{
+    struct TCase *next;
+    const char *name;
+    SFun setup;
+    SFun teardown;
+    TFun test;
+} TCase;
+
+typedef struct Suite
+{
+    struct Suite *next;
+    const char *name;
+    TCase *tcases;
+} Suite;
+
+typedef struct SRunner
+{
+    Suite *suites;
+    int ntests;
+    int nfailed;
+} SRunner;
+
+#define START_TEST(name) static void name(int _i)
+#define END_TEST
+
+#define fail_unless(expr, ...) \
+    ((expr) ? (void)0 : ck_fail_at(__FILE__, __LINE__, "Assertion '" #expr "' failed"))
+#define fail_if(expr, ...) \
+    (!(expr) ? (void)0 : ck_fail_at(__FILE__, __LINE__, "Failure '" #expr "' occurred"))
+#define fail(...) ck_fail_at(__FILE__, __LINE__, "Failed")
+
+void ck_fail_at(const char *file, int line, const char *msg);
+
+Suite *suite_create(const char *name);
+TCase *tcase_create(const char *name);
+void tcase_add_checked_fixture(TCase *tc, SFun setup, SFun teardown);
+void tcase_add_test(TCase *tc, TFun test);
+void suite_add_tcase(Suite *s, TCase *tc);
+
+SRunner *srunner_create(Suite *s);
+void srunner_add_suite(SRunner *sr, Suite *s);
+void srunner_set_fork_status(SRunner *sr, enum fork_status fstat);
+void srunner_run_all(SRunner *sr, enum print_output print_mode);
+int srunner_ntests_failed(SRunner *sr);
+void srunner_free(SRunner *sr);
@@ -0,0 +1,8 @@
+/*
+ * PROJECT:         ReactOS lwIP Unit Tests
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            tools/lwiptest/config.h
+ * PURPOSE:         Included by lwip_check.h, the host build needs nothing here
+ */
+
+#pragma once
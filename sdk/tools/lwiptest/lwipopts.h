@@ -0,0 +1,52 @@
+/*
+ * PROJECT:         ReactOS lwIP Unit Tests
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            tools/lwiptest/lwipopts.h
+ * PURPOSE:         lwIP options for the unit tests, the TCP options match
+ *                  the ReactOS build where the tests allow it
+ */
+
+#pragma once
+
+/* The tests drive the stack and its timers themselves */
+#define NO_SYS                          1
+#define LWIP_NETCONN                    0
+#define LWIP_SOCKET                     0
+
+/* The tests check the memory statistics, so use real pools */
+#define MEM_ALIGNMENT                   4
+#define MEM_SIZE                        (2 * 1024 * 1024)
+#define MEMP_NUM_PBUF                   64
+#define MEMP_NUM_TCP_PCB                8
+#define MEMP_NUM_TCP_SEG                2048
+#define PBUF_POOL_SIZE                  256
+
+#define LWIP_ARP                        0
+#define LWIP_ICMP                       0
+#define LWIP_RAW                        0
+#define LWIP_UDP                        1
+#define LWIP_TCP                        1
+
+#define LWIP_STATS                      1
+#define LWIP_STATS_DISPLAY              0
+#define LINK_STATS                      0
+#define IP_STATS                        0
+#define IPFRAG_STATS                    0
+#define ICMP_STATS                      0
+#define UDP_STATS                       1
+#define TCP_STATS                       1
+#define MEM_STATS                       1
+#define MEMP_STATS                      1
+#define SYS_STATS                       0
+
+/* Same TCP features as the ReactOS build */
+#define TCP_MSS                         1460
+#define TCP_QUEUE_OOSEQ                 1
+#define LWIP_WND_SCALE                  1
+#define TCP_RCV_SCALE                   3
+#define TCP_WND                         0x40000
+#define TCP_SND_BUF                     (TCP_WND + 16 * TCP_MSS)
+#define TCP_SND_QUEUELEN                MEMP_NUM_TCP_SEG
+#define TCP_SNDLOWAT                    (TCP_SND_BUF / 2)
+#define LWIP_TCP_SACK                   1
+#define TCP_CONN_STATS                  1
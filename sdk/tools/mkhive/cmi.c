@@ -139,6 +139,12 @@ CmiInitializeHive(
         return Status;
     }
 
+    /* Index the subkeys of large keys, we look up the same paths over and over */
+    if (!CmpInitializeSubKeyIndex(&Hive->Hive))
+    {
+        DPRINT1("Cannot create the subkey index, lookups will be slower\n");
+    }
+
     // HACK: See the HACK from r31253
     if (!CmCreateRootNode(&Hive->Hive, Name))
     {
@@ -0,0 +1,361 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS hive maker
+ * FILE:            tools/mkhive/hivestate.c
+ * PURPOSE:         Incremental hive generation state
+ *
+ * The state file records a hash of mkhive itself, of the command line
+ * options, of the registry sections of every input INF file and of every
+ * generated hive. When all of them still match, the hives on disk are
+ * exactly what a new run would produce, and the regeneration can be skipped.
+ *
+ * Only the DelReg and AddReg sections are hashed, after string substitution,
+ * so that edits to comments or to the other sections of an INF file don't
+ * cause a rebuild. Changed registry sections are not applied on top of the
+ * existing hives: removed lines can't be undone that way, since the value
+ * they replaced may come from another INF file, and the cell layout would
+ * differ from a clean build. They mean a full rebuild instead.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "mkhive.h"
+
+#ifdef _WIN32
+#include <sys/utime.h>
+#define utime _utime
+#else
+#include <utime.h>
+#endif
+
+/* DEFINES ******************************************************************/
+
+#define HIVE_STATE_VERSION  2
+
+#define FNV_OFFSET_BASIS    0xCBF29CE484222325ULL
+#define FNV_PRIME           0x00000100000001B3ULL
+
+typedef struct _STATE_BUFFER
+{
+    PCHAR Buffer;
+    SIZE_T Length;
+    SIZE_T MaximumLength;
+} STATE_BUFFER, *PSTATE_BUFFER;
+
+/* The sections ImportRegistryFile() applies, in the same order */
+static const WCHAR DelReg[] = {'D','e','l','R','e','g',0};
+static const WCHAR AddReg[] = {'A','d','d','R','e','g',0};
+
+/* FUNCTIONS ****************************************************************/
+
+static ULONGLONG
+HashBytes(
+    IN ULONGLONG Value,
+    IN const VOID *Data,
+    IN SIZE_T Size)
+{
+    const UCHAR *Bytes = Data;
+    SIZE_T i;
+
+    for (i = 0; i < Size; i++)
+    {
+        Value ^= Bytes[i];
+        Value *= FNV_PRIME;
+    }
+
+    return Value;
+}
+
+static BOOL
+HashFile(
+    IN PCSTR FileName,
+    OUT ULONGLONG *Hash)
+{
+    FILE *File;
+    UCHAR Buffer[4096];
+    SIZE_T Size;
+    ULONGLONG Value = FNV_OFFSET_BASIS;
+
+    File = fopen(FileName, "rb");
+    if (File == NULL)
+        return FALSE;
+
+    while ((Size = fread(Buffer, 1, sizeof(Buffer), File)) != 0)
+        Value = HashBytes(Value, Buffer, Size);
+
+    if (ferror(File))
+    {
+        fclose(File);
+        return FALSE;
+    }
+
+    fclose(File);
+    *Hash = Value;
+    return TRUE;
+}
+
+static ULONGLONG
+HashInfSection(
+    IN ULONGLONG Value,
+    IN HINF hInf,
+    IN PCWSTR Section)
+{
+    WCHAR Buffer[MAX_INF_STRING_LENGTH];
+    PINFCONTEXT Context = NULL;
+    LONG FieldCount, i;
+    BOOL Ok;
+
+    /* Tell a missing section apart from an empty one */
+    Ok = InfHostFindFirstLine(hInf, Section, NULL, &Context) == 0;
+    Value = HashBytes(Value, &Ok, sizeof(Ok));
+    if (!Ok)
+        return Value;
+
+    for (; Ok; Ok = (InfHostFindNextLine(Context, Context) == 0))
+    {
+        /* Hash the fields as registry_callback() sees them, the key included */
+        FieldCount = InfHostGetFieldCount(Context);
+        Value = HashBytes(Value, &FieldCount, sizeof(FieldCount));
+
+        for (i = 0; i <= FieldCount; i++)
+        {
+            if (InfHostGetStringField(Context, i, Buffer, sizeof(Buffer)/sizeof(WCHAR), NULL) != 0)
+                Buffer[0] = 0;
+
+            /* Include the terminator to keep the field boundaries */
+            Value = HashBytes(Value, Buffer, (strlenW(Buffer) + 1) * sizeof(WCHAR));
+        }
+    }
+
+    InfHostFreeContext(Context);
+    return Value;
+}
+
+static BOOL
+HashInfFile(
+    IN PCSTR FileName,
+    OUT ULONGLONG *Hash)
+{
+    HINF hInf;
+    ULONG ErrorLine;
+    ULONGLONG Value = FNV_OFFSET_BASIS;
+
+    if (InfHostOpenFile(&hInf, FileName, 0, &ErrorLine) != 0)
+        return FALSE;
+
+    Value = HashInfSection(Value, hInf, DelReg);
+    Value = HashInfSection(Value, hInf, AddReg);
+
+    InfHostCloseFile(hInf);
+    *Hash = Value;
+    return TRUE;
+}
+
+static BOOL
+AppendState(
+    IN OUT PSTATE_BUFFER State,
+    IN PCSTR Format,
+    ...)
+{
+    va_list Args;
+    INT Length;
+    PCHAR NewBuffer;
+
+    va_start(Args, Format);
+    Length = vsnprintf(NULL, 0, Format, Args);
+    va_end(Args);
+    if (Length < 0)
+        return FALSE;
+
+    if (State->Length + Length + 1 > State->MaximumLength)
+    {
+        SIZE_T NewLength = State->MaximumLength * 2;
+
+        if (NewLength < State->Length + Length + 1)
+            NewLength = State->Length + Length + 1;
+
+        NewBuffer = realloc(State->Buffer, NewLength);
+        if (NewBuffer == NULL)
+            return FALSE;
+
+        State->Buffer = NewBuffer;
+        State->MaximumLength = NewLength;
+    }
+
+    va_start(Args, Format);
+    vsnprintf(State->Buffer + State->Length, Length + 1, Format, Args);
+    va_end(Args);
+    State->Length += Length;
+
+    return TRUE;
+}
+
+static BOOL
+AppendFileState(
+    IN OUT PSTATE_BUFFER State,
+    IN PCSTR Tag,
+    IN PCSTR FileName,
+    IN BOOL IsInfFile)
+{
+    ULONGLONG Hash;
+
+    if (IsInfFile ? !HashInfFile(FileName, &Hash) : !HashFile(FileName, &Hash))
+        return FALSE;
+
+    return AppendState(State, "%s %08X%08X %s\n",
+                       Tag, (UINT)(Hash >> 32), (UINT)Hash, FileName);
+}
+
+static BOOL
+BuildHiveState(
+    OUT PSTATE_BUFFER State,
+    IN PCSTR ToolFileName,
+    IN PCSTR Options,
+    IN PCSTR *InfFiles,
+    IN INT InfCount,
+    IN PCSTR *HiveFiles,
+    IN INT HiveCount)
+{
+    INT i;
+
+    State->Buffer = NULL;
+    State->Length = 0;
+    State->MaximumLength = 0;
+
+    /* A rebuilt mkhive may generate different hives from the same INF files */
+    if (!AppendState(State, "version %d\n", HIVE_STATE_VERSION) ||
+        !AppendFileState(State, "tool", ToolFileName, FALSE) ||
+        !AppendState(State, "options %s\n", Options))
+    {
+        goto Failure;
+    }
+
+    for (i = 0; i < InfCount; i++)
+    {
+        if (!AppendFileState(State, "inf", InfFiles[i], TRUE))
+            goto Failure;
+    }
+
+    for (i = 0; i < HiveCount; i++)
+    {
+        if (!AppendFileState(State, "hive", HiveFiles[i], FALSE))
+            goto Failure;
+    }
+
+    return TRUE;
+
+Failure:
+    free(State->Buffer);
+    State->Buffer = NULL;
+    return FALSE;
+}
+
+BOOL
+IsHiveStateCurrent(
+    IN PCSTR StateFileName,
+    IN PCSTR ToolFileName,
+    IN PCSTR Options,
+    IN PCSTR *InfFiles,
+    IN INT InfCount,
+    IN PCSTR *HiveFiles,
+    IN INT HiveCount)
+{
+    STATE_BUFFER State;
+    FILE *File;
+    PCHAR Saved;
+    BOOL Current = FALSE;
+
+    /* A missing INF file or hive simply means that the hives must be rebuilt */
+    if (!BuildHiveState(&State, ToolFileName, Options,
+                        InfFiles, InfCount, HiveFiles, HiveCount))
+    {
+        return FALSE;
+    }
+
+    File = fopen(StateFileName, "rb");
+    if (File == NULL)
+    {
+        free(State.Buffer);
+        return FALSE;
+    }
+
+    /* Read one byte more than expected to catch a longer state file */
+    Saved = malloc(State.Length + 1);
+    if (Saved != NULL)
+    {
+        Current = (fread(Saved, 1, State.Length + 1, File) == State.Length) &&
+                  (memcmp(Saved, State.Buffer, State.Length) == 0);
+        free(Saved);
+    }
+
+    fclose(File);
+    free(State.Buffer);
+    return Current;
+}
+
+BOOL
+SaveHiveState(
+    IN PCSTR StateFileName,
+    IN PCSTR ToolFileName,
+    IN PCSTR Options,
+    IN PCSTR *InfFiles,
+    IN INT InfCount,
+    IN PCSTR *HiveFiles,
+    IN INT HiveCount)
+{
+    STATE_BUFFER State;
+    FILE *File;
+    BOOL ret;
+
+    if (!BuildHiveState(&State, ToolFileName, Options,
+                        InfFiles, InfCount, HiveFiles, HiveCount))
+    {
+        printf("    Error computing the hive state\n");
+        return FALSE;
+    }
+
+    File = fopen(StateFileName, "wb");
+    if (File == NULL)
+    {
+        printf("    Error creating/opening file %s\n", StateFileName);
+        free(State.Buffer);
+        return FALSE;
+    }
+
+    ret = (fwrite(State.Buffer, 1, State.Length, File) == State.Length);
+    ret = (fclose(File) == 0) && ret;
+    free(State.Buffer);
+
+    /* Never leave a truncated state file behind */
+    if (!ret)
+        remove(StateFileName);
+
+    return ret;
+}
+
+BOOL
+TouchHiveFiles(
+    IN PCSTR *HiveFiles,
+    IN INT HiveCount)
+{
+    INT i;
+
+    /* The build system compares time stamps, so make the hives look fresh */
+    for (i = 0; i < HiveCount; i++)
+    {
+        printf("  Keeping binary hive: %s\n", HiveFiles[i]);
+
+        if (utime(HiveFiles[i], NULL) != 0)
+        {
+            printf("    Error updating the time stamp\n");
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* EOF */
@@ -0,0 +1,35 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS hive maker
+ * FILE:            tools/mkhive/hivestate.h
+ * PURPOSE:         Incremental hive generation state
+ */
+
+#pragma once
+
+BOOL
+IsHiveStateCurrent(
+    IN PCSTR StateFileName,
+    IN PCSTR ToolFileName,
+    IN PCSTR Options,
+    IN PCSTR *InfFiles,
+    IN INT InfCount,
+    IN PCSTR *HiveFiles,
+    IN INT HiveCount);
+
+BOOL
+SaveHiveState(
+    IN PCSTR StateFileName,
+    IN PCSTR ToolFileName,
+    IN PCSTR Options,
+    IN PCSTR *InfFiles,
+    IN INT InfCount,
+    IN PCSTR *HiveFiles,
+    IN INT HiveCount);
+
+BOOL
+TouchHiveFiles(
+    IN PCSTR *HiveFiles,
+    IN INT HiveCount);
+
+/* EOF */
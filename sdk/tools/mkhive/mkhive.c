@@ -54,11 +54,13 @@
 
 void usage(void)
 {
-    printf("Usage: mkhive [-?] -h:hive1[,hiveN...] [-u] -d:<dstdir> <inffiles>\n\n"
+    printf("Usage: mkhive [-?] -h:hive1[,hiveN...] [-u] -d:<dstdir> [-i:<statefile>] <inffiles>\n\n"
            "  -h:hiveN  - Comma-separated list of hives to create. Possible values are:\n"
            "              SETUPREG, SYSTEM, SOFTWARE, DEFAULT, SAM, SECURITY, BCD.\n"
            "  -u        - Generate file names in uppercase (default: lowercase) (TEMPORARY FLAG!).\n"
            "  -d:dstdir - The binary hive files are created in this directory.\n"
+           "  -i:file   - Incremental mode: record the INF file and hive hashes in this file,\n"
+           "              and keep the existing hives when none of them changed.\n"
            "  inffiles  - List of INF files with full path.\n"
            "  -?        - Displays this help screen.\n");
 }
@@ -99,7 +101,14 @@ int main(int argc, char *argv[])
     BOOL UpperCaseFileName = FALSE;
     PCSTR HiveList = NULL;
     CHAR DestPath[PATH_MAX] = "";
-    CHAR FileName[PATH_MAX];
+    CHAR StateFileName[PATH_MAX] = "";
+    CHAR Options[PATH_MAX];
+    PCSTR *InfFiles;
+    INT InfCount;
+    CHAR HiveFileNames[MAX_NUMBER_OF_REGISTRY_HIVES][PATH_MAX];
+    PCSTR HiveFiles[MAX_NUMBER_OF_REGISTRY_HIVES];
+    PCMHIVE CmHives[MAX_NUMBER_OF_REGISTRY_HIVES];
+    INT HiveCount;
 
     if (argc < 4)
     {
@@ -131,6 +140,10 @@ int main(int argc, char *argv[])
         {
             convert_path(DestPath, argv[i] + 3);
         }
+        else if (argv[i][1] == 'i' && (argv[i][2] == ':' || argv[i][2] == '='))
+        {
+            convert_path(StateFileName, argv[i] + 3);
+        }
         else
         {
             fprintf(stderr, "Unrecognized option: %s\n", argv[i]);
@@ -155,37 +168,31 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    /* Initialize the registry */
-    RegInitializeRegistry(HiveList);
-
-    /* Default to failure */
-    ret = -1;
-
-    /* Now we should have the list of INF files: parse it */
+    /* Now we should have the list of INF files */
+    InfFiles = (PCSTR*)&argv[i];
+    InfCount = argc - i;
     for (; i < argc; ++i)
-    {
-        convert_path(FileName, argv[i]);
-        if (!ImportRegistryFile(FileName))
-            goto Quit;
-    }
+        convert_path(argv[i], argv[i]);
 
+    /* Build the list of hive files to create */
+    HiveCount = 0;
     for (i = 0; i < MAX_NUMBER_OF_REGISTRY_HIVES; ++i)
     {
         /* Skip this registry hive if it's not in the list */
         if (!strstr(HiveList, RegistryHives[i].HiveName))
             continue;
 
-        strcpy(FileName, DestPath);
-        strcat(FileName, DIR_SEPARATOR_STRING);
+        strcpy(HiveFileNames[HiveCount], DestPath);
+        strcat(HiveFileNames[HiveCount], DIR_SEPARATOR_STRING);
 
-        ptr = FileName + strlen(FileName);
+        ptr = HiveFileNames[HiveCount] + strlen(HiveFileNames[HiveCount]);
 
-        strcat(FileName, RegistryHives[i].HiveName);
+        strcat(HiveFileNames[HiveCount], RegistryHives[i].HiveName);
 
         /* Exception for the special setup registry hive */
         // if (strcmp(RegistryHives[i].HiveName, "SETUPREG") == 0)
         if (i == 0)
-            strcat(FileName, ".HIV");
+            strcat(HiveFileNames[HiveCount], ".HIV");
 
         /* Adjust file name case if needed */
         if (UpperCaseFileName)
@@ -199,8 +206,9 @@ int main(int argc, char *argv[])
                 *ptr = tolower(*ptr);
         }
 
-        if (!ExportBinaryHive(FileName, RegistryHives[i].CmHive))
-            goto Quit;
+        HiveFiles[HiveCount] = HiveFileNames[HiveCount];
+        CmHives[HiveCount] = RegistryHives[i].CmHive;
+        HiveCount++;
 
         /* If we happen to deal with the special setup registry hive, stop there */
         // if (strcmp(RegistryHives[i].HiveName, "SETUPREG") == 0)
@@ -208,6 +216,59 @@ int main(int argc, char *argv[])
             break;
     }
 
+    /*
+     * In incremental mode, nothing needs to be done if neither mkhive, its
+     * options, the registry sections of the INF files nor the hives changed
+     * since the last run. Otherwise all the hives are rebuilt: applying only
+     * the changed sections to the existing hives could not undo removed INF
+     * lines, and the result would differ from a clean build.
+     */
+    if (*StateFileName)
+    {
+        snprintf(Options, sizeof(Options), "%s%s", HiveList, UpperCaseFileName ? " -u" : "");
+
+        if (IsHiveStateCurrent(StateFileName, argv[0], Options,
+                               InfFiles, InfCount, HiveFiles, HiveCount))
+        {
+            if (!TouchHiveFiles(HiveFiles, HiveCount))
+                return -1;
+
+            printf("  Done.\n");
+            return 0;
+        }
+
+        /* Don't trust the state file if we fail half-way */
+        remove(StateFileName);
+    }
+
+    /* Initialize the registry */
+    RegInitializeRegistry(HiveList);
+
+    /* Default to failure */
+    ret = -1;
+
+    /* Parse the INF files */
+    for (i = 0; i < InfCount; ++i)
+    {
+        if (!ImportRegistryFile((PCHAR)InfFiles[i]))
+            goto Quit;
+    }
+
+    for (i = 0; i < HiveCount; ++i)
+    {
+        if (!ExportBinaryHive(HiveFiles[i], CmHives[i]))
+            goto Quit;
+    }
+
+    if (*StateFileName)
+    {
+        if (!SaveHiveState(StateFileName, argv[0], Options,
+                           InfFiles, InfCount, HiveFiles, HiveCount))
+        {
+            goto Quit;
+        }
+    }
+
     /* Success */
     ret = 0;
 
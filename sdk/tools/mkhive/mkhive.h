@@ -123,6 +123,7 @@ RegOpenKeyW(
 #include "cmi.h"
 #include "registry.h"
 #include "binhive.h"
+#include "hivestate.h"
 
 #define OBJ_NAME_PATH_SEPARATOR           ((WCHAR)L'\\')
 
@@ -0,0 +1,144 @@
+/*
+ * PROJECT:         Win32 subsystem
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            win32ss/gdi/dib/blendspan.c
+ * PURPOSE:         AlphaBlend span kernels for unstretched 32bpp sources
+ */
+
+#ifdef DIB_BLENDSPAN_HOST
+#include <typedefs.h>
+#include "blendspan.h"
+#ifndef min
+#define min(a, b)  (((a) < (b)) ? (a) : (b))
+#endif
+#else
+#include <win32k.h>
+#endif
+
+/*
+ * x / (2^n - 1) rounded down, exact for 0 <= x <= (2^n - 1)^2, which covers
+ * every product of two channel values. This replaces the divisions of the
+ * per-pixel code without changing a single result.
+ */
+#define DIV_2N_1(x, n)  (((x) + 1 + ((x) >> (n))) >> (n))
+
+#define LANE_MASK       0x00FF00FF
+
+/* Two channels are processed at once, in the 16-bit halves of a ULONG */
+static __inline ULONG
+Div255x2(ULONG x)
+{
+  return ((x + 0x00010001 + ((x >> 8) & LANE_MASK)) >> 8) & LANE_MASK;
+}
+
+/* Each half is at most 255 + 255, clamp it to 255 */
+static __inline ULONG
+Clamp255x2(ULONG x)
+{
+  ULONG Over = x & 0x01000100;
+
+  return (x | (Over - (Over >> 8))) & LANE_MASK;
+}
+
+VOID
+DIB_32BPP_BlendSpan(PULONG Dst, const ULONG *Src, ULONG Count,
+                    UCHAR ConstAlpha, BOOLEAN SrcAlpha)
+{
+  ULONG SrcRB, SrcAG, DstRB, DstAG, Alpha, InvAlpha;
+
+  for (; Count > 0; Count--, Dst++, Src++)
+  {
+    /* Red and blue in one ULONG, green and alpha in the other */
+    SrcRB = *Src & LANE_MASK;
+    SrcAG = (*Src >> 8) & LANE_MASK;
+    if (ConstAlpha != 255)
+    {
+      SrcRB = Div255x2(SrcRB * ConstAlpha);
+      SrcAG = Div255x2(SrcAG * ConstAlpha);
+    }
+
+    Alpha = SrcAlpha ? (SrcAG >> 16) : ConstAlpha;
+    if (Alpha == 255)
+    {
+      /* Nothing of the destination is left */
+      *Dst = SrcRB | (SrcAG << 8);
+      continue;
+    }
+    if (Alpha == 0 && (SrcRB | SrcAG) == 0)
+    {
+      /* Nothing is added to the destination */
+      continue;
+    }
+
+    InvAlpha = 255 - Alpha;
+    DstRB = Div255x2((*Dst & LANE_MASK) * InvAlpha) + SrcRB;
+    DstAG = Div255x2(((*Dst >> 8) & LANE_MASK) * InvAlpha) + SrcAG;
+    *Dst = Clamp255x2(DstRB) | (Clamp255x2(DstAG) << 8);
+  }
+}
+
+VOID
+DIB_16BPP_BlendSpan565(PUSHORT Dst, const ULONG *Src, ULONG Count,
+                       UCHAR ConstAlpha, BOOLEAN SrcAlpha, BOOLEAN SwapRB)
+{
+  ULONG Pixel, Red, Green, Blue, Alpha, Alpha5, Alpha6, Color;
+
+  for (; Count > 0; Count--, Dst++, Src++)
+  {
+    Pixel = *Src;
+    Red = SwapRB ? (Pixel >> 16) & 0xFF : Pixel & 0xFF;
+    Green = (Pixel >> 8) & 0xFF;
+    Blue = SwapRB ? Pixel & 0xFF : (Pixel >> 16) & 0xFF;
+    Alpha = SrcAlpha ? DIV_2N_1((Pixel >> 24) * ConstAlpha, 8) : ConstAlpha;
+
+    /* Perform bit loss */
+    Red = DIV_2N_1(Red * ConstAlpha, 8) >> 3;
+    Green = DIV_2N_1(Green * ConstAlpha, 8) >> 2;
+    Blue = DIV_2N_1(Blue * ConstAlpha, 8) >> 3;
+    Alpha5 = Alpha >> 3;
+    Alpha6 = Alpha >> 2;
+    if (Alpha6 == 0 && (Red | Green | Blue) == 0)
+      continue;
+
+    /* Do the blend in the right bit depth */
+    Color = *Dst;
+    Red += DIV_2N_1(((Color >> 11) & 0x1F) * (31 - Alpha5), 5);
+    Green += DIV_2N_1(((Color >> 5) & 0x3F) * (63 - Alpha6), 6);
+    Blue += DIV_2N_1((Color & 0x1F) * (31 - Alpha5), 5);
+    *Dst = (USHORT)((min(Red, 31) << 11) | (min(Green, 63) << 5) | min(Blue, 31));
+  }
+}
+
+VOID
+DIB_16BPP_BlendSpan555(PUSHORT Dst, const ULONG *Src, ULONG Count,
+                       UCHAR ConstAlpha, BOOLEAN SrcAlpha, BOOLEAN SwapRB)
+{
+  ULONG Pixel, Red, Green, Blue, Alpha, Color;
+
+  for (; Count > 0; Count--, Dst++, Src++)
+  {
+    Pixel = *Src;
+    Red = SwapRB ? (Pixel >> 16) & 0xFF : Pixel & 0xFF;
+    Green = (Pixel >> 8) & 0xFF;
+    Blue = SwapRB ? Pixel & 0xFF : (Pixel >> 16) & 0xFF;
+    Alpha = SrcAlpha ? DIV_2N_1((Pixel >> 24) * ConstAlpha, 8) : ConstAlpha;
+
+    /* Perform bit loss */
+    Red = DIV_2N_1(Red * ConstAlpha, 8) >> 3;
+    Green = DIV_2N_1(Green * ConstAlpha, 8) >> 3;
+    Blue = DIV_2N_1(Blue * ConstAlpha, 8) >> 3;
+    Alpha >>= 3;
+    if (Alpha == 0 && (Red | Green | Blue) == 0)
+      continue;
+
+    /* Do the blend in the right bit depth, the top bit is kept */
+    Color = *Dst;
+    Red += DIV_2N_1(((Color >> 10) & 0x1F) * (31 - Alpha), 5);
+    Green += DIV_2N_1(((Color >> 5) & 0x1F) * (31 - Alpha), 5);
+    Blue += DIV_2N_1((Color & 0x1F) * (31 - Alpha), 5);
+    *Dst = (USHORT)((Color & 0x8000) | (min(Red, 31) << 10) |
+                    (min(Green, 31) << 5) | min(Blue, 31));
+  }
+}
+
+/* EOF */
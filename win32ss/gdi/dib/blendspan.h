@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+ * Span kernels for AlphaBlend from a 32bpp source with the alpha in the top
+ * byte, when the source is not stretched. They only use integer operations,
+ * and produce exactly the same pixels as the per-pixel code in
+ * DIB_32BPP_AlphaBlend and DIB_16BPP_AlphaBlend.
+ *
+ * ConstAlpha is BLENDFUNCTION.SourceConstantAlpha, SrcAlpha tells whether
+ * AC_SRC_ALPHA is set. For the 16bpp kernels, SwapRB tells whether the
+ * source is BGR, otherwise its red channel is in the low byte.
+ */
+
+VOID DIB_32BPP_BlendSpan(PULONG Dst, const ULONG *Src, ULONG Count,
+                         UCHAR ConstAlpha, BOOLEAN SrcAlpha);
+VOID DIB_16BPP_BlendSpan565(PUSHORT Dst, const ULONG *Src, ULONG Count,
+                            UCHAR ConstAlpha, BOOLEAN SrcAlpha, BOOLEAN SwapRB);
+VOID DIB_16BPP_BlendSpan555(PUSHORT Dst, const ULONG *Src, ULONG Count,
+                            UCHAR ConstAlpha, BOOLEAN SrcAlpha, BOOLEAN SwapRB);
@@ -620,6 +620,41 @@ DIB_16BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
   pexlo = CONTAINING_RECORD(ColorTranslation, EXLATEOBJ, xlo);
   EXLATEOBJ_vInitialize(&exloSrcRGB, pexlo->ppalSrc, &gpalRGB, 0, 0, 0);
 
+  /* Unstretched RGB or BGR source: blend whole lines at once */
+  if (Source->iBitmapFormat == BMF_32BPP &&
+      ((exloSrcRGB.xlo.flXlate & XO_TRIVIAL) ||
+       (pexlo->ppalSrc->flFlags & (PAL_INDEXED | PAL_RGB | PAL_BGR)) == PAL_BGR) &&
+      DestRect->right - DestRect->left == SourceRect->right - SourceRect->left &&
+      DestRect->bottom - DestRect->top == SourceRect->bottom - SourceRect->top)
+  {
+    PUSHORT Dst = (PUSHORT)((ULONG_PTR)Dest->pvScan0 + (DestRect->top * Dest->lDelta) +
+      (DestRect->left << 1));
+    PULONG Src = (PULONG)((ULONG_PTR)Source->pvScan0 + (SourceRect->top * Source->lDelta) +
+      (SourceRect->left << 2));
+    BOOLEAN SwapRB = !(exloSrcRGB.xlo.flXlate & XO_TRIVIAL);
+
+    for (DstY = DestRect->top; DstY < DestRect->bottom; DstY++)
+    {
+      if (pexlo->ppalDst->flFlags & PAL_RGB16_555)
+      {
+        DIB_16BPP_BlendSpan555(Dst, Src, DestRect->right - DestRect->left,
+                               BlendFunc.SourceConstantAlpha,
+                               (BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0, SwapRB);
+      }
+      else
+      {
+        DIB_16BPP_BlendSpan565(Dst, Src, DestRect->right - DestRect->left,
+                               BlendFunc.SourceConstantAlpha,
+                               (BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0, SwapRB);
+      }
+      Dst = (PUSHORT)((ULONG_PTR)Dst + Dest->lDelta);
+      Src = (PULONG)((ULONG_PTR)Src + Source->lDelta);
+    }
+
+    EXLATEOBJ_vCleanup(&exloSrcRGB);
+    return TRUE;
+  }
+
   if (pexlo->ppalDst->flFlags & PAL_RGB16_555)
   {
       NICEPIXEL16_555 DstPixel16;
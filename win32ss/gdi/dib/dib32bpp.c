@@ -383,6 +383,26 @@ DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
     (DestRect->left << 2));
   SrcBpp = BitsPerFormat(Source->iBitmapFormat);
 
+  /* Unstretched source in the same format: blend whole lines at once */
+  if (Source->iBitmapFormat == BMF_32BPP &&
+      (ColorTranslation == NULL || (ColorTranslation->flXlate & XO_TRIVIAL)) &&
+      DestRect->right - DestRect->left == SourceRect->right - SourceRect->left &&
+      DestRect->bottom - DestRect->top == SourceRect->bottom - SourceRect->top)
+  {
+    PULONG Src = (PULONG)((ULONG_PTR)Source->pvScan0 + (SourceRect->top * Source->lDelta) +
+      (SourceRect->left << 2));
+
+    for (Rows = DestRect->bottom - DestRect->top; Rows > 0; Rows--)
+    {
+      DIB_32BPP_BlendSpan(Dst, Src, DestRect->right - DestRect->left,
+                          BlendFunc.SourceConstantAlpha,
+                          (BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0);
+      Dst = (PULONG)((ULONG_PTR)Dst + Dest->lDelta);
+      Src = (PULONG)((ULONG_PTR)Src + Source->lDelta);
+    }
+    return TRUE;
+  }
+
   Rows = 0;
    SrcY = SourceRect->top;
    while (++Rows <= DestRect->bottom - DestRect->top)
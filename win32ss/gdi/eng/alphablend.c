@@ -238,6 +238,9 @@ IntEngAlphaBlend(
                             prclDest, prclSrc, pBlendObj);
     }
 
+    if (ret)
+        DAMAGE_vAddRect(psoDest, prclDest, pco);
+
     return ret;
 }
 
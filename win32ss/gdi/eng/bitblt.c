@@ -733,6 +733,9 @@ IntEngBitBlt(
                         pptlBrush ? &ptlBrush : NULL,
                         Rop4);
 
+    if (bResult)
+        DAMAGE_vAddRect(psoTrg, &rclClipped, NULL);
+
     // FIXME: cleanup temp surface!
 
     return bResult;
@@ -1160,6 +1163,9 @@ IntEngMaskBlt(
                             pptlBrushOrg);
     }
 
+    if (ret)
+        DAMAGE_vAddRect(psoDest, &rcDest, pco);
+
     return ret;
 }
 
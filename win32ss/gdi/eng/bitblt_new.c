@@ -538,6 +538,9 @@ IntEngBitBlt(
                         pptlBrush ? &ptBrush : NULL,
                         rop4);
 
+    if (bResult)
+        DAMAGE_vAddRect(psoTrg, &rcClipped, NULL);
+
     // FIXME: cleanup temp surface!
 
     return bResult;
@@ -683,5 +686,11 @@ IntEngCopyBits(
     RECTL *prclTrg,
     POINTL *pptlSrc)
 {
-    return EngCopyBits(psoTrg, psoSrc, pco, pxlo, prclTrg, pptlSrc);
+    BOOL bResult;
+
+    bResult = EngCopyBits(psoTrg, psoSrc, pco, pxlo, prclTrg, pptlSrc);
+    if (bResult)
+        DAMAGE_vAddRect(psoTrg, prclTrg, pco);
+
+    return bResult;
 }
@@ -183,7 +183,13 @@ IntEngCopyBits(
     RECTL *prclDest,
     POINTL *ptlSource)
 {
-    return EngCopyBits(psoDest, psoSource, pco, pxlo, prclDest, ptlSource);
+    BOOL bResult;
+
+    bResult = EngCopyBits(psoDest, psoSource, pco, pxlo, prclDest, ptlSource);
+    if (bResult)
+        DAMAGE_vAddRect(psoDest, prclDest, pco);
+
+    return bResult;
 }
 
 
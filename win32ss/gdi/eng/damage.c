@@ -0,0 +1,173 @@
+/*
+ * PROJECT:         ReactOS win32 subsystem
+ * LICENSE:         See COPYING in the top level directory
+ * PURPOSE:         Damage tracking of the display surface
+ * FILE:            win32ss/gdi/eng/damage.c
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <win32k.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+VOID
+NTAPI
+DAMAGE_vAccumulate(
+    _Inout_ PGDIDAMAGE pDamage,
+    _In_ SURFOBJ *pso,
+    _In_ const RECTL *prcl,
+    _In_opt_ CLIPOBJ *pco)
+{
+    RECTL rcl = *prcl;
+
+    /* Only what could actually have been drawn to */
+    RECTL_vMakeWellOrdered(&rcl);
+    if (!RECTL_bClipRectBySize(&rcl, &rcl, &pso->sizlBitmap))
+        return;
+
+    if (pco != NULL && pco->iDComplexity != DC_TRIVIAL &&
+        !RECTL_bIntersectRect(&rcl, &rcl, &pco->rclBounds))
+    {
+        return;
+    }
+
+    EngAcquireSemaphore(pDamage->hsem);
+    if (pDamage->bEnabled)
+        DAMAGE_vAddToList(&pDamage->List, &rcl);
+    EngReleaseSemaphore(pDamage->hsem);
+}
+
+VOID
+NTAPI
+DAMAGE_vAddSurface(
+    _In_ PPDEVOBJ ppdev)
+{
+    PGDIDAMAGE pDamage = ppdev->pDamage;
+    RECTL rcl;
+
+    if (pDamage == NULL || ppdev->pSurface == NULL)
+        return;
+
+    RECTL_vSetRect(&rcl,
+                   0,
+                   0,
+                   ppdev->pSurface->SurfObj.sizlBitmap.cx,
+                   ppdev->pSurface->SurfObj.sizlBitmap.cy);
+
+    EngAcquireSemaphore(pDamage->hsem);
+    if (pDamage->bEnabled && !RECTL_bIsEmptyRect(&rcl))
+    {
+        pDamage->List.cRects = 0;
+        DAMAGE_vAddToList(&pDamage->List, &rcl);
+    }
+    EngReleaseSemaphore(pDamage->hsem);
+}
+
+VOID
+NTAPI
+DAMAGE_vFree(
+    _Inout_ PPDEVOBJ ppdev)
+{
+    if (ppdev->pDamage == NULL)
+        return;
+
+    EngDeleteSemaphore(ppdev->pDamage->hsem);
+    ExFreePoolWithTag(ppdev->pDamage, GDITAG_PDEV);
+    ppdev->pDamage = NULL;
+}
+
+/* PUBLIC FUNCTIONS **********************************************************/
+
+BOOL
+APIENTRY
+EngEnableDamage(
+    _In_ HDEV hdev,
+    _In_ BOOL bEnable)
+{
+    PPDEVOBJ ppdev = (PPDEVOBJ)hdev;
+    PGDIDAMAGE pDamage;
+
+    if (ppdev == NULL || !(ppdev->flFlags & PDEV_DISPLAY))
+    {
+        DPRINT1("Damage tracking is only available for display devices\n");
+        return FALSE;
+    }
+
+    /* Serialize against other callers and the mode switch */
+    EngAcquireSemaphore(ppdev->hsemDevLock);
+
+    pDamage = ppdev->pDamage;
+    if (pDamage == NULL && bEnable)
+    {
+        pDamage = ExAllocatePoolWithTag(NonPagedPool, sizeof(GDIDAMAGE), GDITAG_PDEV);
+        if (pDamage == NULL)
+        {
+            EngReleaseSemaphore(ppdev->hsemDevLock);
+            return FALSE;
+        }
+
+        RtlZeroMemory(pDamage, sizeof(GDIDAMAGE));
+        pDamage->hsem = EngCreateSemaphore();
+        if (pDamage->hsem == NULL)
+        {
+            ExFreePoolWithTag(pDamage, GDITAG_PDEV);
+            EngReleaseSemaphore(ppdev->hsemDevLock);
+            return FALSE;
+        }
+
+        ppdev->pDamage = pDamage;
+    }
+
+    if (pDamage != NULL)
+    {
+        /* The structure stays until the PDEV is deleted, so that the inline
+           check in DAMAGE_vAddRect never sees it go away */
+        EngAcquireSemaphore(pDamage->hsem);
+        pDamage->bEnabled = bEnable;
+        pDamage->List.cRects = 0;
+        EngReleaseSemaphore(pDamage->hsem);
+
+        /* Nothing is known about what the driver has seen so far */
+        if (bEnable)
+            DAMAGE_vAddSurface(ppdev);
+    }
+
+    EngReleaseSemaphore(ppdev->hsemDevLock);
+    return TRUE;
+}
+
+ULONG
+APIENTRY
+EngQueryDamage(
+    _In_ HDEV hdev,
+    _In_ ULONG cRects,
+    _Out_writes_opt_(cRects) PRECTL prcl,
+    _In_ FLONG fl)
+{
+    PPDEVOBJ ppdev = (PPDEVOBJ)hdev;
+    PGDIDAMAGE pDamage;
+    ULONG cResult;
+
+    if (ppdev == NULL || ppdev->pDamage == NULL)
+        return DDI_ERROR;
+
+    pDamage = ppdev->pDamage;
+    EngAcquireSemaphore(pDamage->hsem);
+
+    if (!pDamage->bEnabled)
+    {
+        EngReleaseSemaphore(pDamage->hsem);
+        return DDI_ERROR;
+    }
+
+    cResult = DAMAGE_cQueryList(&pDamage->List, cRects, prcl, fl);
+
+    EngReleaseSemaphore(pDamage->hsem);
+    return cResult;
+}
+
+/* EOF */
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <drivers/engdamage.h>
+#include "damagelist.h"
+
+typedef struct _GDIDAMAGE
+{
+    HSEMAPHORE hsem;
+    BOOL       bEnabled;
+    DAMAGELIST List;
+} GDIDAMAGE, *PGDIDAMAGE;
+
+VOID
+NTAPI
+DAMAGE_vAccumulate(
+    _Inout_ PGDIDAMAGE pDamage,
+    _In_ SURFOBJ *pso,
+    _In_ const RECTL *prcl,
+    _In_opt_ CLIPOBJ *pco);
+
+VOID
+NTAPI
+DAMAGE_vAddSurface(
+    _In_ PPDEVOBJ ppdev);
+
+VOID
+NTAPI
+DAMAGE_vFree(
+    _Inout_ PPDEVOBJ ppdev);
+
+/* Records that prcl of pso was drawn to, if pso is a tracked display surface */
+FORCEINLINE
+VOID
+DAMAGE_vAddRect(
+    _In_ SURFOBJ *pso,
+    _In_ const RECTL *prcl,
+    _In_opt_ CLIPOBJ *pco)
+{
+    PPDEVOBJ ppdev = (PPDEVOBJ)pso->hdev;
+
+    if (ppdev == NULL || ppdev->pDamage == NULL || !ppdev->pDamage->bEnabled)
+        return;
+
+    if (&ppdev->pSurface->SurfObj != pso)
+        return;
+
+    DAMAGE_vAccumulate(ppdev->pDamage, pso, prcl, pco);
+}
@@ -0,0 +1,149 @@
+/*
+ * PROJECT:         ReactOS win32 subsystem
+ * LICENSE:         See COPYING in the top level directory
+ * PURPOSE:         Coalescing list of damage rectangles
+ * FILE:            win32ss/gdi/eng/damagelist.c
+ */
+
+#ifdef DAMAGE_LIST_HOST
+#include "damagehost.h"
+#else
+#include <win32k.h>
+#endif
+
+static
+LONGLONG
+DAMAGE_llArea(
+    _In_ const RECTL *prcl)
+{
+    return (LONGLONG)(prcl->right - prcl->left) * (prcl->bottom - prcl->top);
+}
+
+static
+VOID
+DAMAGE_vBound(
+    _Inout_ RECTL *prclDst,
+    _In_ const RECTL *prcl)
+{
+    prclDst->left = min(prclDst->left, prcl->left);
+    prclDst->top = min(prclDst->top, prcl->top);
+    prclDst->right = max(prclDst->right, prcl->right);
+    prclDst->bottom = max(prclDst->bottom, prcl->bottom);
+}
+
+static
+BOOL
+DAMAGE_bContains(
+    _In_ const RECTL *prclOuter,
+    _In_ const RECTL *prclInner)
+{
+    return (prclOuter->left <= prclInner->left &&
+            prclOuter->top <= prclInner->top &&
+            prclOuter->right >= prclInner->right &&
+            prclOuter->bottom >= prclInner->bottom);
+}
+
+/* Overlapping or adjacent rectangles */
+static
+BOOL
+DAMAGE_bTouches(
+    _In_ const RECTL *prcl1,
+    _In_ const RECTL *prcl2)
+{
+    return (prcl1->left <= prcl2->right && prcl2->left <= prcl1->right &&
+            prcl1->top <= prcl2->bottom && prcl2->top <= prcl1->bottom);
+}
+
+/* prcl must be well ordered and not empty */
+VOID
+DAMAGE_vAddToList(
+    _Inout_ PDAMAGELIST pdl,
+    _In_ const RECTL *prcl)
+{
+    RECTL rcl = *prcl;
+    RECTL rclUnion;
+    ULONG i;
+
+    /* Fold the rectangle into the list, until nothing more can be merged */
+    i = 0;
+    while (i < pdl->cRects)
+    {
+        if (DAMAGE_bContains(&pdl->arcl[i], &rcl))
+            return;
+
+        if (DAMAGE_bContains(&rcl, &pdl->arcl[i]))
+        {
+            pdl->arcl[i] = pdl->arcl[--pdl->cRects];
+            continue;
+        }
+
+        if (DAMAGE_bTouches(&rcl, &pdl->arcl[i]))
+        {
+            /* Only merge when this adds no more area than the overlap */
+            rclUnion = rcl;
+            DAMAGE_vBound(&rclUnion, &pdl->arcl[i]);
+            if (DAMAGE_llArea(&rclUnion) <=
+                DAMAGE_llArea(&rcl) + DAMAGE_llArea(&pdl->arcl[i]))
+            {
+                /* The larger rectangle may swallow or touch earlier ones */
+                rcl = rclUnion;
+                pdl->arcl[i] = pdl->arcl[--pdl->cRects];
+                i = 0;
+                continue;
+            }
+        }
+
+        i++;
+    }
+
+    if (pdl->cRects == 0)
+        pdl->rclBounds = rcl;
+    else
+        DAMAGE_vBound(&pdl->rclBounds, &rcl);
+
+    if (pdl->cRects == DAMAGE_MAX_RECTS)
+    {
+        /* Out of space, fall back to the bounding rectangle */
+        pdl->arcl[0] = pdl->rclBounds;
+        pdl->cRects = 1;
+        return;
+    }
+
+    pdl->arcl[pdl->cRects++] = rcl;
+}
+
+/* See EngQueryDamage */
+ULONG
+DAMAGE_cQueryList(
+    _Inout_ PDAMAGELIST pdl,
+    _In_ ULONG cRects,
+    _Out_writes_opt_(cRects) PRECTL prcl,
+    _In_ FLONG fl)
+{
+    ULONG cResult = pdl->cRects;
+
+    if (prcl != NULL)
+    {
+        /* Nothing is returned, so nothing is forgotten either */
+        if (cRects == 0)
+            return cResult;
+
+        if (cRects >= cResult)
+        {
+            RtlCopyMemory(prcl, pdl->arcl, cResult * sizeof(RECTL));
+        }
+        else
+        {
+            /* Not enough room, return what covers all of it */
+            *prcl = pdl->rclBounds;
+            cResult = 1;
+        }
+    }
+
+    if (fl & QDAMAGE_RESET)
+        pdl->cRects = 0;
+
+    return cResult;
+}
+
+/* EOF */
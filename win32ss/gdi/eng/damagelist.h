@@ -0,0 +1,24 @@
+#pragma once
+
+/*
+ * The list of damage rectangles of a display surface. It does not lock,
+ * the caller has to serialize access to it.
+ */
+typedef struct _DAMAGELIST
+{
+    ULONG cRects;
+    RECTL rclBounds;
+    RECTL arcl[DAMAGE_MAX_RECTS];
+} DAMAGELIST, *PDAMAGELIST;
+
+VOID
+DAMAGE_vAddToList(
+    _Inout_ PDAMAGELIST pdl,
+    _In_ const RECTL *prcl);
+
+ULONG
+DAMAGE_cQueryList(
+    _Inout_ PDAMAGELIST pdl,
+    _In_ ULONG cRects,
+    _Out_writes_opt_(cRects) PRECTL prcl,
+    _In_ FLONG fl);
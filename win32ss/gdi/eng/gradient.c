@@ -596,5 +596,8 @@ IntEngGradientFill(
                               ulMode);
     }
 
+    if (Ret)
+        DAMAGE_vAddRect(psoDest, prclExtents, pco);
+
     return Ret;
 }
@@ -696,6 +696,18 @@ IntEngLineTo(SURFOBJ *psoDest,
         ret = EngLineTo(psoDest, ClipObj, pbo, x1, y1, x2, y2, RectBounds, Mix);
     }
 
+    if (ret)
+    {
+        /* Include both end points: the start point is drawn even when it
+           is the bottom right one, and a steep line can reach the column
+           (or a flat one the row) of its end point before the end */
+        b.left = min(x1, x2);
+        b.right = max(x1, x2) + 1;
+        b.top = min(y1, y2);
+        b.bottom = max(y1, y2) + 1;
+        DAMAGE_vAddRect(psoDest, &b, ClipObj);
+    }
+
     return ret;
 }
 
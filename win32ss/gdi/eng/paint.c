@@ -90,15 +90,23 @@ IntEngPaint(
     _In_ __in_data_source(USER_MODE) MIX mix)
 {
     SURFACE *psurf = CONTAINING_RECORD(pso, SURFACE, SurfObj);
+    BOOL bResult;
 
     /* Is the surface's Paint function hooked? */
     if ((pso->iType != STYPE_BITMAP) && (psurf->flags & HOOK_PAINT))
     {
         /* Call the driver's DrvPaint */
-        return GDIDEVFUNCS(pso).Paint(pso, pco, pbo, pptlBrushOrg, mix);
+        bResult = GDIDEVFUNCS(pso).Paint(pso, pco, pbo, pptlBrushOrg, mix);
     }
+    else
+    {
+        bResult = EngPaint(pso, pco, pbo, pptlBrushOrg, mix);
+    }
+
+    if (bResult)
+        DAMAGE_vAddRect(pso, &pco->rclBounds, NULL);
 
-    return EngPaint(pso, pco, pbo, pptlBrushOrg, mix);
+    return bResult;
 }
 
 /* EOF */
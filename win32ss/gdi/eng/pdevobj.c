@@ -85,6 +85,7 @@ PDEVOBJ_vDeletePDEV(
     EngDeleteSemaphore(ppdev->hsemDevLock);
     if (ppdev->pEDDgpl)
         ExFreePoolWithTag(ppdev->pEDDgpl, GDITAG_PDEV);
+    DAMAGE_vFree(ppdev);
     ExFreePoolWithTag(ppdev, GDITAG_PDEV);
 }
 
@@ -480,6 +481,9 @@ PDEVOBJ_vSwitchPdev(
     ppdev->pSurface->SurfObj.hdev = (HDEV)ppdev;
     ppdev2->pSurface->SurfObj.hdev = (HDEV)ppdev2;
 
+    /* Damage tracking belongs to the driver instance */
+    SwitchPointer(&ppdev->pDamage, &ppdev2->pDamage);
+
     /* Exchange devinfo */
     temp.devinfo = ppdev->devinfo;
     ppdev->devinfo = ppdev2->devinfo;
@@ -562,6 +566,9 @@ PDEVOBJ_bSwitchMode(
 
     PDEVOBJ_vRelease(ppdevTmp);
 
+    /* Everything on the new surface is yet to be transferred */
+    DAMAGE_vAddSurface(ppdev);
+
     /* Update primary display capabilities */
     if (ppdev == gppdevPrimary)
     {
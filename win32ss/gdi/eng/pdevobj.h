@@ -148,6 +148,7 @@ typedef struct _PDEVOBJ
                               0 for not removed */
     UINT SafetyRemoveCount;
     struct _EDD_DIRECTDRAW_GLOBAL * pEDDgpl;
+    struct _GDIDAMAGE * pDamage; /* Damage tracking, see EngEnableDamage */
 } PDEVOBJ, *PPDEVOBJ;
 
 /* Globals ********************************************************************/
@@ -513,6 +513,9 @@ IntEngStretchBlt(SURFOBJ *psoDest,
                                Rop4);
     }
 
+    if (ret)
+        DAMAGE_vAddRect(psoDest, &OutputRect, ClipRegion);
+
     return ret;
 }
 
@@ -297,6 +297,9 @@ IntEngTransparentBlt(
                                 Reserved);
     }
 
+    if (Ret)
+        DAMAGE_vAddRect(psoDest, &OutputRect, Clip);
+
     return Ret;
 }
 
@@ -26,6 +26,11 @@ typedef struct _FONT_ENTRY_COLL_MEM
 typedef struct _FONT_CACHE_ENTRY
 {
     LIST_ENTRY ListEntry;
+    LIST_ENTRY HashEntry;
+    LIST_ENTRY FaceEntry;
+    PSHARED_FACE SharedFace;
+    SIZE_T Size;
+    ULONG Hash;
     int GlyphIndex;
     FT_Face Face;
     FT_BitmapGlyph BitmapGlyph;
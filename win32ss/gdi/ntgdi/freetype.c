@@ -88,10 +88,17 @@ static BOOL             g_RenderingEnabled = TRUE;
 #define ASSERT_FREETYPE_LOCK_NOT_HELD() \
     ASSERT(g_FreeTypeLock->Owner != KeGetCurrentThread())
 
-#define MAX_FONT_CACHE 256
+/* The glyph cache is bounded by the size of the cached bitmaps */
+#define MAX_FONT_CACHE_SIZE         (2 * 1024 * 1024)
+#define MAX_FONT_CACHE_FACE_SIZE    (MAX_FONT_CACHE_SIZE / 2)
+#define FONT_CACHE_HASH_BUCKETS     512
 
 static LIST_ENTRY g_FontCacheListHead;
+static LIST_ENTRY g_FontCacheHashTable[FONT_CACHE_HASH_BUCKETS];
 static UINT g_FontCacheNumEntries;
+static SIZE_T g_FontCacheSize;
+static ULONG g_FontCacheHits;
+static ULONG g_FontCacheMisses;
 
 static PWCHAR g_ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -222,6 +229,11 @@ SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
         Ptr->Memory = Memory;
         SharedFaceCache_Init(&Ptr->EnglishUS);
         SharedFaceCache_Init(&Ptr->UserLanguage);
+        InitializeListHead(&Ptr->GlyphCacheListHead);
+        Ptr->GlyphCacheSize = 0;
+
+        /* Let the glyph cache find us from the face */
+        Face->generic.data = Ptr;
 
         SharedMem_AddRef(Memory);
         DPRINT("Creating SharedFace for %s\n", Face->family_name ? Face->family_name : "<NULL>");
@@ -260,31 +272,33 @@ RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
 
     FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
     RemoveEntryList(&Entry->ListEntry);
-    ExFreePoolWithTag(Entry, TAG_FONT);
+    RemoveEntryList(&Entry->HashEntry);
+    RemoveEntryList(&Entry->FaceEntry);
+
+    ASSERT(g_FontCacheSize >= Entry->Size);
+    ASSERT(Entry->SharedFace->GlyphCacheSize >= Entry->Size);
+    g_FontCacheSize -= Entry->Size;
+    Entry->SharedFace->GlyphCacheSize -= Entry->Size;
     g_FontCacheNumEntries--;
-    ASSERT(g_FontCacheNumEntries <= MAX_FONT_CACHE);
+
+    ExFreePoolWithTag(Entry, TAG_FONT);
 }
 
 static void
-RemoveCacheEntries(FT_Face Face)
+RemoveCacheEntries(PSHARED_FACE SharedFace)
 {
-    PLIST_ENTRY CurrentEntry, NextEntry;
     PFONT_CACHE_ENTRY FontEntry;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
-         CurrentEntry = NextEntry)
+    /* Only the entries of this face need to be looked at */
+    while (!IsListEmpty(&SharedFace->GlyphCacheListHead))
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        NextEntry = CurrentEntry->Flink;
-
-        if (FontEntry->Face == Face)
-        {
-            RemoveCachedEntry(FontEntry);
-        }
+        FontEntry = CONTAINING_RECORD(SharedFace->GlyphCacheListHead.Flink, FONT_CACHE_ENTRY, FaceEntry);
+        RemoveCachedEntry(FontEntry);
     }
+
+    ASSERT(SharedFace->GlyphCacheSize == 0);
 }
 
 static void SharedMem_Release(PSHARED_MEM Ptr)
@@ -327,7 +341,7 @@ SharedFace_Release(PSHARED_FACE Ptr)
     if (Ptr->RefCount == 0)
     {
         DPRINT("Releasing SharedFace for %s\n", Ptr->Face->family_name ? Ptr->Face->family_name : "<NULL>");
-        RemoveCacheEntries(Ptr->Face);
+        RemoveCacheEntries(Ptr);
         FT_Done_Face(Ptr->Face);
         SharedMem_Release(Ptr->Memory);
         SharedFaceCache_Release(&Ptr->EnglishUS);
@@ -495,11 +509,24 @@ VOID DumpGlobalFontList(BOOL bDoLock)
         IntUnLockGlobalFonts();
 }
 
+VOID DumpGlyphCacheInfo(BOOL bDoLock)
+{
+    if (bDoLock)
+        IntLockFreeType();
+
+    DPRINT("## DumpGlyphCacheInfo: %u entries, %Iu bytes, %lu hits, %lu misses\n",
+           g_FontCacheNumEntries, g_FontCacheSize, g_FontCacheHits, g_FontCacheMisses);
+
+    if (bDoLock)
+        IntUnLockFreeType();
+}
+
 VOID DumpFontInfo(BOOL bDoLock)
 {
     DumpGlobalFontList(bDoLock);
     DumpPrivateFontList(bDoLock);
     DumpFontSubstList();
+    DumpGlyphCacheInfo(bDoLock);
 }
 #endif
 
@@ -660,10 +687,16 @@ BOOL FASTCALL
 InitFontSupport(VOID)
 {
     ULONG ulError;
+    UINT i;
 
     InitializeListHead(&g_FontListHead);
     InitializeListHead(&g_FontCacheListHead);
+    for (i = 0; i < FONT_CACHE_HASH_BUCKETS; i++)
+    {
+        InitializeListHead(&g_FontCacheHashTable[i]);
+    }
     g_FontCacheNumEntries = 0;
+    g_FontCacheSize = 0;
     /* Fast Mutexes must be allocated from non paged pool */
     g_FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (g_FontListLock == NULL)
@@ -3130,6 +3163,23 @@ SameScaleMatrix(
             FLOATOBJ_Equal(&pmx1->efM22, &pmx2->efM22));
 }
 
+/* The matrix is not hashed, entries which only differ by it share a chain */
+static
+ULONG
+GlyphCacheHash(
+    FT_Face Face,
+    INT GlyphIndex,
+    INT Height,
+    FT_Render_Mode RenderMode)
+{
+    ULONG Hash = (ULONG)((ULONG_PTR)Face >> 4);
+
+    Hash = Hash * 31 + (ULONG)GlyphIndex;
+    Hash = Hash * 31 + (ULONG)Height;
+    Hash = Hash * 31 + (ULONG)RenderMode;
+    return Hash ^ (Hash >> 16);
+}
+
 FT_BitmapGlyph APIENTRY
 ftGdiGlyphCacheGet(
     FT_Face Face,
@@ -3138,17 +3188,22 @@ ftGdiGlyphCacheGet(
     FT_Render_Mode RenderMode,
     PMATRIX pmx)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY CurrentEntry, HashHead;
     PFONT_CACHE_ENTRY FontEntry;
+    ULONG Hash;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
+    Hash = GlyphCacheHash(Face, GlyphIndex, Height, RenderMode);
+    HashHead = &g_FontCacheHashTable[Hash % FONT_CACHE_HASH_BUCKETS];
+
+    for (CurrentEntry = HashHead->Flink;
+         CurrentEntry != HashHead;
          CurrentEntry = CurrentEntry->Flink)
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        if ((FontEntry->Face == Face) &&
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
+        if ((FontEntry->Hash == Hash) &&
+            (FontEntry->Face == Face) &&
             (FontEntry->GlyphIndex == GlyphIndex) &&
             (FontEntry->Height == Height) &&
             (FontEntry->RenderMode == RenderMode) &&
@@ -3156,13 +3211,20 @@ ftGdiGlyphCacheGet(
             break;
     }
 
-    if (CurrentEntry == &g_FontCacheListHead)
+    if (CurrentEntry == HashHead)
     {
+        ++g_FontCacheMisses;
         return NULL;
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&g_FontCacheListHead, CurrentEntry);
+    ++g_FontCacheHits;
+
+    /* Make it the most recently used one, globally and for its face */
+    RemoveEntryList(&FontEntry->ListEntry);
+    InsertHeadList(&g_FontCacheListHead, &FontEntry->ListEntry);
+    RemoveEntryList(&FontEntry->FaceEntry);
+    InsertHeadList(&FontEntry->SharedFace->GlyphCacheListHead, &FontEntry->FaceEntry);
+
     return FontEntry->BitmapGlyph;
 }
 
@@ -3219,12 +3281,20 @@ ftGdiGlyphCacheSet(
 {
     FT_Glyph GlyphCopy;
     INT error;
-    PFONT_CACHE_ENTRY NewEntry;
+    PFONT_CACHE_ENTRY NewEntry, OldEntry;
+    PSHARED_FACE SharedFace;
     FT_Bitmap AlignedBitmap;
     FT_BitmapGlyph BitmapGlyph;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
+    SharedFace = (PSHARED_FACE)Face->generic.data;
+    if (!SharedFace)
+    {
+        DPRINT1("No shared face for caching glyph.\n");
+        return NULL;
+    }
+
     error = FT_Get_Glyph(GlyphSlot, &GlyphCopy);
     if (error)
     {
@@ -3264,16 +3334,36 @@ ftGdiGlyphCacheSet(
 
     NewEntry->GlyphIndex = GlyphIndex;
     NewEntry->Face = Face;
+    NewEntry->SharedFace = SharedFace;
     NewEntry->BitmapGlyph = BitmapGlyph;
     NewEntry->Height = Height;
     NewEntry->RenderMode = RenderMode;
     NewEntry->mxWorldToDevice = *pmx;
+    NewEntry->Hash = GlyphCacheHash(Face, GlyphIndex, Height, RenderMode);
+    NewEntry->Size = sizeof(FONT_CACHE_ENTRY) +
+                     abs(BitmapGlyph->bitmap.pitch) * BitmapGlyph->bitmap.rows;
 
     InsertHeadList(&g_FontCacheListHead, &NewEntry->ListEntry);
-    if (++g_FontCacheNumEntries > MAX_FONT_CACHE)
+    InsertHeadList(&g_FontCacheHashTable[NewEntry->Hash % FONT_CACHE_HASH_BUCKETS], &NewEntry->HashEntry);
+    InsertHeadList(&SharedFace->GlyphCacheListHead, &NewEntry->FaceEntry);
+    g_FontCacheSize += NewEntry->Size;
+    SharedFace->GlyphCacheSize += NewEntry->Size;
+    ++g_FontCacheNumEntries;
+
+    /* Don't let a single face take over the whole cache */
+    while (SharedFace->GlyphCacheSize > MAX_FONT_CACHE_FACE_SIZE &&
+           SharedFace->GlyphCacheListHead.Blink != &NewEntry->FaceEntry)
     {
-        NewEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
+        OldEntry = CONTAINING_RECORD(SharedFace->GlyphCacheListHead.Blink, FONT_CACHE_ENTRY, FaceEntry);
+        RemoveCachedEntry(OldEntry);
+    }
+
+    /* Then trim the least recently used entries of all faces */
+    while (g_FontCacheSize > MAX_FONT_CACHE_SIZE &&
+           g_FontCacheListHead.Blink != &NewEntry->ListEntry)
+    {
+        OldEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
+        RemoveCachedEntry(OldEntry);
     }
 
     return BitmapGlyph;
@@ -6516,15 +6606,15 @@ IntExtTextOutW(
             }
             for (i = -thickness / 2; i < -thickness / 2 + thickness; ++i)
             {
-                EngLineTo(SurfObj,
-                          (CLIPOBJ *)&dc->co,
-                          &dc->eboText.BrushObject,
-                          (TextLeft >> 6),
-                          TextTop + yoff - position + i,
-                          ((TextLeft + (realglyph->root.advance.x >> 10)) >> 6),
-                          TextTop + yoff - position + i,
-                          NULL,
-                          ROP2_TO_MIX(R2_COPYPEN));
+                IntEngLineTo(SurfObj,
+                             (CLIPOBJ *)&dc->co,
+                             &dc->eboText.BrushObject,
+                             (TextLeft >> 6),
+                             TextTop + yoff - position + i,
+                             ((TextLeft + (realglyph->root.advance.x >> 10)) >> 6),
+                             TextTop + yoff - position + i,
+                             NULL,
+                             ROP2_TO_MIX(R2_COPYPEN));
             }
         }
         if (plf->lfStrikeOut)
@@ -6532,15 +6622,15 @@ IntExtTextOutW(
             int i;
             for (i = -thickness / 2; i < -thickness / 2 + thickness; ++i)
             {
-                EngLineTo(SurfObj,
-                          (CLIPOBJ *)&dc->co,
-                          &dc->eboText.BrushObject,
-                          (TextLeft >> 6),
-                          TextTop + yoff - (fixAscender >> 6) / 3 + i,
-                          ((TextLeft + (realglyph->root.advance.x >> 10)) >> 6),
-                          TextTop + yoff - (fixAscender >> 6) / 3 + i,
-                          NULL,
-                          ROP2_TO_MIX(R2_COPYPEN));
+                IntEngLineTo(SurfObj,
+                             (CLIPOBJ *)&dc->co,
+                             &dc->eboText.BrushObject,
+                             (TextLeft >> 6),
+                             TextTop + yoff - (fixAscender >> 6) / 3 + i,
+                             ((TextLeft + (realglyph->root.advance.x >> 10)) >> 6),
+                             TextTop + yoff - (fixAscender >> 6) / 3 + i,
+                             NULL,
+                             ROP2_TO_MIX(R2_COPYPEN));
             }
         }
 
@@ -142,6 +142,15 @@ enum
     REF_MASK_INUSE = 0x00ffffff,
 };
 
+/* Free entries kept per thread, and how many move at once to or from the
+   global free list */
+#define GDI_FREE_ENTRY_BATCH 16
+#define GDI_FREE_ENTRY_CACHE (2 * GDI_FREE_ENTRY_BATCH)
+
+/* Free entries all the thread caches together may keep, entries in the
+   cache of another thread can't be used when the table runs full */
+#define GDI_FREE_ENTRY_CACHE_TOTAL (64 * GDI_FREE_ENTRY_CACHE)
+
 /* GLOBALS *******************************************************************/
 
 /* Per session handle table globals */
@@ -150,6 +159,7 @@ PENTRY gpentHmgr;
 PULONG gpaulRefCount;
 volatile ULONG gulFirstFree;
 volatile ULONG gulFirstUnused;
+volatile LONG glFreeEntryCacheBudget;
 static PPAGED_LOOKASIDE_LIST gpaLookasideList;
 
 static VOID NTAPI GDIOBJ_vCleanup(PVOID ObjectBody);
@@ -304,6 +314,7 @@ InitGdiHandleTable(void)
 
     gulFirstFree = 0;
     gulFirstUnused = RESERVE_ENTRIES_COUNT;
+    glFreeEntryCacheBudget = GDI_FREE_ENTRY_CACHE_TOTAL;
 
     GdiHandleTable = (PVOID)gpentHmgr;
 
@@ -377,15 +388,184 @@ DecrementGdiHandleCount(ULONG ulProcessId)
     if (NT_SUCCESS(Status)) ObDereferenceObject(pep);
 }
 
+/* Follows the free list link of an entry */
+FORCEINLINE
+ULONG
+ENTRY_ulNextFree(ULONG ulIndex)
+{
+    return GDI_HANDLE_GET_INDEX(gpentHmgr[ulIndex].einfo.hFree);
+}
+
+/* Returns the THREADINFO whose free entry cache can be used, if any */
+FORCEINLINE
+PTHREADINFO
+ENTRY_ptiFreeCache(VOID)
+{
+    PTHREADINFO pti = PsGetCurrentThreadWin32Thread();
+
+    if (!pti || (pti->TIF_flags & TIF_INCLEANUP))
+        return NULL;
+
+    if (pti->cFreeGdiEntriesReserved)
+        return pti;
+
+    /* Reserve room for a full cache, once per thread. When the budget is
+       gone, the thread uses the global free list directly */
+    if (glFreeEntryCacheBudget < GDI_FREE_ENTRY_CACHE)
+        return NULL;
+
+    if (InterlockedExchangeAdd(&glFreeEntryCacheBudget, -GDI_FREE_ENTRY_CACHE) < GDI_FREE_ENTRY_CACHE)
+    {
+        /* Someone else was faster */
+        InterlockedExchangeAdd(&glFreeEntryCacheBudget, GDI_FREE_ENTRY_CACHE);
+        return NULL;
+    }
+
+    pti->cFreeGdiEntriesReserved = GDI_FREE_ENTRY_CACHE;
+    return pti;
+}
+
+/* Pushes the linked entries from iFirst to iLast to the free list */
+static
+VOID
+ENTRY_vPushFreeChain(ULONG iFirst, ULONG iLast)
+{
+    ULONG iHead, iNew, iPrev;
+
+    do
+    {
+        /* Get the current first free index and sequence number */
+        iHead = InterlockedReadUlong(&gulFirstFree);
+
+        /* Link the last entry of the chain to the current first one */
+        gpentHmgr[iLast].einfo.pobj = UlongToPtr(iHead & GDI_HANDLE_INDEX_MASK);
+
+        /* Combine the new index and increased sequence number */
+        iNew = iFirst | ((iHead & ~GDI_HANDLE_INDEX_MASK) + 0x10000);
+
+        /* Try to atomically update the first free entry */
+        iPrev = InterlockedCompareExchange((LONG*)&gulFirstFree,
+                                           iNew,
+                                           iHead);
+    }
+    while (iPrev != iHead);
+}
+
+/* Moves up to GDI_FREE_ENTRY_BATCH entries from the free list to the cache
+   of the current thread, with a single exchange of the list head */
+static
+VOID
+ENTRY_vRefillFreeCache(PTHREADINFO pti)
+{
+    ULONG iFirst, iLast, iNext, iPrev, cEntries;
+
+    do
+    {
+        /* Get the index and sequence number of the first free entry */
+        iFirst = InterlockedReadUlong(&gulFirstFree);
+        if (!(iFirst & GDI_HANDLE_INDEX_MASK))
+        {
+            /* Nothing to take, the caller uses the unused entries */
+            return;
+        }
+
+        /* Find the end of the batch. The links may change under us, but
+           then so does the sequence number and the exchange fails */
+        iLast = iFirst & GDI_HANDLE_INDEX_MASK;
+        cEntries = 1;
+        while (cEntries < GDI_FREE_ENTRY_BATCH)
+        {
+            iNext = ENTRY_ulNextFree(iLast);
+            if (iNext == 0)
+                break;
+
+            iLast = iNext;
+            cEntries++;
+        }
+
+        /* Create a new value with an increased sequence number */
+        iNext = ENTRY_ulNextFree(iLast);
+        iNext |= (iFirst & ~GDI_HANDLE_INDEX_MASK) + 0x10000;
+
+        /* Try to take the whole batch */
+        iPrev = InterlockedCompareExchange((LONG*)&gulFirstFree,
+                                           iNext,
+                                           iFirst);
+    }
+    while (iPrev != iFirst);
+
+    /* The batch is ours now */
+    pti->iFirstFreeGdiEntry = iFirst & GDI_HANDLE_INDEX_MASK;
+    pti->cFreeGdiEntries = cEntries;
+}
+
+/* Gives back the cFree first entries of the cache of a thread */
+static
+VOID
+ENTRY_vSpillFreeCache(PTHREADINFO pti, ULONG cFree)
+{
+    ULONG iFirst, iLast, i;
+
+    ASSERT(cFree > 0 && cFree <= pti->cFreeGdiEntries);
+
+    iFirst = pti->iFirstFreeGdiEntry;
+    iLast = iFirst;
+    for (i = 1; i < cFree; i++)
+        iLast = ENTRY_ulNextFree(iLast);
+
+    pti->iFirstFreeGdiEntry = ENTRY_ulNextFree(iLast);
+    pti->cFreeGdiEntries -= cFree;
+
+    ENTRY_vPushFreeChain(iFirst, iLast);
+}
+
+/* Returns all cached free entries of a thread to the free list, and its
+   room in the cache budget to the other threads */
+VOID
+NTAPI
+GDIOBJ_vFlushFreeEntries(
+    _Inout_ PTHREADINFO pti)
+{
+    if (pti->cFreeGdiEntries)
+        ENTRY_vSpillFreeCache(pti, pti->cFreeGdiEntries);
+
+    if (pti->cFreeGdiEntriesReserved)
+    {
+        InterlockedExchangeAdd(&glFreeEntryCacheBudget, (LONG)pti->cFreeGdiEntriesReserved);
+        pti->cFreeGdiEntriesReserved = 0;
+    }
+}
+
 static
 PENTRY
 ENTRY_pentPopFreeEntry(VOID)
 {
     ULONG iFirst, iNext, iPrev;
     PENTRY pentFree;
+    PTHREADINFO pti;
 
     DPRINT("Enter InterLockedPopFreeEntry\n");
 
+    /* Try the cache of the current thread first */
+    pti = ENTRY_ptiFreeCache();
+    if (pti)
+    {
+        if (pti->cFreeGdiEntries == 0)
+            ENTRY_vRefillFreeCache(pti);
+
+        if (pti->cFreeGdiEntries != 0)
+        {
+            pentFree = &gpentHmgr[pti->iFirstFreeGdiEntry];
+            pti->iFirstFreeGdiEntry = ENTRY_ulNextFree(pti->iFirstFreeGdiEntry);
+            pti->cFreeGdiEntries--;
+
+            /* Sanity check: is entry really free? */
+            ASSERT(((ULONG_PTR)pentFree->einfo.pobj & ~GDI_HANDLE_INDEX_MASK) == 0);
+
+            return pentFree;
+        }
+    }
+
     do
     {
         /* Get the index and sequence number of the first free entry */
@@ -438,7 +618,8 @@ static
 VOID
 ENTRY_vPushFreeEntry(PENTRY pentFree)
 {
-    ULONG iToFree, iFirst, iPrev, idxToFree;
+    ULONG idxToFree;
+    PTHREADINFO pti;
 
     DPRINT("Enter ENTRY_vPushFreeEntry\n");
 
@@ -454,23 +635,21 @@ ENTRY_vPushFreeEntry(PENTRY pentFree)
     InterlockedExchangeAdd((LONG*)&gpaulRefCount[idxToFree], REF_INC_REUSE);
     pentFree->FullUnique += 0x0100;
 
-    do
+    /* Keep it for the next allocation of the current thread */
+    pti = ENTRY_ptiFreeCache();
+    if (pti)
     {
-        /* Get the current first free index and sequence number */
-        iFirst = InterlockedReadUlong(&gulFirstFree);
-
-        /* Set the einfo.pobj member to the index of the first free entry */
-        pentFree->einfo.pobj = UlongToPtr(iFirst & GDI_HANDLE_INDEX_MASK);
-
-        /* Combine new index and increased sequence number in iToFree */
-        iToFree = idxToFree | ((iFirst & ~GDI_HANDLE_INDEX_MASK) + 0x10000);
+        /* Give a batch back when the cache is full */
+        if (pti->cFreeGdiEntries >= GDI_FREE_ENTRY_CACHE)
+            ENTRY_vSpillFreeCache(pti, GDI_FREE_ENTRY_BATCH);
 
-        /* Try to atomically update the first free entry */
-        iPrev = InterlockedCompareExchange((LONG*)&gulFirstFree,
-                                           iToFree,
-                                           iFirst);
+        pentFree->einfo.pobj = UlongToPtr(pti->iFirstFreeGdiEntry);
+        pti->iFirstFreeGdiEntry = idxToFree;
+        pti->cFreeGdiEntries++;
+        return;
     }
-    while (iPrev != iFirst);
+
+    ENTRY_vPushFreeChain(idxToFree, idxToFree);
 }
 
 static
@@ -77,6 +77,11 @@ NTSTATUS
 NTAPI
 InitGdiHandleTable(VOID);
 
+VOID
+NTAPI
+GDIOBJ_vFlushFreeEntries(
+    _Inout_ struct _THREADINFO *pti);
+
 BOOL
 NTAPI
 GreIsHandleValid(
@@ -73,6 +73,12 @@ GdiThreadCreate(PETHREAD Thread)
 NTSTATUS
 GdiThreadDestroy(PETHREAD Thread)
 {
+    PTHREADINFO pti = PsGetThreadWin32Thread(Thread);
+
+    /* Don't keep handle table entries for a thread that won't use them */
+    if (pti)
+        GDIOBJ_vFlushFreeEntries(pti);
+
     return STATUS_SUCCESS;
 }
 
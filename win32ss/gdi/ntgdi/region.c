@@ -669,6 +669,125 @@ REGION_SetExtents(
     pReg->rdh.iType = RDH_RECTANGLES;
 }
 
+/*
+ * Because of the banding, both the tops and the bottoms of the rects are
+ * sorted in ascending order, and the rects of a band are sorted by x. This
+ * makes the rect array its own y-band index, which can be binary searched.
+ */
+
+/* Returns the first rect whose bottom is below y, that is the first rect of
+   the band containing y or of the next band below it */
+static
+PRECTL
+FASTCALL
+REGION_pFindBand(
+    _In_ PREGION prgn,
+    _In_ INT y)
+{
+    ULONG iLow = 0, iHigh = prgn->rdh.nCount, iMiddle;
+
+    while (iLow < iHigh)
+    {
+        iMiddle = iLow + (iHigh - iLow) / 2;
+        if (prgn->Buffer[iMiddle].bottom <= y)
+            iLow = iMiddle + 1;
+        else
+            iHigh = iMiddle;
+    }
+
+    return &prgn->Buffer[iLow];
+}
+
+/* Returns the first rect whose top is at or below y */
+static
+PRECTL
+FASTCALL
+REGION_pFindTop(
+    _In_ PRECTL prclFirst,
+    _In_ PRECTL prclEnd,
+    _In_ INT y)
+{
+    PRECTL prclMiddle;
+
+    while (prclFirst < prclEnd)
+    {
+        prclMiddle = prclFirst + (prclEnd - prclFirst) / 2;
+        if (prclMiddle->top < y)
+            prclFirst = prclMiddle + 1;
+        else
+            prclEnd = prclMiddle;
+    }
+
+    return prclFirst;
+}
+
+/* Returns the first rect of a band whose right edge is right of x */
+static
+PRECTL
+FASTCALL
+REGION_pFindInBand(
+    _In_ PRECTL prclFirst,
+    _In_ PRECTL prclBandEnd,
+    _In_ INT x)
+{
+    PRECTL prclMiddle;
+
+    while (prclFirst < prclBandEnd)
+    {
+        prclMiddle = prclFirst + (prclBandEnd - prclFirst) / 2;
+        if (prclMiddle->right <= x)
+            prclFirst = prclMiddle + 1;
+        else
+            prclBandEnd = prclMiddle;
+    }
+
+    return prclFirst;
+}
+
+/* Checks whether a single rect of the region covers the given rect */
+static
+BOOL
+FASTCALL
+REGION_bRectCovered(
+    _In_ PREGION prgn,
+    _In_ const RECTL *prcl)
+{
+    PRECTL prclBand, prclBandEnd, prclEnd;
+
+    /* Only the band containing the top of the rect can have such a rect */
+    prclEnd = prgn->Buffer + prgn->rdh.nCount;
+    prclBand = REGION_pFindBand(prgn, prcl->top);
+    if ((prclBand == prclEnd) || (prclBand->top > prcl->top))
+        return FALSE;
+
+    prclBandEnd = REGION_pFindTop(prclBand, prclEnd, prclBand->top + 1);
+    prclBand = REGION_pFindInBand(prclBand, prclBandEnd, prcl->left);
+
+    return (prclBand != prclBandEnd) &&
+           (prclBand->left <= prcl->left) &&
+           (prclBand->right >= prcl->right) &&
+           (prclBand->bottom >= prcl->bottom);
+}
+
+/* Replaces the rects of a region, without going through REGION_RegionOp */
+static
+BOOL
+FASTCALL
+REGION_bSetRects(
+    _Inout_ PREGION prgn,
+    _In_reads_(cRects) const RECTL *prcl,
+    _In_ ULONG cRects)
+{
+    prgn->rdh.nCount = 0;
+    if (!REGION_bEnsureBufferSize(prgn, cRects))
+        return FALSE;
+
+    COPY_RECTS(prgn->Buffer, (PRECTL)prcl, cRects);
+    prgn->rdh.nCount = cRects;
+    REGION_SetExtents(prgn);
+    return TRUE;
+}
+
 // FIXME: This function needs review and testing
 /***********************************************************************
  *           REGION_CropRegion
@@ -695,21 +814,15 @@ REGION_CropRegion(
     }
 
     /* Skip all rects that are completely above our intersect rect */
-    for (clipa = 0; clipa < rgnSrc->rdh.nCount; clipa++)
-    {
-        /* bottom is exclusive, so break when we go above it */
-        if (rgnSrc->Buffer[clipa].bottom > rect->top) break;
-    }
+    clipa = (ULONG)(REGION_pFindBand(rgnSrc, rect->top) - rgnSrc->Buffer);
 
     /* Bail out, if there is nothing left */
     if (clipa == rgnSrc->rdh.nCount) goto empty;
 
     /* Find the last rect that is still within the intersect rect (exclusive) */
-    for (clipb = clipa; clipb < rgnSrc->rdh.nCount; clipb++)
-    {
-        /* bottom is exclusive, so stop, when we start at that y pos */
-        if (rgnSrc->Buffer[clipb].top >= rect->bottom) break;
-    }
+    clipb = (ULONG)(REGION_pFindTop(&rgnSrc->Buffer[clipa],
+                                    rgnSrc->Buffer + rgnSrc->rdh.nCount,
+                                    rect->bottom) - rgnSrc->Buffer);
 
     /* Bail out, if there is nothing left */
     if (clipb == clipa) goto empty;
@@ -1315,6 +1428,35 @@ REGION_IntersectRegion(
     {
         newReg->rdh.nCount = 0;
     }
+    else if ((reg2->rdh.nCount == 1) &&
+             (reg2->Buffer[0].left <= reg1->rdh.rcBound.left) &&
+             (reg2->Buffer[0].top <= reg1->rdh.rcBound.top) &&
+             (reg2->Buffer[0].right >= reg1->rdh.rcBound.right) &&
+             (reg2->Buffer[0].bottom >= reg1->rdh.rcBound.bottom))
+    {
+        /* Clipping to a rect that contains the region, e.g. the client
+           area of the parent window */
+        return REGION_CopyRegion(newReg, reg1);
+    }
+    else if ((reg1->rdh.nCount == 1) &&
+             (reg1->Buffer[0].left <= reg2->rdh.rcBound.left) &&
+             (reg1->Buffer[0].top <= reg2->rdh.rcBound.top) &&
+             (reg1->Buffer[0].right >= reg2->rdh.rcBound.right) &&
+             (reg1->Buffer[0].bottom >= reg2->rdh.rcBound.bottom))
+    {
+        return REGION_CopyRegion(newReg, reg2);
+    }
+    else if ((reg1->rdh.nCount == 1) && (reg2->rdh.nCount == 1))
+    {
+        RECTL rcl;
+
+        /* Two overlapping rects */
+        rcl.left = max(reg1->Buffer[0].left, reg2->Buffer[0].left);
+        rcl.top = max(reg1->Buffer[0].top, reg2->Buffer[0].top);
+        rcl.right = min(reg1->Buffer[0].right, reg2->Buffer[0].right);
+        rcl.bottom = min(reg1->Buffer[0].bottom, reg2->Buffer[0].bottom);
+        return REGION_bSetRects(newReg, &rcl, 1);
+    }
     else
     {
         if (!REGION_RegionOp(newReg,
@@ -1539,6 +1681,29 @@ REGION_UnionRegion(
         return ret;
     }
 
+    /* Region 2 is a rect that is already part of region 1, which is what
+       invalidating an area that is already invalid comes down to */
+    if ((reg2->rdh.nCount == 1) && REGION_bRectCovered(reg1, &reg2->Buffer[0]))
+    {
+        if (newReg != reg1)
+        {
+            ret = REGION_CopyRegion(newReg, reg1);
+        }
+
+        return ret;
+    }
+
+    /* Region 1 is a rect that is already part of region 2 */
+    if ((reg1->rdh.nCount == 1) && REGION_bRectCovered(reg2, &reg1->Buffer[0]))
+    {
+        if (newReg != reg2)
+        {
+            ret = REGION_CopyRegion(newReg, reg2);
+        }
+
+        return ret;
+    }
+
     if ((ret = REGION_RegionOp(newReg,
                     reg1,
                     reg2,
@@ -1742,6 +1907,68 @@ REGION_SubtractRegion(
         return REGION_CopyRegion(regD, regM);
     }
 
+    if (regS->rdh.nCount == 1)
+    {
+        const RECTL *prclS = &regS->Buffer[0];
+        const RECTL *prclM = &regM->Buffer[0];
+        RECTL arcl[4];
+        ULONG cRects = 0;
+
+        /* Nothing is left of a region inside the rect */
+        if ((prclS->left <= regM->rdh.rcBound.left) &&
+            (prclS->top <= regM->rdh.rcBound.top) &&
+            (prclS->right >= regM->rdh.rcBound.right) &&
+            (prclS->bottom >= regM->rdh.rcBound.bottom))
+        {
+            EMPTY_REGION(regD);
+            return TRUE;
+        }
+
+        /* A rect minus an overlapping rect, e.g. a window minus a sibling
+           on top of it, is at most a band above, one with a rect on either
+           side, and one below */
+        if (regM->rdh.nCount == 1)
+        {
+            if (prclS->top > prclM->top)
+            {
+                arcl[cRects].left = prclM->left;
+                arcl[cRects].top = prclM->top;
+                arcl[cRects].right = prclM->right;
+                arcl[cRects].bottom = prclS->top;
+                cRects++;
+            }
+
+            if (prclS->left > prclM->left)
+            {
+                arcl[cRects].left = prclM->left;
+                arcl[cRects].top = max(prclM->top, prclS->top);
+                arcl[cRects].right = prclS->left;
+                arcl[cRects].bottom = min(prclM->bottom, prclS->bottom);
+                cRects++;
+            }
+
+            if (prclS->right < prclM->right)
+            {
+                arcl[cRects].left = prclS->right;
+                arcl[cRects].top = max(prclM->top, prclS->top);
+                arcl[cRects].right = prclM->right;
+                arcl[cRects].bottom = min(prclM->bottom, prclS->bottom);
+                cRects++;
+            }
+
+            if (prclS->bottom < prclM->bottom)
+            {
+                arcl[cRects].left = prclM->left;
+                arcl[cRects].top = prclS->bottom;
+                arcl[cRects].right = prclM->right;
+                arcl[cRects].bottom = prclM->bottom;
+                cRects++;
+            }
+
+            return REGION_bSetRects(regD, arcl, cRects);
+        }
+    }
+
     if (!REGION_RegionOp(regD,
                     regM,
                     regS,
@@ -2604,17 +2831,20 @@ REGION_PtInRegion(
     INT X,
     INT Y)
 {
-    ULONG i;
-    PRECT r;
+    PRECTL prclBand, prclBandEnd;
 
     if (prgn->rdh.nCount > 0 && INRECT(prgn->rdh.rcBound, X, Y))
     {
-        r =  prgn->Buffer;
-        for (i = 0; i < prgn->rdh.nCount; i++)
-        {
-            if (INRECT(r[i], X, Y))
-                return TRUE;
-        }
+        /* Find the band containing Y, then the rect containing X */
+        prclBand = REGION_pFindBand(prgn, Y);
+        if (prclBand->top > Y)
+            return FALSE;
+
+        prclBandEnd = REGION_pFindTop(prclBand,
+                                      prgn->Buffer + prgn->rdh.nCount,
+                                      prclBand->top + 1);
+        prclBand = REGION_pFindInBand(prclBand, prclBandEnd, X);
+        return (prclBand != prclBandEnd) && (prclBand->left <= X);
     }
 
     return FALSE;
@@ -2626,7 +2856,7 @@ REGION_RectInRegion(
     PREGION Rgn,
     const RECTL *rect)
 {
-    PRECTL pCurRect, pRectEnd;
+    PRECTL pCurRect, pBandEnd, pRectEnd;
     RECT rc;
 
     /* Swap the coordinates to make right >= left and bottom >= top */
@@ -2656,24 +2886,19 @@ REGION_RectInRegion(
     /* This is (just) a useful optimization */
     if ((Rgn->rdh.nCount > 0) && EXTENTCHECK(&Rgn->rdh.rcBound, &rc))
     {
-        for (pCurRect = Rgn->Buffer, pRectEnd = pCurRect +
-                                                Rgn->rdh.nCount; pCurRect < pRectEnd; pCurRect++)
-        {
-            if (pCurRect->bottom <= rc.top)
-                continue;             /* Not far enough down yet */
-
-            if (pCurRect->top >= rc.bottom)
-                break;                /* Too far down */
+        pRectEnd = Rgn->Buffer + Rgn->rdh.nCount;
 
-            if (pCurRect->right <= rc.left)
-                continue;              /* Not far enough over yet */
-
-            if (pCurRect->left >= rc.right)
-            {
-                continue;
-            }
+        /* Skip the bands above the rect, then check the bands it spans */
+        for (pCurRect = REGION_pFindBand(Rgn, rc.top);
+             (pCurRect < pRectEnd) && (pCurRect->top < rc.bottom);
+             pCurRect = pBandEnd)
+        {
+            pBandEnd = REGION_pFindTop(pCurRect, pRectEnd, pCurRect->top + 1);
 
-            return TRUE;
+            /* The first rect in the band that is not left of the rect */
+            pCurRect = REGION_pFindInBand(pCurRect, pBandEnd, rc.left);
+            if ((pCurRect != pBandEnd) && (pCurRect->left < rc.right))
+                return TRUE;
         }
     }
 
@@ -151,6 +151,10 @@ typedef struct _THREADINFO
     LIST_ENTRY W32CallbackListHead;
     SINGLE_LIST_ENTRY  ReferencesList;
     ULONG cExclusiveLocks;
+    /* Free GDI handle table entries kept by this thread, see gdiobj.c */
+    ULONG iFirstFreeGdiEntry;
+    ULONG cFreeGdiEntries;
+    ULONG cFreeGdiEntriesReserved;
 #if DBG
     USHORT acExclusiveLockCount[GDIObjTypeTotal + 1];
 #endif
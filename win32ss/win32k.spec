@@ -44,6 +44,7 @@
 @ stdcall EngDeviceIoControl(ptr long ptr long ptr long ptr)
 @ stdcall EngDitherColor(ptr long long long)
 @ stdcall EngDxIoctl(long ptr long)
+@ stdcall EngEnableDamage(ptr long)
 @ stdcall EngEnumForms(ptr long ptr long ptr ptr)
 @ stdcall EngEraseSurface(ptr ptr long)
 @ stdcall EngFileIoControl(ptr long ptr ptr ptr ptr ptr)
@@ -104,6 +105,7 @@
 @ stdcall EngPlgBlt(ptr ptr ptr ptr ptr ptr ptr ptr ptr ptr long)
 @ stdcall EngProbeForRead(ptr long long) NTOSKRNL.ProbeForRead
 @ stdcall EngProbeForReadAndWrite(ptr long long) NTOSKRNL.ProbeForWrite
+@ stdcall EngQueryDamage(ptr long ptr long)
 @ stdcall EngQueryDeviceAttribute(ptr long ptr long ptr long)
 @ stdcall EngQueryFileTimeStamp(ptr)
 @ stdcall EngQueryLocalTime(ptr)
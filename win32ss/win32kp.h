@@ -34,6 +34,7 @@ typedef struct _DC *PDC;
 #include "gdi/eng/xlateobj.h"
 #include "gdi/eng/floatobj.h"
 #include "gdi/eng/mouse.h"
+#include "gdi/eng/damage.h"
 #include "gdi/eng/mapping.h"
 #include "gdi/ntgdi/xformobj.h"
 #include "gdi/ntgdi/brush.h"